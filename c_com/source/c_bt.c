@@ -272,6 +272,10 @@ UBYTE     cBtFindSearchAdr(bdaddr_t *pAdr, UBYTE *pIndex);
 void      cBtSetSearchConnectedStatus(UBYTE Index);
 void      cBtClearSearchConnectedStatus(UBYTE Index);
 void      BtCloseBtSocket(SLONG *pBtSocket);
+void      cBtApplyLinkPolicy(UBYTE ChNo, UWORD ConnHandle);
+void      cBtLinkStatTx(UBYTE ChNo, UBYTE *pMsg, UWORD Size);
+void      cBtLinkStatRx(UBYTE ChNo, MSGBUF *pMsgBuf);
+void      BtTxBroadcast(UBYTE ChNo);
 
 static char               *get_adapter_path(DBusConnection *conn, const char *adapter);
 static DBusHandlerResult   agent_message(DBusConnection *conn, DBusMessage *msg, void *data);
@@ -396,6 +400,9 @@ void      BtClearChBuf(UBYTE ChNo)
   BtInstance.BtCh[ChNo].MsgBuf.LargeMsg  =  FALSE;
   BtInstance.BtCh[ChNo].MsgBuf.MsgLen    =  0;
   BtInstance.BtCh[ChNo].MsgBuf.RemMsgLen =  0;
+
+  BtInstance.BtCh[ChNo].Rtt.Pending      =  FALSE;
+  BtInstance.BtCh[ChNo].Turn.Pending     =  FALSE;
 }
 
 
@@ -454,6 +461,16 @@ void      BtInit(char* pName)
 
   BtInstance.HciSocket.Socket = -1;
 
+  for(Tmp = 0; Tmp < NO_OF_BT_CHS; Tmp++)
+  {
+    BtInstance.BtCh[Tmp].LinkPolicy.Sniff       =  BT_LINK_SNIFF;
+    BtInstance.BtCh[Tmp].LinkPolicy.PktType     =  BT_LINK_PKT_TYPE;
+    BtInstance.BtCh[Tmp].LinkPolicy.PollSlots   =  BT_LINK_POLL_SLOTS;
+    BtInstance.BtCh[Tmp].LinkPolicy.FlushSlots  =  BT_LINK_FLUSH_SLOTS;
+    cBtClearLinkStat(Tmp);
+  }
+  memset(&(BtInstance.Broadcast), 0, sizeof(BtInstance.Broadcast));
+
   if (TRUE == BtInstance.NonVol.On)
   {
     BtInstance.State =  TURN_ON;
@@ -781,6 +798,7 @@ UWORD     cBtReadCh0(UBYTE *pBuf, UWORD Length)
       printf("\r\n MSG_BUF_FULL - Reading from cCom on Bt Channel 0 number of bytes = %d\r\n",pMsgBuf->InPtr);
     #endif
 
+    cBtLinkStatRx(0, pMsgBuf);
     memcpy(pBuf, pMsgBuf->Buf, (pMsgBuf->InPtr));
     RtnLen           =  pMsgBuf->InPtr;
     pMsgBuf->Status  =  MSG_BUF_EMPTY;
@@ -803,6 +821,7 @@ UWORD     cBtReadCh1(UBYTE *pBuf, UWORD Length)
       printf("\r\n MSG_BUF_FULL on Bt Channel 1 %d bytes copied\r\n",pMsgBuf->InPtr);
     #endif
 
+    cBtLinkStatRx(1, pMsgBuf);
     memcpy(pBuf, pMsgBuf->Buf, (pMsgBuf->InPtr));
     RtnLen           =  pMsgBuf->InPtr;
     pMsgBuf->Status  =  MSG_BUF_EMPTY;
@@ -825,6 +844,7 @@ UWORD     cBtReadCh2(UBYTE *pBuf, UWORD Length)
       printf("\r\n MSG_BUF_FULL on Bt Channel 1\r\n");
     #endif
 
+    cBtLinkStatRx(2, pMsgBuf);
     memcpy(pBuf, pMsgBuf->Buf, (pMsgBuf->InPtr));
     RtnLen           =  pMsgBuf->InPtr;
     pMsgBuf->Status  =  MSG_BUF_EMPTY;
@@ -847,6 +867,7 @@ UWORD      cBtReadCh3(UBYTE *pBuf, UWORD Length)
       printf("\r\n MSG_BUF_FULL on Bt Channel 1\r\n");
     #endif
 
+    cBtLinkStatRx(3, pMsgBuf);
     memcpy(pBuf, pMsgBuf->Buf, (pMsgBuf->InPtr));
     RtnLen           =  pMsgBuf->InPtr;
     pMsgBuf->Status  =  MSG_BUF_EMPTY;
@@ -869,6 +890,7 @@ UWORD      cBtReadCh4(UBYTE *pBuf, UWORD Length)
       printf("\r\n MSG_BUF_FULL on Bt Channel 1\r\n");
     #endif
 
+    cBtLinkStatRx(4, pMsgBuf);
     memcpy(pBuf, pMsgBuf->Buf, (pMsgBuf->InPtr));
     RtnLen           =  pMsgBuf->InPtr;
     pMsgBuf->Status  =  MSG_BUF_EMPTY;
@@ -891,6 +913,7 @@ UWORD      cBtReadCh5(UBYTE *pBuf, UWORD Length)
       printf("\r\n MSG_BUF_FULL on Bt Channel 1\r\n");
     #endif
 
+    cBtLinkStatRx(5, pMsgBuf);
     memcpy(pBuf, pMsgBuf->Buf, (pMsgBuf->InPtr));
     RtnLen           =  pMsgBuf->InPtr;
     pMsgBuf->Status  =  MSG_BUF_EMPTY;
@@ -913,6 +936,7 @@ UWORD      cBtReadCh6(UBYTE *pBuf, UWORD Length)
       printf("\r\n MSG_BUF_FULL on Bt Channel 1\r\n");
     #endif
 
+    cBtLinkStatRx(6, pMsgBuf);
     memcpy(pBuf, pMsgBuf->Buf, (pMsgBuf->InPtr));
     RtnLen           =  pMsgBuf->InPtr;
     pMsgBuf->Status  =  MSG_BUF_EMPTY;
@@ -934,6 +958,7 @@ UWORD      cBtReadCh7(UBYTE *pBuf, UWORD Length)
       printf("\r\n MSG_BUF_FULL on Bt Channel 1\r\n");
     #endif
 
+    cBtLinkStatRx(7, pMsgBuf);
     memcpy(pBuf, pMsgBuf->Buf, (pMsgBuf->InPtr));
     RtnLen           =  pMsgBuf->InPtr;
     pMsgBuf->Status  =  MSG_BUF_EMPTY;
@@ -2592,7 +2617,158 @@ void      BtTxMsgs(void)
         pWriteBuf->OutPtr = 0;
       }
     }
+    else
+    {
+      if (BtInstance.Broadcast.Pending & (1 << Cnt))
+      {
+        // Own messages sent - now the broadcast
+        BtTxBroadcast(Cnt);
+      }
+    }
+  }
+}
+
+
+/*! \brief  Release a channel from the broadcast message
+ *
+ *  The buffer is free again when the last channel is released
+ */
+void      BtBroadcastRelease(UBYTE ChNo, UBYTE Delivered)
+{
+  BTBROADCAST *pBroadcast;
+
+  pBroadcast  =  &(BtInstance.Broadcast);
+
+  if (pBroadcast->Pending & (1 << ChNo))
+  {
+    pBroadcast->Pending  &=  ~(1 << ChNo);
+    if (TRUE == Delivered)
+    {
+      pBroadcast->Delivered  |=  (1 << ChNo);
+    }
+    else
+    {
+      pBroadcast->Failed     |=  (1 << ChNo);
+    }
+    pBroadcast->RefCnt--;
+
+    #ifdef DEBUG_TRACE_BT_BROADCAST
+      if (0 == pBroadcast->RefCnt)
+      {
+        struct  timeval NowVal;
+
+        gettimeofday(&NowVal, NULL);
+        printf("\r\nBT broadcast %d bytes done in %ld uS - delivered %02X, failed %02X\r\n", pBroadcast->Size, (long)(((NowVal.tv_sec - pBroadcast->StartVal.tv_sec) * 1000000) + (NowVal.tv_usec - pBroadcast->StartVal.tv_usec)), pBroadcast->Delivered, pBroadcast->Failed);
+      }
+    #endif
+  }
+}
+
+
+/*! \brief  Send what the socket takes of the broadcast message on one channel
+ *
+ *  Non blocking - a full socket is just tried again at the next BtTxMsgs
+ */
+void      BtTxBroadcast(UBYTE ChNo)
+{
+  BTBROADCAST *pBroadcast;
+  BTSOCKET    *pBtSocket;
+  SWORD       NoWritten;
+
+  pBroadcast  =  &(BtInstance.Broadcast);
+  pBtSocket   =  &(BtInstance.BtCh[ChNo].BtSocket);
+
+  if ((-1 != pBtSocket->Socket) && (CH_CONNECTED == BtInstance.BtCh[ChNo].Status))
+  {
+    NoWritten = send(pBtSocket->Socket, &(pBroadcast->Buf[pBroadcast->OutPtr[ChNo]]), (pBroadcast->Size - pBroadcast->OutPtr[ChNo]), MSG_DONTWAIT);
+
+    if (0 < NoWritten)
+    {
+      pBroadcast->OutPtr[ChNo] += NoWritten;
+      if (pBroadcast->OutPtr[ChNo] >= pBroadcast->Size)
+      {
+        BtBroadcastRelease(ChNo, TRUE);
+      }
+    }
+    else
+    {
+      if ((EAGAIN != errno) && (EWOULDBLOCK != errno) && (EINTR != errno))
+      {
+        BtBroadcastRelease(ChNo, FALSE);
+      }
+    }
+  }
+  else
+  {
+    // Channel is gone
+    BtBroadcastRelease(ChNo, FALSE);
+  }
+}
+
+
+/*! \brief  Send one message to all connected devices, master included
+ *
+ *  The message is copied once and each channel sends from the shared
+ *  buffer as its socket allows. Messages already queued on a channel go
+ *  first, and the channel takes no new message until it has sent this one.
+ *
+ *  \return Size if queued, 0 if the previous broadcast is still being sent,
+ *          no device is connected or the master is connected in MODE2
+ *          (the caller then writes to each device on its own)
+ */
+UWORD     cBtBroadcast(UBYTE *pBuf, UWORD Size)
+{
+  BTBROADCAST *pBroadcast;
+  UBYTE       Cnt;
+  UWORD       RtnVal;
+
+  RtnVal      =  0;
+  pBroadcast  =  &(BtInstance.Broadcast);
+
+  // The master (channel 0) is reached through the I2C buffer in MODE2 - not from here
+  if ((MODE2 == BtInstance.NonVol.DecodeMode) && (CH_CONNECTED == BtInstance.BtCh[BT_SLAVE_CH0].Status))
+  {
+    Size  =  0;
+  }
+
+  if ((0 == pBroadcast->RefCnt) && (0 != Size) && (sizeof(pBroadcast->Buf) >= Size))
+  {
+    memcpy(pBroadcast->Buf, pBuf, Size);
+    pBroadcast->Size       =  Size;
+    pBroadcast->Pending    =  0;
+    pBroadcast->Delivered  =  0;
+    pBroadcast->Failed     =  0;
+    gettimeofday(&(pBroadcast->StartVal), NULL);
+
+    for (Cnt = BT_SLAVE_CH0; Cnt < NO_OF_BT_CHS; Cnt++)
+    {
+      if (CH_CONNECTED == BtInstance.BtCh[Cnt].Status)
+      {
+        pBroadcast->OutPtr[Cnt]  =  0;
+        pBroadcast->Pending     |=  (1 << Cnt);
+        pBroadcast->RefCnt++;
+        cBtLinkStatTx(Cnt, pBuf, Size);
+      }
+    }
+
+    if (0 != pBroadcast->RefCnt)
+    {
+      RtnVal  =  Size;
+    }
   }
+  return(RtnVal);
+}
+
+
+/*! \brief  Per slave status of the last broadcast
+ *
+ *  \return Channels (bits) still sending
+ */
+UBYTE     cBtGetBroadcastStatus(UBYTE *pDelivered, UBYTE *pFailed)
+{
+  *pDelivered  =  BtInstance.Broadcast.Delivered;
+  *pFailed     =  BtInstance.Broadcast.Failed;
+  return(BtInstance.Broadcast.Pending);
 }
 
 
@@ -2628,6 +2804,7 @@ UWORD     cBtDevWriteBuf(UBYTE *pBuf, UWORD Size)
     {
       memcpy(BtInstance.Mode2WriteBuf.Buf, pBuf, Size);
       BtInstance.Mode2WriteBuf.InPtr = Size;
+      I2cWake();
     }
     else
     {
@@ -2636,10 +2813,11 @@ UWORD     cBtDevWriteBuf(UBYTE *pBuf, UWORD Size)
   }
   else
   {
-    if(0 == BtInstance.BtCh[0].WriteBuf.InPtr)
+    if((0 == BtInstance.BtCh[0].WriteBuf.InPtr) && (0 == (BtInstance.Broadcast.Pending & (1 << 0))))
     {
       memcpy(BtInstance.BtCh[0].WriteBuf.Buf, pBuf, Size);
       BtInstance.BtCh[0].WriteBuf.InPtr = Size;
+      cBtLinkStatTx(0, pBuf, Size);
     }
     else
     {
@@ -2652,10 +2830,11 @@ UWORD     cBtDevWriteBuf(UBYTE *pBuf, UWORD Size)
 
 UWORD     cBtDevWriteBuf1(UBYTE *pBuf, UWORD Size)
 {
-  if(0 == BtInstance.BtCh[1].WriteBuf.InPtr)
+  if((0 == BtInstance.BtCh[1].WriteBuf.InPtr) && (0 == (BtInstance.Broadcast.Pending & (1 << 1))))
   {
     memcpy(BtInstance.BtCh[1].WriteBuf.Buf, pBuf, Size);
     BtInstance.BtCh[1].WriteBuf.InPtr = Size;
+    cBtLinkStatTx(1, pBuf, Size);
   }
   else
   {
@@ -2667,10 +2846,11 @@ UWORD     cBtDevWriteBuf1(UBYTE *pBuf, UWORD Size)
 
 UWORD     cBtDevWriteBuf2(UBYTE *pBuf, UWORD Size)
 {
-  if(0 == BtInstance.BtCh[2].WriteBuf.InPtr)
+  if((0 == BtInstance.BtCh[2].WriteBuf.InPtr) && (0 == (BtInstance.Broadcast.Pending & (1 << 2))))
   {
     memcpy(BtInstance.BtCh[2].WriteBuf.Buf, pBuf, Size);
     BtInstance.BtCh[2].WriteBuf.InPtr = Size;
+    cBtLinkStatTx(2, pBuf, Size);
   }
   else
   {
@@ -2682,10 +2862,11 @@ UWORD     cBtDevWriteBuf2(UBYTE *pBuf, UWORD Size)
 
 UWORD     cBtDevWriteBuf3(UBYTE *pBuf, UWORD Size)
 {
-  if(0 == BtInstance.BtCh[3].WriteBuf.InPtr)
+  if((0 == BtInstance.BtCh[3].WriteBuf.InPtr) && (0 == (BtInstance.Broadcast.Pending & (1 << 3))))
   {
     memcpy(BtInstance.BtCh[3].WriteBuf.Buf, pBuf, Size);
     BtInstance.BtCh[3].WriteBuf.InPtr = Size;
+    cBtLinkStatTx(3, pBuf, Size);
   }
   else
   {
@@ -2697,10 +2878,11 @@ UWORD     cBtDevWriteBuf3(UBYTE *pBuf, UWORD Size)
 
 UWORD     cBtDevWriteBuf4(UBYTE *pBuf, UWORD Size)
 {
-  if(0 == BtInstance.BtCh[4].WriteBuf.InPtr)
+  if((0 == BtInstance.BtCh[4].WriteBuf.InPtr) && (0 == (BtInstance.Broadcast.Pending & (1 << 4))))
   {
     memcpy(BtInstance.BtCh[4].WriteBuf.Buf, pBuf, Size);
     BtInstance.BtCh[4].WriteBuf.InPtr = Size;
+    cBtLinkStatTx(4, pBuf, Size);
   }
   else
   {
@@ -2712,10 +2894,11 @@ UWORD     cBtDevWriteBuf4(UBYTE *pBuf, UWORD Size)
 
 UWORD     cBtDevWriteBuf5(UBYTE *pBuf, UWORD Size)
 {
-  if(0 == BtInstance.BtCh[5].WriteBuf.InPtr)
+  if((0 == BtInstance.BtCh[5].WriteBuf.InPtr) && (0 == (BtInstance.Broadcast.Pending & (1 << 5))))
   {
     memcpy(BtInstance.BtCh[5].WriteBuf.Buf, pBuf, Size);
     BtInstance.BtCh[5].WriteBuf.InPtr = Size;
+    cBtLinkStatTx(5, pBuf, Size);
   }
   else
   {
@@ -2727,10 +2910,11 @@ UWORD     cBtDevWriteBuf5(UBYTE *pBuf, UWORD Size)
 
 UWORD     cBtDevWriteBuf6(UBYTE *pBuf, UWORD Size)
 {
-  if(0 == BtInstance.BtCh[6].WriteBuf.InPtr)
+  if((0 == BtInstance.BtCh[6].WriteBuf.InPtr) && (0 == (BtInstance.Broadcast.Pending & (1 << 6))))
   {
     memcpy(BtInstance.BtCh[6].WriteBuf.Buf, pBuf, Size);
     BtInstance.BtCh[6].WriteBuf.InPtr = Size;
+    cBtLinkStatTx(6, pBuf, Size);
   }
   else
   {
@@ -2742,10 +2926,11 @@ UWORD     cBtDevWriteBuf6(UBYTE *pBuf, UWORD Size)
 
 UWORD     cBtDevWriteBuf7(UBYTE *pBuf, UWORD Size)
 {
-  if(0 == BtInstance.BtCh[7].WriteBuf.InPtr)
+  if((0 == BtInstance.BtCh[7].WriteBuf.InPtr) && (0 == (BtInstance.Broadcast.Pending & (1 << 7))))
   {
     memcpy(BtInstance.BtCh[7].WriteBuf.Buf, pBuf, Size);
     BtInstance.BtCh[7].WriteBuf.InPtr = Size;
+    cBtLinkStatTx(7, pBuf, Size);
   }
   else
   {
@@ -2915,6 +3100,215 @@ void      cBtInsertDevConnHandle(UBYTE Index, UWORD ConnHandle)
 }
 
 
+/*! \brief  Issue the link policy of a channel on its ACL connection
+ *
+ *  Commands are fire and forget - command status/complete events are
+ *  ignored by cBtHandleHCI. A controller not supporting one of them
+ *  just keeps its default for that setting.
+ */
+void      cBtApplyLinkPolicy(UBYTE ChNo, UWORD ConnHandle)
+{
+  BTLINKPOLICY                      *pPolicy;
+  write_link_policy_cp              LinkPolicy;
+  exit_sniff_mode_cp                ExitSniff;
+  set_conn_ptype_cp                 PktType;
+  qos_setup_cp                      Qos;
+  write_automatic_flush_timeout_cp  FlushTo;
+
+  pPolicy  =  &(BtInstance.BtCh[ChNo].LinkPolicy);
+
+  if (-1 != BtInstance.HciSocket.Socket)
+  {
+    LinkPolicy.handle  =  ConnHandle;
+    LinkPolicy.policy  =  htobs(HCI_LP_RSWITCH | ((TRUE == pPolicy->Sniff) ? HCI_LP_SNIFF : 0));
+    hci_send_cmd(BtInstance.HciSocket.Socket, OGF_LINK_POLICY, OCF_WRITE_LINK_POLICY, WRITE_LINK_POLICY_CP_SIZE, &LinkPolicy);
+
+    if (FALSE == pPolicy->Sniff)
+    {
+      // Fails (harmless) if the link is already active
+      ExitSniff.handle  =  ConnHandle;
+      hci_send_cmd(BtInstance.HciSocket.Socket, OGF_LINK_POLICY, OCF_EXIT_SNIFF_MODE, EXIT_SNIFF_MODE_CP_SIZE, &ExitSniff);
+    }
+
+    PktType.handle    =  ConnHandle;
+    PktType.pkt_type  =  htobs(pPolicy->PktType);
+    hci_send_cmd(BtInstance.HciSocket.Socket, OGF_LINK_CTL, OCF_SET_CONN_PTYPE, SET_CONN_PTYPE_CP_SIZE, &PktType);
+
+    if (0 != pPolicy->PollSlots)
+    {
+      // Guaranteed service with a latency of PollSlots makes the master poll at least that often
+      memset(&Qos, 0, sizeof(Qos));
+      Qos.handle                =  ConnHandle;
+      Qos.qos.service_type      =  0x02;
+      Qos.qos.latency           =  htobl((ULONG)pPolicy->PollSlots * BT_SLOT_US);
+      Qos.qos.delay_variation   =  htobl(0xFFFFFFFF);
+      hci_send_cmd(BtInstance.HciSocket.Socket, OGF_LINK_POLICY, OCF_QOS_SETUP, QOS_SETUP_CP_SIZE, &Qos);
+    }
+
+    FlushTo.handle   =  ConnHandle;
+    FlushTo.timeout  =  htobs(pPolicy->FlushSlots);
+    hci_send_cmd(BtInstance.HciSocket.Socket, OGF_HOST_CTL, OCF_WRITE_AUTOMATIC_FLUSH_TIMEOUT, WRITE_AUTOMATIC_FLUSH_TIMEOUT_CP_SIZE, &FlushTo);
+
+    #ifdef DEBUG
+      printf("\r\nLink policy on ChNo %d handle %d: Sniff = %d, PktType = %04X, Poll = %d, Flush = %d\r\n", ChNo, ConnHandle, pPolicy->Sniff, pPolicy->PktType, pPolicy->PollSlots, pPolicy->FlushSlots);
+    #endif
+  }
+}
+
+
+UBYTE     cBtSetLinkPolicy(UBYTE ChNo, BTLINKPOLICY *pPolicy)
+{
+  UBYTE   RtnVal;
+  UBYTE   Index;
+
+  RtnVal = FAIL;
+  if (NO_OF_BT_CHS > ChNo)
+  {
+    BtInstance.BtCh[ChNo].LinkPolicy  =  *pPolicy;
+
+    // Connected now - no need to wait for the next connection
+    if (OK == cBtFindDevChNo(ChNo, &Index))
+    {
+      cBtApplyLinkPolicy(ChNo, BtInstance.NonVol.DevList[Index].ConnHandle);
+    }
+    RtnVal = OK;
+  }
+  return(RtnVal);
+}
+
+
+UBYTE     cBtGetLinkPolicy(UBYTE ChNo, BTLINKPOLICY *pPolicy, BTLINKSTAT *pRtt, BTLINKSTAT *pTurn)
+{
+  UBYTE   RtnVal;
+
+  RtnVal = FAIL;
+  if (NO_OF_BT_CHS > ChNo)
+  {
+    *pPolicy  =  BtInstance.BtCh[ChNo].LinkPolicy;
+    *pRtt     =  BtInstance.BtCh[ChNo].Rtt;
+    *pTurn    =  BtInstance.BtCh[ChNo].Turn;
+    RtnVal    =  OK;
+  }
+  return(RtnVal);
+}
+
+
+void      cBtClearLinkStat(UBYTE ChNo)
+{
+  if (NO_OF_BT_CHS > ChNo)
+  {
+    memset(&(BtInstance.BtCh[ChNo].Rtt), 0, sizeof(BTLINKSTAT));
+    memset(&(BtInstance.BtCh[ChNo].Turn), 0, sizeof(BTLINKSTAT));
+  }
+}
+
+
+void      cBtLinkStatAdd(BTLINKSTAT *pStat)
+{
+  struct  timeval NowVal;
+  ULONG   Time;
+
+  gettimeofday(&NowVal, NULL);
+  Time  =  (ULONG)((((NowVal.tv_sec - pStat->StartVal.tv_sec) * 1000000) + (NowVal.tv_usec - pStat->StartVal.tv_usec)) / 100);
+
+  if ((0 == pStat->Count) || (Time < pStat->Min))
+  {
+    pStat->Min  =  Time;
+  }
+  if (Time > pStat->Max)
+  {
+    pStat->Max  =  Time;
+  }
+  if (0xFFFF == pStat->Count)
+  {
+    // Saturated - restart the average
+    pStat->Count  =  0;
+    pStat->Sum    =  0;
+  }
+  pStat->Count++;
+  pStat->Sum     +=  Time;
+  pStat->Pending  =  FALSE;
+
+  #ifdef DEBUG_TRACE_BT_LINK
+    printf("\r\nBT link time %u.%u mS (min %u.%u, max %u.%u, n %u)\r\n", (unsigned)(Time / 10), (unsigned)(Time % 10), (unsigned)(pStat->Min / 10), (unsigned)(pStat->Min % 10), (unsigned)(pStat->Max / 10), (unsigned)(pStat->Max % 10), pStat->Count);
+  #endif
+}
+
+
+/*! \brief  Time command to reply on a channel - called with every message sent
+ *
+ *  Only complete messages are looked at (not chunks of a large message)
+ */
+void      cBtLinkStatTx(UBYTE ChNo, UBYTE *pMsg, UWORD Size)
+{
+  BTCH    *pBtCh;
+
+  pBtCh  =  &(BtInstance.BtCh[ChNo]);
+
+  if ((5 <= Size) && (Size == ((UWORD)pMsg[0] + ((UWORD)pMsg[1] << 8) + sizeof(CMDSIZE))))
+  {
+    switch (pMsg[4])
+    {
+      case DIRECT_COMMAND_REPLY:
+      case SYSTEM_COMMAND_REPLY:
+      {
+        gettimeofday(&(pBtCh->Rtt.StartVal), NULL);
+        pBtCh->Rtt.Pending  =  TRUE;
+      }
+      break;
+
+      case DIRECT_REPLY:
+      case DIRECT_REPLY_ERROR:
+      case SYSTEM_REPLY:
+      case SYSTEM_REPLY_ERROR:
+      {
+        if (TRUE == pBtCh->Turn.Pending)
+        {
+          cBtLinkStatAdd(&(pBtCh->Turn));
+        }
+      }
+      break;
+    }
+  }
+}
+
+
+/*! \brief  Time command to reply on a channel - called with every message received
+ */
+void      cBtLinkStatRx(UBYTE ChNo, MSGBUF *pMsgBuf)
+{
+  BTCH    *pBtCh;
+
+  pBtCh  =  &(BtInstance.BtCh[ChNo]);
+
+  if ((5 <= pMsgBuf->InPtr) && (pMsgBuf->InPtr == (pMsgBuf->MsgLen + sizeof(CMDSIZE))))
+  {
+    switch (pMsgBuf->Buf[4])
+    {
+      case DIRECT_COMMAND_REPLY:
+      case SYSTEM_COMMAND_REPLY:
+      {
+        gettimeofday(&(pBtCh->Turn.StartVal), NULL);
+        pBtCh->Turn.Pending  =  TRUE;
+      }
+      break;
+
+      case DIRECT_REPLY:
+      case DIRECT_REPLY_ERROR:
+      case SYSTEM_REPLY:
+      case SYSTEM_REPLY_ERROR:
+      {
+        if (TRUE == pBtCh->Rtt.Pending)
+        {
+          cBtLinkStatAdd(&(pBtCh->Rtt));
+        }
+      }
+      break;
+    }
+  }
+}
+
+
 /*! \page ComModule
  *
  *  <hr size="1"/>
@@ -2992,6 +3386,7 @@ UWORD     cBtHandleHCI(void)
         {
           UBYTE DevIndex;
           UBYTE SearchIndex;
+          UBYTE ChNo;
 
           if (0 != ((evt_conn_complete*)ptr)->status)
           {
@@ -3040,6 +3435,14 @@ UWORD     cBtHandleHCI(void)
               }
             }
             BtInstance.Incoming.ConnHandle = ((evt_conn_complete*)ptr)->handle;
+
+            // Tune the baseband link - connections from the outside (I am a slave) always use ch 0
+            ChNo  =  (I_AM_MASTER == BtInstance.State) ? BtInstance.OutGoing.ChNo : 0;
+            if (NO_OF_BT_CHS > ChNo)
+            {
+              cBtClearLinkStat(ChNo);
+              cBtApplyLinkPolicy(ChNo, ((evt_conn_complete*)ptr)->handle);
+            }
           }
         }
         break;
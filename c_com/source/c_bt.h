@@ -41,6 +41,13 @@
 #define   MAX_BUNDLE_ID_SIZE            24
 #define   MAX_BUNDLE_SEED_ID_SIZE       11
 
+// Link policy issued over the HCI socket when a channel connects
+#define   BT_SLOT_US                    625                           // Baseband slot
+#define   BT_LINK_SNIFF                 FALSE                         // Sniff adds up to a sniff interval per message
+#define   BT_LINK_PKT_TYPE              (HCI_DM1 | HCI_DH1 | HCI_DM3 | HCI_DH3 | HCI_DM5 | HCI_DH5) // EDR bits clear = 2/3-DHx allowed
+#define   BT_LINK_POLL_SLOTS            8                             // 5 mS max poll interval (QoS latency) - 0 = controller default
+#define   BT_LINK_FLUSH_SLOTS           0                             // Automatic flush timeout - 0 = never (RFCOMM needs every packet)
+
 
 enum
 {
@@ -186,6 +193,28 @@ typedef struct
 }SEARCHLIST;
 
 
+// Baseband link settings per channel
+typedef struct
+{
+  UBYTE     Sniff;                    // FALSE = sniff mode not allowed (and left at connect)
+  UWORD     PktType;                  // Allowed ACL packet types (HCI_DMx/DHx, EDR "not allowed" bits)
+  UWORD     PollSlots;                // Max poll interval in slots - 0 = controller default
+  UWORD     FlushSlots;               // Automatic flush timeout in slots - 0 = infinite
+}BTLINKPOLICY;
+
+
+// Command to reply times in 100 uS
+typedef struct
+{
+  struct    timeval StartVal;
+  UBYTE     Pending;
+  UWORD     Count;
+  ULONG     Min;
+  ULONG     Max;
+  ULONG     Sum;
+}BTLINKSTAT;
+
+
 typedef struct
 {
   WRITEBUF  WriteBuf;
@@ -193,9 +222,26 @@ typedef struct
   MSGBUF    MsgBuf;
   BTSOCKET  BtSocket;
   UBYTE     Status;
+  BTLINKPOLICY  LinkPolicy;
+  BTLINKSTAT    Rtt;                  // Our command -> remote reply (full round trip)
+  BTLINKSTAT    Turn;                 // Remote command -> our reply (brick turnaround)
 }BTCH;
 
 
+// One message to all connected slaves - sent from this single buffer
+typedef struct
+{
+  UBYTE     Buf[1024];
+  UWORD     Size;
+  UWORD     OutPtr[NO_OF_BT_CHS];     // Bytes sent per channel
+  UBYTE     RefCnt;                   // Channels still sending - buffer free at 0
+  UBYTE     Pending;                  // Bit per channel - still sending
+  UBYTE     Delivered;                // Bit per channel - all bytes written to the socket
+  UBYTE     Failed;                   // Bit per channel - closed before done
+  struct    timeval StartVal;
+}BTBROADCAST;
+
+
 typedef   struct
 {
   DEVICELIST  DevList[MAX_DEV_TABLE_ENTRIES];
@@ -241,6 +287,7 @@ typedef struct
   BTCH          BtCh[NO_OF_BT_CHS];   // Communication sockets
   READBUF       Mode2Buf;
   WRITEBUF      Mode2WriteBuf;
+  BTBROADCAST   Broadcast;            // Shared by all channels to slaves
 
   SEARCHLIST    SearchList[MAX_DEV_TABLE_ENTRIES];
   INCOMMING     Incoming;
@@ -294,6 +341,9 @@ UWORD     cBtDevWriteBuf5(UBYTE *pBuf, UWORD Size);
 UWORD     cBtDevWriteBuf6(UBYTE *pBuf, UWORD Size);
 UWORD     cBtDevWriteBuf7(UBYTE *pBuf, UWORD Size);
 
+UWORD     cBtBroadcast(UBYTE *pBuf, UWORD Size);
+UBYTE     cBtGetBroadcastStatus(UBYTE *pDelivered, UBYTE *pFailed);
+
 UBYTE     cBtI2cBufReady(void);
 UWORD     cBtI2cToBtBuf(UBYTE *pBuf, UWORD Size);
 
@@ -330,5 +380,9 @@ void      cBtSetTrustedDev(UBYTE *pBtAddr, UBYTE *pPin, UBYTE PinSize);
 UWORD     cBtSetBundleId(UBYTE *pId);
 UWORD     cBtSetBundleSeedId(UBYTE *pSeedId);
 
+UBYTE     cBtSetLinkPolicy(UBYTE ChNo, BTLINKPOLICY *pPolicy);
+UBYTE     cBtGetLinkPolicy(UBYTE ChNo, BTLINKPOLICY *pPolicy, BTLINKSTAT *pRtt, BTLINKSTAT *pTurn);
+void      cBtClearLinkStat(UBYTE ChNo);
+
 
 #endif /* C_BT_H_ */
@@ -88,7 +88,11 @@ UBYTE cComUsbDeviceConnected = FALSE;
 
 UWORD     cComReadBuffer(UBYTE *pBuffer,UWORD Size);
 UWORD     cComWriteBuffer(UBYTE *pBuffer,UWORD Size);
+UWORD     cComReadBulk(UBYTE *pBuffer,UWORD Size);
+UWORD     cComWriteBulk(UBYTE *pBuffer,UWORD Size);
 UBYTE     cComFindMailbox(UBYTE *pName, UBYTE *pNo);
+void      cComStoreMailbox(WRITE_MAILBOX *pWriteMailbox);
+UWORD     cComBuildMailboxCmd(UBYTE *pBuf, DATA8 *pBoxName, DATA32 *pPayload, UWORD PayloadSize);
 
 void  cComSetMusbHdrcMode(void);
 
@@ -123,6 +127,13 @@ RESULT    cComInit(void)
 
     Result  =  OK;
   }
+
+  // Bulk pipe is optional - older usbdev modules does not provide it
+  ComInstance.Bulkfd            =  open(COM_BULK_DEVICE_NAME, O_RDWR, 0666);
+  ComInstance.BulkRxCnt         =  0;
+  ComInstance.BulkMsgRem        =  0;
+  ComInstance.BulkFirst         =  0;
+
   for (TmpFileHandle = 0;TmpFileHandle < MAX_FILE_HANDLES;TmpFileHandle++)
   {
     ComInstance.Files[TmpFileHandle].State   =  FS_IDLE;
@@ -149,6 +160,7 @@ RESULT    cComInit(void)
   ComInstance.ReadChannel[8]   = cBtReadCh6;
   ComInstance.ReadChannel[9]   = cBtReadCh7;
   ComInstance.ReadChannel[10]  = cWiFiReadTcp;
+  ComInstance.ReadChannel[11]  = cComReadBulk;
 
   ComInstance.WriteChannel[0]  = cComWriteBuffer;
   ComInstance.WriteChannel[1]  = NULL;
@@ -161,6 +173,7 @@ RESULT    cComInit(void)
   ComInstance.WriteChannel[8]  = cBtDevWriteBuf6;
   ComInstance.WriteChannel[9]  = cBtDevWriteBuf7;
   ComInstance.WriteChannel[10] = cWiFiWriteTcp;
+  ComInstance.WriteChannel[11] = cComWriteBulk;
 
   for(Cnt = 0; Cnt < NO_OF_MAILBOXES; Cnt++)
   {
@@ -242,6 +255,10 @@ RESULT    cComExit(void)
   RESULT  Result = FAIL;
 
   close(ComInstance.Cmdfd);
+  if (ComInstance.Bulkfd >= 0)
+  {
+    close(ComInstance.Bulkfd);
+  }
 
   Result  =  OK;
 
@@ -424,6 +441,115 @@ UWORD     cComWriteBuffer(UBYTE *pBuffer,UWORD Size)
 }
 
 
+UWORD     cComReadBulk(UBYTE *pBuffer,UWORD Size)
+{
+  UWORD   Length = 0;
+#if (HARDWARE != SIMULATION)
+  UWORD   Expected;
+  int     Bytes;
+
+  // The bulk pipe is a byte stream - collect one whole command (size field + CmdSize bytes)
+  // in pBuffer before handing it on, just as the command arrives on the HID pipe.
+  // A command larger than Size is handed on in Size byte chunks, as on the other channels,
+  // so a file download continues in RXFILEDL - any other large command is read and dropped
+  Bytes  =  1;
+  while ((ComInstance.Bulkfd >= 0) && (Bytes > 0) && (Length == 0))
+  {
+    if ((0 == ComInstance.BulkMsgRem) && (ComInstance.BulkRxCnt >= sizeof(CMDSIZE)))
+    {
+      // Size field received - bytes in message including size field
+      ComInstance.BulkMsgRem  =  (ULONG)(*(COMCMD*)pBuffer).CmdSize + sizeof(CMDSIZE);
+      ComInstance.BulkFirst   =  1;
+    }
+
+    if (0 == ComInstance.BulkMsgRem)
+    {
+      Expected  =  sizeof(CMDSIZE);
+    }
+    else
+    {
+      if (ComInstance.BulkMsgRem > Size)
+      {
+        Expected  =  Size;
+      }
+      else
+      {
+        Expected  =  (UWORD)ComInstance.BulkMsgRem;
+      }
+    }
+
+    if (ComInstance.BulkRxCnt < Expected)
+    {
+      Bytes  =  read(ComInstance.Bulkfd, &pBuffer[ComInstance.BulkRxCnt], (size_t)(Expected - ComInstance.BulkRxCnt));
+      if (Bytes > 0)
+      {
+        ComInstance.BulkRxCnt +=  Bytes;
+      }
+    }
+    else
+    {
+      // Message or chunk complete
+      if (ComInstance.BulkFirst)
+      {
+        if ((ComInstance.BulkMsgRem <= Size) || (SYSTEM_COMMAND_REPLY == (*(COMCMD*)pBuffer).Cmd) || (SYSTEM_COMMAND_NO_REPLY == (*(COMCMD*)pBuffer).Cmd))
+        {
+          Length  =  ComInstance.BulkRxCnt;
+        }
+      }
+      else
+      {
+        if (RXFILEDL == ComInstance.RxBuf[USBBULK].State)
+        {
+          Length  =  ComInstance.BulkRxCnt;
+        }
+      }
+      ComInstance.BulkMsgRem -=  ComInstance.BulkRxCnt;
+      ComInstance.BulkRxCnt   =  0;
+      ComInstance.BulkFirst   =  0;
+    }
+  }
+
+  #undef DEBUG
+  //#define DEBUG
+  #ifdef DEBUG
+    if (Length)
+    {
+      printf("cComReadBulk Length = %d\r\n", Length);
+    }
+  #endif
+
+#endif
+  return (Length);
+}
+
+
+UWORD     cComWriteBulk(UBYTE *pBuffer,UWORD Size)
+{
+  UWORD   Length = 0;
+#if (HARDWARE != SIMULATION)
+  int     Bytes;
+
+  // Only the actual message is sent - no padding to a report size as on the HID pipe
+  if (ComInstance.Bulkfd >= 0)
+  {
+    Bytes  =  write(ComInstance.Bulkfd, pBuffer, (size_t)Size);
+    if (Bytes > 0)
+    {
+      Length  =  (UWORD)Bytes;
+    }
+  }
+
+  #undef DEBUG
+  //#define DEBUG
+  #ifdef DEBUG
+    printf("cComWriteBulk %d\n\r", Length);
+  #endif
+
+#endif
+  return (Length);
+}
+
+
 UBYTE     cComDirectCommand(UBYTE *pBuffer,UBYTE *pReply)
 {
   UBYTE   Result = 0;
@@ -2274,22 +2400,7 @@ void      cComSystemCommand(RXBUF *pRxBuf, TXBUF *pTxBuf)
 
     case WRITEMAILBOX:
     {
-      UBYTE                 No;
-      UWORD                 PayloadSize;
-      WRITE_MAILBOX         *pWriteMailbox;
-      WRITE_MAILBOX_PAYLOAD *pWriteMailboxPayload;
-
-      pWriteMailbox   =  (WRITE_MAILBOX*)pRxBuf->Buf;
-
-      if(1 == cComFindMailbox(&(pWriteMailbox->Name[0]), &No))
-      {
-        pWriteMailboxPayload  =  (WRITE_MAILBOX_PAYLOAD*)&(pWriteMailbox->Name[(pWriteMailbox->NameSize)]);
-        PayloadSize           =  (UWORD)(pWriteMailboxPayload->SizeLsb);
-        PayloadSize          +=  ((UWORD)(pWriteMailboxPayload->SizeMsb)) << 8;
-        memcpy(ComInstance.MailBox[No].Content, pWriteMailboxPayload->Payload, PayloadSize);
-        ComInstance.MailBox[No].DataSize  =  PayloadSize;
-        ComInstance.MailBox[No].WriteCnt++;
-      }
+      cComStoreMailbox((WRITE_MAILBOX*)pRxBuf->Buf);
     }
     break;
 
@@ -2310,7 +2421,7 @@ void      cComSystemCommand(RXBUF *pRxBuf, TXBUF *pTxBuf)
       snprintf((char*)Pin, PinSize, "%s", (char*)pBtPin->Pin);
 
       // This command can for safety reasons only be handled by USB
-      if (USBDEV == ComInstance.ActiveComCh)
+      if ((USBDEV == ComInstance.ActiveComCh) || (USBBULK == ComInstance.ActiveComCh))
       {
         cBtSetTrustedDev(BtAddr, Pin, PinSize);
         pReplyBtPin->Status    =  SUCCESS;
@@ -2340,7 +2451,7 @@ void      cComSystemCommand(RXBUF *pRxBuf, TXBUF *pTxBuf)
       ULONG  UpdateFile;
       UBYTE  Dummy;
 
-      if (USBDEV == ComInstance.ActiveComCh)
+      if ((USBDEV == ComInstance.ActiveComCh) || (USBBULK == ComInstance.ActiveComCh))
       {
         UpdateFile  =  open(UPDATE_DEVICE_NAME,O_RDWR);
 
@@ -2409,6 +2520,110 @@ void      cComSystemCommand(RXBUF *pRxBuf, TXBUF *pTxBuf)
       pTxBuf->BlockLen = SIZEOF_RPLYBUNDLESEEDID;
     }
     break;
+
+    case PRELOAD_PROGRAM:
+    {
+      PRELOAD_PRG       *pPreload;
+      RPLY_PRELOAD_PRG  *pReplyPreload;
+      char              Name[vmFILENAMESIZE];
+
+      //Setup pointers
+      pPreload       =  (PRELOAD_PRG*)pRxBuf->Buf;
+      pReplyPreload  =  (RPLY_PRELOAD_PRG*)pTxBuf->Buf;
+
+      pReplyPreload->CmdSize  =  SIZEOF_RPLYPRELOADPRG - sizeof(CMDSIZE);
+      pReplyPreload->MsgCount =  pPreload->MsgCount;
+      pReplyPreload->CmdType  =  SYSTEM_REPLY;
+      pReplyPreload->Cmd      =  PRELOAD_PROGRAM;
+      pReplyPreload->Status   =  SUCCESS;
+
+      snprintf(Name,vmFILENAMESIZE,"%s",(char*)(pPreload->Name));
+
+#ifndef DISABLE_PROGRAM_PRELOAD
+      // Only names the file - load and validation are done later by the
+      // VM loop when the user slot is idle, so the reply is not held back
+      if (access(Name,R_OK) == 0)
+      {
+        ProgramPreload(Name);
+      }
+      else
+      {
+        pReplyPreload->CmdType  =  SYSTEM_REPLY_ERROR;
+        pReplyPreload->Status   =  ILLEGAL_PATH;
+      }
+#else
+      pReplyPreload->CmdType    =  SYSTEM_REPLY_ERROR;
+      pReplyPreload->Status     =  UNKNOWN_ERROR;
+#endif
+      pTxBuf->BlockLen = SIZEOF_RPLYPRELOADPRG;
+    }
+    break;
+
+    case BLUETOOTH_LINK:
+    {
+      BT_LINK       *pBtLink;
+      RPLY_BT_LINK  *pReplyBtLink;
+      BTLINKPOLICY  Policy;
+      BTLINKSTAT    Stat[2];
+      UWORD         Val[8];
+      UBYTE         Cnt;
+
+      pBtLink       =  (BT_LINK*)pRxBuf->Buf;
+      pReplyBtLink  =  (RPLY_BT_LINK*)pTxBuf->Buf;
+
+      pReplyBtLink->CmdSize   =  SIZEOF_RPLYBTLINK - sizeof(CMDSIZE);
+      pReplyBtLink->MsgCount  =  pBtLink->MsgCount;
+      pReplyBtLink->CmdType   =  SYSTEM_REPLY;
+      pReplyBtLink->Cmd       =  BLUETOOTH_LINK;
+      pReplyBtLink->Status    =  SUCCESS;
+      pReplyBtLink->ChNo      =  pBtLink->ChNo;
+
+      if (1 == pBtLink->Set)
+      {
+        Policy.Sniff       =  pBtLink->Sniff;
+        Policy.PktType     =  (UWORD)(pBtLink->PktTypeLsb)    + ((UWORD)(pBtLink->PktTypeMsb) << 8);
+        Policy.PollSlots   =  (UWORD)(pBtLink->PollSlotsLsb)  + ((UWORD)(pBtLink->PollSlotsMsb) << 8);
+        Policy.FlushSlots  =  (UWORD)(pBtLink->FlushSlotsLsb) + ((UWORD)(pBtLink->FlushSlotsMsb) << 8);
+        cBtSetLinkPolicy(pBtLink->ChNo, &Policy);
+      }
+      if (2 == pBtLink->Set)
+      {
+        cBtClearLinkStat(pBtLink->ChNo);
+      }
+
+      if (OK == cBtGetLinkPolicy(pBtLink->ChNo, &Policy, &Stat[0], &Stat[1]))
+      {
+        pReplyBtLink->Sniff          =  Policy.Sniff;
+        pReplyBtLink->PktTypeLsb     =  (UBYTE)(Policy.PktType & 0x00FF);
+        pReplyBtLink->PktTypeMsb     =  (UBYTE)((Policy.PktType >> 8) & 0x00FF);
+        pReplyBtLink->PollSlotsLsb   =  (UBYTE)(Policy.PollSlots & 0x00FF);
+        pReplyBtLink->PollSlotsMsb   =  (UBYTE)((Policy.PollSlots >> 8) & 0x00FF);
+        pReplyBtLink->FlushSlotsLsb  =  (UBYTE)(Policy.FlushSlots & 0x00FF);
+        pReplyBtLink->FlushSlotsMsb  =  (UBYTE)((Policy.FlushSlots >> 8) & 0x00FF);
+
+        // Count, average, min and max - round trip first, then turnaround
+        for (Cnt = 0; Cnt < 2; Cnt++)
+        {
+          Val[(Cnt * 4)]      =  Stat[Cnt].Count;
+          Val[(Cnt * 4) + 1]  =  (Stat[Cnt].Count) ? (UWORD)(Stat[Cnt].Sum / Stat[Cnt].Count) : 0;
+          Val[(Cnt * 4) + 2]  =  (Stat[Cnt].Min > 0xFFFF) ? 0xFFFF : (UWORD)Stat[Cnt].Min;
+          Val[(Cnt * 4) + 3]  =  (Stat[Cnt].Max > 0xFFFF) ? 0xFFFF : (UWORD)Stat[Cnt].Max;
+        }
+        for (Cnt = 0; Cnt < 8; Cnt++)
+        {
+          pReplyBtLink->Stat[(Cnt * 2)]      =  (UBYTE)(Val[Cnt] & 0x00FF);
+          pReplyBtLink->Stat[(Cnt * 2) + 1]  =  (UBYTE)((Val[Cnt] >> 8) & 0x00FF);
+        }
+      }
+      else
+      {
+        memset(&(pReplyBtLink->Sniff), 0, SIZEOF_RPLYBTLINK - 8);     // Sniff is at byte 8
+        pReplyBtLink->CmdType  =  SYSTEM_REPLY_ERROR;
+        pReplyBtLink->Status   =  UNKNOWN_ERROR;
+      }
+      pTxBuf->BlockLen = SIZEOF_RPLYBTLINK;
+    }
+    break;
   }
 }
 
@@ -2805,39 +3020,53 @@ void      cComUpdate(void)
         { // in the middle of a write file command
           ULONG RemBytes;
           ULONG BytesToWrite;
+          UBYTE Chunks = 0;
 
-          RemBytes = pRxBuf->MsgLen - pRxBuf->RxBytes;
-
-          if (RemBytes <= pRxBuf->BufSize)
+          // The HID pipe is paced by its reports - the bulk pipe is not, so more
+          // chunks are drained in one update instead of one buffer per update
+          do
           {
-            // Remaining bytes to write
-            BytesToWrite      =  RemBytes;
+            RemBytes = pRxBuf->MsgLen - pRxBuf->RxBytes;
 
-            // Send the reply if requested
-            if (ComInstance.ReplyStatus  &  SYS_CMD_REPLY)
+            if (RemBytes <= pRxBuf->BufSize)
+            {
+              // Remaining bytes to write
+              BytesToWrite      =  RemBytes;
+
+              // Send the reply if requested
+              if (ComInstance.ReplyStatus  &  SYS_CMD_REPLY)
+              {
+                pTxBuf->Writing   =  1;
+              }
+
+              // Clear to receive next msg header
+              pRxBuf->State            =  RXIDLE;
+              ComInstance.ReplyStatus  =  0;
+            }
+            else
             {
-              pTxBuf->Writing   =  1;
+              BytesToWrite  =  pRxBuf->BufSize;
             }
 
-            // Clear to receive next msg header
-            pRxBuf->State            =  RXIDLE;
-            ComInstance.ReplyStatus  =  0;
-          }
-          else
-          {
-            BytesToWrite  =  pRxBuf->BufSize;
-          }
+            write(pRxBuf->pFile->File, pRxBuf->Buf, (size_t)BytesToWrite);
+            pRxBuf->pFile->Pointer  +=  (ULONG)BytesToWrite;
+            pRxBuf->RxBytes         +=  (ULONG)BytesToWrite;
 
-          write(pRxBuf->pFile->File, pRxBuf->Buf, (size_t)BytesToWrite);
-          pRxBuf->pFile->Pointer  +=  (ULONG)BytesToWrite;
-          pRxBuf->RxBytes         +=  (ULONG)BytesToWrite;
+            if (pRxBuf->pFile->Pointer >= pRxBuf->pFile->Size)
+            {
+              cComCloseFileHandle(&(pRxBuf->pFile->File));
+              chmod(pRxBuf->pFile->Name, S_IRWXU | S_IRWXG | S_IRWXO);
+              cComFreeHandle(pRxBuf->FileHandle);
+            }
 
-          if (pRxBuf->pFile->Pointer >= pRxBuf->pFile->Size)
-          {
-            cComCloseFileHandle(&(pRxBuf->pFile->File));
-            chmod(pRxBuf->pFile->Name, S_IRWXU | S_IRWXG | S_IRWXO);
-            cComFreeHandle(pRxBuf->FileHandle);
+            Chunks++;
+            BytesRead  =  0;
+            if ((USBBULK == ChNo) && (RXFILEDL == pRxBuf->State) && (Chunks < USB_BULK_CHUNKS_PER_UPDATE))
+            {
+              BytesRead  =  cComReadBulk(pRxBuf->Buf, pRxBuf->BufSize);
+            }
           }
+          while (BytesRead);
         }
       }
     }
@@ -3274,6 +3503,101 @@ void      cComTxUpdate(UBYTE ChNo)
 }
 
 
+/*! \brief  Store the payload of a WRITEMAILBOX system command in the named mailbox
+ *
+ *  Used by the system command and by UDP messages (c_wifi)
+ */
+void      cComStoreMailbox(WRITE_MAILBOX *pWriteMailbox)
+{
+  UBYTE                 No;
+  UWORD                 PayloadSize;
+  WRITE_MAILBOX_PAYLOAD *pWriteMailboxPayload;
+
+  if(1 == cComFindMailbox(&(pWriteMailbox->Name[0]), &No))
+  {
+    pWriteMailboxPayload  =  (WRITE_MAILBOX_PAYLOAD*)&(pWriteMailbox->Name[(pWriteMailbox->NameSize)]);
+    PayloadSize           =  (UWORD)(pWriteMailboxPayload->SizeLsb);
+    PayloadSize          +=  ((UWORD)(pWriteMailboxPayload->SizeMsb)) << 8;
+    memcpy(ComInstance.MailBox[No].Content, pWriteMailboxPayload->Payload, PayloadSize);
+    ComInstance.MailBox[No].DataSize  =  PayloadSize;
+    ComInstance.MailBox[No].WriteCnt++;
+  }
+}
+
+
+/*! \brief  Store a WRITEMAILBOX system command received outside a com channel
+ *
+ *  The message comes straight off the network so sizes and termination
+ *  are checked before anything is copied
+ *
+ *  \param   pMsg    - WRITEMAILBOX system command (from CMDSIZE)
+ *  \param   Length  - Bytes in pMsg
+ *  \return  OK if stored in a mailbox
+ */
+RESULT    cComWriteMailboxMsg(UBYTE *pMsg, UWORD Length)
+{
+  RESULT  Result = FAIL;
+  UBYTE   No;
+  UWORD   PayloadSize;
+  WRITE_MAILBOX         *pWriteMailbox;
+  WRITE_MAILBOX_PAYLOAD *pWriteMailboxPayload;
+
+  pWriteMailbox  =  (WRITE_MAILBOX*)pMsg;
+
+  if ((SIZEOF_WRITEMAILBOX + SIZEOF_WRITETOMAILBOXPAYLOAD) <= Length)
+  {
+    if ((WRITEMAILBOX == (*pWriteMailbox).Cmd) && (0 < (*pWriteMailbox).NameSize) && ((SIZEOF_WRITEMAILBOX + (*pWriteMailbox).NameSize + SIZEOF_WRITETOMAILBOXPAYLOAD) <= Length))
+    {
+      pWriteMailboxPayload  =  (WRITE_MAILBOX_PAYLOAD*)&((*pWriteMailbox).Name[(*pWriteMailbox).NameSize]);
+      PayloadSize           =  (UWORD)((*pWriteMailboxPayload).SizeLsb);
+      PayloadSize          +=  ((UWORD)((*pWriteMailboxPayload).SizeMsb)) << 8;
+
+      if ((0 == (*pWriteMailbox).Name[(*pWriteMailbox).NameSize - 1]) && (MAILBOX_CONTENT_SIZE >= PayloadSize) && ((SIZEOF_WRITEMAILBOX + (*pWriteMailbox).NameSize + SIZEOF_WRITETOMAILBOXPAYLOAD + PayloadSize) <= Length))
+      {
+        if(1 == cComFindMailbox(&((*pWriteMailbox).Name[0]), &No))
+        {
+          cComStoreMailbox(pWriteMailbox);
+          Result  =  OK;
+        }
+      }
+    }
+  }
+  return (Result);
+}
+
+
+/*! \brief  Build a WRITEMAILBOX system command (no reply)
+ *
+ *  \return  Block length including CMDSIZE
+ */
+UWORD     cComBuildMailboxCmd(UBYTE *pBuf, DATA8 *pBoxName, DATA32 *pPayload, UWORD PayloadSize)
+{
+  WRITE_MAILBOX          *pComMbx;
+  WRITE_MAILBOX_PAYLOAD  *pComMbxPayload;
+
+  pComMbx             =  (WRITE_MAILBOX*)pBuf;
+
+  // First part of message
+  (*pComMbx).CmdSize  =  SIZEOF_WRITEMAILBOX - sizeof(CMDSIZE);
+  (*pComMbx).MsgCount =  1;
+  (*pComMbx).CmdType  =  SYSTEM_COMMAND_NO_REPLY;
+  (*pComMbx).Cmd      =  WRITEMAILBOX;
+  (*pComMbx).NameSize =  strlen((char*)pBoxName) + 1;
+  snprintf((char*)(*pComMbx).Name,(*pComMbx).NameSize,"%s",(char*)pBoxName);
+
+  (*pComMbx).CmdSize += (*pComMbx).NameSize;
+
+  // Payload part of message
+  pComMbxPayload            = (WRITE_MAILBOX_PAYLOAD*) &(pBuf[(*pComMbx).CmdSize + sizeof(CMDSIZE)]);
+  (*pComMbxPayload).SizeLsb = (UBYTE) (PayloadSize & 0x00FF);
+  (*pComMbxPayload).SizeMsb = (UBYTE)((PayloadSize >> 8) & 0x00FF);
+  memcpy((*pComMbxPayload).Payload, pPayload, PayloadSize);
+  (*pComMbx).CmdSize += (PayloadSize + SIZEOF_WRITETOMAILBOXPAYLOAD);
+
+  return ((*pComMbx).CmdSize + sizeof(CMDSIZE));
+}
+
+
 UBYTE     cComFindMailbox(UBYTE *pName, UBYTE *pNo)
 {
   UBYTE   RtnVal = 0;
@@ -3321,6 +3645,8 @@ void      cComReady(void)
   UBYTE   Status;
   UBYTE   ChNos;
   UBYTE   ChNoArr[NO_OF_BT_CHS];
+  UBYTE   Delivered;
+  UBYTE   Failed;
 
 
   TmpIp     =  GetObjectIp();
@@ -3339,6 +3665,12 @@ void      cComReady(void)
       Status  =  ComInstance.ComResult;
     }
 
+    // Broadcast to slaves still being sent
+    if (0 != cBtGetBroadcastStatus(&Delivered, &Failed))
+    {
+      Status  =  BUSY;
+    }
+
     if (BUSY == Status)
     {
       DspStat = BUSYBREAK;
@@ -3668,9 +4000,8 @@ void      cComWriteMailBox(void)
   UBYTE   ChNoArr[NO_OF_BT_CHS];
   UBYTE   Cnt;
   UWORD   PayloadSize = 0;
-
-  WRITE_MAILBOX          *pComMbx;
-  WRITE_MAILBOX_PAYLOAD  *pComMbxPayload;
+  UBYTE   MsgBuf[WIFI_MSG_BODY_SIZE];
+  UBYTE   Broadcast = 0;
 
   pBrickName  =   (DATA8*)PrimParPointer();
   Hardware    =  *(DATA8*)PrimParPointer();
@@ -3752,37 +4083,48 @@ void      cComWriteMailBox(void)
     }
   }
 
-  ChNos = cBtGetChNo((UBYTE*)pBrickName, ChNoArr);
+  if (HW_WIFI == Hardware)
+  {
+    // UDP datagram - BRICKNAME is a brick, a brick or group IP address or empty for all bricks
+    if ((SIZEOF_WRITEMAILBOX + strlen((char*)pBoxName) + 1 + SIZEOF_WRITETOMAILBOXPAYLOAD + PayloadSize) <= WIFI_MSG_BODY_SIZE)
+    {
+      cWiFiMsgSend((char*)pBrickName, MsgBuf, cComBuildMailboxCmd(MsgBuf, pBoxName, Payload, PayloadSize));
+    }
+  }
+  else
+  {
+#ifndef DISABLE_BT_BROADCAST
+    if ((0 == pBrickName[0]) && ((SIZEOF_WRITEMAILBOX + strlen((char*)pBoxName) + 1 + SIZEOF_WRITETOMAILBOXPAYLOAD + PayloadSize) <= sizeof(MsgBuf)))
+    {
+      // Empty name - one copy of the message shared by all connected devices (master included)
+      Broadcast  =  (0 != cBtBroadcast(MsgBuf, cComBuildMailboxCmd(MsgBuf, pBoxName, Payload, PayloadSize)));
 
-  for(Cnt = 0; Cnt < ChNos; Cnt++)
+      #ifdef DEBUG_TRACE_BT_BROADCAST
+        printf("\r\nBT broadcast of %d payload bytes %s\r\n", PayloadSize, Broadcast ? "queued" : "refused");
+      #endif
+    }
+#endif
+  }
+  if ((HW_WIFI != Hardware) && (0 == Broadcast))
   {
-    ComChNo = ChNoArr[Cnt] + BTSLAVE;                               // Ch nos offset from BT module
+    // One message per device - also when the broadcast buffer can not be used
+    ChNos = cBtGetChNo((UBYTE*)pBrickName, ChNoArr);
+
+    #ifdef DEBUG_TRACE_BT_BROADCAST
+      printf("\r\nBT mailbox write queued to %d channels\r\n", ChNos);
+    #endif
 
-    // Valid channel found
-    if ((0 == ComInstance.TxBuf[ComChNo].Writing) && (TXIDLE == ComInstance.TxBuf[ComChNo].State))
+    for(Cnt = 0; Cnt < ChNos; Cnt++)
     {
-      // Buffer is empty
-      pComMbx             =  (WRITE_MAILBOX*)ComInstance.TxBuf[ComChNo].Buf;
-
-      // First part of message
-      (*pComMbx).CmdSize  =  SIZEOF_WRITEMAILBOX - sizeof(CMDSIZE);
-      (*pComMbx).MsgCount =  1;
-      (*pComMbx).CmdType  =  SYSTEM_COMMAND_NO_REPLY;
-      (*pComMbx).Cmd      =  WRITEMAILBOX;
-      (*pComMbx).NameSize =  strlen((char*)pBoxName) + 1;
-      snprintf((char*)(*pComMbx).Name,(*pComMbx).NameSize,"%s",(char*)pBoxName);
-
-      (*pComMbx).CmdSize += (*pComMbx).NameSize;
-
-      // Payload part of message
-      pComMbxPayload            = (WRITE_MAILBOX_PAYLOAD*) &(ComInstance.TxBuf[ComChNo].Buf[(*pComMbx).CmdSize + sizeof(CMDSIZE)]);
-      (*pComMbxPayload).SizeLsb = (UBYTE) (PayloadSize & 0x00FF);
-      (*pComMbxPayload).SizeMsb = (UBYTE)((PayloadSize >> 8) & 0x00FF);
-      memcpy((*pComMbxPayload).Payload, Payload, PayloadSize);
-      (*pComMbx).CmdSize += (PayloadSize + SIZEOF_WRITETOMAILBOXPAYLOAD);
-
-      ComInstance.TxBuf[ComChNo].BlockLen  =  (*pComMbx).CmdSize + sizeof(CMDSIZE);
-      ComInstance.TxBuf[ComChNo].Writing   =  1;
+      ComChNo = ChNoArr[Cnt] + BTSLAVE;                               // Ch nos offset from BT module
+
+      // Valid channel found
+      if ((0 == ComInstance.TxBuf[ComChNo].Writing) && (TXIDLE == ComInstance.TxBuf[ComChNo].State))
+      {
+        // Buffer is empty
+        ComInstance.TxBuf[ComChNo].BlockLen  =  cComBuildMailboxCmd(ComInstance.TxBuf[ComChNo].Buf, pBoxName, Payload, PayloadSize);
+        ComInstance.TxBuf[ComChNo].Writing   =  1;
+      }
     }
   }
 
@@ -4272,6 +4614,17 @@ void      cComWriteFile(void)
  *
  *\n
  *
+ *\n
+ *  - CMD = GET_BROADCAST
+ *\n  Returns the status of the last mailbox broadcast. Bluetooth only        \n
+ *\n  Bit n is Bluetooth channel n (0 = the master this brick is slave to)     \n
+ *    \param  (DATA8)    HARDWARE    - \ref transportlayers                    \n
+ *    \return (DATA8)    PENDING     - Channels still being sent to            \n
+ *    \return (DATA8)    DELIVERED   - Channels the whole message was sent to  \n
+ *    \return (DATA8)    FAILED      - Channels the message could not be sent  \n
+ *
+ *\n
+ *
  */
 /*! \brief  opCOM_GET byte code
  *
@@ -4989,6 +5342,29 @@ void      cComGet(void)
     }
     break;
 
+    case GET_BROADCAST:
+    {
+      UBYTE   Pending;
+      UBYTE   Delivered;
+      UBYTE   Failed;
+
+      Hardware   =  *(DATA8*)PrimParPointer();
+      Pending    =  0;
+      Delivered  =  0;
+      Failed     =  0;
+
+      if (HW_BT == Hardware)
+      {
+        Pending  =  cBtGetBroadcastStatus(&Delivered, &Failed);
+        DspStat  =  NOBREAK;
+      }
+
+      *(DATA8*)PrimParPointer()  =  (DATA8)Pending;
+      *(DATA8*)PrimParPointer()  =  (DATA8)Delivered;
+      *(DATA8*)PrimParPointer()  =  (DATA8)Failed;
+    }
+    break;
+
   }
   SetDispatchStatus(DspStat);
 }
@@ -105,6 +105,8 @@
   #define     ENTERFWUPDATE                 0xA0    //  Restart the brick in Firmware update mode
   #define     SETBUNDLEID                   0xA1    //  Set Bundle ID for mode2
   #define     SETBUNDLESEEDID               0xA2    //  Set bundle seed ID for mode2
+  #define     PRELOAD_PROGRAM               0xA3    //  Keep program ready in standby for fast start
+  #define     BLUETOOTH_LINK                0xA4    //  Bluetooth link policy and latency per channel
 
 /*
 
@@ -585,6 +587,56 @@
     pppppp = null terminated SEED ID string. Max. length = 11 chars including the null termination
 
 
+  PRELOAD_PROGRAM
+  ------------------
+
+    Hints the VM which program will be started next. The program is loaded, validated and
+    allocated in standby while the user slot is idle so that a following start (from the
+    brick UI or a direct command) does not wait for file read and validation.
+
+    xxxxxxxx01A3xxxxxx....
+    bbbbmmmmttsspppppp....
+
+    bbbb = bytes in massage, mmmm = message counter, tt = type of message, ss = system command,
+    pppppp = null terminated full path of the program (.rbf) to preload
+
+
+    Bytes send to the PC:
+
+    0500xxxx03A3xx
+    bbbbmmmmttssrr
+
+    bbbb = bytes in massage, mmmm = message counter, tt = type of message, ss = system command,
+    rr = return status
+
+
+  BLUETOOTH_LINK
+  ------------------
+
+    Reads or sets the baseband link policy of a Bluetooth channel and reads the command to reply
+    times measured on it. The policy is issued on the HCI socket when the channel connects (and at
+    once if it is connected). Times are in 100 uS and restart at every connection.
+
+    0D00xxxx01A4xxxxxxxxxxxxxxxxxx
+    bbbbmmmmttsscciissppppllllffff
+
+    bbbb = bytes in massage, mmmm = message counter, tt = type of message, ss = system command,
+    cc = channel (0 = slave channel, 1..7 = channels to slaves), ii = 0 read, 1 set, 2 clear times,
+    ss = sniff allowed, pppp = allowed ACL packet types (HCI), llll = max poll interval in slots
+    (0 = controller default), ffff = automatic flush timeout in slots (0 = infinite)
+
+
+    Bytes send to the PC:
+
+    1D00xxxx03A4xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx
+    bbbbmmmmttssrrccssppppllllffffnnnnaaaammmmxxxxNNNNAAAAMMMMXXXX
+
+    bbbb = bytes in massage, mmmm = message counter, tt = type of message, ss = system command,
+    rr = return status, cc ss pppp llll ffff = policy now in use,
+    nnnn aaaa mmmm xxxx = count, average, min and max of our command -> remote reply,
+    NNNN AAAA MMMM XXXX = count, average, min and max of remote command -> our reply
+
+
 
 *********************************************************************************************************
   \endverbatim
@@ -916,6 +968,7 @@ enum
   BTMASTER6,
   BTMASTER7,
   WIFI,
+  USBBULK,
   NO_OF_CHS
 };
 
@@ -924,6 +977,7 @@ enum
 #define   MAILBOX_CONTENT_SIZE          250
 #define   USB_CMD_IN_REP_SIZE           1024
 #define   USB_CMD_OUT_REP_SIZE          1024
+#define   USB_BULK_CHUNKS_PER_UPDATE    16      //!< File download chunks drained from the bulk pipe per update
 
 
 typedef   UWORD     CMDSIZE;
@@ -1378,6 +1432,63 @@ typedef   struct
 }RPLY_BUNDLE_SEED_ID;
 #define   SIZEOF_RPLYBUNDLESEEDID       7
 
+typedef   struct
+{
+  CMDSIZE CmdSize;
+  MSGCNT  MsgCount;
+  UBYTE   CmdType;
+  UBYTE   Cmd;
+  UBYTE   Name[];
+}PRELOAD_PRG;
+#define   SIZEOF_PRELOADPRG             4
+
+typedef   struct
+{
+  CMDSIZE CmdSize;
+  MSGCNT  MsgCount;
+  UBYTE   CmdType;
+  UBYTE   Cmd;
+  UBYTE   Status;
+}RPLY_PRELOAD_PRG;
+#define   SIZEOF_RPLYPRELOADPRG         7
+
+typedef   struct
+{
+  CMDSIZE CmdSize;
+  MSGCNT  MsgCount;
+  UBYTE   CmdType;
+  UBYTE   Cmd;
+  UBYTE   ChNo;
+  UBYTE   Set;
+  UBYTE   Sniff;
+  UBYTE   PktTypeLsb;
+  UBYTE   PktTypeMsb;
+  UBYTE   PollSlotsLsb;
+  UBYTE   PollSlotsMsb;
+  UBYTE   FlushSlotsLsb;
+  UBYTE   FlushSlotsMsb;
+}BT_LINK;
+#define   SIZEOF_BTLINK                 15
+
+typedef   struct
+{
+  CMDSIZE CmdSize;
+  MSGCNT  MsgCount;
+  UBYTE   CmdType;
+  UBYTE   Cmd;
+  UBYTE   Status;
+  UBYTE   ChNo;
+  UBYTE   Sniff;
+  UBYTE   PktTypeLsb;
+  UBYTE   PktTypeMsb;
+  UBYTE   PollSlotsLsb;
+  UBYTE   PollSlotsMsb;
+  UBYTE   FlushSlotsLsb;
+  UBYTE   FlushSlotsMsb;
+  UBYTE   Stat[16];
+}RPLY_BT_LINK;
+#define   SIZEOF_RPLYBTLINK             31
+
 
 // Constants related to State
 enum
@@ -1453,6 +1564,8 @@ void      cComReadyMailBox(void);
 void      cComCloseMailBox(void);
 void      cComMailBoxSize(void);
 
+RESULT    cComWriteMailboxMsg(UBYTE *pMsg, UWORD Length);
+
 void      cComGetBrickName(DATA8 Length, DATA8 *pBrickName);
 DATA8     cComGetEvent(void);
 
@@ -1547,6 +1660,10 @@ typedef struct
   MAILBOX   MailBox[NO_OF_MAILBOXES];
 
   int       Cmdfd;
+  int       Bulkfd;
+  UWORD     BulkRxCnt;     // Bytes of the current message (or chunk) collected from the bulk stream
+  ULONG     BulkMsgRem;    // Bytes of the current message not handed on yet (0 = waiting for size field)
+  UBYTE     BulkFirst;     // Current chunk is the start of the message
   UBYTE		  VmReady;
   UBYTE     ComResult;
   UBYTE     ActiveComCh;   // Temporary fix until com channel functionality is in place, Ch interleaving not possible
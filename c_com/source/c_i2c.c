@@ -72,6 +72,8 @@
 
 #include  <linux/i2c-dev.h>
 #include  <pthread.h>
+#include  <poll.h>
+#include  <sys/time.h>
 
 
 /* I2C Adresses */
@@ -115,6 +117,7 @@ enum
 #define   MIN_MSG_LEN                   6
 #define   SLEEPuS                       ((ULONG)(1000))
 #define   SEC_1                         (((ULONG)(1000000))/SLEEPuS)
+#define   IDLE_WAITmS                   1      // Longest sleep while CTS is high and nothing is pending (as the old poll)
 
 typedef   struct
 {
@@ -142,6 +145,18 @@ static    char      *pBundleSeedIdString;
 
 static    char      TmpBuf[I2CBUF_SIZE + 1];
 
+static    UBYTE     CtsIrq;                       // d_bt signals CTS edges - wait with poll()
+static    int       WakePipe[2] = { -1, -1 };     // Wakes the thread when there is new data to send
+static    UBYTE     Mode2OutBuf[I2CBUF_SIZE];     // Mode2 data read from the PIC waiting for Bluetooth
+static    UWORD     Mode2OutLen;
+
+#ifdef DEBUG_TRACE_MODE2
+static    ULONG     TraceFromPic;
+static    ULONG     TraceToPic;
+static    ULONG     TraceWakeUps;
+static    time_t    TraceTime;
+#endif
+
 
 UBYTE     I2cReadStatus(UBYTE *pBuf);
 UBYTE     I2cReadCts(void);
@@ -154,6 +169,8 @@ void      I2cClearPIC_RST(void);
 void      I2cSetPIC_EN(void);
 void      I2cClearPIC_EN(void);
 void      I2cHiImpPIC_EN(void);
+void      I2cFlushToBt(void);
+UWORD     I2cWait(UBYTE Cts, UBYTE Busy);
 
 
 #define   BUFBytesFree                  (((Mode2InBuf.OutPtr - Mode2InBuf.InPtr) - 1)      &  ((UWORD)(MODE2BUF_SIZE - 1)))
@@ -183,6 +200,17 @@ RESULT    I2cInit(READBUF *pBuf, WRITEBUF *pWriteBuf, char *pBundleId, char *pBu
   pBundleIdString     =  pBundleId;
   pBundleSeedIdString =  pBundleSeedId;
 
+  if (0 == pipe(WakePipe))
+  {
+    fcntl(WakePipe[0], F_SETFL, O_NONBLOCK);
+    fcntl(WakePipe[1], F_SETFL, O_NONBLOCK);
+  }
+  else
+  {
+    WakePipe[0] = -1;
+    WakePipe[1] = -1;
+  }
+
   return(Result);
 }
 
@@ -194,6 +222,13 @@ void      I2cExit(void)
   {
     close(BtFile);
   }
+  if (WakePipe[0] >= MIN_HANDLE)
+  {
+    close(WakePipe[0]);
+    close(WakePipe[1]);
+    WakePipe[0] = -1;
+    WakePipe[1] = -1;
+  }
 }
 
 
@@ -205,6 +240,7 @@ void      I2cStart(void)
 
   Mode2InBuf.InPtr  = 0;
   Mode2InBuf.OutPtr = 0;
+  Mode2OutLen       = 0;
   Status            = MODE2_BOOTING;
 
   ThreadRunState = 1;
@@ -223,6 +259,8 @@ void*     I2cCtrl(void *ptr)
   UWORD   Size;
   UBYTE   Buf[200];
   UWORD   Check;
+  UBYTE   Cts;
+  UBYTE   Busy;
 
   I2cFile  =  -1;
 
@@ -283,14 +321,17 @@ void*     I2cCtrl(void *ptr)
   Check = 0;
   while(ThreadRunState)
   {
-    if (Check++ > SEC_1)
+    Cts  = 0;
+    Busy = 0;
+    if (Check > SEC_1)
     {
       // if CTS is low for 1 sec or more then it is an error
       DISCONNDueToErr;
     }
     else
     {
-      if (I2cReadCts())
+      Cts = I2cReadCts();
+      if (Cts)
       {
         Check = 0;          // CTS = High -> reset timer
 
@@ -368,32 +409,46 @@ void*     I2cCtrl(void *ptr)
               UWORD Test;
             #endif
 
-            // Check if TX Bt buffers are ready to accept data
-            if (cBtI2cBufReady())
+            // Read into the thread buffer as soon as it is free - it is
+            // handed to the Bluetooth TX buffer when that one is empty
+            if (0 == Mode2OutLen)
             {
               Size = Buf[1];
+              if (Size > sizeof(Mode2OutBuf))
+              {
+                // The PIC may report up to 255 bytes - read no more than fits
+                Size = sizeof(Mode2OutBuf);
+              }
 
               if (0 < Size)
               {
                 // Bytes for mode2 decoding are ready - read them
-                if (0 > I2cRead(I2cFile, READ_DATA, (char *)Buf, Size))
+                if (0 > I2cRead(I2cFile, READ_DATA, (char *)Mode2OutBuf, Size))
                 {
                   // Error
                   #ifdef DEBUG
                     printf("\r\n'A' Read error \r\n");
                   #endif
                 }
+                else
+                {
+                  #ifdef DEBUG
+                    printf("\r\nA - Reading mode2 data from decoding to Tx on Bluetooth\r\n");
+                    for(Test = 0; Test < Size; Test++)
+                    {
+                      printf("Buf[%d] = %02X\r\n",Test,Mode2OutBuf[Test]);
+                    }
+                  #endif
 
-                #ifdef DEBUG
-                  printf("\r\nA - Reading mode2 data from decoding to Tx on Bluetooth\r\n");
-                  for(Test = 0; Test < Size; Test++)
-                  {
-                    printf("Buf[%d] = %02X\r\n",Test,Buf[Test]);
-                  }
-                #endif
+                  Mode2OutLen = Size;
+                  Busy        = 1;
+                  #ifdef DEBUG_TRACE_MODE2
+                    TraceFromPic += Size;
+                  #endif
 
-                // Send the bytes for mode2 decoding
-                cBtI2cToBtBuf(Buf, Size);
+                  // Send the bytes for mode2 decoding
+                  I2cFlushToBt();
+                }
               }
             }
           }
@@ -402,7 +457,7 @@ void*     I2cCtrl(void *ptr)
           case 'W':
           {
             UWORD BytesToTx;
-            UWORD TmpCnt;
+            UWORD Part;
 
             // More data for mode2 decoding is needed at address 0x54
             #ifdef DEBUG
@@ -418,17 +473,21 @@ void*     I2cCtrl(void *ptr)
                 BytesToTx = (UWORD)(Buf[1]);
               }
 
-              #ifdef DEBUG
-                printf("\r\n Remote data:");
-              #endif
-              for (TmpCnt = 0; TmpCnt < BytesToTx; TmpCnt++)
+              if (BytesToTx > I2CBUF_SIZE)
               {
-                #ifdef DEBUG
-                  printf("%02X, ",Mode2InBuf.Buf[Mode2InBuf.OutPtr]);
-                #endif
-                TmpBuf[TmpCnt] = Mode2InBuf.Buf[Mode2InBuf.OutPtr];
-                BUFAddOutPtr(1);
+                // Not more than one burst
+                BytesToTx = I2CBUF_SIZE;
+              }
+
+              // Copy the (possibly wrapped) block in one or two goes
+              Part = MODE2BUF_SIZE - Mode2InBuf.OutPtr;
+              if (Part > BytesToTx)
+              {
+                Part = BytesToTx;
               }
+              memcpy(TmpBuf, &(Mode2InBuf.Buf[Mode2InBuf.OutPtr]), Part);
+              memcpy(&(TmpBuf[Part]), Mode2InBuf.Buf, BytesToTx - Part);
+              BUFAddOutPtr(BytesToTx);
 
               if (0 > I2cWrite(I2cFile, WRITE_DATA, (char*)TmpBuf, BytesToTx))
               {
@@ -437,6 +496,13 @@ void*     I2cCtrl(void *ptr)
                   printf("\r\n'W' write error \r\n");
                 #endif
               }
+              else
+              {
+                Busy = 1;
+                #ifdef DEBUG_TRACE_MODE2
+                  TraceToPic += BytesToTx;
+                #endif
+              }
             }
           }
           break;
@@ -470,6 +536,10 @@ void*     I2cCtrl(void *ptr)
               }
               else
               {
+                Busy = 1;
+                #ifdef DEBUG_TRACE_MODE2
+                  TraceToPic += MIN_MSG_LEN;
+                #endif
                 #ifdef DEBUG
                   printf("\r\n.... Remote data to the Pic, Bytes transferred %d\r\n",ByteCnt);
                 #endif
@@ -509,6 +579,10 @@ void*     I2cCtrl(void *ptr)
                 }
                 else
                 {
+                  Busy = 1;
+                  #ifdef DEBUG_TRACE_MODE2
+                    TraceToPic += ByteCnt;
+                  #endif
                   #ifdef DEBUG
                     printf("\r\n.... Application data to the Pic, Bytes to send %d\r\n",ByteCnt);
                   #endif
@@ -538,6 +612,10 @@ void*     I2cCtrl(void *ptr)
                 pReadBuf->OutPtr = 0;
                 pReadBuf->InPtr  = Size;
                 pReadBuf->Status = READ_BUF_FULL;
+                Busy             = 1;
+                #ifdef DEBUG_TRACE_MODE2
+                  TraceFromPic += Size;
+                #endif
 
                 #ifdef DEBUG
                   printf("\r\nR - %d bytes of App data read \r\n",Size);
@@ -605,7 +683,7 @@ void*     I2cCtrl(void *ptr)
         }
       }
     }
-    usleep(SLEEPuS);
+    Check += I2cWait(Cts, Busy);
   }
 
   if (I2cFile >= MIN_HANDLE)
@@ -618,6 +696,96 @@ void*     I2cCtrl(void *ptr)
 }
 
 
+void      I2cFlushToBt(void)
+{
+  // Hand data read from the PIC to Bluetooth as soon as its TX buffer is empty
+  if ((Mode2OutLen) && (cBtI2cBufReady()))
+  {
+    cBtI2cToBtBuf(Mode2OutBuf, Mode2OutLen);
+    Mode2OutLen = 0;
+  }
+}
+
+
+// Sleep until there is something to do - return value is the time waited in SLEEPuS ticks
+UWORD     I2cWait(UBYTE Cts, UBYTE Busy)
+{
+  struct    pollfd  Fds[2];
+  struct    timeval Start;
+  struct    timeval End;
+  UBYTE     Dummy[16];
+  int       Timeout;
+  UWORD     Ticks;
+
+  I2cFlushToBt();
+
+  #ifdef DEBUG_TRACE_MODE2
+    if (time(NULL) != TraceTime)
+    {
+      TraceTime = time(NULL);
+      printf("Mode2: from PIC %lu B/s, to PIC %lu B/s, %lu wake ups/s\r\n",(unsigned long)TraceFromPic,(unsigned long)TraceToPic,(unsigned long)TraceWakeUps);
+      TraceFromPic = 0;
+      TraceToPic   = 0;
+      TraceWakeUps = 0;
+    }
+    TraceWakeUps++;
+  #endif
+
+  Ticks = 0;
+  if ((Cts) && (Busy))
+  {
+    // PIC was serviced - go straight on with the next status (burst)
+  }
+  else
+  {
+    if ((CtsIrq) && (WakePipe[0] >= 0))
+    {
+      // Wake on a CTS edge or on new data for the PIC - only poll fast
+      // while data for Bluetooth is waiting for its TX buffer
+      Timeout = IDLE_WAITmS;
+      if ((Mode2OutLen) || (!Cts))
+      {
+        Timeout = SLEEPuS / 1000;
+      }
+
+      Fds[0].fd      = BtFile;
+      Fds[0].events  = POLLIN;
+      Fds[1].fd      = WakePipe[0];
+      Fds[1].events  = POLLIN;
+
+      gettimeofday(&Start, NULL);
+      if (0 < poll(Fds, 2, Timeout))
+      {
+        if (Fds[1].revents & POLLIN)
+        {
+          while (0 < read(WakePipe[0], Dummy, sizeof(Dummy)));
+        }
+      }
+      gettimeofday(&End, NULL);
+
+      Ticks = (UWORD)((((End.tv_sec - Start.tv_sec) * 1000000) + (End.tv_usec - Start.tv_usec)) / SLEEPuS);
+    }
+    else
+    {
+      usleep(SLEEPuS);
+      Ticks = 1;
+    }
+  }
+  return(Ticks);
+}
+
+
+void      I2cWake(void)
+{
+  UBYTE   Dummy = 0;
+
+  if (WakePipe[1] >= 0)
+  {
+    write(WakePipe[1], &Dummy, 1);
+  }
+}
+
+
 UBYTE     I2cReadCts(void)
 {
   UBYTE    Buf[10];
@@ -626,7 +794,8 @@ UBYTE     I2cReadCts(void)
   RtnVal = 0;
   if (BtFile >= 0)
   {
-    read(BtFile, Buf, 1);
+    // d_bt returns 2 bytes (level, edge) when it can signal CTS edges
+    CtsIrq = (2 == read(BtFile, Buf, 2)) ? 1 : 0;
 
     if (Buf[0])
     {
@@ -803,6 +972,7 @@ UWORD     DataToMode2Decoding(UBYTE *pBuf, UWORD Length)
       BUFAddInPtr(1);
     }
     BytesAccepted   =  BytesTransferred;
+    I2cWake();
   }
   return(BytesAccepted);
 }
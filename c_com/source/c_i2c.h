@@ -41,6 +41,7 @@ void      I2cStop(void);
 
 UWORD     DataToMode2Decoding(UBYTE *pBuf, UWORD Length);
 UBYTE     I2cGetBootStatus(void);
+void      I2cWake(void);
 
 
 #endif /* C_I2C_H_ */
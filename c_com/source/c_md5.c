@@ -30,6 +30,9 @@
 #include <endian.h>
 #include <unistd.h>
 #include  <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 
 typedef u_int32_t md5_uint32;
@@ -47,7 +50,19 @@ struct md5_ctx
   char buffer[128];
 };
 
-#define SWAP(n) (n)
+#if __BYTE_ORDER == __BIG_ENDIAN
+# define SWAP(n)                                                        \
+    (((n) << 24) | (((n) & 0xff00) << 8) | (((n) >> 8) & 0xff00) | ((n) >> 24))
+#else
+# define SWAP(n) (n)
+#endif
+
+/* Files are hashed from a window mapped into memory, MD5_MAP_SIZE bytes
+   at a time (a multiple of the page size and of 64).  If the file can not
+   be mapped it is read in MD5_READ_SIZE bytes (a multiple of 64) into an
+   aligned buffer instead.  */
+#define MD5_MAP_SIZE    (1024 * 1024)
+#define MD5_READ_SIZE   (32 * 1024)
 
 /* This array contains the bytes used to pad the buffer to the next
    64-byte boundary.  (RFC 1321, 3.1: Step 1)  */
@@ -67,13 +82,17 @@ static const unsigned char fillbuf[64] = { 0x80, 0 /* , 0, 0, ...  */  };
 
 
 /* Process LEN bytes of BUFFER, accumulating context into CTX.
-   It is assumed that LEN % 64 == 0.  */
+   It is assumed that LEN % 64 == 0.
+
+   On little endian targets a word aligned buffer is used in place, so
+   nothing is copied or swapped per block.  Unaligned or big endian
+   input is first copied (and swapped) into CORRECT_WORDS.  */
 void md5_process_block(const void *buffer, size_t len, struct md5_ctx *ctx)
 {
   md5_uint32        correct_words[16];
-  const md5_uint32 *words  = buffer;
-  size_t            nwords = len / sizeof(md5_uint32);
-  const md5_uint32 *endp = words + nwords;
+  const md5_uint32 *X;
+  const unsigned char *words = buffer;
+  const unsigned char *endp  = words + len;
   md5_uint32        A = ctx->A;
   md5_uint32        B = ctx->B;
   md5_uint32        C = ctx->C;
@@ -92,33 +111,50 @@ void md5_process_block(const void *buffer, size_t len, struct md5_ctx *ctx)
      the loop.  */
   while (words < endp)
   {
-    md5_uint32 *cwp   = correct_words;
     md5_uint32 A_save = A;
     md5_uint32 B_save = B;
     md5_uint32 C_save = C;
     md5_uint32 D_save = D;
 
-    /* First round: using the given function, the context and a constant
-       the next context is computed.  Because the algorithms processing
-       unit is a 32-bit word and it is determined to work on words in
-       little endian byte order we perhaps have to change the byte order
-       before the computation.  To reduce the work for the next steps
-       we store the swapped words in the array CORRECT_WORDS.
-    */
-    #define OP(a, b, c, d, s, T)	                        \
-    do								                                    \
-    {								                                      \
-	    a += FF (b, c, d) + (*cwp++ = SWAP (*words)) + T;		\
-	    ++words;							                              \
-	    CYCLIC (a, s);						                          \
-	    a += b;							                                \
-    }								                                      \
-    while (0)
+#if __BYTE_ORDER == __BIG_ENDIAN
+    {
+      int Cnt;
+
+      memcpy(correct_words, words, 64);
+      for (Cnt = 0; Cnt < 16; Cnt++)
+      {
+        correct_words[Cnt] = SWAP(correct_words[Cnt]);
+      }
+      X = correct_words;
+    }
+#else
+    if (((uintptr_t)words & (sizeof(md5_uint32) - 1)) == 0)
+    {
+      X = (const md5_uint32 *)words;
+    }
+    else
+    {
+      memcpy(correct_words, words, 64);
+      X = correct_words;
+    }
+#endif
+    words += 64;
 
     /* It is unfortunate that C does not provide an operator for
-       cyclic rotation.  Hope the C compiler is smart enough.  */
+       cyclic rotation.  Compilers turn this into a single rotate.  */
     #define CYCLIC(w, s) (w = (w << s) | (w >> (32 - s)))
 
+    /* One step: using the given function, the context, a word of the
+       block and a constant the next context is computed.  */
+    #define OP(f, a, b, c, d, k, s, T)                \
+    do                                                \
+    {                                                 \
+      a += f (b, c, d) + X[k] + T;                    \
+      CYCLIC (a, s);                                  \
+      a += b;                                         \
+    }                                                 \
+    while (0)
+
     /* Before we start, one word to the strange constants.
        They are defined in RFC 1321 as
 
@@ -126,36 +162,22 @@ void md5_process_block(const void *buffer, size_t len, struct md5_ctx *ctx)
     */
 
     /* Round 1.  */
-    OP(A, B, C, D,  7, 0xd76aa478);
-    OP(D, A, B, C, 12, 0xe8c7b756);
-    OP(C, D, A, B, 17, 0x242070db);
-    OP(B, C, D, A, 22, 0xc1bdceee);
-    OP(A, B, C, D,  7, 0xf57c0faf);
-    OP(D, A, B, C, 12, 0x4787c62a);
-    OP(C, D, A, B, 17, 0xa8304613);
-    OP(B, C, D, A, 22, 0xfd469501);
-    OP(A, B, C, D,  7, 0x698098d8);
-    OP(D, A, B, C, 12, 0x8b44f7af);
-    OP(C, D, A, B, 17, 0xffff5bb1);
-    OP(B, C, D, A, 22, 0x895cd7be);
-    OP(A, B, C, D,  7, 0x6b901122);
-    OP(D, A, B, C, 12, 0xfd987193);
-    OP(C, D, A, B, 17, 0xa679438e);
-    OP(B, C, D, A, 22, 0x49b40821);
-
-    /* For the second to fourth round we have the possibly swapped words
-       in CORRECT_WORDS.  Redefine the macro to take an additional first
-       argument specifying the function to use.  */
-    #undef OP
-
-    #define OP(f, a, b, c, d, k, s, T)					\
-    do 								                          \
-   {								                            \
-	    a += f (b, c, d) + correct_words[k] + T;	\
-	    CYCLIC (a, s);						                \
-	    a += b;							                      \
-	  }								                            \
-    while (0)
+    OP(FF, A, B, C, D, 0, 7, 0xd76aa478);
+    OP(FF, D, A, B, C, 1, 12, 0xe8c7b756);
+    OP(FF, C, D, A, B, 2, 17, 0x242070db);
+    OP(FF, B, C, D, A, 3, 22, 0xc1bdceee);
+    OP(FF, A, B, C, D, 4, 7, 0xf57c0faf);
+    OP(FF, D, A, B, C, 5, 12, 0x4787c62a);
+    OP(FF, C, D, A, B, 6, 17, 0xa8304613);
+    OP(FF, B, C, D, A, 7, 22, 0xfd469501);
+    OP(FF, A, B, C, D, 8, 7, 0x698098d8);
+    OP(FF, D, A, B, C, 9, 12, 0x8b44f7af);
+    OP(FF, C, D, A, B, 10, 17, 0xffff5bb1);
+    OP(FF, B, C, D, A, 11, 22, 0x895cd7be);
+    OP(FF, A, B, C, D, 12, 7, 0x6b901122);
+    OP(FF, D, A, B, C, 13, 12, 0xfd987193);
+    OP(FF, C, D, A, B, 14, 17, 0xa679438e);
+    OP(FF, B, C, D, A, 15, 22, 0x49b40821);
 
     /* Round 2.  */
     OP(FG, A, B, C, D, 1, 5, 0xf61e2562);
@@ -217,6 +239,8 @@ void md5_process_block(const void *buffer, size_t len, struct md5_ctx *ctx)
     C += C_save;
     D += D_save;
   }
+  #undef OP
+  #undef CYCLIC
 
   /* Put checksum in context given as argument.  */
   ctx->A = A;
@@ -393,38 +417,250 @@ int md5_stream(FILE *stream, void *resblock)
 }
 
 
-/* An interface to md5_stream.  Operate on FILENAME (it may be "-") and
-   put the result in *MD5_RESULT.  Return non-zero upon failure, zero
-   to indicate success.
+/* Compute MD5 message digest for the file open on FD, hashing it from
+   memory mapped windows if MAPPED is non-zero.  Falls back to aligned
+   reads when the file can not be mapped.  Return non-zero upon failure.
+
+   A mapped file that is truncated while it is hashed raises SIGBUS when
+   a page past the new end is touched, so only map files nobody is
+   writing.  */
+int md5_fd(int fd, int mapped, void *resblock)
+{
+  static md5_uint32 buffer[MD5_READ_SIZE / sizeof(md5_uint32)];
+  struct  md5_ctx ctx;
+  struct  stat    FileStat;
+  off_t   offset;
+  size_t  size;
+  void   *pMap;
+  ssize_t n;
+  size_t  sum;
+
+  md5_init_ctx(&ctx);
+
+  if (mapped && (fstat(fd, &FileStat) == 0) && S_ISREG(FileStat.st_mode))
+  {
+    offset  =  0;
+    pMap    =  MAP_FAILED;
+
+    while (offset < FileStat.st_size)
+    {
+      size  =  FileStat.st_size - offset;
+      if (size > MD5_MAP_SIZE)
+      {
+        size  =  MD5_MAP_SIZE;
+      }
+
+      pMap  =  mmap(0, size, PROT_READ, MAP_PRIVATE, fd, offset);
+      if (pMap == MAP_FAILED)
+      {
+        break;
+      }
+      madvise(pMap, size, MADV_SEQUENTIAL);
+
+      /* Page aligned - whole blocks are hashed in place, only the
+         tail of the last window goes through the context buffer.  */
+      md5_process_block(pMap, size & ~63, &ctx);
+      md5_process_bytes((const char *)pMap + (size & ~63), size & 63, &ctx);
+      munmap(pMap, size);
+      offset += size;
+    }
+
+    if (offset >= FileStat.st_size)
+    {
+      md5_finish_ctx(&ctx, resblock);
+      return 0;
+    }
+
+    /* Continue from where mapping stopped.  */
+    if (lseek(fd, offset, SEEK_SET) != offset)
+    {
+      return 1;
+    }
+  }
+
+  while (1)
+  {
+    sum = 0;
+
+    /* Read block.  Take care for partial reads.  */
+    do
+    {
+      n = read(fd, (char *)buffer + sum, MD5_READ_SIZE - sum);
+      if (n < 0)
+      {
+        if (errno == EINTR)
+        {
+          continue;
+        }
+        return 1;
+      }
+      sum += n;
+    }
+    while (sum < MD5_READ_SIZE && n != 0);
+
+    if (sum == MD5_READ_SIZE)
+    {
+      md5_process_block(buffer, MD5_READ_SIZE, &ctx);
+    }
+    else
+    {
+      /* End of file - add the last bytes.  */
+      if (sum > 0)
+      {
+        md5_process_bytes(buffer, sum, &ctx);
+      }
+      break;
+    }
+  }
+
+  md5_finish_ctx(&ctx, resblock);
+  return 0;
+}
+
+
+/* Operate on FILENAME and put the result in *MD5_RESULT.  Return zero
+   upon failure, non-zero to indicate success.  Pass MAPPED as zero if
+   the file may be written (or truncated) meanwhile - see md5_fd().
 */
-int md5_file(char *filename, int binary, unsigned char *md5_result)
+int md5_file(char *filename, int binary, int mapped, unsigned char *md5_result)
 {
-  FILE *fp;
+  int   fd;
+  int   Result;
 
-  fp = fopen(filename, OPENOPTS(binary));
-  if (fp == NULL)
+  fd = open(filename, O_RDONLY);
+  if (fd < 0)
   {
     printf("md5sum: %s: %s\n", filename, strerror(errno));
     return 0;
   }
 
-  if (md5_stream(fp, md5_result))
+  Result = md5_fd(fd, mapped, md5_result);
+  if (Result)
   {
     printf("md5sum: %s: %s\n", filename, strerror(errno));
+  }
+
+  if (close(fd) < 0)
+  {
+    printf("md5sum: %s: %s\n", filename, strerror(errno));
+    return 0;
+  }
+
+  return (Result == 0);
+}
+
+
+#ifdef MD5_SELFTEST
+/* Host self test and throughput benchmark:
+
+     gcc -O2 -DMD5_SELFTEST -o md5test c_md5.c
+     ./md5test [FILE ...]
+
+   Checks the RFC 1321 (A.5) test suite at every buffer misalignment,
+   times hashing a 64 MB memory buffer and, for each FILE given, prints
+   the sum as md5sum does together with the time md5_file() took.  */
+#include <time.h>
+
+#define MD5_BENCH_SIZE  (64 * 1024 * 1024)
+
+static const char *md5_test_vector[][2] =
+{
+  { "",                                                                                 "d41d8cd98f00b204e9800998ecf8427e" },
+  { "a",                                                                                "0cc175b9c0f1b6a831c399e269772661" },
+  { "abc",                                                                              "900150983cd24fb0d6963f7d28e17f72" },
+  { "message digest",                                                                   "f96b697d7cb7938d525a2f31aaf161d0" },
+  { "abcdefghijklmnopqrstuvwxyz",                                                       "c3fcd3d76192e4007dfb496cca67e13b" },
+  { "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789",                   "d174ab98d277d9f5a5611c2c9f419d9f" },
+  { "12345678901234567890123456789012345678901234567890123456789012345678901234567890", "57edf4a22be3c955ac49da2e2107b67a" },
+};
+
+static void md5_test_hex(const unsigned char *sum, char *hex)
+{
+  int Cnt;
 
-    if (fp != stdin)
+  for (Cnt = 0; Cnt < 16; Cnt++)
+  {
+    sprintf(&hex[Cnt * 2], "%02x", sum[Cnt]);
+  }
+}
+
+static double md5_test_ms(const struct timespec *start)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return ((now.tv_sec - start->tv_sec) * 1000.0) + ((now.tv_nsec - start->tv_nsec) / 1000000.0);
+}
+
+int main(int argc, char *argv[])
+{
+  static md5_uint32 aligned[32];
+  struct md5_ctx    ctx;
+  struct timespec   start;
+  md5_uint32        sum[4];
+  char              hex[MD5LEN + 1];
+  unsigned char    *pBench;
+  double            ms;
+  size_t            len;
+  int               Vector;
+  int               Offset;
+  int               Fail = 0;
+
+  for (Vector = 0; Vector < (int)(sizeof(md5_test_vector) / sizeof(md5_test_vector[0])); Vector++)
+  {
+    len = strlen(md5_test_vector[Vector][0]);
+
+    for (Offset = 0; Offset < (int)sizeof(md5_uint32); Offset++)
     {
-      fclose(fp);
+      memcpy((char *)aligned + Offset, md5_test_vector[Vector][0], len);
+
+      md5_init_ctx(&ctx);
+      md5_process_bytes((char *)aligned + Offset, len, &ctx);
+      md5_finish_ctx(&ctx, sum);
+      md5_test_hex((unsigned char *)sum, hex);
+
+      if (strcmp(hex, md5_test_vector[Vector][1]) != 0)
+      {
+        printf("FAIL MD5 (\"%s\") at offset %d = %s\n", md5_test_vector[Vector][0], Offset, hex);
+        Fail = 1;
+      }
     }
-    return 0;
   }
+  printf("RFC 1321 test suite: %s\n", Fail ? "FAILED" : "passed");
 
+  pBench = malloc(MD5_BENCH_SIZE);
+  if (pBench != NULL)
+  {
+    for (len = 0; len < MD5_BENCH_SIZE; len++)
+    {
+      pBench[len] = (unsigned char)(len * 31);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    md5_init_ctx(&ctx);
+    md5_process_bytes(pBench, MD5_BENCH_SIZE, &ctx);
+    md5_finish_ctx(&ctx, sum);
+    ms = md5_test_ms(&start);
+
+    printf("%d MB from memory: %.1f ms (%.1f MB/s)\n", MD5_BENCH_SIZE >> 20, ms, (MD5_BENCH_SIZE >> 20) * 1000.0 / ms);
+    free(pBench);
+  }
 
-  if (fp != stdin && fclose(fp) == EOF)
+  for (Vector = 1; Vector < argc; Vector++)
   {
-    printf("md5sum: %s: %s\n", filename, strerror(errno));
-    return 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (md5_file(argv[Vector], 0, 1, (unsigned char *)sum))
+    {
+      ms = md5_test_ms(&start);
+      md5_test_hex((unsigned char *)sum, hex);
+      printf("%s  %s  (%.1f ms)\n", hex, argv[Vector], ms);
+    }
+    else
+    {
+      Fail = 1;
+    }
   }
 
-  return 1;
+  return Fail;
 }
+#endif
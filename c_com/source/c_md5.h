@@ -25,7 +25,7 @@
 #define   MD5LEN                      32
 
 
-int md5_file(char *filename, int binary, unsigned char *md5_result);
+int md5_file(char *filename, int binary, int mapped, unsigned char *md5_result);
 
 
 #endif /* C_MD5_H_ */
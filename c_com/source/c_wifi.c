@@ -37,6 +37,7 @@
  */
 
 #include "c_wifi.h"
+#include "c_com.h"
 
 
 // Volatile data
@@ -93,9 +94,30 @@ static char AccessNameTable[MAX_ACCESS_NAME_COUNT][MAX_ACCESS_NAME_LENGTH];
 #define WPA_APPLIKATION_PATH            ""  // Not defined yet
 
 static struct wpa_ctrl *ctrl_conn;      // Control "handle" for the wpa_control interface
+static struct wpa_ctrl *mon_conn;       // Attached "handle" for unsolicited wpa_supplicant events
 
 struct timeval TimerStartVal, TimerCurrentVal;
 struct timeval DongleCheckStartVal, DongleCheckCurrentVal;
+struct timeval ConnectStartVal, ConnectBeginVal;
+
+// Connection to an AP - stepped from cWiFiControl
+int ConnectState = CONNECT_IDLE;
+int ConnectIndex = 0;
+int ConnectTries = 0;
+int ConnectPollMs = 0;
+int WpaLinkUp = FALSE;
+int LinkWasUp = FALSE;
+int LinkLost = FALSE;           // WiFi just turned on or the link went down - WIFI_INITIATED may reconnect
+int FastConnect = FALSE;
+int TcpReadyPending = FALSE;
+
+// Last good connection - persistent, tried first at reconnect
+LAST_GOOD LastGood;
+int LastGoodValid = FALSE;
+
+#ifdef DEBUG_TRACE_WIFI_LATENCY
+int WiFiControlMaxUs = 0;
+#endif
 
 unsigned int TimeOut = 0;
 
@@ -130,6 +152,17 @@ UWORD TcpTotalLength = 0;
 UWORD TcpRestLen = 0;
 UBYTE TcpReadState = TCP_IDLE;
 
+// UDP mailbox messages
+int MsgGroupSocket = -1;                    // WIFI_MSG_PORT - groups and IP addressed messages
+int MsgSocket = -1;                         // Ephemeral port - all TX, unicast RX and acknowledges
+UWORD MsgSeq = 0;
+UBYTE MsgId[4];
+struct in_addr MsgGroups[WIFI_MSG_GROUPS];
+int MsgGroupCnt = 0;
+WIFI_MSG_PEER MsgPeers[WIFI_MSG_PEERS];
+int MsgPeerNext = 0;
+WIFI_MSG_TX MsgTx[WIFI_MSG_PENDING];
+
 // ******************************************************************************
 
 void cWiFiStartTimer(void)  // Start the Timer
@@ -191,7 +224,20 @@ int cWiFiCheckTimer(void)   // Get Elapsed time in seconds
   return (int)(TimerCurrentVal.tv_sec - TimerStartVal.tv_sec);
 }
 
-// Used primarily for debug (development :-))
+int cWiFiElapsedMs(struct timeval *pStartVal)   // Get Elapsed time in mS
+{
+  struct timeval CurrentVal;
+
+  gettimeofday(&CurrentVal, NULL);
+  return (int)(((CurrentVal.tv_sec - (*pStartVal).tv_sec) * 1000) + ((CurrentVal.tv_usec - (*pStartVal).tv_usec) / 1000));
+}
+
+void cWiFiStartConnectTimer(void)
+{
+  gettimeofday(&ConnectStartVal, NULL);
+}
+
+// Unsolicited wpa_supplicant events (and debug (development :-))
 void wpa_control_message_callback(char *message, size_t length)
 {
   // #define DEBUG
@@ -199,6 +245,54 @@ void wpa_control_message_callback(char *message, size_t length)
   #ifdef DEBUG
     printf("%s\n", message);
   #endif
+
+  if(strstr(message, WPA_EVENT_CONNECTED) != NULL)
+  {
+    WpaLinkUp = TRUE;
+  }
+  if(strstr(message, WPA_EVENT_DISCONNECTED) != NULL)
+  {
+    WpaLinkUp = FALSE;
+  }
+}
+
+void cWiFiOpenMonitor(char *CtrlPath)   // Attach for events - without it we only lose the events
+{
+  if((mon_conn = wpa_ctrl_open(CtrlPath)) != NULL)
+  {
+    if(wpa_ctrl_attach(mon_conn) != 0)
+    {
+      wpa_ctrl_close(mon_conn);
+      mon_conn = NULL;
+    }
+  }
+}
+
+void cWiFiCloseMonitor(void)
+{
+  if(mon_conn != NULL)
+  {
+    wpa_ctrl_detach(mon_conn);
+    wpa_ctrl_close(mon_conn);
+    mon_conn = NULL;
+  }
+}
+
+void cWiFiPollEvents(void)  // Non-blocking - hand all pending events to the callback
+{
+  char Event[256];
+  size_t LenEvent;
+
+  while((mon_conn != NULL) && (wpa_ctrl_pending(mon_conn) > 0))
+  {
+    LenEvent = sizeof(Event) - 1; // Space for a trailing /0
+    if(wpa_ctrl_recv(mon_conn, Event, &LenEvent) != 0)
+    {
+      break;
+    }
+    Event[LenEvent] = '\0';
+    wpa_control_message_callback(Event, LenEvent);
+  }
 }
 
 int do_wpa_command(struct wpa_ctrl * control, char *command )
@@ -503,7 +597,6 @@ RESULT Ret = FAIL;
                                 CmdReturn,
                                 &LenCmdReturn,
                                 NULL);
-    sleep(3); // Force some cycles
     CmdReturn[LenCmdReturn] = '\0';
 
     #undef DEBUG
@@ -850,7 +943,6 @@ RESULT cWiFiAddNetwork(void)
                                 aCmdReturn,
                                 &LenaCmdReturn,
                                 NULL);
-    sleep(3); // Force some cycles
     aCmdReturn[LenaCmdReturn] = '\0';
 
     #undef DEBUG
@@ -1419,10 +1511,10 @@ RESULT cWiFiFindIpAddr(void)
   return Result;
 }
 
-RESULT cWiFiRequestIpAdr(char *Interface)
-{
+RESULT cWiFiRequestIpAdr(char *Interface, char *RequestIp, int Flush)  // Start udhcpc in background
+{                                                                       // - see cWiFiIpAdrAssigned
   RESULT Ret = FAIL;
-  char Cmd[48];
+  char Cmd[160];
 
   #undef DEBUG
   //#define DEBUG
@@ -1433,9 +1525,23 @@ RESULT cWiFiRequestIpAdr(char *Interface)
   // strcpy(Cmd, "busybox udhcpc -t 5 -q -i");
   // strcpy(Cmd, "busybox udhcpc -t5 -A2 -n -i");
   // added quit on lease
-  strcpy(Cmd, "udhcpc -t5 -A2 -nq -i");
+  // Old address is removed so that only a new lease shows up on the interface
+  Cmd[0] = '\0';
+  if(Flush == TRUE)
+  {
+    strcpy(Cmd, "ifconfig ");
+    strcat(Cmd, Interface);
+    strcat(Cmd, " 0.0.0.0 &> /dev/null; ");
+  }
+  strcat(Cmd, "udhcpc -t5 -A2 -nq");
+  if((RequestIp != NULL) && (strlen(RequestIp) >= 7))  // Ask for the last lease (no DISCOVER)
+  {
+    strcat(Cmd, " -r ");
+    strcat(Cmd, RequestIp);
+  }
+  strcat(Cmd, " -i");
   strcat(Cmd, Interface);
-  strcat(Cmd, " &> /dev/null");
+  strcat(Cmd, " &> /dev/null &");
 
   #undef DEBUG
   //#define DEBUG
@@ -1451,15 +1557,31 @@ RESULT cWiFiRequestIpAdr(char *Interface)
       printf("\r\nsystem(Cmd) == 0\r\n");
     #endif
 
-    cWiFiFindIpAddr(); // Get and Store IP address
+    Ret = OK;
+  }
+  return Ret;
+}
 
-    #undef DEBUG
-    //#define DEBUG
-    #ifdef DEBUG
-      printf("\r\nAfter cWiFiFindIpAddr()\r\n");
-    #endif
+RESULT cWiFiIpAdrAssigned(char *Interface)  // Cheap check (no fork) for an address on the Interface
+{
+  RESULT Ret = FAIL;
+  struct ifreq IfReq;
+  int Socket;
 
-    Ret = OK;
+  if((Socket = socket(AF_INET, SOCK_DGRAM, 0)) >= 0)
+  {
+    memset(&IfReq, 0x00, sizeof(IfReq));
+    IfReq.ifr_addr.sa_family = AF_INET;
+    strncpy(IfReq.ifr_name, Interface, IFNAMSIZ - 1);
+
+    if(ioctl(Socket, SIOCGIFADDR, &IfReq) == 0)
+    {
+      if(((struct sockaddr_in *)&IfReq.ifr_addr)->sin_addr.s_addr != 0)
+      {
+        Ret = OK;
+      }
+    }
+    close(Socket);
   }
   return Ret;
 }
@@ -1573,6 +1695,60 @@ RESULT cWiFiSetEnableNetwork(void)
   return Ret;
 }
 
+RESULT cWiFiSetDirected(char *Bssid, char *Frequency)  // Lock network 0 to the cached AP and channel
+{                                                      // i.e. no full scan before association
+  RESULT Ret = FAIL;
+  char CmdReturn[10];
+  char Cmd[64];
+  int RetVal;
+  size_t LenCmdReturn;
+
+  if((ctrl_conn != NULL) && (strlen(Bssid) == (MAC_ADDRESS_LENGTH - 1)))
+  {
+    strcpy(Cmd, "SET_NETWORK 0 bssid ");
+    strcat(Cmd, Bssid);
+
+    LenCmdReturn = sizeof(CmdReturn) - 1; // We leave space for a terminating /0x00
+    RetVal = wpa_ctrl_request(  ctrl_conn,
+                                Cmd,
+                                strlen(Cmd),
+                                CmdReturn,
+                                &LenCmdReturn,
+                                NULL);
+
+    if(RetVal < 0)
+    {
+      LenCmdReturn = 0;   // No answer (-2 = timed out)
+    }
+    CmdReturn[LenCmdReturn] = '\0';
+    if(strstr(CmdReturn, "OK") != NULL)
+    {
+      Ret = OK;
+
+      if(strlen(Frequency) > 0)   // Channel is only a help
+      {
+        strcpy(Cmd, "SET_NETWORK 0 scan_freq ");
+        strcat(Cmd, Frequency);
+
+        LenCmdReturn = sizeof(CmdReturn) - 1;
+        RetVal = wpa_ctrl_request(  ctrl_conn,
+                                    Cmd,
+                                    strlen(Cmd),
+                                    CmdReturn,
+                                    &LenCmdReturn,
+                                    NULL);
+      }
+    }
+
+    //#define DEBUG
+    #undef DEBUG
+    #ifdef DEBUG
+      printf("cWiFiSetDirected: bssid = %s, freq = %s, RetVal = %d\n\r", Bssid, Frequency, RetVal);
+    #endif
+  }
+  return Ret;
+}
+
 RESULT cWiFiWpaStatus(void)
 {
   RESULT Ret = FAIL;
@@ -1627,7 +1803,6 @@ RESULT cWiFiDisconnect(void)
                                 &LenCmdReturn,
                                 NULL);
 
-    sleep(2);
     CmdReturn[LenCmdReturn] = '\0';
 
     if(strstr(CmdReturn, "OK") != NULL)
@@ -1769,6 +1944,8 @@ void cWiFiCleanUpOldStuff(void)
 
   cWiFiUdpClientClose();
 
+  cWiFiMsgClose();        // Group memberships belong to the old link
+
   //Disconnect
   cWiFiDisconnect();
   //Kill udhcpc
@@ -1776,62 +1953,20 @@ void cWiFiCleanUpOldStuff(void)
 
   //Remove current network
   cWiFiRemoveNetwork();
-  sleep(3); // Give some time for cleaning before polluting again ;-)
+
+  ConnectState = CONNECT_IDLE;  // Any connection in progress is gone as well
 }
 
-RESULT cWiFiMakeConnectionToAp(int Index)
+RESULT cWiFiConfigureNetwork(int Index)   // Set up the added network block for ApTable[Index]
 {
   RESULT Result = FAIL;
-  RESULT LocalResult = FAIL;
-  int Tries;
 
     //#define DEBUG
     #undef DEBUG
     #ifdef DEBUG
-    	printf("cWiFiMakeConnectionToAp() with Index %d, WiFiStatus = %d\n\r", Index, WiFiStatus);
+    	printf("cWiFiConfigureNetwork() with Index %d, WiFiStatus = %d\n\r", Index, WiFiStatus);
     #endif
 
-    Tries = 0;
-    do
-    {
-      if(cWiFiAddNetwork() == OK)
-      {
-        //#define DEBUG
-        #undef DEBUG
-        #ifdef DEBUG
-          printf("Try no: %d\n\r", Tries);
-        #endif
-
-        LocalResult = OK;
-        break;
-      }
-      else
-      {
-        //#define DEBUG
-        #undef DEBUG
-        #ifdef DEBUG
-          printf("AddNetwork returns garbage\n\r");
-        #endif
-
-        sleep(3);               // Force some cycles
-
-        cWiFiRemoveNetwork();
-      }
-      Tries++;
-    }
-    while((Tries < 3) && (LocalResult == FAIL));
-
-    if(LocalResult == FAIL)
-    {
-      //#define DEBUG
-      #undef DEBUG
-      #ifdef DEBUG
-    	  printf("\r\nERROR_001\r\n");
-      #endif
-
-      return Result;
-    }
-
     // Set the SSID - already known
     if(cWiFiSetSsid(ApTable[Index].friendly_name) != OK)
     {
@@ -1966,97 +2101,116 @@ RESULT cWiFiMakeConnectionToAp(int Index)
       return Result;
     }
 
-    sleep(1);                     // Force some system cycles
-
-    // Reconnect
-    cWiFiReconnect();
-
-    // We need to get an (new) IP-address - network could have changed as well
-
-    strcpy(MyIp4Address, "???");  // Just to be sure - it's the only stuff
-
-    cWiFiKillUdHcPc();            // No leftover
-
-    sleep(1);                     // Force some system cycles
+    Result = OK;
+    return Result;  // Association and IP address lease are followed in cWiFiControl
+}
 
-    cWiFiRequestIpAdr(LogicalIfName);
 
-    //#define DEBUG
-    #undef DEBUG
-    #ifdef DEBUG
-      printf("Here is the (new) IP address: %s\n\r", MyIp4Address);
-    #endif
+void cWiFiClearConnectFlags(void)
+{
+  int j;
 
-    if(strstr(MyIp4Address, "???") == NULL)
+    if(ApTableSize > 1)
     {
-    	//#define DEBUG
-      #undef DEBUG
-      #ifdef DEBUG
-      	printf("MyIp4Address is OK - and NOT set to ??? => %s", MyIp4Address);
-    	#endif
-
-			Result = OK; // Assigned an IP
+      for(j = 0; j < ApTableSize; j++)
+        ApTable[j].ap_flags &= (UBYTE)(~CONNECTED);
     }
+}
 
-    //#define DEBUG
-    #undef DEBUG
-    #ifdef DEBUG
-      printf("\r\nDid we reach the end with an OK? cWiFiMakeConnectionToAp(Index)\r\n");
-      if(Result == OK)
-        printf("\r\nResult == OK\r\n");
-      else
-        printf("\r\nResult == NOT!!!! OK\r\n");
-    #endif
+void cWiFiStoreLastGood(int Index)  // Persistent cache of the network just connected
+{
+  char FileName[128];
+  FILE *PersistentFile = NULL;
+
+  memcpy(&(LastGood.Ap), &(ApTable[Index]), sizeof(aps));
+  LastGood.Ap.ap_flags &= AP_FLAG_ADJUST_FOR_STORAGE;
+  strcpy(LastGood.ip_address, MyIp4Address);
+  LastGoodValid = TRUE;
+
+  strcpy(FileName, WIFI_PERSISTENT_PATH);
+  strcat(FileName, "/");
+  strcat(FileName, WIFI_LAST_GOOD_FILENAME);
 
-    return Result;  // Only OK if an valid association & an IP address has been leased
-                    // Association could give OK even when not fully associated, but a valid
-                    // IP address shows (some) valid connection :-)
+  PersistentFile = fopen(FileName, "wb");
+  if(PersistentFile != NULL)
+  {
+    fwrite(&LastGood, sizeof(LastGood), 1, PersistentFile);
+    fclose(PersistentFile);
+  }
 }
 
-void cWiFiClearConnectFlags(void)
+void cWiFiLoadLastGood(void)
 {
-  int j;
+  char FileName[128];
+  FILE *PersistentFile = NULL;
 
-    if(ApTableSize > 1)
+  LastGoodValid = FALSE;
+
+  strcpy(FileName, WIFI_PERSISTENT_PATH);
+  strcat(FileName, "/");
+  strcat(FileName, WIFI_LAST_GOOD_FILENAME);
+
+  PersistentFile = fopen(FileName, "rb");
+  if(PersistentFile != NULL)
+  {
+    if(fread(&LastGood, sizeof(LastGood), 1, PersistentFile) == 1)
     {
-      for(j = 0; j < ApTableSize; j++)
-        ApTable[j].ap_flags &= (UBYTE)(~CONNECTED);
+      // Zero terminate whatever is in the file
+      LastGood.Ap.friendly_name[FRIENDLY_NAME_LENGTH - 1] = '\0';
+      LastGood.Ap.mac_address[MAC_ADDRESS_LENGTH - 1] = '\0';
+      LastGood.Ap.frequency[FREQUENCY_LENGTH - 1] = '\0';
+      LastGood.Ap.pre_shared_key[PSK_LENGTH - 1] = '\0';
+      LastGood.ip_address[sizeof(LastGood.ip_address) - 1] = '\0';
+
+      if(strlen(LastGood.Ap.friendly_name) > 0)
+      {
+        LastGoodValid = TRUE;
+      }
     }
+    fclose(PersistentFile);
+  }
 }
 
-RESULT cWiFiConnectToAp(int Index)
+void cWiFiConnectDone(RESULT Result)
 {
-  RESULT Result = FAIL;
+  ConnectState = CONNECT_IDLE;
 
-  // Make ApTable[Index] active - "if we're lucky" ;-)
+  if((Result != OK) && (FastConnect == TRUE))
+  { // Cached network did not make it - fall back to the full path
+    //#define DEBUG
+    #undef DEBUG
+    #ifdef DEBUG
+      printf("\r\nFast reconnect FAILed after %d mS - full connect\r\n", cWiFiElapsedMs(&ConnectBeginVal));
+    #endif
 
-  WiFiStatus = BUSY;
+    FastConnect = FALSE;
+    cWiFiKillUdHcPc();
+    cWiFiRemoveNetwork();
+    ConnectTries = 0;
+    ConnectState = CONNECT_ADD_NETWORK;
+    WiFiConnectionState = AP_CONNECTING;
+    return;
+  }
 
-  //#define DEBUG
-  #undef DEBUG
-  #ifdef DEBUG
-    printf("\r\ncWiFiConnectToAp(int Index = %d)\r\n", Index);
+  #ifdef DEBUG_TRACE_WIFI_LATENCY
+    printf("\r\nWiFi connect %s after %d mS - longest cWiFiControl call %d uS\r\n", (Result == OK) ? "OK" : "FAILED", cWiFiElapsedMs(&ConnectBeginVal), WiFiControlMaxUs);
+    WiFiControlMaxUs = 0;
   #endif
 
-  // Kill any connection info
-  cWiFiClearConnectFlags();
-
-  if(cWiFiMakeConnectionToAp(Index) == OK)
+  if(Result == OK)
   {
-    Result = OK;
-
     //#define DEBUG
     #undef DEBUG
     #ifdef DEBUG
-      printf("\r\ncWiFiMakeConnectionToAp(Index = %d) == OK)\r\n", Index);
+      printf("\r\ncWiFiConnectDone(Index = %d) == OK)\r\n", ConnectIndex);
     #endif
 
     // Move the active to TOP
     // Save selected for TOP placing
-    cWiFiPreserveActualApRecord(Index);
+    cWiFiPreserveActualApRecord(ConnectIndex);
 
     // Move all others down one step until index
-    cWifiMoveAllActualDown(Index);
+    cWifiMoveAllActualDown(ConnectIndex);
 
     // Restore and Save @ TOP
     cWiFiRestoreActualApRecord(0);
@@ -2073,22 +2227,270 @@ RESULT cWiFiConnectToAp(int Index)
     // This VERY Ap should now be stored as MOST WANTED @ next WiFi session
     cWiFiAddToKnownApList(0);
 
+    // And tried first without any scan
+    cWiFiStoreLastGood(0);
+    LinkWasUp = TRUE;
+    LinkLost = FALSE;
+
     WiFiConnectionState = UDP_NOT_INITIATED;
     WiFiStatus = OK;
   }
   else
   {
+    cWiFiKillUdHcPc();            // No leftover
     WiFiConnectionState = READY_FOR_AP_SEARCH;
     WiFiStatus = FAIL;
 
-    //#define DEBUG
-    #undef DEBUG
-    #ifdef DEBUG
-      printf("\r\nConnect FAILed.. READY_FOR_AP_SEARCH again\r\n");
-    #endif
+    //#define DEBUG
+    #undef DEBUG
+    #ifdef DEBUG
+      printf("\r\nConnect FAILed.. READY_FOR_AP_SEARCH again\r\n");
+    #endif
+  }
+}
+
+void cWiFiAssociateStep(void)   // AP_CONNECTING - one non blocking step
+{
+  switch(ConnectState)
+  {
+    case  CONNECT_ADD_NETWORK:  if(cWiFiAddNetwork() == OK)
+                                {
+                                  ConnectState = CONNECT_CONFIGURE;
+                                }
+                                else
+                                {
+                                  //#define DEBUG
+                                  #undef DEBUG
+                                  #ifdef DEBUG
+                                    printf("AddNetwork returns garbage - try no: %d\n\r", ConnectTries);
+                                  #endif
+
+                                  cWiFiRemoveNetwork();
+                                  ConnectTries++;
+                                  if(ConnectTries < WIFI_ADD_NETWORK_TRIES)
+                                  {
+                                    cWiFiStartConnectTimer();
+                                    ConnectState = CONNECT_RETRY_WAIT;
+                                  }
+                                  else
+                                  {
+                                    cWiFiConnectDone(FAIL);
+                                  }
+                                }
+                                break;
+
+    case  CONNECT_RETRY_WAIT:   // Give the supplicant some cycles before next try
+                                if(cWiFiElapsedMs(&ConnectStartVal) >= WIFI_ADD_NETWORK_RETRY_MS)
+                                {
+                                  ConnectState = CONNECT_ADD_NETWORK;
+                                }
+                                break;
+
+    case  CONNECT_CONFIGURE:    WpaLinkUp = FALSE;
+                                if(cWiFiConfigureNetwork(ConnectIndex) == OK)
+                                {
+                                  if(FastConnect == TRUE)
+                                  {
+                                    cWiFiSetDirected(ApTable[ConnectIndex].mac_address, ApTable[ConnectIndex].frequency);
+                                  }
+                                  cWiFiReconnect();
+                                  cWiFiStartConnectTimer();
+                                  ConnectState = CONNECT_ASSOCIATE;
+                                }
+                                else
+                                {
+                                  cWiFiConnectDone(FAIL);
+                                }
+                                break;
+
+    case  CONNECT_ASSOCIATE:    // Wait for the supplicant to tell CTRL-EVENT-CONNECTED
+                                // Without event monitor go straight on - DHCP will time out
+                                if((WpaLinkUp == TRUE) || (mon_conn == NULL))
+                                {
+                                  // We need to get an (new) IP-address - network could have changed as well
+                                  strcpy(MyIp4Address, "???");  // Just to be sure - it's the only stuff
+
+                                  cWiFiKillUdHcPc();            // No leftover
+
+                                  if(cWiFiRequestIpAdr(LogicalIfName, (FastConnect == TRUE) ? LastGood.ip_address : NULL, TRUE) == OK)
+                                  {
+                                    cWiFiStartConnectTimer();
+                                    ConnectPollMs = 0;
+                                    ConnectState = CONNECT_LEASE;
+                                    WiFiConnectionState = WIFI_CONNECTED_TO_AP;
+                                  }
+                                  else
+                                  {
+                                    cWiFiConnectDone(FAIL);
+                                  }
+                                }
+                                else
+                                {
+                                  if(cWiFiElapsedMs(&ConnectStartVal) >= ((FastConnect == TRUE) ? WIFI_FAST_TIMEOUT_MS : WIFI_ASSOCIATE_TIMEOUT_MS))
+                                  {
+                                    //#define DEBUG
+                                    #undef DEBUG
+                                    #ifdef DEBUG
+                                      printf("\r\nAssociation timed out\r\n");
+                                    #endif
+
+                                    cWiFiConnectDone(FAIL);
+                                  }
+                                }
+                                break;
+
+    default:                    cWiFiConnectDone(FAIL);
+                                break;
+  }
+}
+
+void cWiFiLeaseStep(void)       // WIFI_CONNECTED_TO_AP - one non blocking step
+{
+  int Elapsed;
+
+  Elapsed = cWiFiElapsedMs(&ConnectStartVal);
+
+  if(Elapsed >= ConnectPollMs)  // Don't misuse the CPU cycles
+  {
+    ConnectPollMs = Elapsed + WIFI_LEASE_POLL_MS;
+
+    if(cWiFiIpAdrAssigned(LogicalIfName) == OK)
+    {
+      cWiFiFindIpAddr(); // Get and Store IP address
+
+      //#define DEBUG
+      #undef DEBUG
+      #ifdef DEBUG
+        printf("Here is the (new) IP address: %s\n\r", MyIp4Address);
+      #endif
+
+      if(strstr(MyIp4Address, "???") == NULL)
+      {
+        cWiFiConnectDone(OK);   // Only OK if an valid association & an IP address has been leased
+      }
+    }
+    else
+    {
+      if(Elapsed >= ((FastConnect == TRUE) ? WIFI_FAST_TIMEOUT_MS : WIFI_LEASE_TIMEOUT_MS))
+      {
+        cWiFiConnectDone(FAIL);
+      }
+    }
+  }
+}
+
+
+RESULT cWiFiConnectToAp(int Index)
+{
+  RESULT Result = FAIL;
+
+  // Make ApTable[Index] active - "if we're lucky" ;-)
+  // Only starts the connection - cWiFiControl takes it through AP_CONNECTING
+  // and WIFI_CONNECTED_TO_AP without blocking the VM. WiFiStatus stays BUSY
+  // until an IP address has been leased or the connection has failed
+
+  WiFiStatus = BUSY;
+
+  //#define DEBUG
+  #undef DEBUG
+  #ifdef DEBUG
+    printf("\r\ncWiFiConnectToAp(int Index = %d)\r\n", Index);
+  #endif
+
+  // Kill any connection info
+  cWiFiClearConnectFlags();
+
+  FastConnect = FALSE;
+  if((ctrl_conn != NULL) && (Index >= 0) && (Index < ApTableSize))
+  {
+    // Same AP as last time - try the cached BSSID, channel and lease first
+    if((LastGoodValid == TRUE) && (strcmp(ApTable[Index].friendly_name, LastGood.Ap.friendly_name) == 0) && (strcmp(ApTable[Index].mac_address, LastGood.Ap.mac_address) == 0))
+    {
+      FastConnect = TRUE;
+    }
+    gettimeofday(&ConnectBeginVal, NULL);
+    TcpReadyPending = TRUE;
+    ConnectIndex = Index;
+    ConnectTries = 0;
+    ConnectState = CONNECT_ADD_NETWORK;
+    WiFiConnectionState = AP_CONNECTING;
+    Result = OK;
+  }
+  else
+  {
+    cWiFiConnectDone(FAIL);
+  }
+
+  return Result;
+}
+
+RESULT cWiFiFastReconnect(void)   // At WiFi on or after a link loss - reconnect to the last good AP without scanning
+{
+  RESULT Result = FAIL;
+  int Index;
+
+  if(LastGoodValid == TRUE)
+  {
+    for(Index = 0; Index < ApTableSize; Index++)
+    {
+      if(strcmp(ApTable[Index].friendly_name, LastGood.Ap.friendly_name) == 0)
+      {
+        break;
+      }
+    }
+    if(Index == ApTableSize)
+    { // Not in the visible list (no scan yet) - show the cached one
+      if(ApTableSize < MAX_AP_ENTRIES)
+      {
+        memcpy(&(ApTable[Index]), &(LastGood.Ap), sizeof(aps));
+        ApTable[Index].ap_flags |= KNOWN;
+        cWiFiIncApListSize();
+      }
+      else
+      {
+        Index = -1;
+      }
+    }
+
+    //#define DEBUG
+    #undef DEBUG
+    #ifdef DEBUG
+      printf("\r\ncWiFiFastReconnect to %s, Index = %d\r\n", LastGood.Ap.friendly_name, Index);
+    #endif
+
+    if(Index >= 0)
+    {
+      Result = cWiFiConnectToAp(Index);
+    }
+  }
+  return Result;
+}
+
+void cWiFiCheckLink(void)   // Dropout while connected - the supplicant re-associates by itself
+{
+  if((WiFiConnectionState >= UDP_NOT_INITIATED) && (WiFiConnectionState < CLOSED) && (mon_conn != NULL))
+  {
+    if(WpaLinkUp != LinkWasUp)
+    {
+      if(WpaLinkUp == FALSE)
+      {
+        gettimeofday(&ConnectBeginVal, NULL);
+        LinkLost = TRUE;
+      }
+      else
+      {
+        LinkLost = FALSE;
+        // Back on (the same) AP - renew the lease on the address we have
+        cWiFiKillUdHcPc();
+        cWiFiRequestIpAdr(LogicalIfName, MyIp4Address, FALSE);
+
+        #ifdef DEBUG_TRACE_WIFI_RECONNECT
+          printf("\r\nWiFi link back after %d mS - TCP ready\r\n", cWiFiElapsedMs(&ConnectBeginVal));
+        #endif
+      }
+      LinkWasUp = WpaLinkUp;
+    }
   }
-
-  return Result;
 }
 
 RESULT cWiFiMakePsk(char *ApSsid, char *PassPhrase, int Index)  // Make the pre-shared key from
@@ -3248,6 +3650,479 @@ RESULT cWiFiInitUdpConnection(void)
   return Result;
 }
 
+// UDP mailbox messages
+// --------------------
+// Every message carries a WRITEMAILBOX system command behind a WIFI_MSG_HEADER.
+// Messages to a brick (name or unicast IP) are acknowledged and retransmitted,
+// messages to a group are best effort. No connection set up - one datagram each.
+
+RESULT cWiFiMsgJoinGroup(struct in_addr Group)
+{
+  RESULT Result = FAIL;
+  struct ip_mreq Mreq;
+  int Index;
+
+  for(Index = 0; Index < MsgGroupCnt; Index++)
+  {
+    if(MsgGroups[Index].s_addr == Group.s_addr)
+    {
+      Result = OK;                          // Already a member
+    }
+  }
+
+  if((Result != OK) && (MsgGroupCnt < WIFI_MSG_GROUPS))
+  {
+    Mreq.imr_multiaddr = Group;
+    Mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+    if(setsockopt(MsgGroupSocket, IPPROTO_IP, IP_ADD_MEMBERSHIP, &Mreq, sizeof(Mreq)) == 0)
+    {
+      MsgGroups[MsgGroupCnt++] = Group;
+      Result = OK;
+    }
+  }
+
+  //#define DEBUG
+  #undef DEBUG
+  #ifdef DEBUG
+    printf("\r\nUDP message group %s join %s\r\n", inet_ntoa(Group), (Result == OK) ? "OK" : "FAILED");
+  #endif
+
+  return Result;
+}
+
+RESULT cWiFiMsgOpen(void)
+{
+  RESULT Result = FAIL;
+  struct sockaddr_in Addr;
+  struct in_addr Group;
+  struct timeval NowVal;
+  ULONG Id;
+  int Temp;
+  int ReUse = 1;
+  UBYTE Ttl = 1;                            // Same subnet only
+
+  if(MsgSocket >= 0)
+  {
+    Result = OK;                            // Already open
+  }
+  else
+  {
+    MsgGroupSocket = socket(AF_INET, SOCK_DGRAM, 0);
+    MsgSocket = socket(AF_INET, SOCK_DGRAM, 0);
+
+    if((MsgGroupSocket >= 0) && (MsgSocket >= 0))
+    {
+      // Several VM's on one host (X86 loopback) share the group port
+      setsockopt(MsgGroupSocket, SOL_SOCKET, SO_REUSEADDR, &ReUse, sizeof(ReUse));
+
+      memset(&Addr, 0, sizeof(Addr));
+      Addr.sin_family = AF_INET;
+      Addr.sin_addr.s_addr = htonl(INADDR_ANY);
+      Addr.sin_port = htons(WIFI_MSG_PORT);
+
+      if(bind(MsgGroupSocket, (struct sockaddr *)&Addr, sizeof(Addr)) == 0)
+      {
+        Addr.sin_port = 0;                  // Ephemeral - unique also with several VM's on one host
+        if(bind(MsgSocket, (struct sockaddr *)&Addr, sizeof(Addr)) == 0)
+        {
+          Temp = fcntl(MsgGroupSocket, F_GETFL, 0);
+          fcntl(MsgGroupSocket, F_SETFL, Temp | O_NONBLOCK);
+          Temp = fcntl(MsgSocket, F_GETFL, 0);
+          fcntl(MsgSocket, F_SETFL, Temp | O_NONBLOCK);
+
+          setsockopt(MsgSocket, IPPROTO_IP, IP_MULTICAST_TTL, &Ttl, sizeof(Ttl));
+          setsockopt(MsgSocket, SOL_SOCKET, SO_BROADCAST, &BroadCast, sizeof(BroadCast));
+
+          // Tells our own multicast loop back and restarted peers apart
+          gettimeofday(&NowVal, NULL);
+          Id = (ULONG)NowVal.tv_usec ^ ((ULONG)NowVal.tv_sec << 12) ^ ((ULONG)getpid() << 20);
+          memcpy(MsgId, &Id, sizeof(MsgId));
+
+          memset(MsgPeers, 0, sizeof(MsgPeers));
+          memset(MsgTx, 0, sizeof(MsgTx));
+          MsgPeerNext = 0;
+          MsgGroupCnt = 0;
+
+          // No multicast route is not fatal - unicast still works
+          Group.s_addr = inet_addr(WIFI_MSG_GROUP);
+          cWiFiMsgJoinGroup(Group);
+
+          Result = OK;
+        }
+      }
+    }
+
+    if(Result != OK)
+    {
+      cWiFiMsgClose();
+    }
+
+    //#define DEBUG
+    #undef DEBUG
+    #ifdef DEBUG
+      printf("\r\nUDP message sockets open %s\r\n", (Result == OK) ? "OK" : "FAILED");
+    #endif
+  }
+
+  return Result;
+}
+
+void cWiFiMsgClose(void)
+{
+  if(MsgGroupSocket >= 0)
+  {
+    close(MsgGroupSocket);                  // Group memberships go with the socket
+  }
+  if(MsgSocket >= 0)
+  {
+    close(MsgSocket);
+  }
+  MsgGroupSocket = -1;
+  MsgSocket = -1;
+  MsgGroupCnt = 0;
+}
+
+RESULT cWiFiMsgParseAddr(char *pTo, struct sockaddr_in *pAddr)  // "a.b.c.d" or "a.b.c.d:port"
+{
+  RESULT Result = FAIL;
+  char Ip[16];
+  char *pPort;
+  int Port = WIFI_MSG_PORT;
+
+  snprintf(Ip, sizeof(Ip), "%s", pTo);
+  pPort = strchr(Ip, ':');
+  if(pPort != NULL)
+  {
+    *pPort = 0;
+    Port = atoi(pPort + 1);
+  }
+
+  if((inet_aton(Ip, &((*pAddr).sin_addr)) != 0) && (Port > 0) && (Port <= 0xFFFF))
+  {
+    (*pAddr).sin_port = htons(Port);
+    Result = OK;
+  }
+
+  return Result;
+}
+
+int cWiFiMsgFindPeer(char *pName)
+{
+  int Peer = -1;
+  int Index;
+
+  for(Index = 0; (Index < WIFI_MSG_PEERS) && (Peer < 0); Index++)
+  {
+    if((MsgPeers[Index].Valid == TRUE) && (strcmp(MsgPeers[Index].Name, pName) == 0))
+    {
+      Peer = Index;
+    }
+  }
+  return Peer;
+}
+
+int cWiFiMsgLearnPeer(WIFI_MSG_HEADER *pHeader, struct sockaddr_in *pAddr, UWORD Seq)
+{
+  int Peer = -1;
+  int Index;
+
+  for(Index = 0; (Index < WIFI_MSG_PEERS) && (Peer < 0); Index++)
+  {
+    if((MsgPeers[Index].Valid == TRUE) && (memcmp(MsgPeers[Index].Id, (*pHeader).Id, sizeof(MsgPeers[Index].Id)) == 0))
+    {
+      Peer = Index;
+    }
+  }
+
+  if(Peer < 0)
+  {
+    // New (or restarted) brick - take the oldest entry
+    Peer = MsgPeerNext;
+    MsgPeerNext = (MsgPeerNext + 1) % WIFI_MSG_PEERS;
+    memcpy(MsgPeers[Peer].Id, (*pHeader).Id, sizeof(MsgPeers[Peer].Id));
+    MsgPeers[Peer].LastSeq = (UWORD)(Seq - 1);
+    MsgPeers[Peer].Seen = 0;
+    MsgPeers[Peer].Valid = TRUE;
+  }
+
+  // Name and address may change - always the latest
+  snprintf(MsgPeers[Peer].Name, sizeof(MsgPeers[Peer].Name), "%s", (char*)(*pHeader).From);
+  MsgPeers[Peer].Addr = *pAddr;
+
+  return Peer;
+}
+
+int cWiFiMsgSeen(int Peer, UWORD Seq)   // TRUE if message Seq from Peer has been delivered
+{
+  SWORD Diff = (SWORD)(Seq - MsgPeers[Peer].LastSeq);
+  int   Result = TRUE;
+
+  if(Diff > 0)
+  {
+    Result = FALSE;                     // Newer than any delivered
+  }
+  else
+  {
+    if((Diff < 0) && (Diff >= -32))
+    {
+      if((MsgPeers[Peer].Seen & (1UL << (-Diff - 1))) == 0)
+      {
+        Result = FALSE;                 // Overtaken by a newer one - not delivered yet
+      }
+    }
+  }
+  return Result;
+}
+
+void cWiFiMsgSetSeen(int Peer, UWORD Seq)
+{
+  SWORD Diff = (SWORD)(Seq - MsgPeers[Peer].LastSeq);
+
+  if(Diff > 0)
+  {
+    // Slide the window - the old newest becomes bit Diff - 1
+    if(Diff > 32)
+    {
+      MsgPeers[Peer].Seen = 0;
+    }
+    else
+    {
+      MsgPeers[Peer].Seen = ((Diff == 32) ? 0 : (MsgPeers[Peer].Seen << Diff)) | (1UL << (Diff - 1));
+    }
+    MsgPeers[Peer].LastSeq = Seq;
+  }
+  else
+  {
+    if((Diff < 0) && (Diff >= -32))
+    {
+      MsgPeers[Peer].Seen |= (1UL << (-Diff - 1));
+    }
+  }
+}
+
+void cWiFiMsgSetHeader(WIFI_MSG_HEADER *pHeader, UBYTE Type, UWORD Seq, char *pTo)
+{
+  memset(pHeader, 0, sizeof(WIFI_MSG_HEADER));
+  (*pHeader).Magic = WIFI_MSG_MAGIC;
+  (*pHeader).Type = Type;
+  (*pHeader).SeqLsb = (UBYTE)(Seq & 0x00FF);
+  (*pHeader).SeqMsb = (UBYTE)((Seq >> 8) & 0x00FF);
+  memcpy((*pHeader).Id, MsgId, sizeof(MsgId));
+  snprintf((char*)(*pHeader).From, sizeof((*pHeader).From), "%s", BrickName);
+  snprintf((char*)(*pHeader).To, sizeof((*pHeader).To), "%s", pTo);
+}
+
+RESULT cWiFiMsgSend(char *pTo, UBYTE *pBody, UWORD Length)
+{
+  RESULT Result = FAIL;
+  WIFI_MSG_HEADER *pHeader;
+  struct sockaddr_in Addr;
+  UBYTE Buf[sizeof(WIFI_MSG_HEADER) + WIFI_MSG_BODY_SIZE];
+  UWORD Size;
+  int Peer;
+  int Index;
+
+  if((Length <= WIFI_MSG_BODY_SIZE) && (cWiFiMsgOpen() == OK))
+  {
+    pHeader = (WIFI_MSG_HEADER*)Buf;
+    memset(&Addr, 0, sizeof(Addr));
+    Addr.sin_family = AF_INET;
+    Addr.sin_port = htons(WIFI_MSG_PORT);
+    MsgSeq++;
+
+    if(pTo[0] == 0)
+    {
+      // All bricks in the default group - best effort
+      cWiFiMsgSetHeader(pHeader, WIFI_MSG_DATA, MsgSeq, "");
+      Addr.sin_addr.s_addr = inet_addr(WIFI_MSG_GROUP);
+    }
+    else
+    {
+      if(cWiFiMsgParseAddr(pTo, &Addr) == OK)
+      {
+        cWiFiMsgSetHeader(pHeader, WIFI_MSG_DATA, MsgSeq, "");
+        if(IN_MULTICAST(ntohl(Addr.sin_addr.s_addr)))
+        {
+          cWiFiMsgJoinGroup(Addr.sin_addr);   // Talking in a group means listening in it too
+        }
+        else
+        {
+          (*pHeader).Flags |= WIFI_MSG_ACK_REQ;
+        }
+      }
+      else
+      {
+        // Brick name - direct if heard from before, else through the default group
+        cWiFiMsgSetHeader(pHeader, WIFI_MSG_DATA, MsgSeq, pTo);
+        (*pHeader).Flags |= WIFI_MSG_ACK_REQ;
+        Peer = cWiFiMsgFindPeer(pTo);
+        if(Peer >= 0)
+        {
+          Addr = MsgPeers[Peer].Addr;
+        }
+        else
+        {
+          Addr.sin_addr.s_addr = inet_addr(WIFI_MSG_GROUP);
+        }
+      }
+    }
+
+    memcpy(&Buf[sizeof(WIFI_MSG_HEADER)], pBody, Length);
+    Size = sizeof(WIFI_MSG_HEADER) + Length;
+
+    if(sendto(MsgSocket, Buf, Size, 0, (struct sockaddr *)&Addr, sizeof(Addr)) == Size)
+    {
+      Result = OK;
+    }
+
+    if((*pHeader).Flags & WIFI_MSG_ACK_REQ)
+    {
+      // Retransmitted from cWiFiMsgPoll until acknowledged - a full list is best effort
+      for(Index = 0; Index < WIFI_MSG_PENDING; Index++)
+      {
+        if(MsgTx[Index].Active == FALSE)
+        {
+          MsgTx[Index].Addr = Addr;
+          MsgTx[Index].Seq = MsgSeq;
+          MsgTx[Index].Length = Size;
+          MsgTx[Index].Tries = 0;
+          memcpy(MsgTx[Index].Buf, Buf, Size);
+          gettimeofday(&(MsgTx[Index].SentVal), NULL);
+          MsgTx[Index].FirstVal = MsgTx[Index].SentVal;
+          MsgTx[Index].Active = TRUE;
+          Result = OK;
+          break;
+        }
+      }
+    }
+
+    //#define DEBUG
+    #undef DEBUG
+    #ifdef DEBUG
+      printf("\r\nUDP message %u to \"%s\" (%s:%d) %s\r\n", MsgSeq, pTo, inet_ntoa(Addr.sin_addr), ntohs(Addr.sin_port), (Result == OK) ? "OK" : "FAILED");
+    #endif
+  }
+
+  return Result;
+}
+
+void cWiFiMsgAcked(UWORD Seq)
+{
+  int Index;
+
+  for(Index = 0; Index < WIFI_MSG_PENDING; Index++)
+  {
+    if((MsgTx[Index].Active == TRUE) && (MsgTx[Index].Seq == Seq))
+    {
+      MsgTx[Index].Active = FALSE;
+
+      #ifdef DEBUG_TRACE_UDP_MSG
+        {
+          struct timeval NowVal;
+
+          gettimeofday(&NowVal, NULL);
+          printf("\r\nUDP message %u acked - round trip %ld uS, %d retransmits\r\n", Seq, (long)(((NowVal.tv_sec - MsgTx[Index].FirstVal.tv_sec) * 1000000) + (NowVal.tv_usec - MsgTx[Index].FirstVal.tv_usec)), MsgTx[Index].Tries);
+        }
+      #endif
+    }
+  }
+}
+
+void cWiFiMsgReceive(int Socket)
+{
+  UBYTE Buf[sizeof(WIFI_MSG_HEADER) + WIFI_MSG_BODY_SIZE];
+  WIFI_MSG_HEADER *pHeader;
+  WIFI_MSG_HEADER Ack;
+  struct sockaddr_in Addr;
+  socklen_t AddrLen;
+  int Size;
+  int Cnt;
+  int Peer;
+  UWORD Seq;
+
+  pHeader = (WIFI_MSG_HEADER*)Buf;
+
+  // Bounded - cWiFiControl is called from the VM loop
+  for(Cnt = 0; Cnt < WIFI_MSG_RX_BURST; Cnt++)
+  {
+    AddrLen = sizeof(Addr);
+    Size = recvfrom(Socket, Buf, sizeof(Buf), 0, (struct sockaddr *)&Addr, &AddrLen);
+    if(Size < 0)
+    {
+      break;                                // Nothing (more) - non-blocking
+    }
+
+    if((Size >= (int)sizeof(WIFI_MSG_HEADER)) && ((*pHeader).Magic == WIFI_MSG_MAGIC) && (memcmp((*pHeader).Id, MsgId, sizeof(MsgId)) != 0))
+    {
+      Seq = (UWORD)(*pHeader).SeqLsb + ((UWORD)(*pHeader).SeqMsb << 8);
+      (*pHeader).From[NAME_LENGTH] = 0;
+      (*pHeader).To[NAME_LENGTH] = 0;
+
+      if((*pHeader).Type == WIFI_MSG_ACK)
+      {
+        cWiFiMsgAcked(Seq);
+      }
+      if((*pHeader).Type == WIFI_MSG_DATA)
+      {
+        Peer = cWiFiMsgLearnPeer(pHeader, &Addr, Seq);
+
+        if(((*pHeader).To[0] == 0) || (strcmp((char*)(*pHeader).To, BrickName) == 0))
+        {
+          // Every number not delivered yet - also one overtaken by a newer message
+          if(cWiFiMsgSeen(Peer, Seq) == FALSE)
+          {
+            cComWriteMailboxMsg(&Buf[sizeof(WIFI_MSG_HEADER)], (UWORD)(Size - sizeof(WIFI_MSG_HEADER)));
+            cWiFiMsgSetSeen(Peer, Seq);
+
+            #ifdef DEBUG_TRACE_UDP_MSG
+              printf("\r\nUDP message %u from \"%s\" (%s:%d) %d bytes\r\n", Seq, (char*)(*pHeader).From, inet_ntoa(Addr.sin_addr), ntohs(Addr.sin_port), Size);
+            #endif
+          }
+
+          if((*pHeader).Flags & WIFI_MSG_ACK_REQ)
+          {
+            // After delivery - and also for a duplicate as the first acknowledge may be the one lost
+            cWiFiMsgSetHeader(&Ack, WIFI_MSG_ACK, Seq, (char*)(*pHeader).From);
+            sendto(MsgSocket, &Ack, sizeof(Ack), 0, (struct sockaddr *)&Addr, sizeof(Addr));
+          }
+        }
+      }
+    }
+  }
+}
+
+void cWiFiMsgPoll(void)
+{
+  int Index;
+
+  if(MsgSocket >= 0)
+  {
+    cWiFiMsgReceive(MsgGroupSocket);
+    cWiFiMsgReceive(MsgSocket);
+
+    for(Index = 0; Index < WIFI_MSG_PENDING; Index++)
+    {
+      if((MsgTx[Index].Active == TRUE) && (cWiFiElapsedMs(&(MsgTx[Index].SentVal)) >= WIFI_MSG_RETRY_MS))
+      {
+        if(MsgTx[Index].Tries >= WIFI_MSG_RETRIES)
+        {
+          MsgTx[Index].Active = FALSE;      // Given up - the receiver is gone
+
+          #ifdef DEBUG_TRACE_UDP_MSG
+            printf("\r\nUDP message %u not acked - given up\r\n", MsgTx[Index].Seq);
+          #endif
+        }
+        else
+        {
+          sendto(MsgSocket, MsgTx[Index].Buf, MsgTx[Index].Length, 0, (struct sockaddr *)&(MsgTx[Index].Addr), sizeof(MsgTx[Index].Addr));
+          MsgTx[Index].Tries++;
+          gettimeofday(&(MsgTx[Index].SentVal), NULL);
+        }
+      }
+    }
+  }
+}
+
 void cWiFiSetBtSerialNo(void)
 {
   FILE *File;
@@ -3480,6 +4355,16 @@ void  cWiFiControl(void)
 {
   struct stat st;
   char Command[128];
+#ifdef DEBUG_TRACE_WIFI_LATENCY
+  struct timeval TraceStartVal, TraceEndVal;
+  int TraceUs;
+
+  gettimeofday(&TraceStartVal, NULL);
+#endif
+
+  cWiFiPollEvents();                      // Keep track of the link
+  cWiFiCheckLink();
+  cWiFiMsgPoll();                         // UDP mailbox messages - not tied to the TCP state
 
   if(BeaconTx == TX_BEACON)               // Do we have to TX the beacons?
   {
@@ -3608,7 +4493,10 @@ void  cWiFiControl(void)
                                                                 printf("\r\nWIFI_INIT, WAIT_ON_INTERFACE => Ping OK %d\r\n", WiFiStatus);
                                                               #endif
 
+                                                              cWiFiOpenMonitor(Command);
                                                               cWiFiPopulateKnownApList();
+                                                              cWiFiLoadLastGood();
+                                                              LinkLost = TRUE;    // No link yet - try the last good AP
                                                               WiFiStatus = OK;
                                                               WiFiConnectionState = WIFI_INITIATED;
                                                               InitState = DONE;
@@ -3650,6 +4538,12 @@ void  cWiFiControl(void)
                                   printf("\r\nREADY for search -> %d\r\n", WiFiStatus);
                                 #endif
 
+                                if(LinkLost == TRUE)
+                                { // Not after beacon errors or a failed scan - only with no link
+                                  LinkLost = FALSE;
+                                  cWiFiFastReconnect();   // Back on the last good AP if we can
+                                }
+
                                 break;
 
     case  READY_FOR_AP_SEARCH:  // We can select SEARCH i.e. Press Connections on the U.I.
@@ -3725,10 +4619,12 @@ void  cWiFiControl(void)
                                 break;
 
     case  AP_CONNECTING:        // First connecting to the selected AP
+                                cWiFiAssociateStep();
                                 break;
 
     case  WIFI_CONNECTED_TO_AP: // We have an active AP connection
                                 // Then get a valid IP address via DHCP
+                                cWiFiLeaseStep();
                                 break;
 
     case  UDP_NOT_INITIATED:    // We have an valid IP address
@@ -3763,6 +4659,8 @@ void  cWiFiControl(void)
                                     printf("\r\nUDP connection READY @ INIT_UDP_CONNECTION\r\n");
                                   #endif
 
+                                  cWiFiMsgOpen();                     // Mailbox messages on the new link
+
                                   if(cWiFiTransmitBeacon() == OK)     // Did we manage to TX one?
                                   {
                                     WiFiConnectionState = UDP_FIRST_TX;
@@ -3816,6 +4714,14 @@ void  cWiFiControl(void)
                                   #endif
 
                                   WiFiConnectionState = TCP_NOT_CONNECTED;
+
+                                  #ifdef DEBUG_TRACE_WIFI_RECONNECT
+                                    if(TcpReadyPending == TRUE)
+                                    {
+                                      printf("\r\nWiFi %s connect - TCP ready after %d mS\r\n", (FastConnect == TRUE) ? "fast" : "full", cWiFiElapsedMs(&ConnectBeginVal));
+                                    }
+                                  #endif
+                                  TcpReadyPending = FALSE;
                                 }
                                 break;
 
@@ -3886,6 +4792,14 @@ void  cWiFiControl(void)
       }
     }
   }
+#ifdef DEBUG_TRACE_WIFI_LATENCY
+  gettimeofday(&TraceEndVal, NULL);
+  TraceUs = (int)(((TraceEndVal.tv_sec - TraceStartVal.tv_sec) * 1000000) + (TraceEndVal.tv_usec - TraceStartVal.tv_usec));
+  if(TraceUs > WiFiControlMaxUs)
+  {
+    WiFiControlMaxUs = TraceUs;
+  }
+#endif
 }
 
 
@@ -3977,6 +4891,8 @@ RESULT    cWiFiTurnOff(void) // TURN OFF
 
     cWiFiUdpClientClose();
 
+    cWiFiMsgClose();
+
     cWiFiTerminate();
 
     //#define DEBUG
@@ -3990,6 +4906,10 @@ RESULT    cWiFiTurnOff(void) // TURN OFF
 
     WiFiConnectionState = WIFI_NOT_INITIATED;
     InitState = NOT_INIT;
+    ConnectState = CONNECT_IDLE;
+    LinkWasUp = FALSE;
+    LinkLost = FALSE;
+    cWiFiCloseMonitor();
     wpa_ctrl_close(ctrl_conn);
     ctrl_conn = NULL;
     cWiFiUnLoadAthHwModules();  // Unload the foundation for the rest
@@ -4017,6 +4937,7 @@ RESULT    cWiFiExit(void)
   RESULT  Result = FAIL;
 
   Result = cWiFiTurnOff();
+  cWiFiMsgClose();
   return Result;
 }
 
@@ -4041,6 +4962,9 @@ RESULT cWiFiInit(void)
   strcpy(MyHwMacAddress, "??:??:??:??:??:??");
   cWiFiSetBtSerialNo();
   cWiFiSetBrickName();
+#ifdef Linux_X86
+  cWiFiMsgOpen();         // No dongle - mailbox messages over the host network (loopback)
+#endif
   WiFiStatus = OK;
   Result = OK;
 
@@ -34,6 +34,8 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <sys/un.h>
+#include <sys/ioctl.h>
+#include <net/if.h>
 #include <errno.h>
 #include <bytecodes.h>
 
@@ -45,6 +47,7 @@
 
 #define WIFI_PERSISTENT_PATH    vmSETTINGS_DIR          // FileSys guidance ;-)
 #define WIFI_PERSISTENT_FILENAME  "WiFiConnections.dat" // Persistent storage for KNOWN connections
+#define WIFI_LAST_GOOD_FILENAME   "WiFiLastGood.dat"    // Persistent cache of the last good connection
 
 #define MAC_ADDRESS_LENGTH    18  // xx:xx:xx:xx:xx:xx + /0x00
 #define FREQUENCY_LENGTH      5
@@ -61,11 +64,29 @@
 #define WIFI_INIT_TIMEOUT     10  //60
 #define WIFI_INIT_DELAY       10
 
+#define WIFI_ADD_NETWORK_TRIES      3
+#define WIFI_ADD_NETWORK_RETRY_MS   1000  // Between ADD_NETWORK tries
+#define WIFI_ASSOCIATE_TIMEOUT_MS   15000 // Waiting for CTRL-EVENT-CONNECTED
+#define WIFI_LEASE_TIMEOUT_MS       20000 // udhcpc -t5 -A2 gives up before this
+#define WIFI_LEASE_POLL_MS          100   // Between checks for a leased IP address
+#define WIFI_FAST_TIMEOUT_MS        5000  // Cached network - association or lease before full path
+
 #define BROADCAST_IP_LOW  "255"   // "192.168.0.255"
 #define BROADCAST_PORT  	3015	  // UDP
 #define TCP_PORT 5555
 #define BEACON_TIME 5             // 5 sec's between BEACONs
 
+#define WIFI_MSG_PORT       3016            // UDP mailbox messages brick to brick
+#define WIFI_MSG_GROUP      "239.255.30.16" // Default group - every brick listens here
+#define WIFI_MSG_GROUPS     4               // Groups joined at a time (default included)
+#define WIFI_MSG_PEERS      8               // Bricks known by name (unicast address and last sequence)
+#define WIFI_MSG_PENDING    4               // Messages waiting for an acknowledge
+#define WIFI_MSG_RETRY_MS   20              // Between retransmits of an unacknowledged message
+#define WIFI_MSG_RETRIES    5               // Retransmits before a message is given up
+#define WIFI_MSG_RX_BURST   8               // Datagrams read per socket and cWiFiControl call
+#define WIFI_MSG_BODY_SIZE  320             // Room for a WRITEMAILBOX system command
+#define WIFI_MSG_MAGIC      0xE3
+
 #define TIME_FOR_WIFI_DONGLE_CHECK 10
 
 #define BLUETOOTH_SER_LENGTH  13  // No "white" space separators
@@ -101,6 +122,16 @@ enum                    // States the STACK goes through
   DONE              = 0x80
 };
 
+enum                    // States a connection to an AP goes through (AP_CONNECTING)
+{
+  CONNECT_IDLE        = 0x00,
+  CONNECT_ADD_NETWORK = 0x01,
+  CONNECT_RETRY_WAIT  = 0x02,
+  CONNECT_CONFIGURE   = 0x03,
+  CONNECT_ASSOCIATE   = 0x04,
+  CONNECT_LEASE       = 0x05  // WIFI_CONNECTED_TO_AP
+};
+
 enum                    // States the TCP connection can be in (READ)
 {
   TCP_IDLE                = 0x00,
@@ -166,6 +197,58 @@ typedef struct
 }
 aps;
 
+typedef struct
+{
+  aps  Ap;                                  // Network incl. derived PSK, BSSID and frequency
+  char ip_address[16];                      // Last leased address - requested again at reconnect
+}
+LAST_GOOD;
+
+enum                                        // UDP message types
+{
+  WIFI_MSG_DATA = 0x01,                     // Header followed by a WRITEMAILBOX system command
+  WIFI_MSG_ACK  = 0x02                      // Header only - Seq is the one acknowledged
+};
+
+#define WIFI_MSG_ACK_REQ  0x01              // Flags - sender wants an acknowledge
+
+typedef struct
+{
+  UBYTE Magic;                              // WIFI_MSG_MAGIC
+  UBYTE Type;
+  UBYTE Flags;
+  UBYTE SeqLsb;
+  UBYTE SeqMsb;
+  UBYTE Id[4];                              // Random per instance - own multicast and duplicates
+  UBYTE From[NAME_LENGTH + 1];              // Sending brick
+  UBYTE To[NAME_LENGTH + 1];                // Receiving brick - empty = all in the group
+}
+WIFI_MSG_HEADER;
+
+typedef struct
+{
+  UBYTE Id[4];
+  char  Name[NAME_LENGTH + 1];
+  struct sockaddr_in Addr;                  // The peer's ephemeral (unicast) message socket
+  UWORD LastSeq;                            // Newest delivered
+  ULONG Seen;                               // Bit n set - LastSeq - 1 - n delivered (older than the window counts as delivered)
+  UBYTE Valid;
+}
+WIFI_MSG_PEER;
+
+typedef struct
+{
+  struct sockaddr_in Addr;
+  struct timeval SentVal;                   // Last (re)transmit
+  struct timeval FirstVal;                  // First transmit - round trip time
+  UWORD Seq;
+  UWORD Length;
+  UBYTE Tries;
+  UBYTE Active;
+  UBYTE Buf[sizeof(WIFI_MSG_HEADER) + WIFI_MSG_BODY_SIZE];
+}
+WIFI_MSG_TX;
+
 // Common Network stuff
 // --------------------
 
@@ -182,6 +265,14 @@ RESULT  cWiFiTxingBeacons(void);        // Are we active in tx beacons??
 
 void cWiFiUdpClientClose(void);
 
+RESULT cWiFiMsgOpen(void);              // Mailbox message sockets - independent of the beacon
+
+void cWiFiMsgClose(void);
+
+RESULT cWiFiMsgSend(char *pTo, UBYTE *pBody, UWORD Length);  // "" = all, group/brick IP or brick name
+
+void cWiFiMsgPoll(void);                // RX, acknowledge and retransmit - from cWiFiControl
+
 // TCP functions
 // -------------
 
@@ -1603,20 +1603,40 @@ DATAF     cInputCalculateColor(COLORSTRUCT *pC)
 }
 
 
+/*! \brief    Calibrate and classify the NXT color sample once per input update
+ *
+ *  Called from "cInputUpdate" (every UPDATE_TIME2) for ports with a NXT color
+ *  sensor - reads only load the calibrated values and the cached color
+ *
+ */
+void      cInputUpdateColor(DATA8 Device)
+{
+  COLORSTRUCT *pC;
+  COLORSTRUCT Col;
+
+  pC    =  &(*InputInstance.pAnalog).NxtCol[Device];
+
+  // Work on a snapshot as the driver updates the raw values
+  Memcpy((void*)&Col,(const void*)pC,sizeof(COLORSTRUCT));
+
+  cInputCalibrateColor(&Col,Col.SensorRaw);
+  InputInstance.Color[Device]  =  cInputCalculateColor(&Col);
+  Memcpy((void*)(*pC).SensorRaw,(const void*)Col.SensorRaw,sizeof(Col.SensorRaw));
+}
+
+
 #ifndef DISABLE_DAISYCHAIN
 
 RESULT    cInputGetColor(DATA8 Device,DATA8 *pData)
 {
   RESULT  Result = FAIL;
 
-  cInputCalibrateColor(&(*InputInstance.pAnalog).NxtCol[Device],(*InputInstance.pAnalog).NxtCol[Device].SensorRaw);
-
   switch (InputInstance.DeviceMode[Device])
   {
     case 2 :
     { // NXT-COL-COL
 
-      pData[0]  =  cInputCalculateColor(&(*InputInstance.pAnalog).NxtCol[Device]);
+      pData[0]  =  InputInstance.Color[Device];
       Result  =  OK;
     }
     break;
@@ -1673,14 +1693,12 @@ DATAF     cInputGetColor(DATA8 Device,DATA8 Index)
 
   Result  =  DATAF_NAN;
 
-  cInputCalibrateColor(&(*InputInstance.pAnalog).NxtCol[Device],(*InputInstance.pAnalog).NxtCol[Device].SensorRaw);
-
   switch (InputInstance.DeviceMode[Device])
   {
     case 2 :
     { // NXT-COL-COL
 
-      Result  =  cInputCalculateColor(&(*InputInstance.pAnalog).NxtCol[Device]);
+      Result  =  InputInstance.Color[Device];
     }
     break;
 
@@ -3063,16 +3081,77 @@ RESULT    cInputCheckIicInfo(UBYTE Port)
 }
 
 
+/*! \brief    Apply device connection event
+ *
+ *            Called for every event read from the DCM event queue
+ *
+ */
+void      cInputDcmEvent(DCMEVENT *pEvent)
+{
+  DATA8   Device = DEVICES;
+  DATA8   Port;
+
+  Port  =  (*pEvent).Port;
+
+  if ((Port >= 0) && (Port < INPUTS))
+  { // Local input port
+
+    Device  =  Port;
+  }
+  if ((Port >= INPUTS) && (Port < (INPUTS + OUTPUTS)))
+  { // Local output port
+
+    Device  =  INPUT_DEVICES + (Port - INPUTS);
+  }
+
+  if (Device < DEVICES)
+  {
+    if ((*pEvent).Event == DCM_EVENT_CONFIRM)
+    { // Identification confirmed - nothing changes
+
+#ifdef DEBUG_TRACE_HOTPLUG
+      printf("c_input   D=%-2d C=%-3d T=%-3d confirmed after %lu mS\r\n",Device,(*pEvent).Conn,(*pEvent).Type,(unsigned long)((*InputInstance.pAnalog).DcmTime - (*pEvent).Time));
+#endif
+    }
+    else
+    { // Connected, disconnected or identification retracted
+
+      InputInstance.DeviceData[Device].Connection   =  (*pEvent).Conn;
+      cInputSetDeviceType(Device,(*pEvent).Type,0,__LINE__);
+
+      if (Device < INPUTS)
+      {
+        InputInstance.DeviceMode[Device]            =  0;
+        InputInstance.TmpMode[Device]               =  MAX_DEVICE_MODES;
+        InputInstance.DeviceData[Device].DevStatus  =  BUSY;
+      }
+#ifdef DEBUG_TRACE_HOTPLUG
+      InputInstance.DeviceData[Device].PlugTime     =  0;
+      if ((*pEvent).Event == DCM_EVENT_CONNECT)
+      {
+        InputInstance.DeviceData[Device].PlugTime   =  (*pEvent).Time;
+      }
+      printf("c_input   D=%-2d C=%-3d T=%-3d %s after %lu mS\r\n",Device,(*pEvent).Conn,(*pEvent).Type,((*pEvent).Event == DCM_EVENT_CONNECT) ? "identified" : "disconnected",(unsigned long)((*InputInstance.pAnalog).DcmTime - (*pEvent).Time));
+#endif
+    }
+  }
+}
+
+
 /*! \brief    Update Device Types
  *
  *            Called when the VM read the device list
  *
+ *            Local port changes are applied from the DCM event queue - the connections
+ *            are only compared with the DCM if events were lost
+ *
  */
 void      cInputDcmUpdate(UWORD Time)
 {
   RESULT  Result = BUSY;
   DATA8   Device;
   DATA8   Port;
+  DCMEVENT *pEvent;
 #ifndef DISABLE_DAISYCHAIN
   TYPES   Tmp;
   TYPES   *pTmp;
@@ -3085,6 +3164,23 @@ void      cInputDcmUpdate(UWORD Time)
 
   if (InputInstance.DCMUpdate)
   {
+    while (InputInstance.DcmEventOut != (*InputInstance.pAnalog).DcmEventIn)
+    { // Apply connection events in order
+
+      if ((UWORD)((*InputInstance.pAnalog).DcmEventIn - InputInstance.DcmEventOut) > DCM_EVENTS)
+      { // Queue overrun - compare connections instead
+
+        InputInstance.DcmEventOut  =  (*InputInstance.pAnalog).DcmEventIn;
+        InputInstance.DcmResync    =  1;
+      }
+      else
+      {
+        pEvent  =  &(*InputInstance.pAnalog).DcmEvent[InputInstance.DcmEventOut & (DCM_EVENTS - 1)];
+        cInputDcmEvent(pEvent);
+        InputInstance.DcmEventOut++;
+      }
+    }
+
     for (Device = 0;Device < DEVICES;Device++)
     {
 
@@ -3093,7 +3189,7 @@ void      cInputDcmUpdate(UWORD Time)
 
         Port  =  Device;
 
-        if (InputInstance.DeviceData[Device].Connection !=  (*InputInstance.pAnalog).InConn[Port])
+        if ((InputInstance.DcmResync) && (InputInstance.DeviceData[Device].Connection !=  (*InputInstance.pAnalog).InConn[Port]))
         { // Connection type has changed
 
           InputInstance.DeviceData[Device].Connection   =  (*InputInstance.pAnalog).InConn[Port];
@@ -3133,7 +3229,7 @@ void      cInputDcmUpdate(UWORD Time)
 
           Port  =  Device - INPUT_DEVICES;
 
-          if (InputInstance.DeviceData[Device].Connection !=  (*InputInstance.pAnalog).OutConn[Port])
+          if ((InputInstance.DcmResync) && (InputInstance.DeviceData[Device].Connection !=  (*InputInstance.pAnalog).OutConn[Port]))
           { // Connection type has changed
 
             InputInstance.DeviceData[Device].Connection   =  (*InputInstance.pAnalog).OutConn[Port];
@@ -3192,6 +3288,13 @@ void      cInputDcmUpdate(UWORD Time)
           if (Result == OK)
           {
             InputInstance.DeviceData[Device].DevStatus    =  OK;
+#ifdef DEBUG_TRACE_HOTPLUG
+            if (InputInstance.DeviceData[Device].PlugTime)
+            {
+              printf("c_input   D=%-2d first valid data %lu mS after plug in\r\n",Device,(unsigned long)((*InputInstance.pAnalog).DcmTime - InputInstance.DeviceData[Device].PlugTime));
+              InputInstance.DeviceData[Device].PlugTime  =  0;
+            }
+#endif
 
 #ifdef BUFPRINTSIZE
             BufPrint('p',"D=%-2d M=%d OK\r\n",(int)Device,InputInstance.DeviceMode[Device]);
@@ -3214,6 +3317,7 @@ void      cInputDcmUpdate(UWORD Time)
 
 
     }
+    InputInstance.DcmResync  =  0;
   }
 
 #ifndef DISABLE_DAISYCHAIN
@@ -3426,14 +3530,25 @@ void      cInputSimulate(UWORD Time,DATA8 Device,DATA8 Connection,DATA8 Type)
 
 void      cInputUpdate(UWORD Time)
 {
-#ifndef DISABLE_BUMBED
   DATA8   Device;
+#ifndef DISABLE_BUMBED
   DATAF   Value;
   DATAF   Diff;
 #endif
 
   cInputDcmUpdate(Time);
 
+#ifndef DISABLE_OLD_COLOR
+  for (Device = 0;Device < INPUTS;Device++)
+  { // New NXT color sample - calibrate and classify here instead of per read
+
+    if (InputInstance.DeviceData[Device].Connection == CONN_NXT_COLOR)
+    {
+      cInputUpdateColor(Device);
+    }
+  }
+#endif
+
 #ifndef DISABLE_BUMBED
   for (Device = 0;Device < INPUT_PORTS;Device++)
   { // check each port for changes
@@ -3540,6 +3655,8 @@ RESULT    cInputInit(void)
 #endif
     InputInstance.DCMUpdate   =  0;
   }
+  InputInstance.DcmEventOut =  (*InputInstance.pAnalog).DcmEventIn;
+  InputInstance.DcmResync   =  1;
 
 
   if (InputInstance.UartFile >= MIN_HANDLE)
@@ -3571,7 +3688,7 @@ RESULT    cInputInit(void)
 
   if (InputInstance.IicFile >= MIN_HANDLE)
   {
-    pIicTmp  =  (IIC*)mmap(0, sizeof(UART), PROT_READ | PROT_WRITE, MAP_FILE | MAP_SHARED, InputInstance.IicFile, 0);
+    pIicTmp  =  (IIC*)mmap(0, sizeof(IIC), PROT_READ | PROT_WRITE, MAP_FILE | MAP_SHARED, InputInstance.IicFile, 0);
 
     if (pIicTmp == MAP_FAILED)
     {
@@ -3800,6 +3917,15 @@ void      cInputDeviceList(void)
  *    -  \return (DATA8) \ref connectiontypes "CONN" - Connection type
  *
  *\n
+ *  - CMD = WAIT_CONNECTION
+ *\n  Wait for device to be plugged in, removed or replaced (dispatch status can change to BUSYBREAK)\n
+ *\n  Returns when the connection differs from CONN and the device is either disconnected or ready with data\n
+ *    -  \param  (DATA8)   LAYER        - Chain layer number [0..3]
+ *    -  \param  (DATA8)   NO           - Port number
+ *    -  \param  (DATA8) \ref connectiontypes "CONN" - Connection type to wait away from (e.g. CONN_NONE to wait for a device)
+ *    -  \return (DATA8) \ref connectiontypes "CONN" - New connection type
+ *
+ *\n
  *  - CMD = GET_NAME
  *\n  Get device name\n
  *    -  \param  (DATA8)   LAYER        - Chain layer number [0..3]
@@ -4199,6 +4325,44 @@ void      cInputDevice(void)
     }
     break;
 
+    case WAIT_CONNECTION :
+    {
+      Tmp         =  *(DATA8*)PrimParPointer();
+      Connection  =  CONN_NONE;
+      Busy        =  0;
+
+      if (Device < DEVICES)
+      {
+        Connection  =  InputInstance.DeviceData[Device].Connection;
+
+        if (Connection == Tmp)
+        { // No change yet
+
+          Busy  =  1;
+        }
+        else
+        {
+          if ((Connection != CONN_NONE) && (Connection != CONN_ERROR) && (InputInstance.DeviceData[Device].DevStatus == BUSY))
+          { // New device not ready yet
+
+            Busy  =  1;
+          }
+        }
+      }
+
+      if (Busy)
+      { // Busy -> block VMThread (woken up by next connection event)
+
+        SetObjectIp(TmpIp - 1);
+        SetDispatchStatus(BUSYBREAK);
+      }
+      else
+      {
+        *(DATA8*)PrimParPointer()  =  Connection;
+      }
+    }
+    break;
+
     case GET_NAME :
     {
       Length        =  *(DATA8*)PrimParPointer();
@@ -5436,14 +5600,18 @@ void    cInputIICRead(void)
     *RdLng  =  MAX_DEVICE_DATALENGTH;
   }
 
-	InputInstance.IicDat.Port     =  Device;
-	InputInstance.IicDat.RdLng    =  *RdLng;
-
-	ioctl(InputInstance.IicFile,IIC_READ_DATA,&InputInstance.IicDat);
+	if ((InputInstance.IicFile >= MIN_HANDLE) && ((*InputInstance.pIic).Result[Device] == OK))
+	{ // Result of latest opINPUT_IIC_WRITE is kept in shared memory by the driver
 
-	if (InputInstance.IicDat.Result == OK)
-	{
-    Memcpy(pRdData,&InputInstance.IicDat.RdData[0], InputInstance.IicDat.RdLng);
+    if (*RdLng > (*InputInstance.pIic).InputLength[Device])
+    {
+      *RdLng  =  (*InputInstance.pIic).InputLength[Device];
+    }
+    if (*RdLng < 0)
+    {
+      *RdLng  =  0;
+    }
+    Memcpy(pRdData,&(*InputInstance.pIic).Input[Device][0],*RdLng);
 		*pResult = OK;
 	}
 	else
@@ -5532,11 +5700,14 @@ void    cInputIICStatus(void)
   	return;
   }
 
-	InputInstance.IicDat.Port     =  Device;
-
-	ioctl(InputInstance.IicFile,IIC_READ_STATUS,&InputInstance.IicDat);
-
-  *pResult  =  InputInstance.IicDat.Result;
+	if (InputInstance.IicFile >= MIN_HANDLE)
+	{
+    *pResult  =  (*InputInstance.pIic).Result[Device];
+	}
+	else
+	{
+		*pResult = FAIL;
+	}
 }
 
 
@@ -118,6 +118,9 @@ typedef   struct
   UWORD   Timer;
   UBYTE   Dir;
 #endif
+#ifdef DEBUG_TRACE_HOTPLUG
+  ULONG   PlugTime;                           //!< DCM time when device was plugged in (0 = reported)
+#endif
 }
 DEVICE;
 
@@ -172,6 +175,12 @@ typedef struct
   UWORD     NoneIndex;
   UWORD     UnknownIndex;
   DATA8     DCMUpdate;
+  UWORD     DcmEventOut;                      //!< Device connection events read from queue
+  DATA8     DcmResync;                        //!< Compare connections with DCM (events lost)
+
+#ifndef DISABLE_OLD_COLOR
+  DATAF     Color[INPUTS];                    //!< NXT color classification from the last input update
+#endif
 
   DATA8     TypeModes[MAX_DEVICE_TYPE + 1];   //!< No of modes for specific type
 
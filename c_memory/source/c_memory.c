@@ -212,6 +212,7 @@ RESULT    cMemoryAlloc(PRGID PrgId,DATA8 Type,GBINDEX Size,void **ppMemory,HANDL
         *ppMemory  =  MemoryInstance.pPoolList[PrgId][TmpHandle].pPool;
         MemoryInstance.pPoolList[PrgId][TmpHandle].Type   =  Type;
         MemoryInstance.pPoolList[PrgId][TmpHandle].Size   =  Size;
+        MemoryInstance.pPoolList[PrgId][TmpHandle].LengthValid  =  0;
         *pHandle  =  TmpHandle;
         Result    =  OK;
       }
@@ -232,6 +233,88 @@ RESULT    cMemoryAlloc(PRGID PrgId,DATA8 Type,GBINDEX Size,void **ppMemory,HANDL
 }
 
 
+/*! \brief    Hand over memory allocated outside the pools to a program
+ *
+ *            The memory is freed together with the rest of the program pool
+ *
+ */
+RESULT    cMemoryAdopt(PRGID PrgId,void *pMemory,GBINDEX Size,HANDLER *pHandle)
+{
+  RESULT  Result = FAIL;
+  HANDLER TmpHandle;
+
+  *pHandle    =  -1;
+
+  if ((PrgId < MAX_PROGRAMS) && (pMemory != NULL))
+  {
+    TmpHandle   =  0;
+
+    while ((TmpHandle < MAX_HANDLES) && (MemoryInstance.pPoolList[PrgId][TmpHandle].pPool != NULL))
+    {
+      TmpHandle++;
+    }
+    if (TmpHandle < MAX_HANDLES)
+    {
+      MemoryInstance.pPoolList[PrgId][TmpHandle].pPool  =  pMemory;
+      MemoryInstance.pPoolList[PrgId][TmpHandle].Type   =  POOL_TYPE_MEMORY;
+      MemoryInstance.pPoolList[PrgId][TmpHandle].Size   =  Size;
+      MemoryInstance.pPoolList[PrgId][TmpHandle].LengthValid  =  0;
+      *pHandle  =  TmpHandle;
+      Result    =  OK;
+    }
+  }
+#ifdef DEBUG
+  printf("  cMemoryAdopt         %-8p S=%8lu P=%1u H=%1d\r\n",pMemory,(long unsigned int)Size,(unsigned int)PrgId,(int)*pHandle);
+#endif
+
+  return (Result);
+}
+
+
+/*! \brief    Load image file into memory not belonging to any program
+ *
+ *            Used to preload programs into standby (see \ref cMemoryAdopt)
+ *
+ */
+RESULT    cMemoryLoadImage(char *pFileName,void **ppImage,DATA32 *pSize,DATA32 *pModTime)
+{
+  RESULT  Result = FAIL;
+  int     hFile;
+  struct  stat FileStatus;
+
+  *ppImage  =  NULL;
+  *pSize    =  0;
+
+  hFile     =  open(pFileName,O_RDONLY);
+  if (hFile >= MIN_HANDLE)
+  {
+    if (fstat(hFile,&FileStatus) == 0)
+    {
+      if ((FileStatus.st_size > 0) && (FileStatus.st_size <= MAX_ARRAY_SIZE))
+      {
+        if (cMemoryRealloc(NULL,ppImage,(DATA32)FileStatus.st_size) == OK)
+        {
+          if (read(hFile,*ppImage,(size_t)FileStatus.st_size) == FileStatus.st_size)
+          {
+            *pSize      =  (DATA32)FileStatus.st_size;
+            *pModTime   =  (DATA32)FileStatus.st_mtime;
+            Result      =  OK;
+          }
+          else
+          {
+            cMemoryFree(*ppImage);
+            *ppImage    =  NULL;
+          }
+        }
+      }
+    }
+    close(hFile);
+  }
+
+  return (Result);
+}
+
+
 void*     cMemoryReallocate(PRGID PrgId,HANDLER Handle,GBINDEX Size)
 {
   void    *pTmp;
@@ -274,6 +357,7 @@ RESULT    cMemoryGetPointer(PRGID PrgId,HANDLER Handle,void **pMemory)
     if (MemoryInstance.pPoolList[PrgId][Handle].pPool != NULL)
     {
       *pMemory  =  MemoryInstance.pPoolList[PrgId][Handle].pPool;
+      MemoryInstance.pPoolList[PrgId][Handle].LengthValid  =  0;
       Result    =  OK;
     }
   }
@@ -517,6 +601,95 @@ void*     cMemoryResize(PRGID PrgId,HANDLER TmpHandle,DATA32 Elements)
 }
 
 
+/*! \brief    Make sure array can hold "Elements" (grows geometrically, never shrinks)
+ *
+ *            Used for arrays that are appended to repeatedly (string handles) so that
+ *            building a long string does not reallocate and copy on every append
+ *
+ *  \return   Pointer to first element in array (NULL if out of memory)
+ */
+void*     cMemoryGrow(PRGID PrgId,HANDLER Handle,DATA32 Elements)
+{
+  DATA32  NewElements;
+  DATA32  ElementSize;
+  void    *pTmp = NULL;
+
+  if (cMemoryGetPointer(PrgId,Handle,&pTmp) == OK)
+  {
+    if (Elements > (*(DESCR*)pTmp).Elements)
+    {
+      ElementSize   =  (DATA32)(*(DESCR*)pTmp).ElementSize;
+      NewElements   =  (*(DESCR*)pTmp).Elements * 2;
+      if (NewElements < Elements)
+      {
+        NewElements  =  Elements;
+      }
+      if ((NewElements * ElementSize + sizeof(DESCR)) > MAX_ARRAY_SIZE)
+      {
+        NewElements  =  Elements;
+      }
+      pTmp  =  cMemoryResize(PrgId,Handle,NewElements);
+    }
+    else
+    {
+      pTmp  =  (*(DESCR*)pTmp).pArray;
+    }
+  }
+
+  return (pTmp);
+}
+
+
+/*! \brief    Get tracked string length of DATA8 array
+ *
+ *            Length is only valid if set by "cMemorySetStringLength" and no pointer to
+ *            the array has been handed out since (zero termination is also checked)
+ *
+ *  \return   Length of string (not including zero termination) or -1 if unknown
+ */
+DATA32    cMemoryGetStringLength(PRGID PrgId,HANDLER Handle)
+{
+  DATA32  Result = -1;
+  DESCR   *pDescr;
+
+  if ((PrgId >= 0) && (PrgId < MAX_PROGRAMS) && (Handle >= 0) && (Handle < MAX_HANDLES))
+  {
+    if ((MemoryInstance.pPoolList[PrgId][Handle].LengthValid) && (MemoryInstance.pPoolList[PrgId][Handle].pPool != NULL))
+    {
+      pDescr  =  (DESCR*)MemoryInstance.pPoolList[PrgId][Handle].pPool;
+      if (((*pDescr).UsedElements < (*pDescr).Elements) && ((*pDescr).pArray[(*pDescr).UsedElements] == 0))
+      {
+        Result  =  (*pDescr).UsedElements;
+      }
+    }
+  }
+
+  return (Result);
+}
+
+
+/*! \brief    Set tracked string length of DATA8 array (stored in UsedElements)
+ *
+ */
+void      cMemorySetStringLength(PRGID PrgId,HANDLER Handle,DATA32 Length)
+{
+  DESCR   *pDescr;
+
+  if ((PrgId >= 0) && (PrgId < MAX_PROGRAMS) && (Handle >= 0) && (Handle < MAX_HANDLES))
+  {
+    if ((MemoryInstance.pPoolList[PrgId][Handle].Type == POOL_TYPE_MEMORY) && (MemoryInstance.pPoolList[PrgId][Handle].pPool != NULL))
+    {
+      pDescr  =  (DESCR*)MemoryInstance.pPoolList[PrgId][Handle].pPool;
+      if (((*pDescr).Type == DATA_8) && (Length >= 0) && (Length < (*pDescr).Elements))
+      {
+        (*pDescr).UsedElements  =  Length;
+        MemoryInstance.pPoolList[PrgId][Handle].LengthValid  =  1;
+      }
+    }
+  }
+}
+
+
 void      FindName(char *pSource,char *pPath,char *pName,char *pExt)
 {
   int     Source      = 0;
@@ -3083,7 +3256,26 @@ void      cMemoryFile(void)
 #ifdef DEBUG_TRACE_FILENAME
           printf("c_memory  cMemoryFile: LOAD_IMAGE  [%s]\r\n",FilenameBuf);
 #endif
+          STime         =  (DATA32)GetTimeUS();
+#ifndef DISABLE_PROGRAM_PRELOAD
+          if (ProgramStandbyClaim(PrgNo,FilenameBuf,&pImage,&ISize) == OK)
+          { // Already loaded and validated in standby
+
+            ImagePointer  =  (DATA32)pImage;
+            hFile         =  -1;
+          }
+          else
+          {
+            hFile       =  open(FilenameBuf,O_RDONLY);
+          }
+          if (PrgNo == USER_SLOT)
+          { // Remember as next program to preload
+
+            ProgramPreload(FilenameBuf);
+          }
+#else
           hFile         =  open(FilenameBuf,O_RDONLY);
+#endif
 
           if (hFile >= MIN_HANDLE)
           {
@@ -3102,6 +3294,7 @@ void      cMemoryFile(void)
 
             close(hFile);
           }
+          VMInstance.Program[PrgNo].LoadTime  =  (ULONG)((DATA32)GetTimeUS() - STime);
           *(DATA32*)PrimParPointer()  =  ISize;
           *(DATA32*)PrimParPointer()  =  ImagePointer;
         }
@@ -4731,7 +4924,8 @@ void      cMemoryFileMd5Sum(void)
 
   memset(pMd5Sum, 0, 16);
 
-  *pSuccess = md5_file((char*)pFileName, 0, (unsigned char *) pMd5Sum);
+  // A file open for writing may shrink while it is hashed - read it instead of mapping it
+  *pSuccess = md5_file((char*)pFileName, 0, (FAIL == cMemoryCheckOpenWrite((char*)pFileName)), (unsigned char *) pMd5Sum);
 }
 
 
@@ -54,6 +54,10 @@ RESULT    cMemoryRealloc(void *pOldMemory,void **ppMemory,DATA32 Size);
 
 RESULT    cMemoryFree(void *pMemory);
 
+RESULT    cMemoryAdopt(PRGID PrgId,void *pMemory,GBINDEX Size,HANDLER *pHandle);
+
+RESULT    cMemoryLoadImage(char *pFileName,void **ppImage,DATA32 *pSize,DATA32 *pModTime);
+
 RESULT    cMemoryGetPointer(PRGID PrgId,HANDLER Handle,void **pMemory);
 
 RESULT    cMemoryArraryPointer(PRGID PrgId,HANDLER Handle,void **pMemory);
@@ -96,6 +100,12 @@ void      cMemoryArrayAppend(void);
 
 void*     cMemoryResize(PRGID PrgId,HANDLER Handle,DATA32 Elements);
 
+void*     cMemoryGrow(PRGID PrgId,HANDLER Handle,DATA32 Elements);
+
+DATA32    cMemoryGetStringLength(PRGID PrgId,HANDLER Handle);
+
+void      cMemorySetStringLength(PRGID PrgId,HANDLER Handle,DATA32 Length);
+
 void      cMemoryFileName(void);
 
 
@@ -128,6 +138,7 @@ typedef   struct
   void    *pPool;
   GBINDEX Size;
   DATA8   Type;
+  DATA8   LengthValid;                    //!< DESCR UsedElements holds string length (cleared on every pointer hand out)
 }
 POOL;
 
@@ -45,6 +45,9 @@ opOUTPUT_STEP_SYNC    LAYER   NOS      SPEED   TURN    STEP    BRAKE           /
 opOUTPUT_TIME_SYNC    LAYER   NOS      SPEED   TURN    TIME    BRAKE           // Set all parameters, start if not started and power != 0
 opOUTPUT_CLR_COUNT    LAYER   NOS                                              // Clears the tacho count used when in sensor mode
 opOUTPUT_GET_COUNT    LAYER   NO       *STEPS                                  // Gets the tacho count used in sensor mode
+opOUTPUT_HOLD         LAYER   NOS      KP      KI      KD      DEADBAND POWER  // Set position hold regulator parameters
+opOUTPUT_STALL        LAYER   NOS      POWER   SPEED   DELAY   ACTION          // Set stall detection parameters
+opOUTPUT_STALL_READY  LAYER   NOS      *STALLED                                // Wait for stall on one of the outputs
 
 
 Parameters:
@@ -65,6 +68,13 @@ Parameters:
                       TIME2   DATA32   [0..MAX]            // Time [mS] for constant speed
                       TIME3   DATA32   [0..MAX]            // Time [mS] to ramp down
                       TURN    DATA16   [-200..200]         // Turn ratio between two syncronized motors
+                      KP      DATA16   [0..MAX]            // Proportional gain                    [0.01 %/degree]
+                      KI      DATA16   [0..MAX]            // Integral gain                        [0.01 %/(degree*S)]
+                      KD      DATA16   [0..MAX]            // Differential gain                    [0.01 %/speed %]
+                      DEADBAND DATA8   [0..MAX]            // Position error ignored               [degree]
+                      DELAY   DATA16   [0..MAX]            // Time [mS] stall condition must last before action
+                      ACTION  DATA8    [0..2]              // Action on stall                      (0=Flag, 1=Coast, 2=Brake)
+                      STALLED DATA8    [0x00..0x0F]        // Bit field representing stalled outputs
 */
 
 /*
@@ -295,6 +305,31 @@ void    cOutputSetTypes(char *pTypes)
 }
 
 
+/*! \brief    cOutputSetVbatt
+ *
+ *  Hand the battery voltage to the motor driver - called from UI every 400 mS.
+ *  The driver filters it and scales unregulated power to nominal voltage
+ *
+ *  \param  (DATAF)   Vbatt   - Battery voltage [V]
+ */
+void      cOutputSetVbatt(DATAF Vbatt)
+{
+  UWORD   mV = 0;
+  DATA8   No;
+
+#ifndef DISABLE_BATT_COMPENSATION
+  if ((Vbatt > (DATAF)0) && (Vbatt < (DATAF)65))
+  {
+    mV  =  (UWORD)(Vbatt * (DATAF)1000);
+  }
+#endif
+  for (No = 0; No < OUTPUTS; No++)
+  {
+    OutputInstance.pMotor[No].Vbatt  =  mV;
+  }
+}
+
+
 /*! \page cOutput Output
  *  <hr size="1"/>
  *  <b> UBYTE    cOutputPackParam (DATA32 Val, DATA8 *pStr)  </b>
@@ -1742,4 +1777,282 @@ void      cOutputGetCount(void)
 }
 
 
+/*! \page   cOutput
+ *  <hr size="1"/>
+ *  <b>     opOUTPUT_POSITION (LAYER, NOS, POS) </b>
+ *
+ *- Hold the outputs at a tacho sensor position\n
+ *- The motor driver regulates towards POS every regulation tick until another\n
+ *  power, speed, step, time or stop command is given - repeat to move the setpoint\n
+ *- Dispatch status unchanged
+ *
+ *  \param  (DATA8)   LAYER   - Chain layer number [0..3]
+ *  \param  (DATA8)   NOS     - Output bit field [0x00..0x0F]
+ *  \param  (DATA32)  POS     - Position in degrees (same count as opOUTPUT_GET_COUNT)
+ */
+/*! \brief  opOUTPUT_POSITION byte code
+ *
+ */
+void      cOutputPosition(void)
+{
+  DATA8   Layer;
+  DATA8   Tmp;
+  OUTPUTPOSITION  Position;
+  UBYTE   Len;
+  DSPSTAT DspStat = NOBREAK;
+  IP      TmpIp;
+
+  TmpIp              =  GetObjectIp();
+  Len                =  0;
+  Layer              =  *(DATA8*)PrimParPointer();
+  Position.Cmd       =  opOUTPUT_POSITION;
+  Position.Nos       =  *(DATA8*)PrimParPointer();
+  Position.Position  =  *(DATA32*)PrimParPointer();
+
+  if (0 == Layer)
+  {
+    if (OutputInstance.PwmFile >= 0)
+    {
+      write(OutputInstance.PwmFile,(DATA8*)&(Position.Cmd),sizeof(Position));
+
+      for (Tmp = 0; Tmp < OUTPUTS; Tmp++)
+      {
+        // Set calling id for all involved outputs
+        if (Position.Nos & (0x01 << Tmp))
+        {
+          OutputInstance.Owner[Tmp] = CallingObjectId();
+        }
+      }
+    }
+  }
+  else
+  {
+    #ifndef    DISABLE_DAISYCHAIN_COM_CALL
+      if (cDaisyReady() != BUSY)
+      {
+        DaisyBuf[Len++]  =  0;
+        DaisyBuf[Len++]  =  0;
+        DaisyBuf[Len++]  =  opOUTPUT_POSITION;
+        Len             +=  cOutputPackParam((DATA32)0, &(DaisyBuf[Len]));
+        Len             +=  cOutputPackParam((DATA32)Position.Nos, &(DaisyBuf[Len]));
+        Len             +=  cOutputPackParam((DATA32)Position.Position, &(DaisyBuf[Len]));
+        if(OK != cDaisyDownStreamCmd(DaisyBuf, Len, Layer))
+        {
+          SetObjectIp(TmpIp - 1);
+          DspStat  =  BUSYBREAK;
+        }
+      }
+      else
+      {
+        SetObjectIp(TmpIp - 1);
+        DspStat  =  BUSYBREAK;
+      }
+    #endif
+  }
+  SetDispatchStatus(DspStat);
+}
+
+
+/*! \page   cOutput
+ *  <hr size="1"/>
+ *  <b>     opOUTPUT_HOLD (LAYER, NOS, KP, KI, KD, DEADBAND, POWER) </b>
+ *
+ *- Set the position hold regulator parameters used by opOUTPUT_POSITION\n
+ *- Power [%] = (KP * error + KI * integrated error - KD * speed) / 100\n
+ *- Dispatch status unchanged
+ *
+ *  \param  (DATA8)   LAYER     - Chain layer number [0..3]
+ *  \param  (DATA8)   NOS       - Output bit field [0x00..0x0F]
+ *  \param  (DATA16)  KP        - Proportional gain [0.01 %/degree]
+ *  \param  (DATA16)  KI        - Integral gain [0.01 %/(degree*S)]
+ *  \param  (DATA16)  KD        - Differential gain [0.01 %/speed %]
+ *  \param  (DATA8)   DEADBAND  - Position error ignored [degree]
+ *  \param  (DATA8)   POWER     - Max power [0..100%]
+ */
+/*! \brief  opOUTPUT_HOLD byte code
+ *
+ */
+void      cOutputHold(void)
+{
+  DATA8   Layer;
+  HOLDSETUP HoldSetup;
+  UBYTE   Len;
+  DSPSTAT DspStat = NOBREAK;
+  IP      TmpIp;
+
+  TmpIp               =  GetObjectIp();
+  Len                 =  0;
+  Layer               =  *(DATA8*)PrimParPointer();
+  HoldSetup.Cmd       =  opOUTPUT_HOLD;
+  HoldSetup.Nos       =  *(DATA8*)PrimParPointer();
+  HoldSetup.Kp        =  *(DATA16*)PrimParPointer();
+  HoldSetup.Ki        =  *(DATA16*)PrimParPointer();
+  HoldSetup.Kd        =  *(DATA16*)PrimParPointer();
+  HoldSetup.Deadband  =  *(DATA8*)PrimParPointer();
+  HoldSetup.Power     =  *(DATA8*)PrimParPointer();
+
+  if (0 == Layer)
+  {
+    if (OutputInstance.PwmFile >= 0)
+    {
+      write(OutputInstance.PwmFile,(DATA8*)&(HoldSetup.Cmd),sizeof(HoldSetup));
+    }
+  }
+  else
+  {
+    #ifndef    DISABLE_DAISYCHAIN_COM_CALL
+      if (cDaisyReady() != BUSY)
+      {
+        DaisyBuf[Len++]  =  0;
+        DaisyBuf[Len++]  =  0;
+        DaisyBuf[Len++]  =  opOUTPUT_HOLD;
+        Len             +=  cOutputPackParam((DATA32)0, &(DaisyBuf[Len]));
+        Len             +=  cOutputPackParam((DATA32)HoldSetup.Nos, &(DaisyBuf[Len]));
+        Len             +=  cOutputPackParam((DATA32)HoldSetup.Kp, &(DaisyBuf[Len]));
+        Len             +=  cOutputPackParam((DATA32)HoldSetup.Ki, &(DaisyBuf[Len]));
+        Len             +=  cOutputPackParam((DATA32)HoldSetup.Kd, &(DaisyBuf[Len]));
+        Len             +=  cOutputPackParam((DATA32)HoldSetup.Deadband, &(DaisyBuf[Len]));
+        Len             +=  cOutputPackParam((DATA32)HoldSetup.Power, &(DaisyBuf[Len]));
+        if(OK != cDaisyDownStreamCmd(DaisyBuf, Len, Layer))
+        {
+          SetObjectIp(TmpIp - 1);
+          DspStat  =  BUSYBREAK;
+        }
+      }
+      else
+      {
+        SetObjectIp(TmpIp - 1);
+        DspStat  =  BUSYBREAK;
+      }
+    #endif
+  }
+  SetDispatchStatus(DspStat);
+}
+
+
+/*! \page   cOutput
+ *  <hr size="1"/>
+ *  <b>     opOUTPUT_STALL (LAYER, NOS, POWER, SPEED, DELAY, ACTION) </b>
+ *
+ *- Set the stall detection evaluated by the motor driver every regulation tick\n
+ *- An output is stalled when driven with at least POWER while running at most\n
+ *  SPEED for DELAY mS - the stall flag is set and the ACTION is taken\n
+ *- Dispatch status unchanged
+ *
+ *  \param  (DATA8)   LAYER   - Chain layer number [0..3]
+ *  \param  (DATA8)   NOS     - Output bit field [0x00..0x0F]
+ *  \param  (DATA8)   POWER   - Min power [0..100%] (0 = disable stall detection)
+ *  \param  (DATA8)   SPEED   - Max speed [0..100%]
+ *  \param  (DATA16)  DELAY   - Time the condition must last [mS]
+ *  \param  (DATA8)   ACTION  - Action on stall (0 = flag only, 1 = coast, 2 = brake)
+ */
+/*! \brief  opOUTPUT_STALL byte code
+ *
+ */
+void      cOutputStall(void)
+{
+  DATA8   Layer;
+  STALLSETUP StallSetup;
+  UBYTE   Len;
+  DSPSTAT DspStat = NOBREAK;
+  IP      TmpIp;
+
+  TmpIp               =  GetObjectIp();
+  Len                 =  0;
+  Layer               =  *(DATA8*)PrimParPointer();
+  StallSetup.Cmd      =  opOUTPUT_STALL;
+  StallSetup.Nos      =  *(DATA8*)PrimParPointer();
+  StallSetup.Power    =  *(DATA8*)PrimParPointer();
+  StallSetup.Speed    =  *(DATA8*)PrimParPointer();
+  StallSetup.Delay    =  *(DATA16*)PrimParPointer();
+  StallSetup.Action   =  *(DATA8*)PrimParPointer();
+
+  if (0 == Layer)
+  {
+    if (OutputInstance.PwmFile >= 0)
+    {
+      write(OutputInstance.PwmFile,(DATA8*)&(StallSetup.Cmd),sizeof(StallSetup));
+    }
+  }
+  else
+  {
+    #ifndef    DISABLE_DAISYCHAIN_COM_CALL
+      if (cDaisyReady() != BUSY)
+      {
+        DaisyBuf[Len++]  =  0;
+        DaisyBuf[Len++]  =  0;
+        DaisyBuf[Len++]  =  opOUTPUT_STALL;
+        Len             +=  cOutputPackParam((DATA32)0, &(DaisyBuf[Len]));
+        Len             +=  cOutputPackParam((DATA32)StallSetup.Nos, &(DaisyBuf[Len]));
+        Len             +=  cOutputPackParam((DATA32)StallSetup.Power, &(DaisyBuf[Len]));
+        Len             +=  cOutputPackParam((DATA32)StallSetup.Speed, &(DaisyBuf[Len]));
+        Len             +=  cOutputPackParam((DATA32)StallSetup.Delay, &(DaisyBuf[Len]));
+        Len             +=  cOutputPackParam((DATA32)StallSetup.Action, &(DaisyBuf[Len]));
+        if(OK != cDaisyDownStreamCmd(DaisyBuf, Len, Layer))
+        {
+          SetObjectIp(TmpIp - 1);
+          DspStat  =  BUSYBREAK;
+        }
+      }
+      else
+      {
+        SetObjectIp(TmpIp - 1);
+        DspStat  =  BUSYBREAK;
+      }
+    #endif
+  }
+  SetDispatchStatus(DspStat);
+}
+
+
+/*! \page   cOutput
+ *  <hr size="1"/>
+ *  <b>     opOUTPUT_STALL_READY (LAYER, NOS, *STALLED) </b>
+ *
+ *- Wait until the motor driver detects a stall on one of the outputs\n
+ *- The stall flags are in shared memory and cleared by the next power, speed,\n
+ *  start, step, time or position command on the output\n
+ *- Dispatch status can change to BUSYBREAK
+ *
+ *  \param  (DATA8)   LAYER   - Chain layer number [0..3]
+ *  \param  (DATA8)   NOS     - Output bit field [0x00..0x0F]
+ *  \return (DATA8)   STALLED - Stalled outputs bit field [0x00..0x0F] (0 on chain layers)
+ */
+/*! \brief  opOUTPUT_STALL_READY byte code
+ *
+ */
+void      cOutputStallReady(void)
+{
+  DATA8   Layer;
+  DATA8   Nos;
+  DATA8   Stalled = 0;
+  UBYTE   Tmp;
+  IP      TmpIp;
+  DSPSTAT DspStat = NOBREAK;
+
+  TmpIp  =  GetObjectIp();
+  Layer  =  *(DATA8*)PrimParPointer();
+  Nos    =  *(DATA8*)PrimParPointer();
+
+  if (0 == Layer)
+  {
+    for (Tmp = 0;Tmp < OUTPUTS;Tmp++)
+    {
+      if ((Nos & (1 << Tmp)) && (OutputInstance.pMotor[Tmp].Stalled))
+      {
+        Stalled |=  (1 << Tmp);
+      }
+    }
+    if (0 == Stalled)
+    {
+      // Rewind IP
+      SetObjectIp(TmpIp - 1);
+      DspStat  =  BUSYBREAK;
+    }
+  }
+  *(DATA8*)PrimParPointer()  =  Stalled;
+  SetDispatchStatus(DspStat);
+}
+
+
 //*****************************************************************************
@@ -33,6 +33,7 @@ RESULT    cOutputClose(void);
 RESULT    cOutputExit(void);
 
 void      cOutputSetTypes(char *pTypes);
+void      cOutputSetVbatt(DATAF Vbatt);
 void      cOutputSetType(void);
 UBYTE     cMotorGetBusyFlags(void);
 void      cMotorSetBusyFlags(UBYTE Flags);
@@ -57,6 +58,10 @@ void      cOutputStepSync(void);
 void      cOutputTimeSync(void);
 void      cOutputClrCount(void);
 void      cOutputGetCount(void);
+void      cOutputPosition(void);
+void      cOutputHold(void);
+void      cOutputStall(void);
+void      cOutputStallReady(void);
 
 typedef struct
 {
@@ -156,6 +156,7 @@
 #include  "../../c_memory/source/c_memory.h"
 #include  "../../c_com/source/c_com.h"
 #include  "../../c_input/source/c_input.h"
+#include  "../../c_output/source/c_output.h"
 #include  <string.h>
 #include  <time.h>
 extern    char *strptime(const char *s, const char *format, struct tm *tm);
@@ -1737,14 +1738,29 @@ UBYTE     TopLineWifiIconMap[TOP_WIFI_ICONS] =
 };
 
 
-void      cUiUpdateTopline(void)
+// Debug decorations change on every call - never reuse the drawn top line
+#if defined(TRACK_UPDATE) || defined(DEBUG_VIRTUAL_BATT_TEMP) || defined(ENABLE_PERFORMANCE_TEST) || defined(ENABLE_LOAD_TEST) || defined(ENABLE_MEMORY_TEST) || defined(ENABLE_STATUS_TEST) || defined(DEBUG_BACK_BLOCKED)
+#define   TOPLINE_ALWAYS_REDRAW
+#endif
+
+
+/*! \brief    Update the top line
+ *
+ *  The top line is only redrawn when one of its inputs (the state fingerprint) has
+ *  changed or when something else has drawn over it. The battery level is quantized
+ *  to the icon shown.
+ *
+ *  \return  DATA8 1 if the top line has been redrawn
+ */
+DATA8     cUiUpdateTopline(void)
 {
   DATA16  X1,X2;
   DATA16  V;
   DATA8   BtStatus;
   DATA8   WifiStatus;
   DATA8   TmpStatus;
-  DATA8   Name[NAME_LENGTH + 1];
+  DATA8   Redraw = 0;
+  TOPLINE_STATE State;
 
 #ifdef TRACK_UPDATE
   static  DATA16 Counter = 0;
@@ -1759,6 +1775,64 @@ void      cUiUpdateTopline(void)
 #endif
 
   if (UiInstance.TopLineEnabled)
+  {
+    // Collect everything shown
+    memset(&State,0,sizeof(State));
+    State.Bt    =  cComGetBtStatus();
+    State.WiFi  =  cComGetWifiStatus();
+#ifndef Linux_X86
+    State.Usb   =  cComGetUsbStatus();
+#endif
+    State.Accu  =  UiInstance.Accu;
+    cComGetBrickName(NAME_LENGTH + 1,State.Name);
+
+    V   =  (DATA16)(UiInstance.Vbatt * 1000.0);
+    V  -=  UiInstance.BattIndicatorLow;
+    V   =  (V * (TOP_BATT_ICONS - 1)) / (UiInstance.BattIndicatorHigh - UiInstance.BattIndicatorLow);
+    if (V > (TOP_BATT_ICONS - 1))
+    {
+      V  =  (TOP_BATT_ICONS - 1);
+    }
+    if (V < 0)
+    {
+      V  =  0;
+    }
+    State.Batt  =  (DATA8)V;
+
+    if ((UiInstance.ToplineValid == 0) || (memcmp(&State,&UiInstance.Topline,sizeof(State)) != 0))
+    {
+      Redraw  =  1;
+    }
+    if (memcmp((*UiInstance.pLcd).Lcd,UiInstance.ToplineImage,LCD_TOPLINE_SIZE) != 0)
+    { // Top line has been drawn over
+      Redraw  =  1;
+    }
+#ifdef TOPLINE_ALWAYS_REDRAW
+    Redraw  =  1;
+#endif
+#ifdef ALLOW_DEBUG_PULSE
+    if (VMInstance.PulseShow)
+    {
+      Redraw  =  1;
+    }
+#endif
+
+#ifdef DEBUG_TRACE_TOPLINE
+    UiInstance.ToplineCalls++;
+    if (Redraw)
+    {
+      UiInstance.ToplineRedraws++;
+    }
+    if (UiInstance.ToplineCalls >= 100)
+    {
+      printf("Topline: %d redraws in %d calls\r\n",UiInstance.ToplineRedraws,UiInstance.ToplineCalls);
+      UiInstance.ToplineCalls    =  0;
+      UiInstance.ToplineRedraws  =  0;
+    }
+#endif
+  }
+
+  if ((UiInstance.TopLineEnabled) && (Redraw))
   {
     // Clear top line
     LCDClearTopline(UiInstance.pLcd);
@@ -1770,7 +1844,7 @@ void      cUiUpdateTopline(void)
 #endif
     // Show BT status
     TmpStatus   =  0;
-    BtStatus    =  cComGetBtStatus();
+    BtStatus    =  State.Bt;
     if (BtStatus > 0)
     {
       TmpStatus   =  1;
@@ -1788,7 +1862,7 @@ void      cUiUpdateTopline(void)
 
     // Show WIFI status
     TmpStatus   =  0;
-    WifiStatus  =  cComGetWifiStatus();
+    WifiStatus  =  State.WiFi;
     if (WifiStatus > 0)
     {
       TmpStatus   =  1;
@@ -1809,14 +1883,12 @@ void      cUiUpdateTopline(void)
 #endif
 
     // Show brick name
-    cComGetBrickName(NAME_LENGTH + 1,Name);
-
     X1  =  dLcdGetFontWidth(SMALL_FONT);
     X2  =  LCD_WIDTH / X1;
-    X2 -=  strlen((char*)Name);
+    X2 -=  strlen((char*)State.Name);
     X2 /=  2;
     X2 *=  X1;
-    dLcdDrawText((*UiInstance.pLcd).Lcd,FG_COLOR,X2,1,SMALL_FONT,Name);
+    dLcdDrawText((*UiInstance.pLcd).Lcd,FG_COLOR,X2,1,SMALL_FONT,State.Name);
 
 #ifdef ENABLE_PERFORMANCE_TEST
     X1  =  100;
@@ -1912,7 +1984,7 @@ void      cUiUpdateTopline(void)
 
 #ifndef Linux_X86
     // Show USB status
-    if (cComGetUsbStatus())
+    if (State.Usb)
     {
       dLcdDrawIcon((*UiInstance.pLcd).Lcd,FG_COLOR,(X2 - 1) * X1,1,SMALL_ICON,SICON_USB);
     }
@@ -1926,18 +1998,7 @@ void      cUiUpdateTopline(void)
 #endif
 
     // Show battery
-    V   =  (DATA16)(UiInstance.Vbatt * 1000.0);
-    V  -=  UiInstance.BattIndicatorLow;
-    V   =  (V * (TOP_BATT_ICONS - 1)) / (UiInstance.BattIndicatorHigh - UiInstance.BattIndicatorLow);
-    if (V > (TOP_BATT_ICONS - 1))
-    {
-      V  =  (TOP_BATT_ICONS - 1);
-    }
-    if (V < 0)
-    {
-      V  =  0;
-    }
-    dLcdDrawIcon((*UiInstance.pLcd).Lcd,FG_COLOR,X2 * X1,1,SMALL_ICON,TopLineBattIconMap[V]);
+    dLcdDrawIcon((*UiInstance.pLcd).Lcd,FG_COLOR,X2 * X1,1,SMALL_ICON,TopLineBattIconMap[State.Batt]);
 
 #ifdef DEBUG_RECHARGEABLE
     if (UiInstance.Accu == 0)
@@ -1949,7 +2010,14 @@ void      cUiUpdateTopline(void)
 
     // Show bottom line
     dLcdDrawLine((*UiInstance.pLcd).Lcd,FG_COLOR,0,TOPLINE_HEIGHT,LCD_WIDTH,TOPLINE_HEIGHT);
+
+    // Remember what is on the top line now
+    memcpy(&UiInstance.Topline,&State,sizeof(State));
+    memcpy(UiInstance.ToplineImage,(*UiInstance.pLcd).Lcd,LCD_TOPLINE_SIZE);
+    UiInstance.ToplineValid  =  1;
   }
+
+  return (Redraw);
 }
 
 
@@ -2173,6 +2241,7 @@ void      cUiCheckVoltage(void)
 { // 400mS
 
   cUiUpdatePower();
+  cOutputSetVbatt(UiInstance.Vbatt);
 
   if (UiInstance.Vbatt >= UiInstance.BattWarningHigh)
   {
@@ -2612,8 +2681,10 @@ void      cUiUpdate(UWORD Time)
 
         if (UiInstance.ScreenBusy == 0)
         {
-          cUiUpdateTopline();
-          dLcdUpdate(UiInstance.pLcd);
+          if (cUiUpdateTopline())
+          {
+            dLcdUpdate(UiInstance.pLcd);
+          }
         }
 #ifdef BUFPRINTSIZE
         if ((*UiInstance.pUi).Activated & BUTTON_BUFPRINT)
@@ -322,6 +322,18 @@ TXTBOX;
 #define   BUTTON_SET                    (BUTTON_ALIVE | BUTTON_CLICK)
 
 
+typedef   struct                        //!< Everything shown in the top line
+{
+  DATA8     Bt;
+  DATA8     WiFi;
+  DATA8     Usb;
+  DATA8     Batt;                       //!< Battery icon index
+  DATA8     Accu;
+  DATA8     Name[NAME_LENGTH + 1];
+}
+TOPLINE_STATE;
+
+
 typedef   struct
 {
   //*****************************************************************************
@@ -421,6 +433,14 @@ typedef   struct
   DATA8     BtOn;
   DATA8     WiFiOn;
 
+  TOPLINE_STATE Topline;                //!< State the top line was last drawn from
+  UBYTE     ToplineImage[LCD_TOPLINE_SIZE];
+  DATA8     ToplineValid;
+#ifdef DEBUG_TRACE_TOPLINE
+  DATA16    ToplineCalls;
+  DATA16    ToplineRedraws;
+#endif
+
   DATA16    BattIndicatorHigh;
   DATA16    BattIndicatorLow;
   DATAF     BattWarningHigh;
@@ -37,9 +37,14 @@
  *
  *  When it is detected - a signal is sent to the \ref InputLibraryDeviceSetup "Input Library Device Setup" and the state will freeze in a state that only looks for
  *  an open port condition (for more than STEADY_TIME).
+ *
+ *  Input devices are identified already when the pins have been steady for IDENTIFY_STEADY_TIME. The identification
+ *  is published as a \ref DcmEvents "connect event" and confirmed when the device has stayed connected (and for new
+ *  sensors kept the same connection 1 level) until CONNECT_STEADY_TIME - otherwise the port is reset.
  *  \verbatim
 */
 
+#define   IN_IDENTIFY_STEADY_TIME       50    //  [mS]  time needed before a provisional identification
 #define   IN_CONNECT_STEADY_TIME        350   //  [mS]  time needed to be sure that the connection is steady
 #define   IN_DISCONNECT_STEADY_TIME     100   //  [mS]  time needed to be sure that the disconnection is steady
 
@@ -343,6 +348,7 @@ EV3 DUMB OUTPUT DEVICE ID's:
 #include  <linux/slab.h>
 #include  <linux/mm.h>
 #include  <linux/hrtimer.h>
+#include  <linux/delay.h>
 
 #include  <linux/init.h>
 #include  <linux/uaccess.h>
@@ -1025,6 +1031,8 @@ UWORD     SpiUpdate(UWORD DataOut)
 
 
 
+
+
 // DEVICE1 ********************************************************************
 
 static    struct hrtimer Device1Timer;
@@ -1050,6 +1058,10 @@ typedef struct
   UBYTE   Event;
   UBYTE   Timer;
   UBYTE	  FSMEnabled;
+  UBYTE   PubType;
+  UBYTE   PubConn;
+  UBYTE   Confirm;
+  ULONG   Since;
 }
 INPORT;
 
@@ -1068,6 +1080,9 @@ typedef struct
   UBYTE   OldState;
   UBYTE   Event;
   UBYTE   Timer;
+  UBYTE   PubType;
+  UBYTE   PubConn;
+  ULONG   Since;
 }
 OUTPORT;
 
@@ -1122,236 +1137,196 @@ static    UBYTE NextTime1[SCHEMESIZE1]    = { 0x00,0x00,0x00,0x01,0x00,0x00,0x00
 
 static    ktime_t Time1[2];
 
+static    UBYTE   NxtPointer = 0;
+
 
 /*
 
           ONE OR MORE NXT COLOR SENSOR ATTACHED
 
                   |---------------------------------------------------------------------------------------------------|
-                     100uS
-                  |---------|
-
-                    ,---------,         ,---------,
-Clock               |         |         |         |
-                  --'         '---------'         '-------------------------------------------------------------------
+                     1mS
+                  |-----------------------------|
 
-INTR              |         |         |         |
+INTR              |         |         |         |         |         |
 
-Colour convert    ||         |         |         ||
+SPI R/W           ||||      ||||      ||          ||||      ||||      ||
 
-SPI R/W           ||||      ||||      ||||      |||
+Clock                                   ,-------------------------------,
+                  ----------------------'                               '----------------
 
-PIN 1               ||      | |
+LED               blank                 red                             green
 
-PIN 6                          |      | ||
+Colour sample                        b                               r
 
-Other                                           |
 
-MuxSetup          e012      r345      g67x      bee
-
-Converting        ee01      2r34      5g67      xbe
-
-Reading           --e0      12r3      45g6      7xb
-
-ClockHigh         0100      0000      0100      000
-
-ClockLow          0000      0100      0000      010
-
-NextTime          0001      0001      0002      001
-
-1 = 200uS
-2 = 400uS
+In full color mode the NXT color sensor lights the next color on every clock edge. The colour
+port is converted in the normal scheme 1 scan (port channel 6) and the result is stored as the color that
+has been lit for the whole period - then the clock is toggled to light the next one
+(blank -> red -> green -> blue -> blank). A full color set is ready every 4 periods on all colour
+ports and the scan is the same with and without NXT color sensors attached. In the other modes
+the lamp does not change and all colors get the sample.
 
 */
 
-#define   SCHEMESIZE2    15
-
-static    UBYTE MuxSetup2[SCHEMESIZE2]    = { 0x13,0x00,0x01,0x02,0x10,0x03,0x04,0x05,0x11,0x06,0x07,0x20,0x12,0x20,0x20 };
-
-static    UBYTE Reading2[SCHEMESIZE2]     = { 0x80,0x20,0x13,0x00,0x01,0x02,0x10,0x03,0x04,0x05,0x11,0x06,0x07,0x80,0x12 };
-
-static    UBYTE ClockHigh2[SCHEMESIZE2]   = { 0x00,0x01,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x02,0x00,0x00,0x00,0x00,0x00 };
-
-static    UBYTE ClockLow2[SCHEMESIZE2]    = { 0x00,0x00,0x00,0x00,0x00,0x01,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x01,0x00 };
-
-static    UBYTE NextTime2[SCHEMESIZE2]    = { 0x00,0x00,0x00,0x01,0x00,0x00,0x00,0x01,0x00,0x00,0x00,0x02,0x00,0x00,0x01 };
-
-static    ktime_t Time2[2];
-static    ktime_t NextTime;
-
 static    UBYTE InputPoint1 = 8;
 
-static    UBYTE Color = 0;
-static    UBYTE NxtPointer = 0;
 static    UBYTE NxtColorActive[INPUTS];
 static    UBYTE Nxtcolor[INPUTS];
 static    UBYTE NxtcolorCmd[INPUTS];
 static    UBYTE NxtcolorLatchedCmd[INPUTS];
-static    UBYTE InputPoint2 = 0;
+static    UBYTE NxtColorPhase[INPUTS];
+
+#ifdef DEBUG_TRACE_ADC
+static    ktime_t TraceStart;
+static    s64     TraceIrqTime;
+static    ULONG   TraceIrqs;
+static    ULONG   TracePortSamples;
+static    ULONG   TraceOtherSamples;
+#endif
 
 
+static UBYTE AdcScan(void)
+{ // One step of scheme 1 - returns time to next step
 
-static enum hrtimer_restart Device1TimerInterrupt1(struct hrtimer *pTimer)
-{
-  UBYTE   Port;
   UWORD   *pData;
   UWORD   Data;
   UWORD   Input;
 
-  // restart timer
-  hrtimer_forward_now(pTimer,NextTime);
-
-  if (NxtPointer == 0)
+  do
   {
-    if (++InputPoint2 >= INPUTS)
+    pData  =  &Data;
+    if (MuxSetup1[NxtPointer] & 0x20)
     {
-      InputPoint2  =  0;
+      Input  =  (UWORD)InputReadMap[InputPoint1];
+    }
+    else
+    {
+      Input  =   (UWORD)InputReadMap[MuxSetup1[NxtPointer] & 0x0F];
     }
-#ifndef DISABLE_PREEMPTED_VM
-    ((*pAnalog).PreemptMilliSeconds)++;
-#endif
-  }
-
-  if (!Color)
-  { // No NXT color sensor attached -> use scheme 1
 
-    do
+    if (Reading1[NxtPointer] & 0x20)
     {
-      pData  =  &Data;
-      if (MuxSetup1[NxtPointer] & 0x20)
+      pData  =  &pInputs[InputPoint1];
+      if (++InputPoint1 >= INPUTADC)
       {
-        Input  =  (UWORD)InputReadMap[InputPoint1];
+        InputPoint1  =  8;
       }
-      else
+#ifdef DEBUG_TRACE_ADC
+      TraceOtherSamples++;
+#endif
+    }
+    else
+    {
+      if (!(Reading1[NxtPointer] & 0xF0))
       {
-        Input  =   (UWORD)InputReadMap[MuxSetup1[NxtPointer] & 0x0F];
+        pData  =   &pInputs[Reading1[NxtPointer]];
       }
+    }
 
-      if (Reading1[NxtPointer] & 0x20)
-      {
-        pData  =  &pInputs[InputPoint1];
-        if (++InputPoint1 >= INPUTADC)
-        {
-          InputPoint1  =  8;
-        }
-      }
-      else
-      {
-        if (!(Reading1[NxtPointer] & 0xF0))
-        {
-          pData  =   &pInputs[Reading1[NxtPointer]];
-        }
-      }
+    *pData  =  (UWORD)SpiUpdate((0x1840 | ((Input & 0x000F) << 7)));
+    *pData &=  0x0FFF;
 
-      *pData  =  (UWORD)SpiUpdate((0x1840 | ((Input & 0x000F) << 7)));
-      *pData &=  0x0FFF;
+    NxtPointer++;
+  }
+  while ((NextTime1[NxtPointer - 1] == 0));
 
-      NxtPointer++;
-    }
-    while ((NextTime1[NxtPointer - 1] == 0));
+  return (NextTime1[NxtPointer - 1] - 1);
+}
 
-    NextTime  =  Time1[NextTime1[NxtPointer - 1] - 1];
 
-    if (NxtPointer >= SCHEMESIZE1)
-    {
-      NxtPointer  =  0;
-    }
-  }
-  else
-  { // One or more NXT color sensors attached -> use scheme 2
+#ifndef DISABLE_OLD_COLOR
+static void NxtColorSample(void)
+{
+  UBYTE   Port;
+  UBYTE   Tmp;
 
-    do
+  for (Port = 0;Port < INPUTS;Port++)
+  {
+    if (Nxtcolor[Port])
     {
+      if (NxtcolorLatchedCmd[Port] == 0x0D)
+      { // Full color: store the lit color and light the next one
 
-      pData  =  &Data;
-      if (MuxSetup2[NxtPointer] & 0x20)
-      {
-        Input  =  (UWORD)InputReadMap[InputPoint1];
-      }
-      else
-      {
-        if (MuxSetup2[NxtPointer] & 0x10)
-        {
-          Input  =  (UWORD)InputReadMap[InputPoint2 + INPUTS];
-        }
-        else
-        {
-          Input  =   (UWORD)InputReadMap[MuxSetup2[NxtPointer] & 0x0F];
-        }
-      }
+        (*pAnalog).NxtCol[Port].ADRaw[NxtColorPhase[Port]]  =  pInputs[Port + INPUTS];
 
-      if (Reading2[NxtPointer] & 0x20)
-      {
-        pData  =  &pInputs[InputPoint1];
-        if (++InputPoint1 >= INPUTADC)
+        switch (NxtColorPhase[Port])
         {
-          InputPoint1  =  8;
-        }
-      }
-      else
-      {
-        if (Reading2[NxtPointer] & 0x10)
-        {
-          pData  =  (UWORD*)&(*pAnalog).NxtCol[InputPoint2].ADRaw[(Reading2[NxtPointer] & 0x03)];
-        }
-        else
-        {
-          if (!(Reading2[NxtPointer] & 0xF0))
+          case BLANK :
           {
-            pData  =   &pInputs[Reading2[NxtPointer]];
+            PINHigh(Port,INPUT_PORT_PIN5);
+            NxtColorPhase[Port]  =  RED;
           }
-        }
-      }
+          break;
 
-      *pData  =  (UWORD)SpiUpdate((0x1840 | ((Input & 0x000F) << 7))) & 0xFFF;
-      if (NxtcolorLatchedCmd[InputPoint2] == 0x0D)
-      {
-        if (ClockHigh2[NxtPointer])
-        {
-          if (Nxtcolor[InputPoint2])
+          case RED :
           {
-            if (ClockHigh2[NxtPointer] == 0x01)
-            {
-              PINHigh(InputPoint2,INPUT_PORT_PIN5);
-            }
-            else
-            {
-              PINFloat(InputPoint2,INPUT_PORT_PIN5);
-            }
+            PINLow(Port,INPUT_PORT_PIN5);
+            NxtColorPhase[Port]  =  GREEN;
           }
-        }
-        if (ClockLow2[NxtPointer])
-        {
-          if (Nxtcolor[InputPoint2])
+          break;
+
+          case GREEN :
+          {
+            PINFloat(Port,INPUT_PORT_PIN5);
+            NxtColorPhase[Port]  =  BLUE;
+          }
+          break;
+
+          default :
           {
-            PINLow(InputPoint2,INPUT_PORT_PIN5);
+            PINLow(Port,INPUT_PORT_PIN5);
+            NxtColorPhase[Port]  =  BLANK;
           }
+          break;
+
         }
       }
+      else
+      { // Lamp is constant
 
-      NxtPointer++;
+        for (Tmp = 0;Tmp < COLORS;Tmp++)
+        {
+          (*pAnalog).NxtCol[Port].ADRaw[Tmp]  =  pInputs[Port + INPUTS];
+        }
+      }
     }
-    while ((NextTime2[NxtPointer - 1] == 0));
+  }
+}
+#endif
 
-    NextTime  =  Time2[NextTime2[NxtPointer - 1] - 1];
 
-    if (NxtPointer >= SCHEMESIZE2)
-    {
-      NxtPointer  =  0;
-    }
-  }
+static enum hrtimer_restart Device1TimerInterrupt1(struct hrtimer *pTimer)
+{
+  UBYTE   Port;
+#ifdef DEBUG_TRACE_ADC
+  ktime_t IrqStart;
+
+  IrqStart  =  ktime_get();
+#endif
 
   if (NxtPointer == 0)
   {
-    Color  =  0;
+#ifndef DISABLE_PREEMPTED_VM
+    ((*pAnalog).PreemptMilliSeconds)++;
+#endif
+  }
+
+  // restart timer when the next step is due
+  hrtimer_forward_now(pTimer,Time1[AdcScan()]);
+
+  if (NxtPointer >= SCHEMESIZE1)
+  { // Period done - all port channels converted
+
+    NxtPointer  =  0;
+#ifndef DISABLE_OLD_COLOR
+    NxtColorSample();
+#endif
+
     for (Port = 0;Port < INPUTS;Port++)
     {
 #ifndef DISABLE_FAST_DATALOG_BUFFER
-      if (NxtColorActive[Port])
-      {
-        Color  =  1;
-      }
-      else
+      if (!NxtColorActive[Port])
       { // Buffer for fast data logging
 
         (*pAnalog).Pin1[Port][(*pAnalog).LogIn[Port]]  =  (*pAnalog).InPin1[Port];
@@ -1371,19 +1346,30 @@ static enum hrtimer_restart Device1TimerInterrupt1(struct hrtimer *pTimer)
           }
         }
       }
-      Nxtcolor[Port]  =  NxtColorActive[Port];
-#else
-      if (NxtColorActive[Port])
-      {
-        Color  =  1;
-      }
-      Nxtcolor[Port]  =  NxtColorActive[Port];
 #endif
+      Nxtcolor[Port]            =  NxtColorActive[Port];
+      NxtcolorLatchedCmd[Port]  =  NxtcolorCmd[Port];
 
       (*pAnalog).Updated[Port]  =  1;
     }
-    NxtcolorLatchedCmd[InputPoint2]  =  NxtcolorCmd[InputPoint2];
+#ifdef DEBUG_TRACE_ADC
+    TracePortSamples++;
+#endif
+  }
+
+#ifdef DEBUG_TRACE_ADC
+  TraceIrqTime +=  ktime_to_ns(ktime_sub(ktime_get(),IrqStart));
+  TraceIrqs++;
+  if (ktime_to_ns(ktime_sub(IrqStart,TraceStart)) >= 1000000000LL)
+  {
+    printk("  %s %u irq/S %u uS/S port ch %u S/S other ch %u S/S\n",DEVICE1_NAME,(unsigned)TraceIrqs,(unsigned)(TraceIrqTime / 1000),(unsigned)TracePortSamples,(unsigned)(TraceOtherSamples / (INPUTADC - (INPUTS * 2))));
+    TraceStart         =  IrqStart;
+    TraceIrqTime       =  0;
+    TraceIrqs          =  0;
+    TracePortSamples   =  0;
+    TraceOtherSamples  =  0;
   }
+#endif
 
   return (HRTIMER_RESTART);
 }
@@ -1830,10 +1816,6 @@ static int Device1Init(void)
 
       Time1[0]  =  ktime_set(0,200000);
       Time1[1]  =  ktime_set(0,600000);
-      Time2[0]  =  ktime_set(0,200000);
-      Time2[1]  =  ktime_set(0,400000);
-
-      NextTime  =  Time1[0];
 
       Device1Time  =  ktime_set(0,DEVICE_UPDATE_TIME);
       hrtimer_init(&Device1Timer,CLOCK_MONOTONIC,HRTIMER_MODE_REL);
@@ -2190,6 +2172,13 @@ static void Device2Exit(void)
 #define   DCM_TOUCH_DELAY               20                        // [mS]
 #define   DCM_CONNECT_STABLE_DELAY      IN_CONNECT_STEADY_TIME    // [mS]
 #define   DCM_EVENT_STABLE_DELAY        IN_DISCONNECT_STEADY_TIME // [mS]
+#ifndef DISABLE_FAST_DCM
+#define   DCM_IDENTIFY_STABLE_DELAY     IN_IDENTIFY_STEADY_TIME   // [mS]
+#else
+#define   DCM_IDENTIFY_STABLE_DELAY     IN_CONNECT_STEADY_TIME    // [mS]
+#endif
+#define   DCM_CONFIRM_DELAY             (DCM_CONNECT_STABLE_DELAY - DCM_IDENTIFY_STABLE_DELAY)  // [mS]
+#define   DCM_CONFIRM_TICKS             (DCM_CONFIRM_DELAY / DCM_TIMER_RESOLUTION)
 
 #ifndef DISABLE_OLD_COLOR
 #define   DCM_NXT_COLOR_TIMEOUT         500                       // [mS]
@@ -2207,11 +2196,9 @@ static    UWORD Device3StateTimer;
 
 static    struct hrtimer NxtColorTimer;
 static    ktime_t        NxtColorTime;
-#define   NXTCOLOR_TIMER_RESOLUTION      200              // [uS]
-
-
-
-
+#define   NXTCOLOR_RESET_TIME       200               // [uS] Clock reset step time
+#define   NXTCOLOR_HALF_BIT         200               // [uS] Clock high and clock low time (one edge per interrupt)
+#define   NXTCOLOR_MAX_PERIOD       1000              // [uS] Max time between interrupts
 
 
 #define   NXTCOLOR_BYTES            (12 * 4 + 3 * 2)
@@ -2228,183 +2215,233 @@ static    UBYTE   NxtColorByteCnt[INPUTS];
 static    UBYTE   NxtColorBitCnt[INPUTS];
 static    UBYTE   NxtColorBuffer[INPUTS][NXTCOLOR_BYTES];
 
-static    UWORD   NxtColorInitTimer[INPUTS];
+static    ULONG   NxtColorWait[INPUTS];                   // [uS] until next step on port
+static    ULONG   NxtColorTimeUs;                         // [uS] since last interrupt
 static    UBYTE   NxtColorInitCnt[INPUTS];
 
 static    UBYTE   NxtColorInitInUse;
 
 
+static UBYTE NxtColorHalfBit(UBYTE Port)
+{ // One clock edge per call, LSB first - data valid while clock is high
+  // Clock stays low one extra period when the next byte is loaded
+  // Returns 1 when the last byte is clocked
 
-static enum hrtimer_restart NxtColorCommIntr(struct hrtimer *pTimer)
-{
-  UBYTE   Port;
-
-  hrtimer_forward_now(pTimer,NxtColorTime);
-
-  for (Port = 0;Port < NO_OF_INPUT_PORTS;Port++)
-  { // look at one port at a time
+  UBYTE   Done = 0;
 
-    if (NxtColorState[Port])
+  if (NxtColorBitCnt[Port])
+  {
+    if (!NxtColorClkHigh[Port])
     {
-      switch (NxtColorState[Port])
+      if (NxtColorTx[Port])
       {
-        case 1 :
+        if (NxtColorByte[Port] & 1)
         {
-          PINFloat(Port,INPUT_PORT_PIN5)
-          NxtColorState[Port]++;
+          PINHigh(Port,INPUT_PORT_PIN6);
         }
-        break;
-
-        case 2 :
+        else
         {
-          if (PINRead(Port,INPUT_PORT_PIN5))
-          {
-            if (NxtColorInitCnt[Port] == 0)
-            {
-              PINHigh(Port,INPUT_PORT_PIN5);
-              NxtColorState[Port]++;
-            }
-            else
-            {
-              NxtColorInitTimer[Port]  =  0;
-              NxtColorState[Port]     +=  2;
-            }
-          }
-          else
-          {
-            PINHigh(Port,INPUT_PORT_PIN5);
-            NxtColorState[Port]++;
-          }
+          PINLow(Port,INPUT_PORT_PIN6);
         }
-        break;
-
-        case 3 :
+        NxtColorByte[Port] >>= 1;
+      }
+      else
+      {
+        PINFloat(Port,INPUT_PORT_PIN6);
+      }
+      PINHigh(Port,INPUT_PORT_PIN5);
+      NxtColorClkHigh[Port]  =  1;
+    }
+    else
+    {
+      NxtColorBitCnt[Port]--;
+      if (!NxtColorTx[Port])
+      {
+        NxtColorByte[Port] >>= 1;
+        if (PINRead(Port,INPUT_PORT_PIN6))
         {
-          PINLow(Port,INPUT_PORT_PIN5);
-          if (++NxtColorInitCnt[Port] >= 2)
-          {
-            NxtColorState[Port]++;
-          }
-          else
-          {
-            NxtColorState[Port]  =  1;
-          }
+          NxtColorByte[Port] |=  0x80;
         }
-        break;
-
-        case 4 :
+        else
         {
-          PINLow(Port,INPUT_PORT_PIN5);
-          if (++NxtColorInitTimer[Port] >= ((DCM_NXT_COLOR_INIT_DELAY * 1000) / NXTCOLOR_TIMER_RESOLUTION))
-          {
-            NxtColorState[Port]++;
-          }
+          NxtColorByte[Port] &= ~0x80;
         }
-        break;
-
-        case 5 :
+        if (!NxtColorBitCnt[Port])
         {
-          NxtColorBuffer[Port][0]   =  NxtColorCmd[Port];
-          NxtColorByteCnt[Port]     =  1;
-          NxtColorBytePnt[Port]     =  0;
-          NxtColorTx[Port]          =  1;
-          NxtColorState[Port]++;
+          NxtColorBuffer[Port][NxtColorBytePnt[Port]]  =  NxtColorByte[Port];
+          NxtColorBytePnt[Port]++;
         }
-        break;
+      }
+      PINLow(Port,INPUT_PORT_PIN5);
+      NxtColorClkHigh[Port]  =  0;
 
-        case 6 :
-        {
-          if ((NxtColorBitCnt[Port] == 0)  && (NxtColorByteCnt[Port] == 0))
-          {
-            NxtColorByteCnt[Port]     =  NXTCOLOR_BYTES;
-            NxtColorBytePnt[Port]     =  0;
-            NxtColorTx[Port]          =  0;
-            NxtColorState[Port]++;
-          }
-        }
-        break;
+      if ((NxtColorBitCnt[Port] == 0) && (NxtColorByteCnt[Port] == 0))
+      {
+        Done  =  1;
+      }
+    }
+  }
+  else
+  {
+    if (NxtColorByteCnt[Port])
+    {
+      if (NxtColorTx[Port])
+      {
+        NxtColorByte[Port]  =  NxtColorBuffer[Port][NxtColorBytePnt[Port]];
+        NxtColorBytePnt[Port]++;
+      }
+      NxtColorBitCnt[Port]  =  8;
+      NxtColorByteCnt[Port]--;
+    }
+    else
+    {
+      Done  =  1;
+    }
+  }
 
-        case 7 :
-        {
-          if ((NxtColorBitCnt[Port] == 0)  && (NxtColorByteCnt[Port] == 0))
-          {
-            NxtColorState[Port]++;
-          }
-        }
-        break;
+  return (Done);
+}
 
-        default :
-        {
-          NxtColorState[Port]  =  0;
-        }
-        break;
 
-      }
+static ULONG NxtColorStep(UBYTE Port)
+{
+  ULONG   Wait = NXTCOLOR_RESET_TIME;
+
+  switch (NxtColorState[Port])
+  {
+    case 1 :
+    {
+      PINFloat(Port,INPUT_PORT_PIN5)
+      NxtColorState[Port]++;
+    }
+    break;
 
-      if (NxtColorBitCnt[Port])
+    case 2 :
+    {
+      if (PINRead(Port,INPUT_PORT_PIN5))
       {
-        if (!NxtColorClkHigh[Port])
+        if (NxtColorInitCnt[Port] == 0)
         {
-          if (NxtColorTx[Port])
-          {
-            if (NxtColorByte[Port] & 1)
-            {
-              PINHigh(Port,INPUT_PORT_PIN6);
-            }
-            else
-            {
-              PINLow(Port,INPUT_PORT_PIN6);
-            }
-            NxtColorByte[Port] >>= 1;
-          }
-          else
-          {
-            PINFloat(Port,INPUT_PORT_PIN6);
-          }
           PINHigh(Port,INPUT_PORT_PIN5);
-          NxtColorClkHigh[Port]  =  1;
+          NxtColorState[Port]++;
         }
         else
         {
-
-          NxtColorBitCnt[Port]--;
-          if (!NxtColorTx[Port])
-          {
-            NxtColorByte[Port] >>= 1;
-            if (PINRead(Port,INPUT_PORT_PIN6))
-            {
-              NxtColorByte[Port] |=  0x80;
-            }
-            else
-            {
-              NxtColorByte[Port] &= ~0x80;
-            }
-            if (!NxtColorBitCnt[Port])
-            {
-              NxtColorBuffer[Port][NxtColorBytePnt[Port]]  =  NxtColorByte[Port];
-              NxtColorBytePnt[Port]++;
-            }
-          }
-          PINLow(Port,INPUT_PORT_PIN5);
-          NxtColorClkHigh[Port]  =  0;
+          NxtColorState[Port]     +=  2;
         }
       }
       else
       {
-        if (NxtColorByteCnt[Port])
-        {
-          if (NxtColorTx[Port])
-          {
-            NxtColorByte[Port]  =  NxtColorBuffer[Port][NxtColorBytePnt[Port]];
-            NxtColorBytePnt[Port]++;
-          }
-          NxtColorBitCnt[Port]  =  8;
-          NxtColorByteCnt[Port]--;
-        }
+        PINHigh(Port,INPUT_PORT_PIN5);
+        NxtColorState[Port]++;
+      }
+    }
+    break;
+
+    case 3 :
+    {
+      PINLow(Port,INPUT_PORT_PIN5);
+      if (++NxtColorInitCnt[Port] >= 2)
+      {
+        NxtColorState[Port]++;
+      }
+      else
+      {
+        NxtColorState[Port]  =  1;
+      }
+    }
+    break;
+
+    case 4 :
+    { // Clock low for the init delay
+
+      PINLow(Port,INPUT_PORT_PIN5);
+      Wait  =  DCM_NXT_COLOR_INIT_DELAY * 1000;
+      NxtColorState[Port]++;
+    }
+    break;
+
+    case 5 :
+    { // Send command
+
+      NxtColorBuffer[Port][0]   =  NxtColorCmd[Port];
+      NxtColorByteCnt[Port]     =  1;
+      NxtColorBytePnt[Port]     =  0;
+      NxtColorBitCnt[Port]      =  0;
+      NxtColorClkHigh[Port]     =  0;
+      NxtColorTx[Port]          =  1;
+      NxtColorState[Port]++;
+    }
+    break;
+
+    case 6 :
+    { // Clock out command
+
+      Wait  =  NXTCOLOR_HALF_BIT;
+      if (NxtColorHalfBit(Port))
+      {
+        NxtColorByteCnt[Port]     =  NXTCOLOR_BYTES;
+        NxtColorBytePnt[Port]     =  0;
+        NxtColorTx[Port]          =  0;
+        NxtColorState[Port]++;
+      }
+    }
+    break;
+
+    case 7 :
+    { // Clock in calibration data
+
+      Wait  =  NXTCOLOR_HALF_BIT;
+      if (NxtColorHalfBit(Port))
+      {
+        NxtColorState[Port]  =  0;
+      }
+    }
+    break;
+
+    default :
+    {
+      NxtColorState[Port]  =  0;
+    }
+    break;
+
+  }
+
+  return (Wait);
+}
+
+
+static enum hrtimer_restart NxtColorCommIntr(struct hrtimer *pTimer)
+{ // Only pin changes - never waits, so all ports can be stepped in the same interrupt
+
+  UBYTE   Port;
+  ULONG   Next = NXTCOLOR_MAX_PERIOD;
+
+  for (Port = 0;Port < NO_OF_INPUT_PORTS;Port++)
+  { // look at one port at a time
+
+    if (NxtColorState[Port])
+    {
+      if (NxtColorWait[Port] > NxtColorTimeUs)
+      {
+        NxtColorWait[Port] -=  NxtColorTimeUs;
+      }
+      else
+      {
+        NxtColorWait[Port]  =  NxtColorStep(Port);
+      }
+      if ((NxtColorState[Port]) && (NxtColorWait[Port] < Next))
+      {
+        Next  =  NxtColorWait[Port];
       }
     }
   }
 
+  // restart timer when the first port is due
+  NxtColorTimeUs  =  Next;
+  NxtColorTime    =  ktime_set(0,Next * 1000);
+  hrtimer_forward_now(pTimer,NxtColorTime);
+
   return (HRTIMER_RESTART);
 }
 
@@ -2416,11 +2453,13 @@ void      NxtColorCommStart(UBYTE Port,UBYTE Cmd)
   NxtColorBytePnt[Port]   =  0;
   NxtColorByteCnt[Port]   =  0;
   NxtColorBitCnt[Port]    =  0;
+  NxtColorWait[Port]      =  0;
   NxtColorCmd[Port]       =  Cmd;
 
   if (NxtColorInitInUse == 0)
   {
-    NxtColorTime      =  ktime_set(0,NXTCOLOR_TIMER_RESOLUTION * 1000);
+    NxtColorTimeUs    =  NXTCOLOR_RESET_TIME;
+    NxtColorTime      =  ktime_set(0,NXTCOLOR_RESET_TIME * 1000);
     hrtimer_init(&NxtColorTimer,CLOCK_MONOTONIC,HRTIMER_MODE_REL);
     NxtColorTimer.function  =  NxtColorCommIntr;
     hrtimer_start(&NxtColorTimer,NxtColorTime,HRTIMER_MODE_REL);
@@ -2458,6 +2497,111 @@ void      NxtColorCommStop(UBYTE Port)
 #endif
 
 
+static void DcmPublish(UBYTE Port,UBYTE Event,UBYTE Type,UBYTE Conn,ULONG Time)
+{
+  DCMEVENT *pEvent;
+
+  pEvent              =  &(*pAnalog).DcmEvent[(*pAnalog).DcmEventIn & (DCM_EVENTS - 1)];
+  (*pEvent).Time      =  Time;
+  (*pEvent).Port      =  (DATA8)Port;
+  (*pEvent).Event     =  (DATA8)Event;
+  (*pEvent).Type      =  (DATA8)Type;
+  (*pEvent).Conn      =  (DATA8)Conn;
+  wmb();
+  (*pAnalog).DcmEventIn++;
+
+#ifdef DEBUG
+  printk("e   %d E=%d T=%d C=%d %lu mS\n",Port,Event,Type,Conn,(unsigned long)((*pAnalog).DcmTime - Time));
+#endif
+}
+
+
+static UBYTE DcmInputPin1Conn(UBYTE Port)
+{
+  UBYTE   Conn;
+
+  if ((*pAnalog).InPin1[Port] > VtoC(IN1_NEAR_PIN2))
+  {
+    Conn  =  CONN_ERROR;
+  }
+  else
+  {
+    if ((*pAnalog).InPin1[Port] < VtoC(IN1_NEAR_GND))
+    {
+      Conn  =  CONN_INPUT_UART;
+    }
+    else
+    {
+      Conn  =  CONN_INPUT_DUMB;
+    }
+  }
+
+  return (Conn);
+}
+
+
+static void DcmInputEvents(UBYTE Port)
+{
+  if ((InputPort[Port].PubType != (UBYTE)(*pAnalog).InDcm[Port]) || (InputPort[Port].PubConn != (UBYTE)(*pAnalog).InConn[Port]))
+  { // type or connection changed - publish
+
+    InputPort[Port].PubType   =  (*pAnalog).InDcm[Port];
+    InputPort[Port].PubConn   =  (*pAnalog).InConn[Port];
+    InputPort[Port].Confirm   =  0;
+
+    if (InputPort[Port].PubConn == CONN_NONE)
+    {
+      DcmPublish(Port,DCM_EVENT_DISCONNECT,TYPE_NONE,CONN_NONE,(*pAnalog).DcmTime);
+    }
+    else
+    {
+      DcmPublish(Port,DCM_EVENT_CONNECT,InputPort[Port].PubType,InputPort[Port].PubConn,InputPort[Port].Since);
+    }
+  }
+  else
+  {
+    if ((InputPort[Port].PubConn != CONN_NONE) && (InputPort[Port].Connected) && (InputPort[Port].Confirm <= DCM_CONFIRM_TICKS))
+    { // identified but not confirmed yet
+
+      if (InputPort[Port].Confirm++ == DCM_CONFIRM_TICKS)
+      {
+        if ((InputPort[Port].State == DCM_CONNECTED_WAITING_FOR_PIN1_TO_FLOAT) && (DcmInputPin1Conn(Port) != InputPort[Port].PubConn))
+        { // connection 1 has moved since identification - start over
+
+          InputPort[Port].Connected   =  0;
+          InputPort[Port].State       =  DCM_INIT;
+        }
+        else
+        {
+          DcmPublish(Port,DCM_EVENT_CONFIRM,InputPort[Port].PubType,InputPort[Port].PubConn,InputPort[Port].Since);
+        }
+      }
+    }
+  }
+}
+
+
+static void DcmOutputEvents(UBYTE Port)
+{
+  if ((OutputPort[Port].PubType != (UBYTE)(*pAnalog).OutDcm[Port]) || (OutputPort[Port].PubConn != (UBYTE)(*pAnalog).OutConn[Port]))
+  { // type or connection changed - publish (output devices are identified after full steady time)
+
+    OutputPort[Port].PubType  =  (*pAnalog).OutDcm[Port];
+    OutputPort[Port].PubConn  =  (*pAnalog).OutConn[Port];
+
+    if (OutputPort[Port].PubConn == CONN_NONE)
+    {
+      DcmPublish(INPUTS + Port,DCM_EVENT_DISCONNECT,TYPE_NONE,CONN_NONE,(*pAnalog).DcmTime);
+    }
+    else
+    {
+      DcmPublish(INPUTS + Port,DCM_EVENT_CONNECT,OutputPort[Port].PubType,OutputPort[Port].PubConn,OutputPort[Port].Since);
+      DcmPublish(INPUTS + Port,DCM_EVENT_CONFIRM,OutputPort[Port].PubType,OutputPort[Port].PubConn,OutputPort[Port].Since);
+    }
+  }
+}
+
+
 static enum hrtimer_restart Device3TimerInterrupt1(struct hrtimer *pTimer)
 {
   UBYTE   Port;
@@ -2470,7 +2614,7 @@ static enum hrtimer_restart Device3TimerInterrupt1(struct hrtimer *pTimer)
 
   hrtimer_forward_now(pTimer,Device3Time);
 
-
+  (*pAnalog).DcmTime +=  DCM_TIMER_RESOLUTION;
 
   switch (Device3State)
   {
@@ -2571,6 +2715,11 @@ static enum hrtimer_restart Device3TimerInterrupt1(struct hrtimer *pTimer)
               printk("\nPort%d\n", Port);
               printk("i ! %d Event = %02X Old = %02X\n",Port,Event,InputPort[Port].Event);
 #endif
+              if (InputPort[Port].Event == 0)
+              { // leaving open port condition
+
+                InputPort[Port].Since  =  (*pAnalog).DcmTime;
+              }
               InputPort[Port].Event    =  Event;
               InputPort[Port].Timer    =  0;
             }
@@ -2578,7 +2727,7 @@ static enum hrtimer_restart Device3TimerInterrupt1(struct hrtimer *pTimer)
             if (InputPort[Port].Event)
             { // some event
 
-              if (++(InputPort[Port].Timer) >= (DCM_CONNECT_STABLE_DELAY / DCM_TIMER_RESOLUTION))
+              if (++(InputPort[Port].Timer) >= (DCM_IDENTIFY_STABLE_DELAY / DCM_TIMER_RESOLUTION))
               {
                 // some event is stable
 
@@ -2771,6 +2920,7 @@ static enum hrtimer_restart Device3TimerInterrupt1(struct hrtimer *pTimer)
             if (NxtColorCommReady(Port))
             {
               NxtcolorCmd[Port]           =  InputPort[Port].Cmd;
+              NxtColorPhase[Port]         =  BLANK;
               InputPort[Port].Timer       =  0;
               InputPort[Port].State       =  DCM_CONNECTED_WAITING_FOR_PIN2_HIGH;
 
@@ -2820,23 +2970,14 @@ static enum hrtimer_restart Device3TimerInterrupt1(struct hrtimer *pTimer)
 
           case DCM_PIN1_LOADED :
           {
-            if ((*pAnalog).InPin1[Port] > VtoC(IN1_NEAR_PIN2))
+            (*pAnalog).InConn[Port]       =  DcmInputPin1Conn(Port);
+            if ((*pAnalog).InConn[Port] == CONN_ERROR)
             {
               (*pAnalog).InDcm[Port]      =  TYPE_ERROR;
-              (*pAnalog).InConn[Port]     =  CONN_ERROR;
             }
             else
             {
-              if ((*pAnalog).InPin1[Port] < VtoC(IN1_NEAR_GND))
-              {
-                (*pAnalog).InDcm[Port]    =  TYPE_UNKNOWN;
-                (*pAnalog).InConn[Port]   =  CONN_INPUT_UART;
-              }
-              else
-              {
-                (*pAnalog).InDcm[Port]    =  TYPE_UNKNOWN;
-                (*pAnalog).InConn[Port]   =  CONN_INPUT_DUMB;
-              }
+              (*pAnalog).InDcm[Port]      =  TYPE_UNKNOWN;
             }
 
             InputPort[Port].Connected   =  1;
@@ -2941,6 +3082,7 @@ static enum hrtimer_restart Device3TimerInterrupt1(struct hrtimer *pTimer)
           break;
 
         }
+        DcmInputEvents(Port);
 #ifdef DEBUG
         if (InputPort[Port].OldState != InputPort[Port].State)
         {
@@ -3009,6 +3151,11 @@ static enum hrtimer_restart Device3TimerInterrupt1(struct hrtimer *pTimer)
             if (OutputPort[Port].Event != Event)
             { // pins has changed - reset timer
 
+              if (OutputPort[Port].Event == 0)
+              { // leaving open port condition
+
+                OutputPort[Port].Since =  (*pAnalog).DcmTime;
+              }
               OutputPort[Port].Event   =  Event;
               OutputPort[Port].Timer   =  0;
             }
@@ -3237,6 +3384,7 @@ static enum hrtimer_restart Device3TimerInterrupt1(struct hrtimer *pTimer)
           break;
 
         }
+        DcmOutputEvents(Port);
 #ifdef DEBUG
         if (OutputPort[Port].OldState != OutputPort[Port].State)
         {
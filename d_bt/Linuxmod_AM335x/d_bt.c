@@ -61,6 +61,9 @@ static    void ModuleExit(void);
 #include  <linux/module.h>
 #include  <linux/miscdevice.h>
 #include  <asm/uaccess.h>
+#include  <linux/interrupt.h>
+#include  <linux/poll.h>
+#include  <linux/wait.h>
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("The LEGO Group");
@@ -79,6 +82,72 @@ module_exit(ModuleExit);
 
 
 
+// CTS ************************************************************************
+
+// The PIC clear-to-send line is only monitored if its GPIO is given as module
+// parameter "CtsPin" (sys/init passes it from settings/BtCtsPin, which is not shipped - without it c_i2c keeps
+// polling every millisecond). A rising edge is latched and wakes up pollers, so the
+// mode2 thread in c_i2c can sleep until the PIC is ready instead of polling
+
+static    int       CtsPin  =  -1;
+static    volatile  UBYTE   CtsEdge;
+static    DECLARE_WAIT_QUEUE_HEAD(CtsWait);
+
+
+static irqreturn_t CtsIntr(int irq, void *dev_id)
+{
+  CtsEdge  =  1;
+  wake_up_interruptible(&CtsWait);
+
+  return (IRQ_HANDLED);
+}
+
+
+static void CtsInit(void)
+{
+  int     Status;
+
+  if (CtsPin >= 0)
+  {
+    CtsEdge  =  0;
+    Status   =  gpio_request(CtsPin, "BT_CTS");
+    if (Status < 0)
+    {
+      printk("error %d requesting CTS GPIO %d\n", Status, CtsPin);
+      CtsPin  =  -1;
+    }
+    else
+    {
+      Status   =  gpio_direction_input(CtsPin);
+      if (Status >= 0)
+      {
+        Status   =  request_irq(gpio_to_irq(CtsPin), CtsIntr, 0, "BT_CTS", NULL);
+      }
+      if (Status < 0)
+      {
+        printk("error %d requesting CTS IRQ %d\n", Status, CtsPin);
+        gpio_free(CtsPin);
+        CtsPin  =  -1;
+      }
+      else
+      {
+        irq_set_irq_type(gpio_to_irq(CtsPin), IRQ_TYPE_EDGE_RISING);
+      }
+    }
+  }
+}
+
+
+static void CtsExit(void)
+{
+  if (CtsPin >= 0)
+  {
+    free_irq(gpio_to_irq(CtsPin), NULL);
+    gpio_free(CtsPin);
+  }
+}
+
+
 // DEVICE1 ********************************************************************
 
 
@@ -96,8 +165,38 @@ static ssize_t Device1Write(struct file *File,const char *Buffer,size_t Count,lo
 
 static ssize_t Device1Read(struct file *File,char *Buffer,size_t Count,loff_t *Offset)
 {
+  char    Buf[2];
+  int     Lng;
 
-  return(1);
+  Lng  =  1;
+  if ((CtsPin >= 0) && (Count >= sizeof(Buf)))
+  {
+    // Byte 0 = CTS level, byte 1 = rising edge since last read
+    Buf[1]   =  CtsEdge;
+    CtsEdge  =  0;
+    Buf[0]   =  gpio_get_value(CtsPin) ? 1 : 0;
+    Lng      =  sizeof(Buf);
+    if (copy_to_user(Buffer, Buf, Lng))
+    {
+      Lng  =  -EFAULT;
+    }
+  }
+
+  return (Lng);
+}
+
+
+static unsigned int Device1Poll(struct file *File, poll_table *Wait)
+{
+  unsigned int Mask = 0;
+
+  poll_wait(File, &CtsWait, Wait);
+  if (CtsEdge)
+  {
+    Mask  =  POLLIN | POLLRDNORM;
+  }
+
+  return (Mask);
 }
 
 
@@ -119,7 +218,8 @@ static    const struct file_operations Device1Entries =
 {
   .owner   =  THIS_MODULE,
   .read    =  Device1Read,
-  .write   =  Device1Write
+  .write   =  Device1Write,
+  .poll    =  Device1Poll
 };
 
 
@@ -212,6 +312,7 @@ static void Device2Exit(void)
 
 #ifndef PCASM
 module_param (HwId, charp, 0);
+module_param (CtsPin, int, 0);
 #endif
 
 static int ModuleInit(void)
@@ -237,6 +338,7 @@ static int ModuleInit(void)
 
       Device1Init();
       Device2Init();
+      CtsInit();
 
   return (0);
 }
@@ -249,6 +351,7 @@ static void ModuleExit(void)
   #endif
 
 
+  CtsExit();
   Device1Exit();
   Device2Exit();
 
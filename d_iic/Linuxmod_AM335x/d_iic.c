@@ -26,6 +26,48 @@
  * \verbatim
 */
 
+#define   IIC_TIMER_RESOLUTION          10                // [100uS]  Scheduler tick
+#define   IIC_BIT_TIME                  50                // [uS]     Half bit period on the bus (10 KHz clock like NXT)
+
+#define   IIC_POWERUP_DELAY             1000              // [100uS]  Time from connection to first transfer
+#define   IIC_RETRY_DELAY               500               // [100uS]  Time between identification attempts
+#define   IIC_ID_RETRIES                3                 //          Identification attempts before giving up
+
+#define   IIC_ID_ADDRESS                0x01              //          Device address used for identification
+#define   IIC_ID_MANUFACTURER           0x08              //          Register holding manufacturer string
+#define   IIC_ID_TYPE                   0x10              //          Register holding sensor type string
+
+#define   IIC_ONESHOT                   0                 //          Transaction for one-shot requests from byte codes
+#define   IIC_SETUPSTRING               1                 //          Transaction for setup string from type data
+#define   IIC_REPEATING                 2                 //          First repeating transaction (poll string from type data)
+#define   IIC_TRANSACTIONS              7                 //          Transactions per port
+
+/*
+
+    1.  DCM driver detects an NXT IIC device and c_input writes IIC_SET_CONN                        -> IIC_INIT
+
+    2.  Port pins are handed over to the bit engine and the device is given time to power up       -> IIC_POWERUP
+
+    3.  Manufacturer and sensor type strings are read from IIC_ID_ADDRESS                           -> IIC_MANUFACTURER, IIC_TYPE
+
+    4.  "Changed" is set - c_input reads the strings (IIC_READ_TYPE_INFO), finds type and mode
+        and writes setup and poll strings (IIC_SET)                                                 -> IIC_RUNNING
+
+    5.  Every scheduler tick the next due transaction on each port is started on the bus:
+
+          IIC_SETUPSTRING       setup string written once after IIC_SET
+          IIC_ONESHOT           INPUT_DEVICE SETUP/READY_IIC (IIC_SETUP) and INPUT_IIC_WRITE (IIC_WRITE_DATA)
+          IIC_REPEATING..       poll string at the type data repeat time and INPUT_DEVICE SETUP requests
+                                with REPEAT != 1 - taken round robin so multiplexed devices get a fair share
+
+        Repeating transactions each own a slice of "Raw" (poll string first) and every completed
+        transaction publishes a new sample with a time stamp. One-shot results from INPUT_IIC_WRITE
+        are published in "Input" / "Result" so INPUT_IIC_READ and INPUT_IIC_STATUS are memory reads.
+
+    6.  Device disconnected (IIC_SET_CONN)                                                         -> IIC_EXIT -> IIC_IDLE
+
+*/
+
 /*!
 \endverbatim
  *
@@ -77,6 +119,8 @@ static    void ModuleExit(void);
 #include  <linux/miscdevice.h>
 #include  <asm/uaccess.h>
 
+#include  <linux/slab.h>
+
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("The LEGO Group");
 MODULE_DESCRIPTION(MODULE_NAME);
@@ -88,6 +132,10 @@ module_exit(ModuleExit);
 
 
 
+
+
+
+
 int       Hw = 6;
 
 /*! \page IicModuleResources Gpios and Resources used for Module
@@ -97,11 +145,1432 @@ int       Hw = 6;
  *  \verbatim
  */
 
+static volatile ULONG *CM_PER;
+static volatile ULONG *CM;
+
+static volatile ULONG *GPIOBANK0;
+static volatile ULONG *GPIOBANK1;
+static volatile ULONG *GPIOBANK2;
+static volatile ULONG *GPIOBANK3;
+
+
+#define   NO_OF_INPUT_PORTS             INPUTS
+
+enum      IicPortPins
+{
+  IIC_PORT_BUFFER_CTRL,
+  IIC_PORT_CLOCK,
+  IIC_PORT_DATA,
+  IIC_PORT_PINS
+};
+
+
+INPIN     IicPortPin[NO_OF_INPUT_PORTS][IIC_PORT_PINS];
+
+
+INPIN     EP2_IicPortPin[][IIC_PORT_PINS] =
+{
+  { // Input port 1
+    { GP1_19 , NULL, 0 }, // Buffer disable
+    { GP1_28 , NULL, 0 }, // Pin 5  - DIGIA0          - Clock
+    { GP1_18 , NULL, 0 }, // Pin 6  - DIGIA1          - Data
+  },
+  { // Input port 2
+    { GP0_4  , NULL, 0 }, // Buffer disable
+    { GP1_16 , NULL, 0 }, // Pin 5  - DIGIB0          - Clock
+    { GP0_5  , NULL, 0 }, // Pin 6  - DIGIB1          - Data
+  },
+  { // Input port 3
+    { GP3_19 , NULL, 0 }, // Buffer disable
+    { GP0_12 , NULL, 0 }, // Pin 5  - DIGIC0          - Clock
+    { GP0_13 , NULL, 0 }, // Pin 6  - DIGIC1          - Data
+  },
+  { // Input port 4
+    { GP3_15 , NULL, 0 }, // Buffer disable
+    { GP3_21 , NULL, 0 }, // Pin 5  - DIGID0          - Clock
+    { GP1_17 , NULL, 0 }, // Pin 6  - DIGID1          - Data
+  },
+};
+
+
+INPIN     *pIicPortPin[] =
+{
+  [EP2]       =   (INPIN*)&EP2_IicPortPin[0],      //  EP2     platform
+};
+
+/*  \endverbatim
+ *  \n
+ */
+
+
+void GetPeriphealBasePtr(ULONG Address, ULONG Size, ULONG **Ptr)
+{
+  if (request_mem_region(Address, Size, MODULE_NAME) >= 0)
+  {
+    *Ptr = (ULONG *)ioremap(Address, Size);
+    if (*Ptr == NULL)
+      printk("%s memory remap ERROR!\n", DEVICE1_NAME);
+  }
+  else
+  {
+    printk("Region request ERROR!\n");
+  }
+}
+
+
+void SetGpio(int Pin)
+{
+  int Tmp = 0;
+
+  if (Pin >= 0)
+  {
+    while ((MuxRegMap[Tmp].Pin != Pin) && (MuxRegMap[Tmp].Pin != -1))
+    {
+      Tmp++;
+    }
+    if (MuxRegMap[Tmp].Pin == Pin)
+    {
+      CM[MuxRegMap[Tmp].Addr >> 2] = MuxRegMap[Tmp].Mode;
+    }
+  }
+}
+
+
+void InitGpio(void)
+{
+  int Port;
+  int Pin;
+
+  memcpy(IicPortPin,pIicPortPin[Hw],sizeof(EP2_IicPortPin));
+  if (memcmp((const void*)IicPortPin,(const void*)pIicPortPin[Hw],sizeof(EP2_IicPortPin)) != 0)
+  {
+    printk("%s IicPortPin tabel broken!\n",MODULE_NAME);
+  }
+
+  for (Port = 0;Port < NO_OF_INPUT_PORTS;Port++)
+  {
+    for (Pin = 0;Pin < IIC_PORT_PINS;Pin++)
+    {
+      if ((IicPortPin[Port][Pin].Pin >= 0) && (IicPortPin[Port][Pin].Pin < 128))
+      {
+        if (IicPortPin[Port][Pin].Pin < 32)
+        {
+          IicPortPin[Port][Pin].pGpio  =  GPIOBANK0;
+        }
+        else if (IicPortPin[Port][Pin].Pin < 64)
+        {
+          IicPortPin[Port][Pin].pGpio  =  GPIOBANK1;
+        }
+        else if (IicPortPin[Port][Pin].Pin < 96)
+        {
+          IicPortPin[Port][Pin].pGpio  =  GPIOBANK2;
+        }
+        else
+        {
+          IicPortPin[Port][Pin].pGpio  =  GPIOBANK3;
+        }
+        IicPortPin[Port][Pin].Mask     =  (1 << (IicPortPin[Port][Pin].Pin & 0x1F));
+        SetGpio(IicPortPin[Port][Pin].Pin);
+      }
+    }
+  }
+}
+
+
+#define   PIICFloat(port,pin)           {\
+                                          (IicPortPin[port][pin].pGpio)[GPIO_OE] |=  IicPortPin[port][pin].Mask;\
+                                        }
+
+
+#define   PIICRead(port,pin)            ((IicPortPin[port][pin].pGpio)[GPIO_DATAIN] & IicPortPin[port][pin].Mask)
+
+
+#define   PIICHigh(port,pin)            {\
+                                          (IicPortPin[port][pin].pGpio)[GPIO_SETDATAOUT]  =  IicPortPin[port][pin].Mask;\
+                                          (IicPortPin[port][pin].pGpio)[GPIO_OE]      &= ~IicPortPin[port][pin].Mask;\
+                                        }
+
+#define   PIICLow(port,pin)             {\
+                                          (IicPortPin[port][pin].pGpio)[GPIO_CLEARDATAOUT]  =  IicPortPin[port][pin].Mask;\
+                                          (IicPortPin[port][pin].pGpio)[GPIO_OE]      &= ~IicPortPin[port][pin].Mask;\
+                                        }
+
+
+#ifndef   DEBUG_D_IIC_TARGET
+
+// NXT devices never stretch the clock so it is driven both ways, data is open drain
+
+#define   SCLHigh(port)                 PIICHigh(port,IIC_PORT_CLOCK)
+#define   SCLLow(port)                  PIICLow(port,IIC_PORT_CLOCK)
+#define   SDAFloat(port)                PIICFloat(port,IIC_PORT_DATA)
+#define   SDALow(port)                  PIICLow(port,IIC_PORT_DATA)
+#define   SDARead(port)                 PIICRead(port,IIC_PORT_DATA)
+
+#else
+
+/*! \page IicTarget Software IIC Target
+ *
+ *  <hr size="1"/>
+ *
+ *  When DEBUG_D_IIC_TARGET is defined the clock and data pins are replaced by a model of an
+ *  NXT style IIC device on every port. The model follows the bus edge by edge, so the bit engine,
+ *  identification and the transaction scheduler run exactly as with a real sensor connected.\n
+ *
+ *  \verbatim
+
+    Address   0x01
+    0x00      "V1.0"          version
+    0x08      "LEGO"          manufacturer
+    0x10      "Sonar"         sensor type
+    0x42      counter         incremented every time it is read
+    others    read/write memory
+
+    \endverbatim
+ */
+
+#define   TARGET_ADDRESS                0x01
+#define   TARGET_COUNTER                0x42
+#define   TARGET_REGISTERS              256
+
+enum      TARGET_STATE
+{
+  TARGET_IDLE,
+  TARGET_RECEIVE,                                 // Clocking in a byte
+  TARGET_ACK,                                     // Driving acknowledge
+  TARGET_TRANSMIT,                                // Clocking out a byte
+  TARGET_MACK,                                    // Waiting for master acknowledge
+};
+
+typedef   struct
+{
+  UBYTE   Scl;                                    // Clock line
+  UBYTE   Sda;                                    // Data line from master (1 = released)
+  UBYTE   Out;                                    // Data line from target (1 = released)
+  UBYTE   State;
+  UBYTE   Bits;
+  UBYTE   Byte;
+  UBYTE   Count;                                  // Bytes received since start (0 = address)
+  UBYTE   Reading;
+  UBYTE   Acked;
+  UBYTE   Pointer;                                // Register pointer
+  UBYTE   Reg[TARGET_REGISTERS];
+}
+IICTARGET;
+
+static    IICTARGET IicTarget[NO_OF_INPUT_PORTS];
+
+
+static void IicTargetInit(UBYTE Port)
+{
+  IICTARGET *pTarget = &IicTarget[Port];
+
+  memset(pTarget,0,sizeof(IICTARGET));
+  (*pTarget).Scl  =  1;
+  (*pTarget).Sda  =  1;
+  (*pTarget).Out  =  1;
+  memcpy(&(*pTarget).Reg[0x00],"V1.0",4);
+  memcpy(&(*pTarget).Reg[IIC_ID_MANUFACTURER],"LEGO",4);
+  memcpy(&(*pTarget).Reg[IIC_ID_TYPE],"Sonar",5);
+}
+
+
+static void IicTargetLoad(IICTARGET *pTarget)
+{
+  (*pTarget).Byte     =  (*pTarget).Reg[(*pTarget).Pointer];
+  if ((*pTarget).Pointer == TARGET_COUNTER)
+  {
+    (*pTarget).Reg[TARGET_COUNTER]++;
+  }
+  (*pTarget).Pointer++;
+  (*pTarget).Bits     =  0;
+  (*pTarget).Out      =  ((*pTarget).Byte >> 7) & 1;
+  (*pTarget).State    =  TARGET_TRANSMIT;
+}
+
+
+static void IicTargetSda(UBYTE Port,UBYTE Level)
+{
+  IICTARGET *pTarget = &IicTarget[Port];
+
+  if (((*pTarget).Scl) && (Level != (*pTarget).Sda))
+  {
+    if (Level == 0)
+    { // Start condition
+
+      (*pTarget).State    =  TARGET_RECEIVE;
+      (*pTarget).Bits     =  0;
+      (*pTarget).Count    =  0;
+    }
+    else
+    { // Stop condition
+
+      (*pTarget).State    =  TARGET_IDLE;
+    }
+    (*pTarget).Out        =  1;
+  }
+  (*pTarget).Sda          =  Level;
+}
+
+
+static void IicTargetScl(UBYTE Port,UBYTE Level)
+{
+  IICTARGET *pTarget = &IicTarget[Port];
+
+  if (Level != (*pTarget).Scl)
+  {
+    (*pTarget).Scl  =  Level;
+
+    if (Level)
+    { // Rising edge - sample data line
+
+      if ((*pTarget).State == TARGET_RECEIVE)
+      {
+        (*pTarget).Byte   =  ((*pTarget).Byte << 1) | ((*pTarget).Sda & (*pTarget).Out);
+        (*pTarget).Bits++;
+      }
+      if ((*pTarget).State == TARGET_MACK)
+      {
+        (*pTarget).Acked  =  !(*pTarget).Sda;
+      }
+    }
+    else
+    { // Falling edge - drive data line
+
+      switch ((*pTarget).State)
+      {
+        case TARGET_RECEIVE :
+        {
+          if ((*pTarget).Bits >= 8)
+          {
+            (*pTarget).State    =  TARGET_ACK;
+            (*pTarget).Out      =  0;
+
+            if ((*pTarget).Count == 0)
+            { // Address
+
+              if (((*pTarget).Byte >> 1) == TARGET_ADDRESS)
+              {
+                (*pTarget).Reading  =  (*pTarget).Byte & 1;
+              }
+              else
+              {
+                (*pTarget).Out      =  1;
+                (*pTarget).State    =  TARGET_IDLE;
+              }
+            }
+            else
+            {
+              if ((*pTarget).Count == 1)
+              {
+                (*pTarget).Pointer  =  (*pTarget).Byte;
+              }
+              else
+              {
+                (*pTarget).Reg[(*pTarget).Pointer++]  =  (*pTarget).Byte;
+              }
+            }
+            (*pTarget).Count++;
+          }
+        }
+        break;
+
+        case TARGET_ACK :
+        {
+          if ((*pTarget).Reading)
+          {
+            IicTargetLoad(pTarget);
+          }
+          else
+          {
+            (*pTarget).Out      =  1;
+            (*pTarget).Bits     =  0;
+            (*pTarget).State    =  TARGET_RECEIVE;
+          }
+        }
+        break;
+
+        case TARGET_TRANSMIT :
+        {
+          if (++(*pTarget).Bits < 8)
+          {
+            (*pTarget).Out      =  ((*pTarget).Byte >> (7 - (*pTarget).Bits)) & 1;
+          }
+          else
+          {
+            (*pTarget).Out      =  1;
+            (*pTarget).State    =  TARGET_MACK;
+          }
+        }
+        break;
+
+        case TARGET_MACK :
+        {
+          if ((*pTarget).Acked)
+          {
+            IicTargetLoad(pTarget);
+          }
+          else
+          {
+            (*pTarget).State    =  TARGET_IDLE;
+          }
+        }
+        break;
+      }
+    }
+  }
+}
+
+
+#define   SCLHigh(port)                 IicTargetScl(port,1)
+#define   SCLLow(port)                  IicTargetScl(port,0)
+#define   SDAFloat(port)                IicTargetSda(port,1)
+#define   SDALow(port)                  IicTargetSda(port,0)
+#define   SDARead(port)                 (IicTarget[port].Sda & IicTarget[port].Out)
+
+#endif
+
+
+static void IicPortEnable(UBYTE Port)
+{
+#ifndef   DEBUG_D_IIC_TARGET
+  PIICHigh(Port,IIC_PORT_BUFFER_CTRL);
+#else
+  IicTargetInit(Port);
+#endif
+  SDAFloat(Port);
+  SCLHigh(Port);
+}
+
+
+static void IicPortDisable(UBYTE Port)
+{
+#ifndef   DEBUG_D_IIC_TARGET
+  PIICFloat(Port,IIC_PORT_CLOCK);
+  PIICFloat(Port,IIC_PORT_DATA);
+#endif
+}
+
+
+/*! \page IicBus IIC Bit Engine
+ *
+ *  <hr size="1"/>
+ *
+ *  The bit engine clocks one transfer per port on the pins. Each tick of the bit timer is half a
+ *  bit period, every byte is a frame of 9 bits with the acknowledge as the last bit. Reading is
+ *  done as the NXT did it: stop after the write part and start again with the read address.\n
+ *  The bit timer only runs while a transfer is in progress on one of the ports.
+ *
+ *  \verbatim
+
+    write part    START  ADDR+W  A  DATA  A ... DATA  A  STOP
+    read part     START  ADDR+R  A  DATA  A ... DATA  N  STOP
+
+    \endverbatim
+ */
+
+enum      IIC_BUS_STATE
+{
+  BUS_IDLE,
+  BUS_START,                                      // Data line falls while clock is high
+  BUS_BIT_LOW,                                    // Clock low - next bit on data line
+  BUS_BIT_HIGH,                                   // Clock high - sample data line
+  BUS_STOP_LOW,
+  BUS_STOP_HIGH,
+  BUS_STOP,                                       // Data line rises while clock is high
+  BUS_DONE,
+  BUS_ERROR,
+  BUS_STATES
+};
+
+
+typedef   struct
+{
+  UBYTE   State;
+  UBYTE   Bit;                                    // Bit number in frame
+  UWORD   Out;                                    // Frame to clock out (1 = release data line)
+  UWORD   In;                                     // Frame clocked in
+  UBYTE   Reading;                                // Read part in progress
+  UBYTE   Frame;                                  // Frame number in part (0 = address)
+  UBYTE   Fail;                                   // Acknowledge missing
+  UBYTE   Addr;
+  UBYTE   WrLng;
+  UBYTE   RdLng;
+  UBYTE   WrData[IIC_DATA_LENGTH];
+  UBYTE   RdData[IIC_DATA_LENGTH];
+}
+IICBUS;
+
+
+static    IICBUS IicBus[NO_OF_INPUT_PORTS];
+
+static    struct hrtimer IicBitTimer;
+static    ktime_t        IicBitTime;
+
+
+static void IicBusFrame(IICBUS *pBus)
+{
+  if ((*pBus).Frame == 0)
+  { // Address and direction - device acknowledges
+
+    (*pBus).Out    =  ((((*pBus).Addr << 1) | (*pBus).Reading) << 1) | 1;
+  }
+  else
+  {
+    if ((*pBus).Reading)
+    { // Release data line, acknowledge all but the last byte
+
+      (*pBus).Out  =  0x1FE;
+      if ((*pBus).Frame >= (*pBus).RdLng)
+      {
+        (*pBus).Out |=  0x001;
+      }
+    }
+    else
+    { // Data byte - device acknowledges
+
+      (*pBus).Out  =  ((UWORD)(*pBus).WrData[(*pBus).Frame - 1] << 1) | 1;
+    }
+  }
+  (*pBus).In       =  0;
+  (*pBus).Bit      =  0;
+}
+
+
+static void IicBusStart(UBYTE Port,UBYTE Addr,UBYTE *pWrData,UBYTE WrLng,UBYTE RdLng)
+{
+  IICBUS  *pBus = &IicBus[Port];
+
+  (*pBus).Addr      =  Addr & 0x7F;
+  (*pBus).WrLng     =  WrLng;
+  (*pBus).RdLng     =  RdLng;
+  memcpy((*pBus).WrData,pWrData,WrLng);
+  (*pBus).Reading   =  0;
+  if ((WrLng == 0) && (RdLng))
+  { // Nothing to write - read from current register
+
+    (*pBus).Reading =  1;
+  }
+  (*pBus).Fail      =  0;
+  (*pBus).State     =  BUS_START;
+
+  if (!hrtimer_active(&IicBitTimer))
+  {
+    hrtimer_start(&IicBitTimer,IicBitTime,HRTIMER_MODE_REL);
+  }
+}
+
+
+static enum hrtimer_restart IicBitTimerInterrupt(struct hrtimer *pTimer)
+{
+  IICBUS  *pBus;
+  UBYTE   Port;
+  UBYTE   Last;
+  UBYTE   Active = 0;
+
+  for (Port = 0;Port < NO_OF_INPUT_PORTS;Port++)
+  {
+    pBus  =  &IicBus[Port];
+
+    switch ((*pBus).State)
+    {
+      case BUS_START :
+      {
+        SDALow(Port);
+        (*pBus).Frame    =  0;
+        IicBusFrame(pBus);
+        (*pBus).State    =  BUS_BIT_LOW;
+      }
+      break;
+
+      case BUS_BIT_LOW :
+      {
+        SCLLow(Port);
+        if ((*pBus).Out & (0x100 >> (*pBus).Bit))
+        {
+          SDAFloat(Port);
+        }
+        else
+        {
+          SDALow(Port);
+        }
+        (*pBus).State    =  BUS_BIT_HIGH;
+      }
+      break;
+
+      case BUS_BIT_HIGH :
+      {
+        SCLHigh(Port);
+        (*pBus).In     <<=  1;
+        if (SDARead(Port))
+        {
+          (*pBus).In    |=  1;
+        }
+
+        if (++(*pBus).Bit < 9)
+        {
+          (*pBus).State  =  BUS_BIT_LOW;
+        }
+        else
+        { // Frame done
+
+          if (((*pBus).Reading) && ((*pBus).Frame))
+          {
+            (*pBus).RdData[(*pBus).Frame - 1]  =  (UBYTE)((*pBus).In >> 1);
+          }
+          else
+          {
+            if ((*pBus).In & 1)
+            { // Not acknowledged
+
+              (*pBus).Fail  =  1;
+            }
+          }
+
+          Last  =  (*pBus).WrLng;
+          if ((*pBus).Reading)
+          {
+            Last  =  (*pBus).RdLng;
+          }
+          if (((*pBus).Fail) || ((*pBus).Frame >= Last))
+          {
+            (*pBus).State  =  BUS_STOP_LOW;
+          }
+          else
+          {
+            (*pBus).Frame++;
+            IicBusFrame(pBus);
+            (*pBus).State  =  BUS_BIT_LOW;
+          }
+        }
+      }
+      break;
+
+      case BUS_STOP_LOW :
+      {
+        SCLLow(Port);
+        SDALow(Port);
+        (*pBus).State    =  BUS_STOP_HIGH;
+      }
+      break;
+
+      case BUS_STOP_HIGH :
+      {
+        SCLHigh(Port);
+        (*pBus).State    =  BUS_STOP;
+      }
+      break;
+
+      case BUS_STOP :
+      {
+        SDAFloat(Port);
+
+        if ((*pBus).Fail)
+        {
+          (*pBus).State      =  BUS_ERROR;
+        }
+        else
+        {
+          if ((!(*pBus).Reading) && ((*pBus).RdLng))
+          { // Write part done - start read part
+
+            (*pBus).Reading  =  1;
+            (*pBus).State    =  BUS_START;
+          }
+          else
+          {
+            (*pBus).State    =  BUS_DONE;
+          }
+        }
+      }
+      break;
+
+    }
+
+    if (((*pBus).State >= BUS_START) && ((*pBus).State <= BUS_STOP))
+    {
+      Active++;
+    }
+  }
+
+  if (!Active)
+  {
+    return (HRTIMER_NORESTART);
+  }
+  hrtimer_forward_now(pTimer,IicBitTime);
+
+  return (HRTIMER_RESTART);
+}
+
+
+/*! \page IicModuleMemory Shared Memory
+ *
+ *  <hr size="1"/>
+ *
+ *  It is possible to get a pointer to the iic values for use in userspace
+ *  this pointer will point to the IIC struct in lms2012.h.\n
+ *
+ *  Raw holds the latest read data of all repeating transactions on the port (poll string first),
+ *  Time the driver time stamp [mS] of it. Result, Input and InputLength hold the outcome of the
+ *  latest INPUT_IIC_WRITE.\n
+ */
+
+
+enum      IIC_STATE
+{
+  IIC_IDLE,
+  IIC_INIT,                                       // Device connected - hand pins to bit engine
+  IIC_POWERUP,                                    // Waiting for device to power up
+  IIC_MANUFACTURER,                               // Reading manufacturer string
+  IIC_TYPE,                                       // Reading sensor type string
+  IIC_RUNNING,                                    // Scheduling transactions
+  IIC_EXIT,
+  IIC_STATES
+};
+
+
+enum      IIC_TRANS_STATE
+{
+  TRANS_FREE,
+  TRANS_WAITING,                                  // Queued - started when due
+  TRANS_ACTIVE,                                   // On the bus
+  TRANS_DONE,                                     // Result waiting for IIC_SETUP
+};
+
+
+enum      IIC_TRANS_KIND
+{
+  KIND_SETUP,                                     // Setup string from type data
+  KIND_POLL,                                      // Repeating - published in Raw
+  KIND_DEVICE,                                    // One-shot from IIC_SETUP - fetched by IIC_SETUP
+  KIND_WRITE,                                     // One-shot from IIC_WRITE_DATA - published in Input
+};
+
+
+typedef   struct
+{
+  UBYTE   State;
+  UBYTE   Kind;
+  UBYTE   Repeat;                                 // Runs left (0 = infinite)
+  UWORD   Time;                                   // [mS] Repeat time
+  UWORD   Timer;                                  // [mS] Time until due
+  UBYTE   Offset;                                 // Offset of read data in Raw
+  RESULT  Result;
+  DATA8   WrLng;                                  // Including device address
+  DATA8   RdLng;                                  // Negative -> byte order reversed
+  DATA8   WrData[IIC_DATA_LENGTH];
+  DATA8   RdData[IIC_DATA_LENGTH];
+}
+IICTRANS;
+
+
+typedef   struct
+{
+  UBYTE   State;
+  UWORD   Timer;                                  // [IIC_TIMER_RESOLUTION]
+  UBYTE   Retries;
+  UBYTE   NewString;                              // IIC_SET received
+  UBYTE   Current;                                // Transaction on the bus
+  UBYTE   Next;                                   // Next repeating transaction to look at
+  UBYTE   Used;                                   // Bytes of Raw owned by repeating transactions
+  DATA8   Image[IIC_DATA_LENGTH];                 // Latest read data of repeating transactions
+  DATA8   Manufacturer[IIC_NAME_LENGTH + 1];
+  DATA8   SensorType[IIC_NAME_LENGTH + 1];
+  IICTRANS Trans[IIC_TRANSACTIONS];
+}
+IICPORT;
+
+
+static    IICPORT IicPort[NO_OF_INPUT_PORTS];
+static    IICSTR  IicStrings[NO_OF_INPUT_PORTS];
+static    UBYTE   IicConfigured[NO_OF_INPUT_PORTS];
+static    ULONG   IicTime;
+
+static    IIC IicDefault;
+static    IIC *pIic = &IicDefault;
+
+static    DEFINE_SPINLOCK(IicLock);                         // Port state shared by ioctl and port timer
+
+static    struct hrtimer Device1Timer;
+static    ktime_t        Device1Time;
+
+
+static UBYTE IicLength(DATA8 Lng)
+{
+  if (Lng < 0)
+  {
+    Lng  =  0 - Lng;
+  }
+
+  return ((UBYTE)Lng);
+}
+
+
+static UWORD IicRepeatTime(DATA16 Time)
+{
+  if (Time < MIN_IIC_REPEAT_TIME)
+  {
+    Time  =  MIN_IIC_REPEAT_TIME;
+  }
+  if (Time > MAX_IIC_REPEAT_TIME)
+  {
+    Time  =  MAX_IIC_REPEAT_TIME;
+  }
+
+  return ((UWORD)Time);
+}
+
+
+static UBYTE IicSame(IICTRANS *pTrans,IICDAT *pIicDat)
+{
+  UBYTE   Result = 0;
+
+  if (((*pTrans).WrLng == (*pIicDat).WrLng) && ((*pTrans).RdLng == (*pIicDat).RdLng))
+  {
+    if (memcmp((*pTrans).WrData,(*pIicDat).WrData,(*pTrans).WrLng) == 0)
+    {
+      Result  =  1;
+    }
+  }
+
+  return (Result);
+}
+
+
+static void IicTransClear(UBYTE Port,UBYTE First)
+{ // Drop transactions from First and up
+
+  UBYTE   Slot;
+
+  for (Slot = First;Slot < IIC_TRANSACTIONS;Slot++)
+  {
+    IicPort[Port].Trans[Slot].State  =  TRANS_FREE;
+  }
+  IicPort[Port].Used    =  0;
+  IicPort[Port].Next    =  IIC_REPEATING;
+  memset(IicPort[Port].Image,0,IIC_DATA_LENGTH);
+}
+
+
+static SBYTE IicTransAdd(UBYTE Port,UBYTE Kind,UBYTE Repeat,DATA16 Time,DATA8 WrLng,DATA8 *pWrData,DATA8 RdLng)
+{ // Queue a repeating transaction - returns slot or -1 if no room
+
+  IICTRANS *pTrans;
+  SBYTE   Result = -1;
+  UBYTE   Slot;
+
+  if ((IicPort[Port].Used + IicLength(RdLng)) <= IIC_DATA_LENGTH)
+  {
+    Slot  =  IIC_REPEATING;
+    while ((Slot < IIC_TRANSACTIONS) && (IicPort[Port].Trans[Slot].State != TRANS_FREE))
+    {
+      Slot++;
+    }
+    if (Slot < IIC_TRANSACTIONS)
+    {
+      pTrans               =  &IicPort[Port].Trans[Slot];
+      (*pTrans).Kind       =  Kind;
+      (*pTrans).Repeat     =  Repeat;
+      (*pTrans).Time       =  IicRepeatTime(Time);
+      (*pTrans).Timer      =  0;
+      (*pTrans).Offset     =  IicPort[Port].Used;
+      (*pTrans).WrLng      =  WrLng;
+      (*pTrans).RdLng      =  RdLng;
+      memcpy((*pTrans).WrData,pWrData,WrLng);
+      IicPort[Port].Used  +=  IicLength(RdLng);
+      (*pTrans).State      =  TRANS_WAITING;
+      Result               =  (SBYTE)Slot;
+    }
+  }
+
+  return (Result);
+}
+
+
+static void IicTransLoad(IICTRANS *pTrans,UBYTE Kind,IICDAT *pIicDat)
+{ // Fill in one-shot transaction from byte code request
+
+  (*pTrans).Kind     =  Kind;
+  (*pTrans).Repeat   =  (*pIicDat).Repeat;
+  (*pTrans).Time     =  IicRepeatTime((*pIicDat).Time);
+  (*pTrans).Timer    =  0;
+  (*pTrans).WrLng    =  (*pIicDat).WrLng;
+  (*pTrans).RdLng    =  (*pIicDat).RdLng;
+  memcpy((*pTrans).WrData,(*pIicDat).WrData,(*pIicDat).WrLng);
+  (*pTrans).Result   =  BUSY;                             // Until the transfer is done
+  (*pTrans).State    =  TRANS_WAITING;
+}
+
+
+static void IicStringLoad(ULONG String,DATA8 Lng,DATA8 *pData)
+{ // Strings from type data are left aligned, first byte is device address
+
+  DATA8   Tmp;
+
+  for (Tmp = 0;(Tmp < Lng) && (Tmp < 4);Tmp++)
+  {
+    pData[Tmp]  =  (DATA8)(String >> (24 - (Tmp * 8)));
+  }
+}
+
+
+static void IicPublish(UBYTE Port)
+{
+#ifndef DISABLE_FAST_DATALOG_BUFFER
+  memcpy((void*)(*pIic).Raw[Port][(*pIic).LogIn[Port]],(void*)IicPort[Port].Image,IIC_DATA_LENGTH);
+
+  (*pIic).Actual[Port]  =  (*pIic).LogIn[Port];
+  (*pIic).Repeat[Port][(*pIic).Actual[Port]]  =  0;
+
+  if (++((*pIic).LogIn[Port]) >= DEVICE_LOGBUF_SIZE)
+  {
+    (*pIic).LogIn[Port]      =  0;
+  }
+#else
+  memcpy((void*)(*pIic).Raw[Port],(void*)IicPort[Port].Image,IIC_DATA_LENGTH);
+#endif
+  (*pIic).Time[Port]     =  IicTime;
+  (*pIic).Status[Port]  |=  IIC_DATA_READY;
+}
+
+
+static void IicTransStart(UBYTE Port,UBYTE Slot)
+{
+  IICTRANS *pTrans = &IicPort[Port].Trans[Slot];
+
+  IicPort[Port].Current  =  Slot;
+  (*pTrans).Timer        =  (*pTrans).Time;
+  (*pTrans).State        =  TRANS_ACTIVE;
+  IicBusStart(Port,(UBYTE)(*pTrans).WrData[0],(UBYTE*)&(*pTrans).WrData[1],(UBYTE)((*pTrans).WrLng - 1),IicLength((*pTrans).RdLng));
+}
+
+
+static void IicTransDone(UBYTE Port)
+{
+  IICPORT  *pPort  = &IicPort[Port];
+  IICTRANS *pTrans = &(*pPort).Trans[(*pPort).Current];
+  UBYTE    Lng;
+  UBYTE    Tmp;
+  SBYTE    Slot;
+
+  Lng  =  IicLength((*pTrans).RdLng);
+
+  (*pTrans).Result  =  FAIL;
+  if (IicBus[Port].State == BUS_DONE)
+  {
+    for (Tmp = 0;Tmp < Lng;Tmp++)
+    {
+      if ((*pTrans).RdLng < 0)
+      {
+        (*pTrans).RdData[Tmp]  =  (DATA8)IicBus[Port].RdData[Lng - 1 - Tmp];
+      }
+      else
+      {
+        (*pTrans).RdData[Tmp]  =  (DATA8)IicBus[Port].RdData[Tmp];
+      }
+    }
+    (*pTrans).Result  =  OK;
+  }
+  IicBus[Port].State  =  BUS_IDLE;
+
+  if ((*pTrans).State == TRANS_ACTIVE)
+  { // Not dropped while on the bus
+
+    switch ((*pTrans).Kind)
+    {
+      case KIND_SETUP :
+      {
+        (*pTrans).State  =  TRANS_FREE;
+      }
+      break;
+
+      case KIND_POLL :
+      {
+        if ((*pTrans).Result == OK)
+        {
+          memcpy(&(*pPort).Image[(*pTrans).Offset],(*pTrans).RdData,Lng);
+          IicPublish(Port);
+        }
+        (*pTrans).State  =  TRANS_WAITING;
+        if ((*pTrans).Repeat)
+        {
+          if (--(*pTrans).Repeat == 0)
+          {
+            (*pTrans).State  =  TRANS_FREE;
+          }
+        }
+      }
+      break;
+
+      case KIND_DEVICE :
+      {
+        if (((*pTrans).Repeat != 1) && ((*pTrans).Result == OK))
+        { // Keep on polling in the background
+
+          Slot  =  IicTransAdd(Port,KIND_POLL,(*pTrans).Repeat ? (*pTrans).Repeat - 1 : 0,(*pTrans).Time,(*pTrans).WrLng,(*pTrans).WrData,(*pTrans).RdLng);
+          if (Slot >= 0)
+          {
+            (*pPort).Trans[Slot].Timer  =  (*pTrans).Time;
+            memcpy((*pPort).Trans[Slot].RdData,(*pTrans).RdData,Lng);
+            memcpy(&(*pPort).Image[(*pPort).Trans[Slot].Offset],(*pTrans).RdData,Lng);
+            IicPublish(Port);
+          }
+        }
+        (*pTrans).State  =  TRANS_DONE;
+      }
+      break;
+
+      case KIND_WRITE :
+      {
+        if ((*pTrans).Result == OK)
+        {
+          memcpy((*pIic).Input[Port],(*pTrans).RdData,Lng);
+          (*pIic).InputLength[Port]  =  Lng;
+        }
+        (*pIic).Result[Port]         =  (*pTrans).Result;
+        (*pTrans).State              =  TRANS_FREE;
+      }
+      break;
+
+    }
+  }
+}
+
+
+static void IicSchedule(UBYTE Port)
+{ // Start next due transaction - setup string, one-shot and repeating round robin
+
+  IICPORT  *pPort = &IicPort[Port];
+  UBYTE    Slot;
+  UBYTE    Tmp;
+
+  if ((*pPort).Trans[IIC_SETUPSTRING].State == TRANS_WAITING)
+  {
+    IicTransStart(Port,IIC_SETUPSTRING);
+  }
+  else
+  {
+    if ((*pPort).Trans[IIC_ONESHOT].State == TRANS_WAITING)
+    {
+      IicTransStart(Port,IIC_ONESHOT);
+    }
+    else
+    {
+      Slot  =  (*pPort).Next;
+      for (Tmp = IIC_REPEATING;Tmp < IIC_TRANSACTIONS;Tmp++)
+      {
+        if (Slot >= IIC_TRANSACTIONS)
+        {
+          Slot  =  IIC_REPEATING;
+        }
+        if (((*pPort).Trans[Slot].State == TRANS_WAITING) && ((*pPort).Trans[Slot].Timer == 0))
+        {
+          (*pPort).Next  =  Slot + 1;
+          IicTransStart(Port,Slot);
+          break;
+        }
+        Slot++;
+      }
+    }
+  }
+}
+
+
+static void IicIdStart(UBYTE Port,UBYTE Register)
+{
+  IicBusStart(Port,IIC_ID_ADDRESS,&Register,1,IIC_NAME_LENGTH);
+}
+
+
+static enum hrtimer_restart Device1TimerInterrupt1(struct hrtimer *pTimer)
+{
+  IICPORT *pPort;
+  UBYTE   Port;
+  UBYTE   Slot;
+  DATA8   Buffer[IIC_DATA_LENGTH];
+  unsigned long Flags;
+
+  hrtimer_forward_now(pTimer,Device1Time);
+
+  spin_lock_irqsave(&IicLock,Flags);
+
+  IicTime  +=  IIC_TIMER_RESOLUTION / 10;
+
+  for (Port = 0;Port < NO_OF_INPUT_PORTS;Port++)
+  { // look at one port at a time
+
+    pPort  =  &IicPort[Port];
+
+    switch ((*pPort).State)
+    {
+      case IIC_IDLE :
+      {
+      }
+      break;
+
+      case IIC_INIT :
+      { // Device connected
+
+        IicBus[Port].State          =  BUS_IDLE;
+        IicTransClear(Port,IIC_ONESHOT);
+        memset((*pPort).Manufacturer,0,IIC_NAME_LENGTH + 1);
+        memset((*pPort).SensorType,0,IIC_NAME_LENGTH + 1);
+        (*pIic).Status[Port]        =  0;
+        (*pIic).Time[Port]          =  0;
+        (*pIic).Result[Port]        =  FAIL;                // Nothing transferred yet
+        (*pPort).NewString          =  0;
+        (*pPort).Retries            =  IIC_ID_RETRIES;
+        (*pPort).Timer              =  0;
+        IicPortEnable(Port);
+        (*pPort).State              =  IIC_POWERUP;
+      }
+      break;
+
+      case IIC_POWERUP :
+      {
+        if (++(*pPort).Timer >= (IIC_POWERUP_DELAY / IIC_TIMER_RESOLUTION))
+        {
+          IicIdStart(Port,IIC_ID_MANUFACTURER);
+          (*pPort).State            =  IIC_MANUFACTURER;
+        }
+      }
+      break;
+
+      case IIC_MANUFACTURER :
+      {
+        if (IicBus[Port].State == BUS_DONE)
+        {
+          memcpy((*pPort).Manufacturer,IicBus[Port].RdData,IIC_NAME_LENGTH);
+          IicIdStart(Port,IIC_ID_TYPE);
+          (*pPort).State            =  IIC_TYPE;
+        }
+        if (IicBus[Port].State == BUS_ERROR)
+        {
+          IicBus[Port].State        =  BUS_IDLE;
+          if (--(*pPort).Retries)
+          {
+            (*pPort).Timer          =  (IIC_POWERUP_DELAY - IIC_RETRY_DELAY) / IIC_TIMER_RESOLUTION;
+            (*pPort).State          =  IIC_POWERUP;
+          }
+          else
+          { // No identification - c_input will treat it as unknown IIC device
+
+            (*pIic).Changed[Port]   =  1;
+            (*pIic).Status[Port]   |=  IIC_DATA_READY;
+            (*pPort).State          =  IIC_RUNNING;
+          }
+        }
+      }
+      break;
+
+      case IIC_TYPE :
+      {
+        if ((IicBus[Port].State == BUS_DONE) || (IicBus[Port].State == BUS_ERROR))
+        {
+          if (IicBus[Port].State == BUS_DONE)
+          {
+            memcpy((*pPort).SensorType,IicBus[Port].RdData,IIC_NAME_LENGTH);
+          }
+          IicBus[Port].State        =  BUS_IDLE;
+
+#ifdef DEBUG_D_IIC
+          printk("d_iic  %d   Identified [%s] [%s]\n",Port,(*pPort).Manufacturer,(*pPort).SensorType);
+#endif
+          (*pIic).Changed[Port]     =  1;
+          (*pIic).Status[Port]     |=  IIC_DATA_READY;
+          (*pPort).State            =  IIC_RUNNING;
+        }
+      }
+      break;
+
+      case IIC_RUNNING :
+      {
+        if ((*pPort).NewString)
+        { // Type or mode changed - setup and poll strings from type data
+
+          (*pPort).NewString        =  0;
+          IicTransClear(Port,IIC_SETUPSTRING);
+
+          if (IicStrings[Port].SetupLng)
+          {
+            (*pPort).Trans[IIC_SETUPSTRING].Kind   =  KIND_SETUP;
+            (*pPort).Trans[IIC_SETUPSTRING].WrLng  =  IicStrings[Port].SetupLng;
+            (*pPort).Trans[IIC_SETUPSTRING].RdLng  =  0;
+            IicStringLoad(IicStrings[Port].SetupString,IicStrings[Port].SetupLng,(*pPort).Trans[IIC_SETUPSTRING].WrData);
+            (*pPort).Trans[IIC_SETUPSTRING].State  =  TRANS_WAITING;
+          }
+          if (IicStrings[Port].PollLng)
+          {
+            IicStringLoad(IicStrings[Port].PollString,IicStrings[Port].PollLng,Buffer);
+            IicTransAdd(Port,KIND_POLL,0,IicStrings[Port].Time,IicStrings[Port].PollLng,Buffer,IicStrings[Port].ReadLng);
+            (*pIic).Status[Port]   &= ~IIC_DATA_READY;
+          }
+          else
+          {
+            (*pIic).Status[Port]   |=  IIC_DATA_READY;
+          }
+        }
+
+        for (Slot = IIC_REPEATING;Slot < IIC_TRANSACTIONS;Slot++)
+        {
+          if ((*pPort).Trans[Slot].Timer >= (IIC_TIMER_RESOLUTION / 10))
+          {
+            (*pPort).Trans[Slot].Timer -=  (IIC_TIMER_RESOLUTION / 10);
+          }
+          else
+          {
+            (*pPort).Trans[Slot].Timer  =  0;
+          }
+        }
+
+        if ((IicBus[Port].State == BUS_DONE) || (IicBus[Port].State == BUS_ERROR))
+        {
+          IicTransDone(Port);
+        }
+        if (IicBus[Port].State == BUS_IDLE)
+        {
+          IicSchedule(Port);
+        }
+#ifndef DISABLE_FAST_DATALOG_BUFFER
+        ((*pIic).Repeat[Port][(*pIic).Actual[Port]])++;
+#endif
+      }
+      break;
+
+      case IIC_EXIT :
+      {
+        IicBus[Port].State          =  BUS_IDLE;
+        if ((*pPort).Trans[IIC_ONESHOT].State != TRANS_FREE)
+        {
+          (*pIic).Result[Port]      =  FAIL;
+        }
+        IicTransClear(Port,IIC_ONESHOT);
+        IicPortDisable(Port);
+        (*pIic).Status[Port]        =  0;
+        (*pIic).Changed[Port]       =  0;
+        (*pPort).State              =  IIC_IDLE;
+      }
+      break;
+
+    }
+  }
+
+  spin_unlock_irqrestore(&IicLock,Flags);
+
+  return (HRTIMER_RESTART);
+}
+
 
 static long Device1Ioctl(struct file *File, unsigned int Request, unsigned long Pointer)
 {
+  long      Result = 0;
+  DEVCON    DevCon;
+  IICSTR    IicStr;
+  IICDAT    IicDat;
+  IICTRANS  *pTrans;
+  DATA8     Port = 0;
+  UBYTE     Slot;
+  unsigned long Flags;
+
+  switch (Request)
+  {
 
-  return (0);
+    case IIC_SET_CONN :
+    {
+      copy_from_user((void*)&DevCon,(void*)Pointer,sizeof(DEVCON));
+
+      spin_lock_irqsave(&IicLock,Flags);
+      for (Port = 0;Port < INPUTS;Port++)
+      {
+        if (DevCon.Connection[Port] == CONN_NXT_IIC)
+        {
+          if (IicConfigured[Port] == 0)
+          {
+            IicConfigured[Port]     =  1;
+            IicPort[Port].State     =  IIC_INIT;
+          }
+        }
+        else
+        {
+          (*pIic).Status[Port]     &= ~IIC_DATA_READY;
+          if (IicConfigured[Port])
+          {
+            IicConfigured[Port]     =  0;
+            IicPort[Port].State     =  IIC_EXIT;
+          }
+        }
+      }
+      spin_unlock_irqrestore(&IicLock,Flags);
+    }
+    break;
+
+    case IIC_READ_TYPE_INFO :
+    {
+      copy_from_user((void*)&IicStr,(void*)Pointer,sizeof(IICSTR));
+      Port  =  IicStr.Port;
+
+      if ((Port >= 0) && (Port < INPUTS))
+      {
+        spin_lock_irqsave(&IicLock,Flags);
+        memcpy(IicStr.Manufacturer,IicPort[Port].Manufacturer,IIC_NAME_LENGTH + 1);
+        memcpy(IicStr.SensorType,IicPort[Port].SensorType,IIC_NAME_LENGTH + 1);
+        spin_unlock_irqrestore(&IicLock,Flags);
+        copy_to_user((void*)Pointer,(void*)&IicStr,sizeof(IICSTR));
+      }
+    }
+    break;
+
+    case IIC_SET :
+    {
+      copy_from_user((void*)&IicStr,(void*)Pointer,sizeof(IICSTR));
+      Port  =  IicStr.Port;
+
+      if ((Port >= 0) && (Port < INPUTS))
+      {
+#ifdef DEBUG_D_IIC
+        printk("d_iic  %d   IIC_SET T=%d M=%d S=%d 0x%08X P=%d 0x%08X R=%d Time=%d\n",Port,IicStr.Type,IicStr.Mode,IicStr.SetupLng,(unsigned int)IicStr.SetupString,IicStr.PollLng,(unsigned int)IicStr.PollString,IicStr.ReadLng,IicStr.Time);
+#endif
+        // Lengths come from type data - strings hold max 4 bytes (0 = no string)
+        if ((IicStr.SetupLng < 0) || (IicStr.SetupLng > 4))
+        {
+          IicStr.SetupLng         =  (IicStr.SetupLng < 0) ? 0 : 4;
+        }
+        if ((IicStr.PollLng < 0) || (IicStr.PollLng > 4))
+        {
+          IicStr.PollLng          =  (IicStr.PollLng < 0) ? 0 : 4;
+        }
+        if (IicLength(IicStr.ReadLng) > IIC_DATA_LENGTH)
+        {
+          IicStr.ReadLng          =  (IicStr.ReadLng < 0) ? -IIC_DATA_LENGTH : IIC_DATA_LENGTH;
+        }
+        spin_lock_irqsave(&IicLock,Flags);
+        IicStrings[Port]          =  IicStr;
+        IicPort[Port].NewString   =  1;
+        spin_unlock_irqrestore(&IicLock,Flags);
+      }
+    }
+    break;
+
+    case IIC_SETUP :
+    { // INPUT_DEVICE SETUP and READY_IIC - BUSY until result is ready
+
+      copy_from_user((void*)&IicDat,(void*)Pointer,sizeof(IICDAT));
+      Port            =  IicDat.Port;
+      IicDat.Result   =  FAIL;
+
+      spin_lock_irqsave(&IicLock,Flags);
+
+      if ((Port >= 0) && (Port < INPUTS) && (IicPort[Port].State == IIC_RUNNING) && (IicDat.WrLng > 0) && (IicDat.WrLng <= IIC_DATA_LENGTH) && (IicLength(IicDat.RdLng) <= IIC_DATA_LENGTH))
+      {
+        pTrans        =  &IicPort[Port].Trans[IIC_ONESHOT];
+        IicDat.Result =  BUSY;
+
+        if (((*pTrans).State == TRANS_DONE) && ((*pTrans).Kind == KIND_DEVICE) && (IicSame(pTrans,&IicDat)))
+        { // Result ready
+
+          IicDat.Result   =  (*pTrans).Result;
+          memcpy(IicDat.RdData,(*pTrans).RdData,IIC_DATA_LENGTH);
+          (*pTrans).State =  TRANS_FREE;
+        }
+        else
+        {
+          if (((*pTrans).State == TRANS_FREE) || ((*pTrans).State == TRANS_DONE))
+          { // Results not fetched are dropped
+
+            for (Slot = IIC_REPEATING;Slot < IIC_TRANSACTIONS;Slot++)
+            {
+              if ((IicDat.Repeat != 1) && (IicPort[Port].Trans[Slot].State != TRANS_FREE) && (IicSame(&IicPort[Port].Trans[Slot],&IicDat)))
+              { // Already polled in the background - answer from latest data
+
+                IicPort[Port].Trans[Slot].Time    =  IicRepeatTime(IicDat.Time);
+                memcpy(IicDat.RdData,IicPort[Port].Trans[Slot].RdData,IIC_DATA_LENGTH);
+                IicDat.Result   =  OK;
+                break;
+              }
+            }
+            if (IicDat.Result == BUSY)
+            {
+              IicTransLoad(pTrans,KIND_DEVICE,&IicDat);
+            }
+          }
+        }
+      }
+      spin_unlock_irqrestore(&IicLock,Flags);
+
+      copy_to_user((void*)Pointer,(void*)&IicDat,sizeof(IICDAT));
+    }
+    break;
+
+    case IIC_READ_STATUS :
+    {
+      copy_from_user((void*)&IicDat,(void*)Pointer,sizeof(IICDAT));
+      Port            =  IicDat.Port;
+      IicDat.Result   =  FAIL;
+
+      spin_lock_irqsave(&IicLock,Flags);
+
+      if ((Port >= 0) && (Port < INPUTS))
+      {
+        IicDat.Result =  (*pIic).Result[Port];
+      }
+      spin_unlock_irqrestore(&IicLock,Flags);
+
+      copy_to_user((void*)Pointer,(void*)&IicDat,sizeof(IICDAT));
+    }
+    break;
+
+    case IIC_READ_DATA :
+    {
+      copy_from_user((void*)&IicDat,(void*)Pointer,sizeof(IICDAT));
+      Port            =  IicDat.Port;
+      IicDat.Result   =  FAIL;
+
+      spin_lock_irqsave(&IicLock,Flags);
+
+      if ((Port >= 0) && (Port < INPUTS))
+      {
+        IicDat.Result =  (*pIic).Result[Port];
+        if (IicLength(IicDat.RdLng) > (*pIic).InputLength[Port])
+        {
+          IicDat.RdLng  =  (*pIic).InputLength[Port];
+        }
+        memcpy(IicDat.RdData,(*pIic).Input[Port],IIC_DATA_LENGTH);
+      }
+      spin_unlock_irqrestore(&IicLock,Flags);
+
+      copy_to_user((void*)Pointer,(void*)&IicDat,sizeof(IICDAT));
+    }
+    break;
+
+    case IIC_WRITE_DATA :
+    { // INPUT_IIC_WRITE - result published in shared memory
+
+      copy_from_user((void*)&IicDat,(void*)Pointer,sizeof(IICDAT));
+      Port            =  IicDat.Port;
+      IicDat.Result   =  FAIL;
+
+      spin_lock_irqsave(&IicLock,Flags);
+
+      if ((Port >= 0) && (Port < INPUTS) && (IicPort[Port].State == IIC_RUNNING) && (IicDat.WrLng > 0) && (IicDat.WrLng <= IIC_DATA_LENGTH) && (IicLength(IicDat.RdLng) <= IIC_DATA_LENGTH))
+      {
+        pTrans        =  &IicPort[Port].Trans[IIC_ONESHOT];
+
+        if (((*pTrans).State == TRANS_FREE) || ((*pTrans).State == TRANS_DONE))
+        {
+          IicDat.Repeat           =  1;
+          (*pIic).Result[Port]    =  BUSY;
+          IicTransLoad(pTrans,KIND_WRITE,&IicDat);
+          IicDat.Result           =  BUSY;
+        }
+      }
+      spin_unlock_irqrestore(&IicLock,Flags);
+
+      copy_to_user((void*)Pointer,(void*)&IicDat,sizeof(IICDAT));
+    }
+    break;
+
+  }
+
+  return (Result);
 }
 
 
@@ -118,14 +1587,45 @@ static ssize_t Device1Write(struct file *File,const char *Buffer,size_t Count,lo
 static ssize_t Device1Read(struct file *File,char *Buffer,size_t Count,loff_t *Offset)
 {
   int     Lng     = 0;
+  int     Tmp;
+  int     Port;
+
+  Port   =  0;
+  Tmp    =  5;
+  while ((Count > Tmp) && (Port < INPUTS))
+  {
+    if (Port != (INPUTS - 1))
+    {
+      Tmp    =  snprintf(&Buffer[Lng],4,"%2u ",(UWORD)IicPort[Port].State);
+    }
+    else
+    {
+      Tmp    =  snprintf(&Buffer[Lng],5,"%2u\r",(UWORD)IicPort[Port].State);
+    }
+    Lng   +=  Tmp;
+    Count -=  Tmp;
+    Port++;
+  }
 
   return (Lng);
 }
 
+
+#define     SHM_LENGTH    (sizeof(IicDefault))
+#define     NPAGES        ((SHM_LENGTH + PAGE_SIZE - 1) / PAGE_SIZE)
+static void *kmalloc_ptr;
+
+
 static int Device1Mmap(struct file *filp, struct vm_area_struct *vma)
 {
-   int ret = 0;
+   int ret;
+
+   ret = remap_pfn_range(vma,vma->vm_start,virt_to_phys((void*)((unsigned long)pIic)) >> PAGE_SHIFT,vma->vm_end-vma->vm_start,PAGE_SHARED);
 
+   if (ret != 0)
+   {
+     ret  =  -EAGAIN;
+   }
 
    return (ret);
 }
@@ -152,14 +1652,57 @@ static    struct miscdevice Device1 =
 static int Device1Init(void)
 {
   int     Result = -1;
-
+  UWORD   *pTmp;
+  int     i;
+  int     Port;
 
   Result  =  misc_register(&Device1);
   if (Result)
   {
     printk("  %s device register failed\n",DEVICE1_NAME);
   }
+  else
+  {
+    // allocate kernel shared memory for iic values (pIic)
+    if ((kmalloc_ptr = kmalloc((NPAGES + 2) * PAGE_SIZE, GFP_KERNEL)) != NULL)
+    {
+      pTmp = (UWORD*)((((unsigned long)kmalloc_ptr) + PAGE_SIZE - 1) & PAGE_MASK);
+      for (i = 0; i < NPAGES * PAGE_SIZE; i += PAGE_SIZE)
+      {
+        SetPageReserved(virt_to_page(((unsigned long)pTmp) + i));
+      }
+      pIic      =  (IIC*)pTmp;
+      memset(pIic,0,sizeof(IIC));
+
+      for (Port = 0;Port < INPUTS;Port++)
+      {
+        IicPort[Port].State     =  IIC_IDLE;
+        IicBus[Port].State      =  BUS_IDLE;
+        IicConfigured[Port]     =  0;
+        IicTransClear(Port,IIC_ONESHOT);
+        (*pIic).Result[Port]    =  FAIL;                    // Not OK before anything is transferred
+      }
+
+      IicBitTime  =  ktime_set(0,IIC_BIT_TIME * 1000);
+      hrtimer_init(&IicBitTimer,CLOCK_MONOTONIC,HRTIMER_MODE_REL);
+      IicBitTimer.function  =  IicBitTimerInterrupt;
+
+      Device1Time  =  ktime_set(0,IIC_TIMER_RESOLUTION * 100000);
+      hrtimer_init(&Device1Timer,CLOCK_MONOTONIC,HRTIMER_MODE_REL);
+      Device1Timer.function  =  Device1TimerInterrupt1;
+      hrtimer_start(&Device1Timer,Device1Time,HRTIMER_MODE_REL);
 
+#ifdef DEBUG
+      printk("  %s device register succes\n",DEVICE1_NAME);
+#endif
+    }
+    else
+    {
+      printk("  %s kmalloc failed !!\n",DEVICE1_NAME);
+      misc_deregister(&Device1);
+      Result  =  -ENOMEM;
+    }
+  }
 
   return (Result);
 }
@@ -167,6 +1710,27 @@ static int Device1Init(void)
 
 static void Device1Exit(void)
 {
+  int     Port;
+  UWORD   *pTmp;
+  int     i;
+
+  hrtimer_cancel(&Device1Timer);
+  hrtimer_cancel(&IicBitTimer);
+
+  for (Port = 0;Port < INPUTS;Port++)
+  {
+    IicPortDisable(Port);
+  }
+
+  // free shared memory
+  pTmp   =  (UWORD*)pIic;
+  pIic   =  &IicDefault;
+
+  for (i = 0; i < NPAGES * PAGE_SIZE; i+= PAGE_SIZE)
+  {
+    ClearPageReserved(virt_to_page(((unsigned long)pTmp) + i));
+  }
+  kfree(kmalloc_ptr);
 
   misc_deregister(&Device1);
 #ifdef DEBUG
@@ -196,8 +1760,28 @@ static int ModuleInit(void)
   printk("%s init started\n",MODULE_NAME);
 #endif
 
+  GetPeriphealBasePtr(0x44E10000, 0x1448, (ULONG **)&CM);
+  GetPeriphealBasePtr(0x44E00000, 0x154, (ULONG **)&CM_PER);
+  GetPeriphealBasePtr(0x44E07000, 0x198, (ULONG **)&GPIOBANK0);
+  GetPeriphealBasePtr(0x4804C000, 0x198, (ULONG **)&GPIOBANK1);
+  GetPeriphealBasePtr(0x481AC000, 0x198, (ULONG **)&GPIOBANK2);
+  GetPeriphealBasePtr(0x481AE000, 0x198, (ULONG **)&GPIOBANK3);
 
-      Device1Init();
+  CM_PER[0xAC >> 2] |= 0x2;     //CM_PER_GPIO1_CLKCTRL
+  while(0x2 != (ioread32(&CM_PER[0xAC >> 2]) & 0x2))
+    ;
+
+  CM_PER[0xB0 >> 2] |= 0x2;     //CM_PER_GPIO2_CLKCTRL
+  while(0x2 != (ioread32(&CM_PER[0xB0 >> 2]) & 0x2))
+    ;
+
+  CM_PER[0xB4 >> 2] |= 0x2;     //CM_PER_GPIO3_CLKCTRL
+  while(0x2 != (ioread32(&CM_PER[0xB4 >> 2]) & 0x2))
+    ;
+
+  InitGpio();
+
+  Device1Init();
 
   return (0);
 }
@@ -211,6 +1795,11 @@ static void ModuleExit(void)
 
   Device1Exit();
 
-
+  iounmap(CM);
+  iounmap(CM_PER);
+  iounmap(GPIOBANK0);
+  iounmap(GPIOBANK1);
+  iounmap(GPIOBANK2);
+  iounmap(GPIOBANK3);
 }
 
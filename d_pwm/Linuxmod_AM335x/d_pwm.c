@@ -26,7 +26,19 @@ int 	HwInvBits = 0;
 //#define   SPEED_PWMCNT_REL              (100) //(MAX_PWM_CNT/MAX_SPEED)
 #define   SPEED_PWMCNT_REL              (MAX_PWM_CNT/MAX_SPEED)
 #define   RAMP_FACTOR                   (1000)
+#define   HOLD_GAIN_SCALE               (100)                         // Hold gains are in 0.01 %
+#define   HOLD_TICKS_PER_S              (1000 / SOFT_TIMER_MS)
+#define   HOLD_MAX_ERR                  (32767)                       // [degree] keeps KP * error inside SLONG
+#define   HOLD_DEFAULT_KP               (800)
+#define   HOLD_DEFAULT_KI               (200)
+#define   HOLD_DEFAULT_KD               (200)
+#define   HOLD_DEFAULT_DEADBAND         (1)
+#define   HOLD_DEFAULT_POWER            (100)
 #define   MAX_SYNC_MOTORS               (2)
+#define   BATT_SCALE_ONE                (1024)                        // Compensation factor for 1:1
+#define   BATT_NOMINAL_MV               (7500)                        // [mV] unregulated power is scaled to this voltage
+#define   BATT_MIN_MV                   (5000)                        // [mV] below this the reading is not trusted
+#define   BATT_FILTER_SHIFT             (8)                           // Filter time constant 256 * SOFT_TIMER_MS ~ 0.5 S
 
 
 //#define   COUNTS_PER_PULSE_LM           12800L
@@ -180,6 +192,20 @@ typedef   struct
   UBYTE   Mutex;
   UBYTE   DirChgPtr;
   SWORD   TurnRatio;
+  SLONG   HoldPosition;
+  SLONG   HoldIVal;
+  SWORD   HoldKp;
+  SWORD   HoldKi;
+  SWORD   HoldKd;
+  UBYTE   HoldDeadband;
+  UBYTE   HoldPower;
+  UWORD   StallCnt;
+  UWORD   StallDelay;
+  UBYTE   StallPower;
+  UBYTE   StallSpeed;
+  UBYTE   StallAction;
+  SLONG   VbattFilt;
+  UWORD   BattScale;
 }MOTOR;
 
 typedef   struct
@@ -345,6 +371,13 @@ static volatile UWORD *eHRPWM2;
 
 static ULONG *DMTIMER3;		//It's important not to add the "volatile"!
 
+#ifdef DEBUG_TRACE_HOLD
+static    ULONG   TraceHoldTicks[NO_OF_OUTPUT_PORTS];
+static    SLONG   TraceHoldErrSum[NO_OF_OUTPUT_PORTS];
+static    SLONG   TraceHoldErrMax[NO_OF_OUTPUT_PORTS];
+static    SLONG   TraceHoldPowerSum[NO_OF_OUTPUT_PORTS];
+#endif
+
 
 static    MOTOR   Motor[NO_OF_OUTPUT_PORTS];
 static    SLONG   *(StepPowerSteps[NO_OF_OUTPUT_PORTS]);
@@ -699,6 +732,14 @@ void      SetPower(UBYTE Port, SLONG Power)
       Power = ((Power * 9500)/10000) + 500;
     }
   }
+#ifndef   DISABLE_BATT_COMPENSATION
+  // Deliver the duty a nominal battery would give
+  Power = (Power * Motor[Port].BattScale) / BATT_SCALE_ONE;
+  if (MAX_PWM_CNT < Power)
+  {
+    Power = MAX_PWM_CNT;
+  }
+#endif
   SetDuty[Port](Power);
 }
 
@@ -784,6 +825,23 @@ void      ClearPIDParameters(UBYTE No)
 }
 
 
+void      ClearStall(UBYTE Nos)
+{
+  UBYTE   Tmp;
+
+  for (Tmp = 0; Tmp < NO_OF_OUTPUT_PORTS; Tmp++)
+  {
+    if (Nos & (1 << Tmp))
+    {
+      Motor[Tmp].Mutex      = TRUE;
+      Motor[Tmp].StallCnt   = 0;
+      pMotor[Tmp].Stalled   = FALSE;
+      Motor[Tmp].Mutex      = FALSE;
+    }
+  }
+}
+
+
 /*! \page PwmModule
  *
  *  <hr size="1"/>
@@ -1167,6 +1225,91 @@ void      dRegulateSpeed(UBYTE No)
 }
 
 
+/*! \brief    dRegulatePosition
+ *
+ *  Position hold (servo) regulator - called every SOFT_TIMER_MS in state HOLD
+ *  Regulates the tacho sensor count towards HoldPosition with PID, deadband
+ *  and power limit from opOUTPUT_HOLD
+ *
+ *  Parameters:
+ *  No: The motor number
+ *
+ */
+void      dRegulatePosition(UBYTE No)
+{
+  SLONG   PosErr;
+  SLONG   ILimit;
+  SLONG   Pct;
+  SLONG   MaxPct;
+
+  MaxPct  = (SLONG)Motor[No].HoldPower * HOLD_GAIN_SCALE;
+  PosErr  = Motor[No].HoldPosition - Motor[No].TachoSensor;
+
+  if ((PosErr <= (SLONG)Motor[No].HoldDeadband) && (PosErr >= -(SLONG)Motor[No].HoldDeadband))
+  {
+    PosErr = 0;
+  }
+  if (PosErr > HOLD_MAX_ERR)
+  {
+    PosErr = HOLD_MAX_ERR;
+  }
+  if (PosErr < -HOLD_MAX_ERR)
+  {
+    PosErr = -HOLD_MAX_ERR;
+  }
+
+  if (Motor[No].HoldKi > 0)
+  {
+    // Integrated error is limited so that the integral part alone can not exceed the power limit
+    ILimit              = (MaxPct * HOLD_TICKS_PER_S) / (SLONG)Motor[No].HoldKi;
+    Motor[No].HoldIVal += PosErr;
+    if (Motor[No].HoldIVal > ILimit)
+    {
+      Motor[No].HoldIVal = ILimit;
+    }
+    if (Motor[No].HoldIVal < -ILimit)
+    {
+      Motor[No].HoldIVal = -ILimit;
+    }
+  }
+  else
+  {
+    Motor[No].HoldIVal = 0;
+  }
+
+  Pct  = (SLONG)Motor[No].HoldKp * PosErr;
+  Pct += ((SLONG)Motor[No].HoldKi * Motor[No].HoldIVal) / HOLD_TICKS_PER_S;
+  Pct -= (SLONG)Motor[No].HoldKd * (SLONG)Motor[No].Speed;
+
+  if (Pct > MaxPct)
+  {
+    Pct = MaxPct;
+  }
+  if (Pct < -MaxPct)
+  {
+    Pct = -MaxPct;
+  }
+
+  Motor[No].Power = (Pct * SPEED_PWMCNT_REL) / HOLD_GAIN_SCALE;
+  SetRegulationPower(No, Motor[No].Power);
+
+#ifdef DEBUG_TRACE_HOLD
+  PosErr = Motor[No].HoldPosition - Motor[No].TachoSensor;
+  if (PosErr < 0)
+  {
+    PosErr = 0 - PosErr;
+  }
+  TraceHoldTicks[No]++;
+  TraceHoldErrSum[No]   += PosErr;
+  TraceHoldPowerSum[No] += Pct / HOLD_GAIN_SCALE;
+  if (PosErr > TraceHoldErrMax[No])
+  {
+    TraceHoldErrMax[No]  = PosErr;
+  }
+#endif
+}
+
+
 void      BrakeMotor(UBYTE No, SLONG TachoCnt)
 {
   SLONG TmpTacho;
@@ -1376,6 +1519,131 @@ void      TestAndFloatSyncedMotors(UBYTE MotorBitField, UBYTE SyncCmd)
 }
 
 
+#ifndef   DISABLE_BATT_COMPENSATION
+/*! \brief    dUpdateBattScale
+ *
+ *  Battery compensation - called every SOFT_TIMER_MS
+ *  The VM writes the battery voltage [mV] into shared memory every 400 mS.
+ *  It is low pass filtered here and turned into the factor SetPower uses to
+ *  scale open loop duty to what a BATT_NOMINAL_MV battery would deliver.
+ *  A zero or implausible voltage (no VM, simulator) gives no scaling
+ *
+ *  Parameters:
+ *  No: The motor number
+ *
+ *  Returns TRUE when the factor changed and open loop duty must be re-applied
+ */
+UBYTE     dUpdateBattScale(UBYTE No)
+{
+  SLONG   Vbatt;
+  UWORD   Scale;
+
+  Vbatt = (SLONG)pMotor[No].Vbatt;
+  if (BATT_MIN_MV > Vbatt)
+  {
+    Motor[No].VbattFilt  =  0;
+    Scale                =  BATT_SCALE_ONE;
+  }
+  else
+  {
+    if (0 == Motor[No].VbattFilt)
+    { // First reading - seed the filter
+      Motor[No].VbattFilt  =  Vbatt << BATT_FILTER_SHIFT;
+    }
+    else
+    {
+      Motor[No].VbattFilt +=  Vbatt - (Motor[No].VbattFilt >> BATT_FILTER_SHIFT);
+    }
+    Scale  =  (UWORD)((BATT_NOMINAL_MV * BATT_SCALE_ONE) / (Motor[No].VbattFilt >> BATT_FILTER_SHIFT));
+  }
+  if (Scale != Motor[No].BattScale)
+  {
+    Motor[No].BattScale  =  Scale;
+    return(TRUE);
+  }
+  return(FALSE);
+}
+#endif
+
+
+/*! \brief    dCheckStall
+ *
+ *  Stall detection - called every SOFT_TIMER_MS after regulation
+ *  A driven motor is stalled when the power is at least StallPower while the
+ *  speed is at most StallSpeed for StallDelay ticks. The stall flag and count
+ *  are updated in shared memory and the stall action is taken once per run
+ *  command
+ *
+ *  Parameters:
+ *  No: The motor number
+ *
+ */
+void      dCheckStall(UBYTE No)
+{
+  SLONG   Power;
+  SLONG   Speed;
+  UBYTE   Partner;
+
+  Power  =  Motor[No].Power;
+  Speed  =  Motor[No].Speed;
+  if (Power < 0)
+  {
+    Power = 0 - Power;
+  }
+  if (Speed < 0)
+  {
+    Speed = 0 - Speed;
+  }
+
+  if ((0 == Motor[No].StallPower) || (IDLE == Motor[No].State) || (BRAKED == Motor[No].State) ||
+      (STOP_MOTOR == Motor[No].State) || (HOLD == Motor[No].State) ||
+      (Power < ((SLONG)Motor[No].StallPower * SPEED_PWMCNT_REL)) || (Speed > (SLONG)Motor[No].StallSpeed))
+  {
+    Motor[No].StallCnt = 0;
+  }
+  else
+  {
+    if (Motor[No].StallCnt < Motor[No].StallDelay)
+    {
+      Motor[No].StallCnt++;
+    }
+    else
+    {
+      if (FALSE == pMotor[No].Stalled)
+      {
+        if ((SyncMNos[0] == No) || (SyncMNos[1] == No))
+        {
+          Partner = SyncMNos[0];
+          if (SyncMNos[0] == No)
+          {
+            Partner = SyncMNos[1];
+          }
+          if ((STALL_FLAG != Motor[No].StallAction) && (UNUSED_SYNC_MOTOR != Partner) && (TRUE == Motor[Partner].Mutex))
+          {
+            // Partner is being changed by a command - take the action next tick
+            return;
+          }
+        }
+
+        pMotor[No].Stalled = TRUE;
+        pMotor[No].StallCount++;
+
+        if (STALL_COAST == Motor[No].StallAction)
+        {
+          TestAndFloatSyncedMotors((0x01 << No), FALSE);
+          StopAndFloatMotor(No);
+        }
+        if (STALL_BRAKE == Motor[No].StallAction)
+        {
+          TestAndFloatSyncedMotors((0x01 << No), FALSE);
+          StopAndBrakeMotor(No);
+        }
+      }
+    }
+  }
+}
+
+
 /*! \page PwmModule
  *
  *  <hr size="1"/>
@@ -1393,6 +1661,7 @@ static enum hrtimer_restart Device1TimerInterrupt1(struct hrtimer *pTimer)
 {
   UBYTE No;
   UBYTE Test;
+  UBYTE BattChanged = FALSE;
 
   static SLONG volatile TmpTacho;
   static SLONG volatile Tmp;
@@ -1419,11 +1688,14 @@ static enum hrtimer_restart Device1TimerInterrupt1(struct hrtimer *pTimer)
     {
 
       Test = dCalculateSpeed(No, &(Motor[No].Speed));
+#ifndef   DISABLE_BATT_COMPENSATION
+      BattChanged = dUpdateBattScale(No);
+#endif
       switch(Motor[No].State)
       {
         case UNLIMITED_UNREG:
         {
-          if (Motor[No].TargetPower != Motor[No].Power)
+          if ((Motor[No].TargetPower != Motor[No].Power) || (TRUE == BattChanged))
           {
             Motor[No].Power  = Motor[No].TargetPower;
             SetPower(No,Motor[No].Power);
@@ -1653,6 +1925,10 @@ static enum hrtimer_restart Device1TimerInterrupt1(struct hrtimer *pTimer)
 
           if ((TRUE == CheckLessThanSpecial(StepCntTst, Motor[No].TachoCntConst, Motor[No].Dir)) && (FALSE == Motor[No].LockRampDown))
           {
+            if (TRUE == BattChanged)
+            {
+              SetPower(No,Motor[No].Power);
+            }
           }
           else
           {
@@ -1983,6 +2259,12 @@ static enum hrtimer_restart Device1TimerInterrupt1(struct hrtimer *pTimer)
         }
         break;
 
+        case HOLD:
+        {
+          dRegulatePosition(No);
+        }
+        break;
+
         case IDLE:
         { /* Intentionally left empty */
         }
@@ -1992,8 +2274,22 @@ static enum hrtimer_restart Device1TimerInterrupt1(struct hrtimer *pTimer)
         }
         break;
       }
+      dCheckStall(No);
+    }
+  }
+#ifdef DEBUG_TRACE_HOLD
+  for (No = 0; No < NO_OF_OUTPUT_PORTS; No++)
+  {
+    if (TraceHoldTicks[No] >= (1000 / SOFT_TIMER_MS))
+    { // Hold tracking error mean/max [degree] and mean power [%] over the last second
+      printk("%s %c hold err %ld/%ld pwr %ld\n",DEVICE1_NAME,'A' + No,(long)(TraceHoldErrSum[No] / (SLONG)TraceHoldTicks[No]),(long)TraceHoldErrMax[No],(long)(TraceHoldPowerSum[No] / (SLONG)TraceHoldTicks[No]));
+      TraceHoldTicks[No]     =  0;
+      TraceHoldErrSum[No]    =  0;
+      TraceHoldErrMax[No]    =  0;
+      TraceHoldPowerSum[No]  =  0;
     }
   }
+#endif
   return (HRTIMER_RESTART);
 }
 
@@ -2072,6 +2368,8 @@ void      CheckforEndOfSync(void)
  *  opOUTPUT_STEP_SYNC:   Runs two motors regulated and syncronized, duration as specified by tacho cnts
  *  opOUTPUT_TIME_SYNC:   Runs two motors regulated and syncronized, duration as specified by time
  *  opOUTPUT_CLR_COUNT:   Resets the tacho count related to when motor is used as a sensor
+ *  opOUTPUT_HOLD:        Sets the position hold regulator parameters
+ *  opOUTPUT_STALL:       Sets the stall detection parameters
  *
  *
  *  Default state:        TBD
@@ -2116,6 +2414,19 @@ static ssize_t Device1Write(struct file *File,const char *Buffer,size_t Count,lo
           Motor[Tmp].TargetState  = UNLIMITED_UNREG;
           SetCoast(Tmp);
         }
+
+        // Stall and hold setup does not survive the program that set it
+        Motor[Tmp].StallPower   =  0;                     // Stall detection off
+        Motor[Tmp].StallSpeed   =  0;
+        Motor[Tmp].StallDelay   =  0;
+        Motor[Tmp].StallAction  =  STALL_FLAG;
+        Motor[Tmp].StallCnt     =  0;
+        Motor[Tmp].HoldKp       =  HOLD_DEFAULT_KP;
+        Motor[Tmp].HoldKi       =  HOLD_DEFAULT_KI;
+        Motor[Tmp].HoldKd       =  HOLD_DEFAULT_KD;
+        Motor[Tmp].HoldDeadband =  HOLD_DEFAULT_DEADBAND;
+        Motor[Tmp].HoldPower    =  HOLD_DEFAULT_POWER;
+        Motor[Tmp].HoldIVal     =  0;
         Motor[Tmp].Mutex = FALSE;
       }
     }
@@ -2163,6 +2474,9 @@ static ssize_t Device1Write(struct file *File,const char *Buffer,size_t Count,lo
           Motor[Tmp].TimeCnt       =  0;
           pMotor[Tmp].TachoSensor  =  0;
           Motor[Tmp].TachoSensor   =  0;
+          Motor[Tmp].StallCnt      =  0;
+          pMotor[Tmp].Stalled      =  FALSE;
+          pMotor[Tmp].StallCount   =  0;
           Motor[Tmp].Mutex         =  FALSE;
         }
       }
@@ -2197,6 +2511,7 @@ static ssize_t Device1Write(struct file *File,const char *Buffer,size_t Count,lo
         if (Buf[1] & (1 << Tmp))
         {
           Motor[Tmp].Mutex         =  TRUE;
+          Motor[Tmp].HoldPosition -=  Motor[Tmp].TachoSensor;   // Hold the same physical position
           pMotor[Tmp].TachoSensor  =  0;
           Motor[Tmp].TachoSensor   =  0;
           Motor[Tmp].Mutex         =  FALSE;
@@ -2237,6 +2552,7 @@ static ssize_t Device1Write(struct file *File,const char *Buffer,size_t Count,lo
       UBYTE Tmp;
 
       TestAndFloatSyncedMotors(Buf[1], FALSE);
+      ClearStall(Buf[1]);
 
       CheckSpeedPowerLimits(&(Buf[2]));
 
@@ -2247,7 +2563,7 @@ static ssize_t Device1Write(struct file *File,const char *Buffer,size_t Count,lo
           Motor[Tmp].Mutex       = TRUE;
           Motor[Tmp].TargetPower = (SLONG)(Buf[2]) * (SLONG)(Motor[Tmp].Pol) * (SLONG)SPEED_PWMCNT_REL;
 
-          if ((IDLE == Motor[Tmp].State) || (BRAKED == Motor[Tmp].State))
+          if ((IDLE == Motor[Tmp].State) || (BRAKED == Motor[Tmp].State) || (HOLD == Motor[Tmp].State))
           {
             Motor[Tmp].TargetState = UNLIMITED_UNREG;
           }
@@ -2262,6 +2578,7 @@ static ssize_t Device1Write(struct file *File,const char *Buffer,size_t Count,lo
       UBYTE Tmp;
 
       TestAndFloatSyncedMotors(Buf[1], FALSE);
+      ClearStall(Buf[1]);
 
       CheckSpeedPowerLimits(&(Buf[2]));
 
@@ -2271,7 +2588,7 @@ static ssize_t Device1Write(struct file *File,const char *Buffer,size_t Count,lo
         {
           Motor[Tmp].Mutex        = TRUE;
           Motor[Tmp].TargetSpeed  = (Buf[2]) * (Motor[Tmp].Pol);
-          if ((IDLE == Motor[Tmp].State) || (BRAKED == Motor[Tmp].State))
+          if ((IDLE == Motor[Tmp].State) || (BRAKED == Motor[Tmp].State) || (HOLD == Motor[Tmp].State))
           {
             Motor[Tmp].TargetState = UNLIMITED_REG;
           }
@@ -2284,12 +2601,14 @@ static ssize_t Device1Write(struct file *File,const char *Buffer,size_t Count,lo
     case opOUTPUT_START:
     {
       UBYTE Tmp;
+
+      ClearStall(Buf[1]);
       for (Tmp = 0;Tmp < OUTPUTS;Tmp++)
       {
         if (Buf[1] & (1 << Tmp))
         {
           Motor[Tmp].Mutex = TRUE;
-          if ((IDLE == Motor[Tmp].State) || (BRAKED == Motor[Tmp].State))
+          if ((IDLE == Motor[Tmp].State) || (BRAKED == Motor[Tmp].State) || (HOLD == Motor[Tmp].State))
           {
             Motor[Tmp].State  = Motor[Tmp].TargetState;
           }
@@ -2344,6 +2663,110 @@ static ssize_t Device1Write(struct file *File,const char *Buffer,size_t Count,lo
 
     case opOUTPUT_POSITION:
     {
+      UBYTE           Tmp;
+      OUTPUTPOSITION  Position;
+
+      memcpy((UBYTE*)(&(Position.Cmd)), &Buf[0], sizeof(Position));
+
+      TestAndFloatSyncedMotors(Position.Nos, FALSE);
+      ClearStall(Position.Nos);
+
+      for (Tmp = 0;Tmp < OUTPUTS;Tmp++)
+      {
+        if ((Position.Nos & (1 << Tmp)) && ((TYPE_TACHO == Motor[Tmp].Type) || (TYPE_MINITACHO == Motor[Tmp].Type)))
+        {
+          Motor[Tmp].Mutex         = TRUE;
+          Motor[Tmp].HoldPosition  = Position.Position;   // Same count as tacho sensor (not relative to polarity)
+          if (HOLD != Motor[Tmp].State)
+          {
+            // Entering hold - start without integrated error
+            ReadyStatus           &= ~(0x01 << Tmp);
+            TestStatus            &= ~(0x01 << Tmp);
+            Motor[Tmp].HoldIVal    = 0;
+            Motor[Tmp].TargetState = UNLIMITED_UNREG;
+            Motor[Tmp].State       = HOLD;
+          }
+          Motor[Tmp].Mutex         = FALSE;
+        }
+      }
+    }
+    break;
+
+    case opOUTPUT_HOLD:
+    {
+      UBYTE       Tmp;
+      HOLDSETUP   HoldSetup;
+
+      memcpy((UBYTE*)(&(HoldSetup.Cmd)), &Buf[0], sizeof(HoldSetup));
+
+      // DATA8 from the byte code - negative values would wrap when stored as UBYTE
+      if (HoldSetup.Power > MAX_SPEED)
+      {
+        HoldSetup.Power = MAX_SPEED;
+      }
+      if (HoldSetup.Power < 0)
+      {
+        HoldSetup.Power = 0;
+      }
+      if (HoldSetup.Deadband > MAX_SPEED)
+      {
+        HoldSetup.Deadband = MAX_SPEED;
+      }
+      if (HoldSetup.Deadband < 0)
+      {
+        HoldSetup.Deadband = 0;
+      }
+
+      for (Tmp = 0;Tmp < OUTPUTS;Tmp++)
+      {
+        if (HoldSetup.Nos & (1 << Tmp))
+        {
+          Motor[Tmp].Mutex         = TRUE;
+          Motor[Tmp].HoldKp        = HoldSetup.Kp;
+          Motor[Tmp].HoldKi        = HoldSetup.Ki;
+          Motor[Tmp].HoldKd        = HoldSetup.Kd;
+          Motor[Tmp].HoldDeadband  = (UBYTE)HoldSetup.Deadband;
+          Motor[Tmp].HoldPower     = (UBYTE)HoldSetup.Power;
+          Motor[Tmp].HoldIVal      = 0;
+          Motor[Tmp].Mutex         = FALSE;
+        }
+      }
+    }
+    break;
+
+    case opOUTPUT_STALL:
+    {
+      UBYTE       Tmp;
+      STALLSETUP  StallSetup;
+
+      memcpy((UBYTE*)(&(StallSetup.Cmd)), &Buf[0], sizeof(StallSetup));
+
+      if (StallSetup.Power > MAX_SPEED)
+      {
+        StallSetup.Power = MAX_SPEED;
+      }
+      if (StallSetup.Speed > MAX_SPEED)
+      {
+        StallSetup.Speed = MAX_SPEED;
+      }
+      if (StallSetup.Delay < 0)
+      {
+        StallSetup.Delay = 0;
+      }
+
+      for (Tmp = 0;Tmp < OUTPUTS;Tmp++)
+      {
+        if (StallSetup.Nos & (1 << Tmp))
+        {
+          Motor[Tmp].Mutex         = TRUE;
+          Motor[Tmp].StallPower    = (UBYTE)StallSetup.Power;
+          Motor[Tmp].StallSpeed    = (UBYTE)StallSetup.Speed;
+          Motor[Tmp].StallDelay    = (UWORD)StallSetup.Delay / SOFT_TIMER_MS;
+          Motor[Tmp].StallAction   = (UBYTE)StallSetup.Action;
+          Motor[Tmp].StallCnt      = 0;
+          Motor[Tmp].Mutex         = FALSE;
+        }
+      }
     }
     break;
 
@@ -2355,6 +2778,7 @@ static ssize_t Device1Write(struct file *File,const char *Buffer,size_t Count,lo
       memcpy((UBYTE*)(&(StepPower.Cmd)), &Buf[0], sizeof(StepPower));
 
       TestAndFloatSyncedMotors(StepPower.Nos, FALSE);
+      ClearStall(StepPower.Nos);
 
       CheckSpeedPowerLimits(&(StepPower.Power));
 
@@ -2417,6 +2841,7 @@ static ssize_t Device1Write(struct file *File,const char *Buffer,size_t Count,lo
       memcpy((UBYTE*)(&(TimePower.Cmd)), &Buf[0], sizeof(TimePower));
 
       TestAndFloatSyncedMotors(TimePower.Nos, FALSE);
+      ClearStall(TimePower.Nos);
 
       // Adjust if there is inconsistency between power and Time
       if (((TimePower.Power < 0) && ((TimePower.Time1 > 0) || (TimePower.Time2 > 0) || (TimePower.Time3 > 0))) ||
@@ -2488,6 +2913,7 @@ static ssize_t Device1Write(struct file *File,const char *Buffer,size_t Count,lo
       memcpy((UBYTE*)(&(StepSpeed.Cmd)), &Buf[0], sizeof(StepSpeed));
 
       TestAndFloatSyncedMotors(StepSpeed.Nos, FALSE);
+      ClearStall(StepSpeed.Nos);
 
       CheckSpeedPowerLimits(&(StepSpeed.Speed));
 
@@ -2553,6 +2979,7 @@ static ssize_t Device1Write(struct file *File,const char *Buffer,size_t Count,lo
       memcpy((UBYTE*)(&(TimeSpeed.Cmd)), &Buf[0], sizeof(TimeSpeed));
 
       TestAndFloatSyncedMotors(TimeSpeed.Nos, FALSE);
+      ClearStall(TimeSpeed.Nos);
 
       CheckSpeedPowerLimits(&(TimeSpeed.Speed));
 
@@ -2628,6 +3055,7 @@ static ssize_t Device1Write(struct file *File,const char *Buffer,size_t Count,lo
       memcpy((UBYTE*)(&(StepSync.Cmd)), &Buf[0], sizeof(StepSync));
 
       TestAndFloatSyncedMotors(StepSync.Nos, TRUE);
+      ClearStall(StepSync.Nos);
 
       //Check if exceeding speed limits
       CheckSpeedPowerLimits(&(StepSync.Speed));
@@ -2787,6 +3215,7 @@ static ssize_t Device1Write(struct file *File,const char *Buffer,size_t Count,lo
       memcpy((UBYTE*)(&(TimeSync.Cmd)), &Buf[0], sizeof(TimeSync));
 
       TestAndFloatSyncedMotors(TimeSync.Nos, TRUE);
+      ClearStall(TimeSync.Nos);
 
       //Check if exceeding speed limits
       CheckSpeedPowerLimits(&(TimeSync.Speed));
@@ -3020,6 +3449,12 @@ static int Device1Init(void)
 		Motor[Tmp].TargetState  =  UNLIMITED_UNREG; //default startup state
 		Motor[Tmp].Mutex        =  FALSE;
 		Motor[Tmp].BrakeAfter   =  FALSE;
+		Motor[Tmp].HoldKp       =  HOLD_DEFAULT_KP;
+		Motor[Tmp].HoldKi       =  HOLD_DEFAULT_KI;
+		Motor[Tmp].HoldKd       =  HOLD_DEFAULT_KD;
+		Motor[Tmp].HoldDeadband =  HOLD_DEFAULT_DEADBAND;
+		Motor[Tmp].HoldPower    =  HOLD_DEFAULT_POWER;
+		Motor[Tmp].BattScale    =  BATT_SCALE_ONE;
 
 		CLEARTachoArray(Tmp);
 		SETMotorType(Tmp, TYPE_NONE);                  //  Motor types can be: TYPE_TACHO, TYPE_NONE, TYPE_MINITACHO
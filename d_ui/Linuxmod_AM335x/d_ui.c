@@ -49,6 +49,8 @@ static    void ModuleExit(void);
 #include  <asm/uaccess.h>
 
 #include  <linux/fb.h>
+#include  <linux/workqueue.h>
+#include  <linux/spinlock.h>
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("The LEGO Group");
@@ -363,14 +365,210 @@ void lcd_put_vol_char(int x, int y, unsigned char letter, unsigned char c0, unsi
 static unsigned char bat_vol_update = 0;
 
 
+// OVERLAY ********************************************************************
+//
+// The hrtimer only samples the LED pattern and the battery voltage. When a
+// shown value changes the overlay is redrawn from a workqueue, and the areas
+// damaged in that frame are merged before they are sent to the panel
+
+#define   OVERLAY_GLYPHS                15        // Glyphs in vol_char_8x20
+#define   OVERLAY_GLYPH_W               8
+#define   OVERLAY_GLYPH_H               20
+#define   OVERLAY_MAX_DAMAGE            4
+#define   OVERLAY_MERGE_SLACK           880       // Extra pixels worth sending to save a panel transfer
+
+typedef struct
+{
+  int     x0;
+  int     y0;
+  int     x1;                                     // Exclusive
+  int     y1;                                     // Exclusive
+}DAMAGE;
+
+static    struct work_struct  OverlayWork;
+static    DEFINE_SPINLOCK(OverlayLock);
+
+static    unsigned char LedCol1;                  // Published by the timer
+static    unsigned char LedCol2;
+static    int           BatShow = -1;             // (Colour << 8) | digits, published by the timer
+
+static    int           LedDrawn = -1;            // What is on the panel now
+static    int           BatDrawn = -1;
+
+static    unsigned char GlyphSpan[OVERLAY_GLYPHS][OVERLAY_GLYPH_H][OVERLAY_GLYPH_W * 2];
+static    DAMAGE        Damage[OVERLAY_MAX_DAMAGE];
+static    int           DamageCnt = 0;
+
+static    const unsigned char BatCol[3][2] = { { 0xF8, 0x00 }, { 0xFF, 0xE0 }, { 0x07, 0xE0 } };
+
+
+static int DamageArea(DAMAGE *pD)
+{
+  return ((pD->x1 - pD->x0) * (pD->y1 - pD->y0));
+}
+
+
+static void OverlayDamage(int x, int y, int w, int h)
+{
+  DAMAGE  New;
+  DAMAGE  Union;
+  int     i;
+  int     Merged;
+
+  New.x0  =  x;
+  New.y0  =  y;
+  New.x1  =  x + w;
+  New.y1  =  y + h;
+
+  do
+  {
+    Merged  =  0;
+    for (i = 0; (i < DamageCnt) && (!Merged); i++)
+    {
+      Union.x0  =  min(New.x0, Damage[i].x0);
+      Union.y0  =  min(New.y0, Damage[i].y0);
+      Union.x1  =  max(New.x1, Damage[i].x1);
+      Union.y1  =  max(New.y1, Damage[i].y1);
+
+      if (DamageArea(&Union) <= (DamageArea(&New) + DamageArea(&Damage[i]) + OVERLAY_MERGE_SLACK))
+      {
+        New          =  Union;
+        Damage[i]    =  Damage[--DamageCnt];
+        Merged       =  1;
+      }
+    }
+  }
+  while (Merged);
+
+  if (DamageCnt < OVERLAY_MAX_DAMAGE)
+  {
+    Damage[DamageCnt++]  =  New;
+  }
+  else
+  {
+    Damage[0].x0  =  min(New.x0, Damage[0].x0);
+    Damage[0].y0  =  min(New.y0, Damage[0].y0);
+    Damage[0].x1  =  max(New.x1, Damage[0].x1);
+    Damage[0].y1  =  max(New.y1, Damage[0].y1);
+  }
+}
+
+
+static void OverlayFlush(void)
+{
+  int     i;
+
+  for (i = 0; i < DamageCnt; i++)
+  {
+    ili9225fb_extern_touch(Damage[i].x0, Damage[i].y0, Damage[i].x1 - Damage[i].x0, Damage[i].y1 - Damage[i].y0);
+  }
+  DamageCnt  =  0;
+}
+
+
+static void OverlayRenderGlyphs(unsigned char c0, unsigned char c1)
+{
+  int     Glyph, line, bit;
+  unsigned char byte;
+  unsigned char *pSpan;
+
+  // Expand the 1 bit glyphs to panel pixels once per colour
+  for (Glyph = 0; Glyph < OVERLAY_GLYPHS; Glyph++)
+  {
+    for (line = 0; line < OVERLAY_GLYPH_H; line++)
+    {
+      byte   =  vol_char_8x20[Glyph * OVERLAY_GLYPH_H + line];
+      pSpan  =  GlyphSpan[Glyph][line];
+      for (bit = 7; bit >= 0; bit--)
+      {
+        *pSpan++  =  (byte & (1 << bit)) ? c0 : 0;
+        *pSpan++  =  (byte & (1 << bit)) ? c1 : 0;
+      }
+    }
+  }
+}
+
+
+static void OverlayPutGlyph(int x, int y, unsigned char Glyph)
+{
+  int     line;
+
+  for (line = 0; line < OVERLAY_GLYPH_H; line++)
+  {
+    memcpy(fbmem + (x + (y + line) * 220) * 2, GlyphSpan[Glyph][line], OVERLAY_GLYPH_W * 2);
+  }
+  OverlayDamage(x, y, OVERLAY_GLYPH_W, OVERLAY_GLYPH_H);
+}
+
+
+static void OverlayUpdate(struct work_struct *pWork)
+{
+  unsigned long Flags;
+  unsigned char col1, col2;
+  int     Led, Bat;
+  int     x, y, location;
+
+  spin_lock_irqsave(&OverlayLock, Flags);
+  col1  =  LedCol1;
+  col2  =  LedCol2;
+  Bat   =  BatShow;
+  spin_unlock_irqrestore(&OverlayLock, Flags);
+
+  Led  =  (col1 << 8) | col2;
+  if (Led != LedDrawn)
+  {
+    LedDrawn  =  Led;
+    for(y = 0; y < 40; y++)
+    {
+      for(x = 180; x < 220; x++)
+      {
+        location = (x + y * 220) * 2;
+
+        *(fbmem + location++) = col1;
+        *(fbmem + location) = col2;
+      }
+    }
+    OverlayDamage(180, 0, 40, 40);
+  }
+
+  if ((Bat >= 0) && (Bat != BatDrawn))
+  {
+    if ((BatDrawn < 0) || ((Bat >> 8) != (BatDrawn >> 8)))
+    {
+      // New colour - everything is redrawn
+      OverlayRenderGlyphs(BatCol[Bat >> 8][0], BatCol[Bat >> 8][1]);
+
+      OverlayPutGlyph(180             , 60, 11);
+      OverlayPutGlyph(180 + 11        , 60, 12);
+      OverlayPutGlyph(180 + 11 * 2    , 60, 13);
+      OverlayPutGlyph(180 + 11 * 3 - 1, 60, 14);
+      OverlayPutGlyph(180 + 10 * 1    , 80, 10);
+      OverlayPutGlyph(180 + 10 * 3    , 80, 11);
+      BatDrawn  =  -1;
+    }
+    if ((BatDrawn < 0) || (((Bat & 0xFF) / 10) != ((BatDrawn & 0xFF) / 10)))
+    {
+      OverlayPutGlyph(180         , 80, (unsigned char)((Bat & 0xFF) / 10));
+    }
+    if ((BatDrawn < 0) || (((Bat & 0xFF) % 10) != ((BatDrawn & 0xFF) % 10)))
+    {
+      OverlayPutGlyph(180 + 10 * 2, 80, (unsigned char)((Bat & 0xFF) % 10));
+    }
+    BatDrawn  =  Bat;
+  }
+
+  OverlayFlush();
+}
+
+
 static enum hrtimer_restart Device1TimerInterrupt1(struct hrtimer *pTimer)
 {
   UBYTE   Tmp;
 
-  unsigned char col1_vol = 0, col2_vol = 0;
   static int vol_times = 0, vol_sum = 0; 
   static unsigned char col1 = 0, col2 = 0, col1_old = 0, col2_old = 0;
-  int x, y, location, vol, num1, num2;
+  int vol, num1, num2, Show;
+  unsigned long Flags;
 
 
   if (PatternBlock)
@@ -423,19 +621,12 @@ static enum hrtimer_restart Device1TimerInterrupt1(struct hrtimer *pTimer)
 	{
 		col1_old = col1;
 		col2_old = col2;
-		for(y = 0; y < 40; y++)
-		{
-			for(x = 180; x < 220; x++)
-			{
-				location = (x + y * 220) * 2;
-
-				*(fbmem + location++) = col1;
-				*(fbmem + location) = col2;
-
-			}
-		}
 
-		ili9225fb_extern_touch(180, 0, 40, 40);
+		spin_lock_irqsave(&OverlayLock, Flags);
+		LedCol1 = col1;
+		LedCol2 = col2;
+		spin_unlock_irqrestore(&OverlayLock, Flags);
+		schedule_work(&OverlayWork);
 	}
 
   }
@@ -457,38 +648,31 @@ static enum hrtimer_restart Device1TimerInterrupt1(struct hrtimer *pTimer)
 			vol_sum = (vol_sum >> 2) + 49;
 			vol_sum = vol_sum > 9999 ? 9999 : vol_sum;
 
+			num1 = vol_sum / 1000;
+			num2 = (vol_sum - num1 * 1000) / 100;
+
 			if ( vol_sum > 7400)
 			{
-				col1_vol = 0x07;
-				col2_vol = 0xE0;
+				Show = 2 << 8;
 			}
 			else if (vol_sum > 6400)
 			{
-				col1_vol = 0xFF;
-				col2_vol = 0xE0;
+				Show = 1 << 8;
 			}
 			else
 			{
-				col1_vol = 0xF8;
-				col2_vol = 0x0;
+				Show = 0 << 8;
 			}
+			Show |= num1 * 10 + num2;
 
-			num1 = vol_sum / 1000;
-			num2 = (vol_sum - num1 * 1000) / 100;
-		 
-			lcd_put_vol_char(180             , 60, 11, col1_vol, col2_vol);
-			lcd_put_vol_char(180 + 11        , 60, 12, col1_vol, col2_vol);
-			lcd_put_vol_char(180 + 11 * 2    , 60, 13, col1_vol, col2_vol);
-			lcd_put_vol_char(180 + 11 * 3 - 1, 60, 14, col1_vol, col2_vol);
-			
-			
-			lcd_put_vol_char(180         , 80, (unsigned char)num1, col1_vol, col2_vol);
-			lcd_put_vol_char(180 + 10 * 2, 80, (unsigned char)num2, col1_vol, col2_vol);
-			lcd_put_vol_char(180 + 10 * 1, 80, 10, col1_vol, col2_vol);
-			lcd_put_vol_char(180 + 10 * 3, 80, 11, col1_vol, col2_vol);
-
-			ili9225fb_extern_touch(180, 60, 11 * 4, 20 * 2);
-
+			// Only wake the renderer when the shown value changes
+			if (Show != BatShow)
+			{
+				spin_lock_irqsave(&OverlayLock, Flags);
+				BatShow = Show;
+				spin_unlock_irqrestore(&OverlayLock, Flags);
+				schedule_work(&OverlayWork);
+			}
 
 			vol_sum = 0;
 		}
@@ -807,6 +991,7 @@ static int Device1Init(void)
 		      Device2Timer.function  =  Device2TimerInterrupt1;
 		      hrtimer_start(&Device2Timer,Device2Time,HRTIMER_MODE_REL);
 		      // setup ui update timer interrupt
+		       INIT_WORK(&OverlayWork, OverlayUpdate);
 		       Device1Time  =  ktime_set(0,50000000);
 		       hrtimer_init(&Device1Timer,CLOCK_MONOTONIC,HRTIMER_MODE_REL);
 		       Device1Timer.function  =  Device1TimerInterrupt1;
@@ -865,6 +1050,7 @@ static void Device1Exit(void)
 
 	hrtimer_cancel(&Device1Timer);
   	hrtimer_cancel(&Device2Timer);
+	cancel_work_sync(&OverlayWork);
 
 	for(y = 0; y <= 175; y++)
 	{
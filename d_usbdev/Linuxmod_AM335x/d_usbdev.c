@@ -48,6 +48,7 @@
 
 #define   MODULE_NAME                   "usbdev_module"
 #define   DEVICE1_NAME                  USBDEV_DEVICE
+#define   DEVICE2_NAME                  USBBULK_DEVICE
 
 static    int  ModuleInit(void);
 static    void ModuleExit(void);
@@ -112,6 +113,22 @@ char usb_char_buffer_out[MAX_EP_SIZE];
 char usb_full_buffer_out[MAX_FULLSPEED_EP_SIZE];
 int usb_char_out_length = 0;
 
+// Vendor bulk interface - deep request queues and a ring buffer towards user space
+#define BULK_RX_BUF_SIZE    16384   // Must be a power of 2
+#define BULK_NO_OF_RX_REQS  16
+#define BULK_NO_OF_TX_REQS  4
+#define BULK_REQ_SIZE       4096    // Largest message accepted in one write
+static DEFINE_SPINLOCK(bulk_lock);
+char bulk_rx_buffer[BULK_RX_BUF_SIZE];
+unsigned bulk_rx_in = 0;
+unsigned bulk_rx_out = 0;
+struct usb_request *bulk_rx_parked[BULK_NO_OF_RX_REQS];
+int bulk_rx_parked_cnt = 0;
+struct usb_request *bulk_tx_idle[BULK_NO_OF_TX_REQS];
+int bulk_tx_idle_cnt = 0;
+int bulk_tx_pool = 0;                 // Bumped when the idle pool is freed - older requests are not returned to it
+int bulk_online = 0;
+
 #define     SHM_LENGTH    (sizeof(UsbSpeedDefault))
 #define     NPAGES        ((SHM_LENGTH + PAGE_SIZE - 1) / PAGE_SIZE)
 static void *kmalloc_ptr;
@@ -690,6 +707,155 @@ static void Device1Exit(void)
 }
 
 
+// DEVICE2 char device stuff ********************************************************************
+
+static ssize_t Device2Write(struct file *File,const char *Buffer,size_t Count,loff_t *Data)
+{
+  // Queue one message on the bulk IN pipe - all or nothing
+
+  struct usb_request *req = NULL;
+  unsigned long Flags;
+  int BytesWritten = 0;
+  int Pool = 0;
+
+  if ((Count > 0) && (Count <= BULK_REQ_SIZE))
+  {
+    spin_lock_irqsave(&bulk_lock, Flags);
+    if ((bulk_online) && (bulk_tx_idle_cnt > 0))
+    {
+      req  = bulk_tx_idle[--bulk_tx_idle_cnt];
+      Pool = bulk_tx_pool;
+    }
+    spin_unlock_irqrestore(&bulk_lock, Flags);
+
+    if (req != NULL)
+    {
+      if (copy_from_user(req->buf, Buffer, Count) == 0)
+      {
+        req->length = Count;
+        if (usb_ep_queue(save_bulk_in_ep, req, GFP_KERNEL) == 0)
+        {
+          BytesWritten = Count;
+        }
+        else
+        {
+          bulk_tx_release(req, Pool);
+        }
+      }
+      else
+      {
+        bulk_tx_release(req, Pool);
+        BytesWritten = -EFAULT;
+      }
+    }
+  }
+
+  //#define DEBUG
+  #undef DEBUG
+  #ifdef DEBUG
+    printk("usbbulk %d written\n\r", BytesWritten);
+  #endif
+
+  return (BytesWritten); // Zero means no idle request - try again later
+}
+
+static ssize_t Device2Read(struct file *File,char *Buffer,size_t Count,loff_t *Offset)
+{
+  // Read whatever the HOST has streamed - never blocks
+  unsigned long Flags;
+  unsigned In;
+  unsigned Out;
+  unsigned Part;
+  int     BytesRead     = 0;
+
+  spin_lock_irqsave(&bulk_lock, Flags);
+  In  = bulk_rx_in;
+  Out = bulk_rx_out;
+  spin_unlock_irqrestore(&bulk_lock, Flags);
+
+  BytesRead = (In - Out) & (BULK_RX_BUF_SIZE - 1);
+  if (BytesRead > Count)
+  {
+    BytesRead = Count;
+  }
+
+  if (BytesRead > 0)
+  {
+    Part = BULK_RX_BUF_SIZE - Out;
+    if (Part > BytesRead)
+    {
+      Part = BytesRead;
+    }
+    if ((copy_to_user(Buffer, &bulk_rx_buffer[Out], Part)) || (copy_to_user(&Buffer[Part], bulk_rx_buffer, BytesRead - Part)))
+    {
+      return (-EFAULT);
+    }
+
+    spin_lock_irqsave(&bulk_lock, Flags);
+    bulk_rx_out = (Out + BytesRead) & (BULK_RX_BUF_SIZE - 1);
+    if (bulk_online)
+    {
+      bulk_rx_unpark();
+    }
+    spin_unlock_irqrestore(&bulk_lock, Flags);
+  }
+
+  return (BytesRead);
+}
+
+static    const struct file_operations Device2Entries =
+{
+  .owner        = THIS_MODULE,
+  .read         = Device2Read,
+  .write        = Device2Write
+};
+
+
+static    struct miscdevice Device2 =
+{
+  MISC_DYNAMIC_MINOR,
+  DEVICE2_NAME,
+  &Device2Entries
+};
+
+
+static int Device2Init(void)
+{
+  int     Result = -1;
+
+  Result  =  misc_register(&Device2);
+  if (Result)
+  {
+    //#define DEBUG
+    #undef DEBUG
+    #ifdef DEBUG
+      printk("  %s device register failed\n",DEVICE2_NAME);
+    #endif
+  }
+  else
+  {
+    //#define DEBUG
+    #undef DEBUG
+    #ifdef DEBUG
+      printk("  %s device register OK\n",DEVICE2_NAME);
+    #endif
+  }
+
+  return (Result);
+}
+
+static void Device2Exit(void)
+{
+  misc_deregister(&Device2);
+
+  //#define DEBUG
+  #undef DEBUG
+  #ifdef DEBUG
+    printk("  %s device unregistered\n",DEVICE2_NAME);
+  #endif
+}
+
+
 // MODULE *********************************************************************
 
 char *HostStr;    // Used for HostName - or NOT used at all
@@ -747,6 +913,7 @@ static int ModuleInit(void)
     printk("\n\rThis is the INSMODed SerialNumber (BT mac): %s\n\r", serial);
   #endif
 
+  Device2Init();
   Device1Init();
 
   return (0);
@@ -761,6 +928,7 @@ static void ModuleExit(void)
   #endif
 
   Device1Exit();
+  Device2Exit();
 
 }
 
@@ -44,6 +44,9 @@ struct f_rudolf {
 	struct usb_ep		*in_ep;
 	struct usb_ep		*out_ep;
 
+	struct usb_ep		*bulk_in_ep;
+	struct usb_ep		*bulk_out_ep;
+
 	int			cur_alt;
 };
 
@@ -63,6 +66,8 @@ enum            // Used for signaling the IN stuff USB-state
 int input_state = USB_DATA_IDLE;
 struct usb_ep *save_in_ep;
 struct usb_request *save_in_req;
+struct usb_ep *save_bulk_in_ep;
+struct usb_ep *save_bulk_out_ep;
 
 /*-------------------------------------------------------------------------*/
 
@@ -78,6 +83,18 @@ static struct usb_interface_descriptor rudolf_intf = {
 	/* .iInterface		= DYNAMIC */
 };
 
+static struct usb_interface_descriptor rudolf_bulk_intf = {
+	.bLength =		sizeof rudolf_bulk_intf,
+	.bDescriptorType =	USB_DT_INTERFACE,
+	.bInterfaceNumber           =     1,
+	.bAlternateSetting 	=	0,
+	.bNumEndpoints 		=	2,
+	.bInterfaceSubClass         =     0,
+	.bInterfaceProtocol         =     0,
+	.bInterfaceClass =	USB_CLASS_VENDOR_SPEC,
+	/* .iInterface		= DYNAMIC */
+};
+
 
 
 static struct hid_descriptor hs_hid_rudolf_desc = {
@@ -132,12 +149,31 @@ static struct usb_endpoint_descriptor rudolf_in_fs_desc = {
   .bInterval                  =     1, /* 1 = 1 mSec POLL rate for FS */
 };
 
+static struct usb_endpoint_descriptor rudolf_bulk_out_fs_desc = {
+  .bLength                    =     USB_DT_ENDPOINT_SIZE,
+  .bDescriptorType            =     USB_DT_ENDPOINT,
+  .bEndpointAddress           =     USB_DIR_OUT,
+  .bmAttributes               =     USB_ENDPOINT_XFER_BULK,
+  .wMaxPacketSize             =     cpu_to_le16(64),
+};
+
+static struct usb_endpoint_descriptor rudolf_bulk_in_fs_desc = {
+  .bLength                    =     USB_DT_ENDPOINT_SIZE,
+  .bDescriptorType            =     USB_DT_ENDPOINT,
+  .bEndpointAddress           =     USB_DIR_IN,
+  .bmAttributes               =     USB_ENDPOINT_XFER_BULK,
+  .wMaxPacketSize             =     cpu_to_le16(64),
+};
+
 
 static struct usb_descriptor_header *fs_rudolf_descs[] = {
   (struct usb_descriptor_header *) &rudolf_intf,
   (struct usb_descriptor_header *) &fs_hid_rudolf_desc,
   (struct usb_descriptor_header *) &rudolf_in_fs_desc,
   (struct usb_descriptor_header *) &rudolf_out_fs_desc,
+  (struct usb_descriptor_header *) &rudolf_bulk_intf,
+  (struct usb_descriptor_header *) &rudolf_bulk_in_fs_desc,
+  (struct usb_descriptor_header *) &rudolf_bulk_out_fs_desc,
 	NULL,
 };
 
@@ -176,6 +212,22 @@ static struct usb_endpoint_descriptor rudolf_out_hs_desc = {
                                          */
 };
 
+static struct usb_endpoint_descriptor rudolf_bulk_in_hs_desc = {
+  .bLength                    =     USB_DT_ENDPOINT_SIZE,
+  .bDescriptorType            =     USB_DT_ENDPOINT,
+  .bEndpointAddress           =     USB_DIR_IN,
+  .bmAttributes               =     USB_ENDPOINT_XFER_BULK,
+  .wMaxPacketSize             =     cpu_to_le16(512),
+};
+
+static struct usb_endpoint_descriptor rudolf_bulk_out_hs_desc = {
+  .bLength                    =     USB_DT_ENDPOINT_SIZE,
+  .bDescriptorType            =     USB_DT_ENDPOINT,
+  .bEndpointAddress           =     USB_DIR_OUT,
+  .bmAttributes               =     USB_ENDPOINT_XFER_BULK,
+  .wMaxPacketSize             =     cpu_to_le16(512),
+};
+
 
 
 static struct usb_descriptor_header *hs_rudolf_descs[] = {
@@ -183,6 +235,9 @@ static struct usb_descriptor_header *hs_rudolf_descs[] = {
   (struct usb_descriptor_header *) &hs_hid_rudolf_desc,
   (struct usb_descriptor_header *) &rudolf_in_hs_desc,
   (struct usb_descriptor_header *) &rudolf_out_hs_desc,
+  (struct usb_descriptor_header *) &rudolf_bulk_intf,
+  (struct usb_descriptor_header *) &rudolf_bulk_in_hs_desc,
+  (struct usb_descriptor_header *) &rudolf_bulk_out_hs_desc,
   NULL,
 };
 
@@ -219,9 +274,9 @@ struct usb_request *alloc_ep_req(struct usb_ep *ep, int len)
 
 	req = usb_ep_alloc_request(ep, GFP_ATOMIC);
 	if (req) {
-	//	if (len)
-	//		req->length = len;
-	//	else
+		if (len)
+			req->length = len;
+		else
 			req->length = buflen;
 		req->buf = kmalloc(req->length, GFP_ATOMIC);
 		if (!req->buf) {
@@ -303,6 +358,22 @@ f_rudolf_bind(struct usb_configuration *c, struct usb_function *f)
 	}
 	ss->out_ep->driver_data = cdev;	/* claim */
 
+	/* vendor bulk interface for high throughput transfers */
+	id = usb_interface_id(c, f);
+	if (id < 0)
+		return id;
+	rudolf_bulk_intf.bInterfaceNumber = id;
+
+	ss->bulk_in_ep = usb_ep_autoconfig(cdev->gadget, &rudolf_bulk_in_fs_desc);
+	if (!ss->bulk_in_ep)
+		goto autoconf_fail;
+	ss->bulk_in_ep->driver_data = cdev;	/* claim */
+
+	ss->bulk_out_ep = usb_ep_autoconfig(cdev->gadget, &rudolf_bulk_out_fs_desc);
+	if (!ss->bulk_out_ep)
+		goto autoconf_fail;
+	ss->bulk_out_ep->driver_data = cdev;	/* claim */
+
 
 
 
@@ -313,6 +384,8 @@ f_rudolf_bind(struct usb_configuration *c, struct usb_function *f)
 	/* support high speed hardware */
 	rudolf_in_hs_desc.bEndpointAddress = rudolf_in_fs_desc.bEndpointAddress;
 	rudolf_out_hs_desc.bEndpointAddress = rudolf_out_fs_desc.bEndpointAddress;
+	rudolf_bulk_in_hs_desc.bEndpointAddress = rudolf_bulk_in_fs_desc.bEndpointAddress;
+	rudolf_bulk_out_hs_desc.bEndpointAddress = rudolf_bulk_out_fs_desc.bEndpointAddress;
 
 
 
@@ -627,6 +700,240 @@ static int rudolf_start_ep(struct f_rudolf *rudolf, bool is_in)
 
 
 
+/*-------------------------------------------------------------------------*/
+
+/* Vendor bulk interface
+ *
+ * OUT: BULK_NO_OF_RX_REQS packet sized requests are kept queued, completed
+ * packets are copied into bulk_rx_buffer. If the ring buffer is full the
+ * request is parked until user space has read enough to make room.
+ *
+ * IN:  a pool of BULK_NO_OF_TX_REQS requests - user space takes an idle one,
+ * fills it and queues it. Requests return to the pool on completion.
+ */
+
+static int bulk_rx_space(void)
+{
+  return (BULK_RX_BUF_SIZE - 1 - ((bulk_rx_in - bulk_rx_out) & (BULK_RX_BUF_SIZE - 1)));
+}
+
+static void bulk_rx_store(struct usb_request *req)
+{
+  unsigned  Part;
+
+  // Must be called with bulk_lock held and room for req->actual bytes
+
+  Part = BULK_RX_BUF_SIZE - bulk_rx_in;
+  if (Part > req->actual)
+  {
+    Part = req->actual;
+  }
+  memcpy(&bulk_rx_buffer[bulk_rx_in], req->buf, Part);
+  memcpy(bulk_rx_buffer, (u8*)req->buf + Part, req->actual - Part);
+  bulk_rx_in = (bulk_rx_in + req->actual) & (BULK_RX_BUF_SIZE - 1);
+}
+
+static void bulk_rx_unpark(void)
+{
+  struct usb_request  *req;
+  int                 i;
+
+  // Must be called with bulk_lock held
+
+  while ((bulk_rx_parked_cnt > 0) && (bulk_rx_space() >= bulk_rx_parked[0]->actual))
+  {
+    req = bulk_rx_parked[0];
+    bulk_rx_parked_cnt--;
+    for (i = 0; i < bulk_rx_parked_cnt; i++)
+    {
+      bulk_rx_parked[i] = bulk_rx_parked[i + 1];
+    }
+
+    bulk_rx_store(req);
+    if (usb_ep_queue(save_bulk_out_ep, req, GFP_ATOMIC))
+    {
+      free_ep_req(save_bulk_out_ep, req);
+    }
+  }
+}
+
+static void bulk_out_complete(struct usb_ep *ep, struct usb_request *req)
+{
+  unsigned long Flags;
+
+  switch (req->status)
+  {
+    case 0:
+    {
+      spin_lock_irqsave(&bulk_lock, Flags);
+      if ((bulk_rx_parked_cnt == 0) && (bulk_rx_space() >= req->actual))
+      {
+        bulk_rx_store(req);
+        if (usb_ep_queue(ep, req, GFP_ATOMIC))
+        {
+          free_ep_req(ep, req);
+        }
+      }
+      else
+      {
+        // No room - hold the request back (and thereby NAK the host)
+        bulk_rx_parked[bulk_rx_parked_cnt++] = req;
+      }
+      spin_unlock_irqrestore(&bulk_lock, Flags);
+    }
+    break;
+
+    case -ESHUTDOWN:      /* disconnect from host */
+    case -ECONNABORTED:   /* hardware forced ep reset */
+    case -ECONNRESET:     /* request dequeued */
+    {
+      free_ep_req(ep, req);
+    }
+    break;
+
+    default:
+    {
+      if (usb_ep_queue(ep, req, GFP_ATOMIC))
+      {
+        free_ep_req(ep, req);
+      }
+    }
+    break;
+  }
+}
+
+static void bulk_in_complete(struct usb_ep *ep, struct usb_request *req)
+{
+  unsigned long Flags;
+
+  switch (req->status)
+  {
+    case -ESHUTDOWN:      /* disconnect from host */
+    case -ECONNABORTED:   /* hardware forced ep reset */
+    case -ECONNRESET:     /* request dequeued */
+    {
+      free_ep_req(ep, req);
+    }
+    break;
+
+    default:
+    {
+      spin_lock_irqsave(&bulk_lock, Flags);
+      bulk_tx_idle[bulk_tx_idle_cnt++] = req;
+      spin_unlock_irqrestore(&bulk_lock, Flags);
+    }
+    break;
+  }
+}
+
+static void disable_bulk(struct f_rudolf *ss)
+{
+  struct usb_composite_dev  *cdev;
+  unsigned long             Flags;
+
+  cdev = ss->function.config->cdev;
+
+  spin_lock_irqsave(&bulk_lock, Flags);
+  bulk_online = 0;
+  bulk_tx_pool++;
+  spin_unlock_irqrestore(&bulk_lock, Flags);
+
+  // Queued requests complete with -ESHUTDOWN and are freed there
+  disable_endpoints(cdev, ss->bulk_in_ep, ss->bulk_out_ep, NULL, NULL);
+
+  spin_lock_irqsave(&bulk_lock, Flags);
+  while (bulk_tx_idle_cnt > 0)
+  {
+    free_ep_req(ss->bulk_in_ep, bulk_tx_idle[--bulk_tx_idle_cnt]);
+  }
+  while (bulk_rx_parked_cnt > 0)
+  {
+    free_ep_req(ss->bulk_out_ep, bulk_rx_parked[--bulk_rx_parked_cnt]);
+  }
+  spin_unlock_irqrestore(&bulk_lock, Flags);
+}
+
+static int enable_bulk(struct usb_composite_dev *cdev, struct f_rudolf *ss)
+{
+  struct usb_request  *req;
+  int                 result;
+  int                 i;
+
+  result = config_ep_by_speed(cdev->gadget, &(ss->function), ss->bulk_in_ep);
+  if (result)
+    return result;
+  result = usb_ep_enable(ss->bulk_in_ep);
+  if (result < 0)
+    return result;
+  ss->bulk_in_ep->driver_data = ss;
+
+  result = config_ep_by_speed(cdev->gadget, &(ss->function), ss->bulk_out_ep);
+  if (result == 0)
+    result = usb_ep_enable(ss->bulk_out_ep);
+  if (result < 0) {
+    usb_ep_disable(ss->bulk_in_ep);
+    ss->bulk_in_ep->driver_data = NULL;
+    return result;
+  }
+  ss->bulk_out_ep->driver_data = ss;
+
+  save_bulk_in_ep     = ss->bulk_in_ep;
+  save_bulk_out_ep    = ss->bulk_out_ep;
+  bulk_rx_in          = 0;
+  bulk_rx_out         = 0;
+  bulk_rx_parked_cnt  = 0;
+  bulk_tx_idle_cnt    = 0;
+
+  for (i = 0; i < BULK_NO_OF_TX_REQS; i++)
+  {
+    req = alloc_ep_req(ss->bulk_in_ep, BULK_REQ_SIZE);
+    if (req)
+    {
+      req->complete = bulk_in_complete;
+      req->zero     = 1;    // Terminate transfers of a whole number of packets
+      bulk_tx_idle[bulk_tx_idle_cnt++] = req;
+    }
+  }
+
+  // One packet per OUT request so a message never waits for the next one
+  for (i = 0; i < BULK_NO_OF_RX_REQS; i++)
+  {
+    req = alloc_ep_req(ss->bulk_out_ep, usb_endpoint_maxp(ss->bulk_out_ep->desc));
+    if (req)
+    {
+      req->complete = bulk_out_complete;
+      if (usb_ep_queue(ss->bulk_out_ep, req, GFP_ATOMIC))
+      {
+        free_ep_req(ss->bulk_out_ep, req);
+      }
+    }
+  }
+  bulk_online = 1;
+
+  DBG(cdev, "%s bulk interface enabled\n", ss->function.name);
+  return 0;
+}
+
+static void bulk_tx_release(struct usb_request *req, int pool)
+{
+  // Back to the idle pool it was taken from - if the bulk interface has
+  // been disabled since, that pool is gone and the request is freed here
+
+  unsigned long Flags;
+
+  spin_lock_irqsave(&bulk_lock, Flags);
+  if ((bulk_online) && (pool == bulk_tx_pool) && (bulk_tx_idle_cnt < BULK_NO_OF_TX_REQS))
+  {
+    bulk_tx_idle[bulk_tx_idle_cnt++] = req;
+  }
+  else
+  {
+    free_ep_req(save_bulk_in_ep, req);
+  }
+  spin_unlock_irqrestore(&bulk_lock, Flags);
+}
+
+
 static void disable_source_sink(struct f_rudolf *ss)
 {
 	struct usb_composite_dev	*cdev;
@@ -710,6 +1017,13 @@ static int f_rudolf_set_alt(struct usb_function *f,
 	struct f_rudolf		*ss = func_to_ss(f);
 	struct usb_composite_dev	*cdev = f->config->cdev;
 
+	if (intf == rudolf_bulk_intf.bInterfaceNumber)
+	{
+		if (ss->bulk_in_ep->driver_data)
+			disable_bulk(ss);
+		return enable_bulk(cdev, ss);
+	}
+
 	//alt should be zero
 	if (ss->in_ep->driver_data)
 		disable_source_sink(ss);
@@ -732,6 +1046,7 @@ static void f_rudolf_disable(struct usb_function *f)
 	struct f_rudolf *ss = func_to_ss(f);
 
 	disable_source_sink(ss);
+	disable_bulk(ss);
 }
 
 /*-------------------------------------------------------------------------*/
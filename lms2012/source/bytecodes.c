@@ -323,6 +323,7 @@ static OPCODE OpCodes[256] =
   OC(   opOUTPUT_POLARITY,      PAR8,PAR8,PAR8,                                 0,0,0,0,0             ),
   OC(   opOUTPUT_READ,          PAR8,PAR8,PAR8,PAR32,                           0,0,0,0               ),
   OC(   opOUTPUT_READY,         PAR8,PAR8,                                      0,0,0,0,0,0           ),
+  OC(   opOUTPUT_POSITION,      PAR8,PAR8,PAR32,                                0,0,0,0,0             ),
   OC(   opOUTPUT_TEST,          PAR8,PAR8,PAR8,                                 0,0,0,0,0             ),
   OC(   opOUTPUT_STEP_POWER,    PAR8,PAR8,PAR8,PAR32,PAR32,PAR32,PAR8,          0                     ),
   OC(   opOUTPUT_TIME_POWER,    PAR8,PAR8,PAR8,PAR32,PAR32,PAR32,PAR8,          0                     ),
@@ -333,6 +334,9 @@ static OPCODE OpCodes[256] =
   OC(   opOUTPUT_CLR_COUNT,     PAR8,PAR8,                                      0,0,0,0,0,0           ),
   OC(   opOUTPUT_GET_COUNT,     PAR8,PAR8,PAR32,                                0,0,0,0,0             ),
   OC(   opOUTPUT_PRG_STOP,      0,                                              0,0,0,0,0,0,0         ),
+  OC(   opOUTPUT_HOLD,          PAR8,PAR8,PAR16,PAR16,PAR16,PAR8,PAR8,          0                     ),
+  OC(   opOUTPUT_STALL,         PAR8,PAR8,PAR8,PAR8,PAR16,PAR8,                 0,0                   ),
+  OC(   opOUTPUT_STALL_READY,   PAR8,PAR8,PAR8,                                 0,0,0,0,0             ),
   //    Memory
   OC(   opFILE,                 PAR8,SUBP,FILE_SUBP,                            0,0,0,0,0             ),
   OC(   opARRAY,                PAR8,SUBP,ARRAY_SUBP,                           0,0,0,0,0             ),
@@ -413,6 +417,9 @@ static  SUBCODE SubCodes[SUBPS][MAX_SUBCODES] =
   SC(   PROGRAM_SUBP,           GET_PRGRESULT,          PAR16,PAR8,                                     0,0,0,0,0,0           ),
   SC(   PROGRAM_SUBP,           SET_INSTR,              PAR16,                                          0,0,0,0,0,0,0         ),
   SC(   PROGRAM_SUBP,           GET_PRGNAME,            PAR16,PAR8,                                     0,0,0,0,0,0           ),
+  SC(   PROGRAM_SUBP,           SET_BP_COND,            PAR16,PAR32,PAR8,PAR32,PAR32,                   0,0,0                 ),
+  SC(   PROGRAM_SUBP,           GET_BP_HITS,            PAR16,PAR32,PAR32,                              0,0,0,0,0             ),
+  SC(   PROGRAM_SUBP,           CLR_BP,                 PAR16,PAR32,                                    0,0,0,0,0,0           ),
   //    Memory
   SC(   FILE_SUBP,              OPEN_APPEND,            PAR8,PAR16,                                     0,0,0,0,0,0           ),
   SC(   FILE_SUBP,              OPEN_READ,              PAR8,PAR16,PAR32,                               0,0,0,0,0             ),
@@ -623,6 +630,7 @@ static  SUBCODE SubCodes[SUBPS][MAX_SUBCODES] =
   SC(   INPUT_SUBP,             SET_TYPEMODE,           PAR8,PAR8,PAR8,PAR8,PAR8,                       0,0,0                 ),
   SC(   INPUT_SUBP,             GET_TYPEMODE,           PAR8,PAR8,PAR8,PAR8,                            0,0,0,0               ),
   SC(   INPUT_SUBP,             GET_CONNECTION,         PAR8,PAR8,PAR8,                                 0,0,0,0,0             ),
+  SC(   INPUT_SUBP,             WAIT_CONNECTION,        PAR8,PAR8,PAR8,PAR8,                            0,0,0,0               ),
   SC(   INPUT_SUBP,             GET_NAME,               PAR8,PAR8,PAR8,PAR8,                            0,0,0,0               ),
   SC(   INPUT_SUBP,             GET_SYMBOL,             PAR8,PAR8,PAR8,PAR8,                            0,0,0,0               ),
   SC(   INPUT_SUBP,             GET_FORMAT,             PAR8,PAR8,PAR8,PAR8,PAR8,PAR8,                  0,0                   ),
@@ -687,6 +695,7 @@ static  SUBCODE SubCodes[SUBPS][MAX_SUBCODES] =
   SC(   COM_GET_SUBP,           CONNEC_ITEM,            PAR8,PAR8,PAR8,PAR8,PAR8,                       0,0,0                 ),
   SC(   COM_GET_SUBP,           GET_INCOMING,           PAR8,PAR8,PAR8,PAR8,                            0,0,0,0               ),
   SC(   COM_GET_SUBP,           GET_MODE2,              PAR8,PAR8,                                      0,0,0,0,0,0           ),
+  SC(   COM_GET_SUBP,           GET_BROADCAST,          PAR8,PAR8,PAR8,PAR8,                            0,0,0,0               ),
 
   //    ComSet
   SC(   COM_SET_SUBP,           SET_ON_OFF,             PAR8,PAR8,                                      0,0,0,0,0,0           ),
@@ -427,6 +427,9 @@ typedef   enum
   opOUTPUT_GET_COUNT          = 0xB3, //     10011
 
   opOUTPUT_PRG_STOP           = 0xB4, //     10100
+  opOUTPUT_HOLD               = 0xB5, //     10101
+  opOUTPUT_STALL              = 0xB6, //     10110
+  opOUTPUT_STALL_READY        = 0xB7, //     10111
 
 //  \endverbatim \ref cMemory "MEMORY" \verbatim
 //                                        11000...
@@ -676,6 +679,7 @@ typedef   enum
   CONNEC_ITEM   = 18,
   GET_INCOMING  = 19,
   GET_MODE2     = 20,
+  GET_BROADCAST = 21,                   //!<      Get
 
   COM_GET_SUBCODES
 }
@@ -745,6 +749,7 @@ typedef   enum
   READY_SI        = 29,
   GET_MINMAX      = 30,
   GET_BUMPS       = 31,
+  WAIT_CONNECTION = 32,
 
   INPUT_DEVICESUBCODES
 }
@@ -768,6 +773,9 @@ typedef   enum
   GET_PRGRESULT = 24,   // VM
   SET_INSTR     = 25,   // VM
   GET_PRGNAME   = 26,   // VM
+  SET_BP_COND   = 27,   // VM
+  GET_BP_HITS   = 28,   // VM
+  CLR_BP        = 29,   // VM
 
   PROGRAM_INFO_SUBCODES,
 }
@@ -776,6 +784,26 @@ PROGRAM_INFO_SUBCODE;
 //! \endverbatim
 
 
+/*! \page bpcondition Breakpoint Conditions
+
+    \verbatim */
+
+typedef   enum
+{
+  BP_ALWAYS                     = 0,    //!< Stop every time the breakpoint is passed
+  BP_EQUAL                      = 1,    //!< Stop if DATA32 global at OFFSET == VALUE
+  BP_NOT_EQUAL                  = 2,    //!< Stop if DATA32 global at OFFSET != VALUE
+  BP_LESS                       = 3,    //!< Stop if DATA32 global at OFFSET <  VALUE
+  BP_GREATER                    = 4,    //!< Stop if DATA32 global at OFFSET >  VALUE
+  BP_HIT_COUNT                  = 5,    //!< Stop every VALUE times the breakpoint is passed
+
+  BP_CONDITIONS
+}
+BP_CONDITION;
+
+/*  \endverbatim */
+
+
 //! \page uidrawsubcode Specific command parameter
 //!
 //!
@@ -1600,6 +1628,23 @@ WARNING;
 /*  \endverbatim */
 
 
+/*! \page stallactions Stall Actions
+
+    \verbatim */
+
+typedef   enum
+{
+  STALL_FLAG        = 0,                //!< Only set the stall flag - motor keeps running
+  STALL_COAST       = 1,                //!< Set the stall flag and coast the motor
+  STALL_BRAKE       = 2,                //!< Set the stall flag and brake the motor
+
+  STALL_ACTIONS
+}
+STALL_ACTION;
+
+/*  \endverbatim */
+
+
 #define   DATA8_NAN     ((DATA8)(-128))
 #define   DATA16_NAN    ((DATA16)(-32768))
 #define   DATA32_NAN    ((DATA32)(0x80000000))
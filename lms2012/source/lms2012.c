@@ -170,6 +170,8 @@ void      Do(void);
 void      Probe(void);
 void      BreakPoint(void);
 void      BreakSet(void);
+BRKP      *BreakFind(PRGID PrgId,IMINDEX Addr);
+void      BreakRemove(PRGID PrgId,BRKP *pBrkp);
 void      Random(void);
 void      Info(void);
 void      Strings(void);
@@ -281,6 +283,472 @@ void      SetInstructions(ULONG Instructions)
 }
 
 
+#ifndef DISABLE_IDLE_LOOP_PARKING
+
+/*! \page idleloop Idle Loop Parking
+ *
+ *  Programs often end in "Loop: JR(Loop)" or poll a sensor, button, timer or mailbox in a tight
+ *  compare and branch loop. Such a loop only burns CPU until an external event changes one of
+ *  its inputs.
+ *
+ *  When a branch jumps backwards the loop body from the branch target up to and including the
+ *  branch is analysed once (result cached by address). The loop is "idle" if
+ *
+ *-   the body is straight line code only using: moves, compares, basic arithmetic, conditional
+ *    branches leaving the loop, opTIMER_READ, opINPUT_READ, opINPUT_READSI, opUI_BUTTON PRESSED
+ *    and opMAILBOX_TEST
+ *-   no variable read in the body is written at the same or a later instruction (no loop carried state)
+ *
+ *  The object taking an idle back-edge is parked by ending its time slice (SLEEPBREAK).
+ *  When all objects in all running programs have been parked or waiting (BUSYBREAK) for a full
+ *  round the VM thread sleeps until next housekeeping update (max UPDATE_TIME1) where inputs,
+ *  timers, buttons and mailboxes can change.
+ *
+ *  opTIMER_READ_US is deliberately not accepted (uS busy waits must not be delayed).
+ *
+ *  Counters: PRG.IdleParks, VMInstance.IdleYields, VMInstance.IdleTime [uS]
+ */
+
+
+/*! \brief    Decode one parameter in idle loop analysis (no side effects)
+ *
+ *  \param    ppI       Pointer to instruction pointer (advanced past parameter)
+ *  \param    pVar      Variable key (bit 31 set = global) or -1 if constant
+ *  \param    pTarget   Branch target if parameter is used as offset
+ *  \param    pValue    Constant value
+ *  \return   RESULT    OK or FAIL if parameter can not be analysed (handles, addresses)
+ */
+RESULT    IdleLoopParameter(IP *ppI,DATA32 *pVar,IP *pTarget,DATA32 *pValue)
+{
+  RESULT  Result = OK;
+  IP      pI;
+  IMGDATA Data;
+  ULONG   Value  = 0;
+  UBYTE   Bytes  = 0;
+  UBYTE   Byte;
+  DATA8   Label  = 0;
+
+  pI        =  *ppI;
+  Data      =  *pI++;
+  *pVar     =  -1;
+
+  if (Data & PRIMPAR_LONG)
+  { // long format
+
+    if (!(Data & PRIMPAR_VARIABEL) && (Data & PRIMPAR_LABEL))
+    { // label (one byte index)
+
+      Label  =  1;
+      Bytes  =  1;
+    }
+    else
+    {
+      switch (Data & PRIMPAR_BYTES)
+      {
+        case PRIMPAR_1_BYTE :
+        {
+          Bytes  =  1;
+        }
+        break;
+
+        case PRIMPAR_2_BYTES :
+        {
+          Bytes  =  2;
+        }
+        break;
+
+        case PRIMPAR_4_BYTES :
+        {
+          Bytes  =  4;
+        }
+        break;
+
+        default :
+        { // strings
+
+          Result  =  FAIL;
+        }
+        break;
+
+      }
+    }
+    if (Data & (PRIMPAR_HANDLE | PRIMPAR_ADDR))
+    {
+      Result  =  FAIL;
+    }
+    if (Result == OK)
+    {
+      for (Byte = 0;Byte < Bytes;Byte++)
+      {
+        Value |=  (ULONG)*pI++ << (8 * Byte);
+      }
+      if (Data & PRIMPAR_VARIABEL)
+      {
+        *pVar  =  (DATA32)Value;
+        if (Data & PRIMPAR_GLOBAL)
+        {
+          *pVar |=  (DATA32)0x80000000;
+        }
+      }
+      else
+      {
+        if ((Bytes == 1) && (Value & 0x00000080) && (!Label))
+        {
+          Value |=  0xFFFFFF00;
+        }
+        if ((Bytes == 2) && (Value & 0x00008000))
+        {
+          Value |=  0xFFFF0000;
+        }
+      }
+    }
+  }
+  else
+  { // short format
+
+    if (Data & PRIMPAR_VARIABEL)
+    {
+      *pVar  =  (DATA32)(Data & PRIMPAR_INDEX);
+      if (Data & PRIMPAR_GLOBAL)
+      {
+        *pVar |=  (DATA32)0x80000000;
+      }
+    }
+    else
+    {
+      Value  =  (ULONG)(Data & PRIMPAR_VALUE);
+      if (Data & PRIMPAR_CONST_SIGN)
+      {
+        Value |= ~(ULONG)(PRIMPAR_VALUE);
+      }
+    }
+  }
+
+  *pValue   =  (DATA32)Value;
+  if (Label)
+  {
+    *pTarget  =  NULL;
+    if ((Value > 0) && (Value < MAX_LABELS))
+    {
+      *pTarget  =  &VMInstance.pImage[VMInstance.Program[VMInstance.ProgramId].Label[Value].Addr];
+    }
+  }
+  else
+  {
+    *pTarget  =  pI + (DATA32)Value;
+  }
+  *ppI      =  pI;
+
+  return (Result);
+}
+
+
+/*! \brief    Get parameter layout of byte codes accepted in idle loops
+ *
+ *  \param    OpCode    Byte code
+ *  \param    pWrite    Index of parameter written (-1 = none)
+ *  \param    pBranch   Index of parameter holding branch offset (-1 = none)
+ *  \return   DATA8     Number of parameters or -1 if byte code is not accepted
+ */
+DATA8     IdleLoopOpcode(OP OpCode,DATA8 *pWrite,DATA8 *pBranch)
+{
+  DATA8   Pars = -1;
+
+  *pWrite   =  -1;
+  *pBranch  =  -1;
+
+  if ((OpCode >= opADD8) && (OpCode <= opDIVF))
+  { // ADD, SUB, MUL, DIV (A,B,RESULT)
+
+    Pars     =  3;
+    *pWrite  =  2;
+  }
+  else
+  {
+    if ((OpCode >= opMOVE8_8) && (OpCode <= opMOVEF_F))
+    { // MOVE (SOURCE,DESTINATION)
+
+      Pars     =  2;
+      *pWrite  =  1;
+    }
+    else
+    {
+      if ((OpCode >= opCP_LT8) && (OpCode <= opCP_GTEQF))
+      { // CP (LEFT,RIGHT,FLAG)
+
+        Pars     =  3;
+        *pWrite  =  2;
+      }
+      else
+      {
+        if ((OpCode >= opJR_LT8) && (OpCode <= opJR_GTEQF))
+        { // JR (LEFT,RIGHT,OFFSET)
+
+          Pars      =  3;
+          *pBranch  =  2;
+        }
+        else
+        {
+          switch (OpCode)
+          {
+            case opNOP :
+            {
+              Pars      =  0;
+            }
+            break;
+
+            case opOR8 :
+            case opOR16 :
+            case opOR32 :
+            case opAND8 :
+            case opAND16 :
+            case opAND32 :
+            case opXOR8 :
+            case opXOR16 :
+            case opXOR32 :
+            {
+              Pars      =  3;
+              *pWrite   =  2;
+            }
+            break;
+
+            case opJR :
+            {
+              Pars      =  1;
+              *pBranch  =  0;
+            }
+            break;
+
+            case opJR_FALSE :
+            case opJR_TRUE :
+            case opJR_NAN :
+            {
+              Pars      =  2;
+              *pBranch  =  1;
+            }
+            break;
+
+            case opTIMER_READ :
+            {
+              Pars      =  1;
+              *pWrite   =  0;
+            }
+            break;
+
+            case opINPUT_READ :
+            case opINPUT_READSI :
+            { // (LAYER,NO,TYPE,MODE,VALUE)
+
+              Pars      =  5;
+              *pWrite   =  4;
+            }
+            break;
+
+            case opUI_BUTTON :
+            { // (PRESSED,BUTTON,STATE) - sub code checked by caller
+
+              Pars      =  3;
+              *pWrite   =  2;
+            }
+            break;
+
+            case opMAILBOX_TEST :
+            { // (NO,BUSY)
+
+              Pars      =  2;
+              *pWrite   =  1;
+            }
+            break;
+
+            default :
+            {
+            }
+            break;
+
+          }
+        }
+      }
+    }
+  }
+
+  return (Pars);
+}
+
+
+/*! \brief    Check if two variable keys overlap (variables are max 4 bytes)
+ *
+ */
+DATA8     IdleLoopOverlap(DATA32 VarA,DATA32 VarB)
+{
+  DATA8   Result = 0;
+  DATA32  Diff;
+
+  if (((VarA ^ VarB) & (DATA32)0x80000000) == 0)
+  {
+    Diff  =  (VarA & 0x7FFFFFFF) - (VarB & 0x7FFFFFFF);
+    if ((Diff > -4) && (Diff < 4))
+    {
+      Result  =  1;
+    }
+  }
+
+  return (Result);
+}
+
+
+/*! \brief    Analyse loop body from back-edge target to end of back-edge branch
+ *
+ *  \param    pHead     Loop start (branch target)
+ *  \param    pEnd      Instruction following the back-edge branch
+ *  \return   DATA8     1 if loop is idle (see \ref idleloop)
+ */
+DATA8     IdleLoopAnalyse(IP pHead,IP pEnd)
+{
+  DATA8   Result = 1;
+  IP      pI;
+  IP      pTarget;
+  OP      OpCode;
+  DATA8   Pars;
+  DATA8   Par;
+  DATA8   Write;
+  DATA8   Branch;
+  DATA32  Var;
+  DATA32  Value;
+  UBYTE   Instr  = 0;
+  UBYTE   Reads  = 0;
+  UBYTE   Writes = 0;
+  UBYTE   ReadNo;
+  UBYTE   WriteNo;
+  DATA32  ReadVar[IDLE_LOOP_VARS];
+  UBYTE   ReadInstr[IDLE_LOOP_VARS];
+  DATA32  WriteVar[IDLE_LOOP_VARS];
+  UBYTE   WriteInstr[IDLE_LOOP_VARS];
+
+  if ((pEnd - pHead) > IDLE_LOOP_BODY)
+  {
+    Result  =  0;
+  }
+  pI  =  pHead;
+  while ((Result) && (pI < pEnd))
+  {
+    OpCode  =  *pI++;
+    Pars    =  IdleLoopOpcode(OpCode,&Write,&Branch);
+    if (Pars < 0)
+    {
+      Result  =  0;
+    }
+    for (Par = 0;(Result) && (Par < Pars);Par++)
+    {
+      if (IdleLoopParameter(&pI,&Var,&pTarget,&Value) != OK)
+      {
+        Result  =  0;
+      }
+      else
+      {
+        if ((OpCode == opUI_BUTTON) && (Par == 0) && ((Var >= 0) || (Value != PRESSED)))
+        { // Only sub code PRESSED is side effect free
+
+          Result  =  0;
+        }
+        if (Par == Branch)
+        { // Branches must leave the loop or restart it
+
+          if ((Var >= 0) || (pTarget == NULL) || ((pTarget > pHead) && (pTarget < pEnd)))
+          {
+            Result  =  0;
+          }
+        }
+        else
+        {
+          if (Var >= 0)
+          {
+            if (Par == Write)
+            {
+              if (Writes < IDLE_LOOP_VARS)
+              {
+                WriteVar[Writes]    =  Var;
+                WriteInstr[Writes]  =  Instr;
+                Writes++;
+              }
+              else
+              {
+                Result  =  0;
+              }
+            }
+            else
+            {
+              if (Reads < IDLE_LOOP_VARS)
+              {
+                ReadVar[Reads]      =  Var;
+                ReadInstr[Reads]    =  Instr;
+                Reads++;
+              }
+              else
+              {
+                Result  =  0;
+              }
+            }
+          }
+        }
+      }
+    }
+    Instr++;
+  }
+  if (pI != pEnd)
+  {
+    Result  =  0;
+  }
+
+  // Reject loop carried state: variable read before (or when) it is written
+
+  for (ReadNo = 0;(Result) && (ReadNo < Reads);ReadNo++)
+  {
+    for (WriteNo = 0;(Result) && (WriteNo < Writes);WriteNo++)
+    {
+      if ((WriteInstr[WriteNo] >= ReadInstr[ReadNo]) && (IdleLoopOverlap(ReadVar[ReadNo],WriteVar[WriteNo])))
+      {
+        Result  =  0;
+      }
+    }
+  }
+#ifdef DEBUG_TRACE_IDLE
+  printf("IDLE LOOP P=%-1d %5d..%-5d %s\r\n",VMInstance.ProgramId,(int)(pHead - VMInstance.pImage),(int)(pEnd - VMInstance.pImage),Result ? "PARK" : "BUSY");
+#endif
+
+  return (Result);
+}
+
+
+/*! \brief    Handle back-edge branch (called before IP is adjusted)
+ *
+ *            Parks running object by ending its time slice if the loop is idle
+ *
+ *  \param    Value Negative branch offset
+ */
+void      IdleLoopBackEdge(IMOFFS Value)
+{
+  IDLELOOP *pEntry;
+  IP      pEnd;
+
+  pEnd    =  VMInstance.ObjectIp;
+  pEntry  =  &VMInstance.IdleLoop[((ULONG)pEnd ^ ((ULONG)pEnd >> 5)) & (IDLE_LOOP_CACHE - 1)];
+
+  if ((*pEntry).pEnd != pEnd)
+  {
+    (*pEntry).Idle  =  IdleLoopAnalyse(pEnd + Value,pEnd);
+    (*pEntry).pEnd  =  pEnd;
+  }
+  if ((*pEntry).Idle)
+  {
+    VMInstance.Program[VMInstance.ProgramId].IdleParks++;
+    VMInstance.IdleParked  =  1;
+    SetDispatchStatus(SLEEPBREAK);
+  }
+}
+
+#endif
+
+
 /*! \brief    Adjust current instruction pointer
  *
  *  \param    Value Signed offset to add
@@ -288,6 +756,13 @@ void      SetInstructions(ULONG Instructions)
  */
 void      AdjustObjectIp(IMOFFS Value)
 {
+#ifndef DISABLE_IDLE_LOOP_PARKING
+  if ((Value < 0) && (!VMInstance.Debug))
+  { // Back-edge
+
+    IdleLoopBackEdge(Value);
+  }
+#endif
   VMInstance.ObjectIp += Value;
 }
 
@@ -818,7 +1293,8 @@ void*     PrimParPointer(void)
     }
     if (Data & PRIMPAR_HANDLE)
     {
-      VMInstance.Handle  =  *(HANDLER*)Result;
+      VMInstance.Handle        =  *(HANDLER*)Result;
+      VMInstance.HandleLength  =  cMemoryGetStringLength(VMInstance.ProgramId,VMInstance.Handle);
       cMemoryArraryPointer(VMInstance.ProgramId,VMInstance.Handle,&Result);
     }
     else
@@ -1312,6 +1788,51 @@ void      CopyLocalsToPars(OBJID Id)
 // VM routines
 //*****************************************************************************
 
+#ifndef DISABLE_LAZY_VALIDATION
+/*! \brief    Validate object byte codes before object is scheduled the first time
+ *
+ *            Programs validated lazily only have headers and first object checked at start.
+ *            On failure the program is stopped (FAILBREAK) before any byte code in the object runs
+ *
+ *  \param    ObjId   Object to validate
+ *  \return   RESULT  OK or FAIL
+ */
+RESULT    ObjectValidate(OBJID ObjId)
+{
+  RESULT  Result = OK;
+  PRG     *pProgram;
+
+  pProgram  =  &VMInstance.Program[VMInstance.ProgramId];
+
+  if (!(*pProgram).Validated)
+  {
+    if ((ObjId == 0) || (ObjId > VMInstance.Objects))
+    {
+      Result  =  FAIL;
+    }
+    else
+    {
+      if (!(*pProgram).pObjValid[ObjId])
+      {
+        Result  =  cValidateObject(VMInstance.pImage,ObjId,(*pProgram).Label);
+        if (Result == OK)
+        {
+          (*pProgram).pObjValid[ObjId]  =  1;
+        }
+      }
+    }
+    if (Result != OK)
+    {
+      LogErrorNumber(VM_PROGRAM_VALIDATION);
+      SetDispatchStatus(FAILBREAK);
+    }
+  }
+
+  return (Result);
+}
+#endif
+
+
 /*! \brief    Initialise object instruction pointer and trigger counter
  *
  *  \param    ObjId Object to reset
@@ -1367,6 +1888,11 @@ GBINDEX   GetAmountOfRamForImage(IP pI)
     Bytes    =  (Bytes + 3)  & 0xFFFFFFFC;
     Bytes   +=  sizeof(OBJ) + pHead[ObjId].LocalBytes;
   }
+#ifndef DISABLE_LAZY_VALIDATION
+
+  // Object validated flags
+  Bytes     +=  NoOfObj + 1;
+#endif
 
   return (Bytes);
 }
@@ -1403,6 +1929,229 @@ UWORD     GetChecksum(IP pI)
 #endif
 
 
+#ifndef DISABLE_PROGRAM_PRELOAD
+/*! \brief    Release program in standby (if not handed over)
+ *
+ *            A claimed image belongs to the user slot pool but its ram is
+ *            still ours until "ProgramStandbyTake".
+ *
+ */
+void      ProgramStandbyFree(void)
+{
+  if (VMInstance.Standby.State == STANDBY_LOADED)
+  {
+    cMemoryFree(VMInstance.Standby.pImage);
+  }
+  if (VMInstance.Standby.State == STANDBY_READY)
+  {
+    cMemoryFree(VMInstance.Standby.pImage);
+    cMemoryFree(VMInstance.Standby.pData);
+  }
+  if (VMInstance.Standby.State == STANDBY_CLAIMED)
+  {
+    cMemoryFree(VMInstance.Standby.pData);
+  }
+  VMInstance.Standby.pImage     =  NULL;
+  VMInstance.Standby.pData      =  NULL;
+  VMInstance.Standby.State      =  STANDBY_EMPTY;
+}
+
+
+/*! \brief    Set program to keep ready in standby
+ *
+ *            Called with the last program loaded into the user slot and
+ *            from the system command PRELOAD_PROGRAM. The actual load is done
+ *            by "ProgramStandbyUpdate" when the user slot is idle.
+ *
+ *  \param    pFileName Full path of image file
+ *
+ */
+void      ProgramPreload(char *pFileName)
+{
+  if (strcmp(VMInstance.Standby.Filename,pFileName) != 0)
+  {
+    if (VMInstance.Standby.State != STANDBY_CLAIMED)
+    {
+      ProgramStandbyFree();
+    }
+    snprintf(VMInstance.Standby.Filename,vmFILENAMESIZE,"%s",pFileName);
+  }
+  if (VMInstance.Standby.State == STANDBY_FAILED)
+  {
+    VMInstance.Standby.State    =  STANDBY_EMPTY;
+  }
+}
+
+
+/*! \brief    Load, validate and allocate program in standby if user slot is idle
+ *
+ *            Done in two idle updates - file read in the first, validation
+ *            and ram allocation in the next - so one loop pass does not hold
+ *            the ui and input updates back for all of it.
+ *
+ */
+void      ProgramStandbyUpdate(void)
+{
+  void    *pImage;
+  void    *pData;
+  DATA32  Size;
+  DATA32  ModTime;
+  GBINDEX RamSize;
+#ifdef DEBUG_TRACE_PRELOAD
+  ULONG   Time;
+#endif
+
+  if ((VMInstance.Program[USER_SLOT].Status == STOPPED) && (VMInstance.Program[DEBUG_SLOT].Status == STOPPED))
+  {
+    if ((VMInstance.Standby.State == STANDBY_EMPTY) && (VMInstance.Standby.Filename[0]))
+    {
+#ifdef DEBUG_TRACE_PRELOAD
+      Time                        =  cTimerGetuS();
+#endif
+      VMInstance.Standby.State    =  STANDBY_FAILED;
+
+      if (cMemoryLoadImage(VMInstance.Standby.Filename,&pImage,&Size,&ModTime) == OK)
+      {
+        if (Size >= sizeof(IMGHEAD))
+        {
+          VMInstance.Standby.pImage     =  (IP)pImage;
+          VMInstance.Standby.ImageSize  =  Size;
+          VMInstance.Standby.ModTime    =  ModTime;
+          VMInstance.Standby.State      =  STANDBY_LOADED;
+        }
+        else
+        {
+          cMemoryFree(pImage);
+        }
+      }
+#ifdef DEBUG_TRACE_PRELOAD
+      printf("Standby %s %s in %lu uS\r\n",VMInstance.Standby.Filename,(VMInstance.Standby.State == STANDBY_LOADED) ? "loaded" : "failed",(unsigned long)(cTimerGetuS() - Time));
+#endif
+    }
+    else
+    {
+      if (VMInstance.Standby.State == STANDBY_LOADED)
+      {
+#ifdef DEBUG_TRACE_PRELOAD
+        Time                        =  cTimerGetuS();
+#endif
+        pImage                      =  VMInstance.Standby.pImage;
+        VMInstance.Standby.pImage   =  NULL;
+        VMInstance.Standby.State    =  STANDBY_FAILED;
+
+        if (cValidateProgram(USER_SLOT,(IP)pImage,VMInstance.Standby.Label,0) == OK)
+        {
+          RamSize  =  GetAmountOfRamForImage((IP)pImage);
+
+          if (cMemoryRealloc(NULL,&pData,(DATA32)RamSize) == OK)
+          {
+            memset(pData,0,(size_t)RamSize);
+
+            VMInstance.Standby.pImage     =  (IP)pImage;
+            VMInstance.Standby.pData      =  (VARDATA*)pData;
+            VMInstance.Standby.RamSize    =  RamSize;
+            VMInstance.Standby.State      =  STANDBY_READY;
+          }
+        }
+        if (VMInstance.Standby.State != STANDBY_READY)
+        {
+          cMemoryFree(pImage);
+        }
+#ifdef DEBUG_TRACE_PRELOAD
+        printf("Standby %s %s in %lu uS\r\n",VMInstance.Standby.Filename,(VMInstance.Standby.State == STANDBY_READY) ? "ready" : "failed",(unsigned long)(cTimerGetuS() - Time));
+#endif
+      }
+    }
+  }
+}
+
+
+/*! \brief    Hand over image from standby instead of loading it from file
+ *
+ *            Image is only used if file name, size and modification time match.
+ *            Ram is handed over later by "ProgramStandbyTake" at program start.
+ *
+ *  \param    PrgId     Program id (only USER_SLOT is supported)
+ *  \param    pFileName Full path of image file
+ *  \param    ppImage   Returns pointer to image (owned by program pool)
+ *  \param    pSize     Returns image size
+ *
+ *  \return   RESULT    OK if handed over
+ */
+RESULT    ProgramStandbyClaim(PRGID PrgId,char *pFileName,IP *ppImage,DATA32 *pSize)
+{
+  RESULT  Result = FAIL;
+  HANDLER TmpHandle;
+  struct  stat FileStatus;
+
+  if (VMInstance.Standby.State == STANDBY_CLAIMED)
+  { // Previous claim was never started (image belongs to the user slot pool)
+
+    ProgramStandbyFree();
+  }
+  if ((VMInstance.Standby.State == STANDBY_READY) && (PrgId == USER_SLOT) && (!VMInstance.TerminalEnabled))
+  {
+    if (strcmp(VMInstance.Standby.Filename,pFileName) == 0)
+    {
+      if ((stat(pFileName,&FileStatus) == 0) && ((DATA32)FileStatus.st_size == VMInstance.Standby.ImageSize) && ((DATA32)FileStatus.st_mtime == VMInstance.Standby.ModTime))
+      {
+        if (cMemoryAdopt(PrgId,VMInstance.Standby.pImage,(GBINDEX)VMInstance.Standby.ImageSize,&TmpHandle) == OK)
+        {
+          VMInstance.Standby.State  =  STANDBY_CLAIMED;
+          *ppImage                  =  VMInstance.Standby.pImage;
+          *pSize                    =  VMInstance.Standby.ImageSize;
+          Result                    =  OK;
+        }
+      }
+      else
+      { // File changed since preload
+
+        ProgramStandbyFree();
+      }
+    }
+  }
+
+  return (Result);
+}
+
+
+/*! \brief    Take over ram and labels for claimed image at program start
+ *
+ *  \param    PrgId     Program id
+ *  \param    pI        Pointer to image being started
+ *  \param    ppData    Returns cleared ram for globals and objects
+ *  \param    pRamSize  Returns size of ram
+ *
+ *  \return   DATA8     1 if program was preloaded (no validation or clearing needed)
+ */
+DATA8     ProgramStandbyTake(PRGID PrgId,IP pI,VARDATA **ppData,GBINDEX *pRamSize)
+{
+  DATA8   Result = 0;
+  HANDLER TmpHandle;
+
+  if ((VMInstance.Standby.State == STANDBY_CLAIMED) && (PrgId == USER_SLOT) && (pI == VMInstance.Standby.pImage))
+  {
+    if (cMemoryAdopt(PrgId,VMInstance.Standby.pData,VMInstance.Standby.RamSize,&TmpHandle) == OK)
+    {
+      memcpy(VMInstance.Program[PrgId].Label,VMInstance.Standby.Label,sizeof(VMInstance.Program[PrgId].Label));
+      *ppData     =  VMInstance.Standby.pData;
+      *pRamSize   =  VMInstance.Standby.RamSize;
+      Result      =  1;
+    }
+    else
+    {
+      cMemoryFree(VMInstance.Standby.pData);
+    }
+    VMInstance.Standby.pImage   =  NULL;
+    VMInstance.Standby.pData    =  NULL;
+    VMInstance.Standby.State    =  STANDBY_EMPTY;
+  }
+
+  return (Result);
+}
+#endif
+
+
 /*! \brief    Initialise program for execution
  *
  *  \param    PrgId Program id (index)
@@ -1420,24 +2169,43 @@ RESULT    ProgramReset(PRGID PrgId,IP pI,GP pG,UBYTE Deb)
   GBINDEX RamSize;
   VARDATA *pData;
   OBJID   ObjIndex;
-  DATA8   No;
   DATA8   Disassemble;
+  DATA8   Preloaded = 0;
+  DATA8   Lazy = 0;
+  RESULT  Valid = OK;
+  ULONG   StartTime;
 #ifdef DISABLE_UPDATE_DISASSEMBLY
   UWORD   Chks;
 #endif
 
+  StartTime                                 =  cTimerGetuS();
   VMInstance.Program[PrgId].Status          =  STOPPED;
+#ifndef DISABLE_IDLE_LOOP_PARKING
+  VMInstance.Program[PrgId].IdleParks       =  0;
+
+  // Image memory may be reused - forget analysed back-edges
+  memset(VMInstance.IdleLoop,0,sizeof(VMInstance.IdleLoop));
+#endif
   VMInstance.Program[PrgId].StatusChange    =  STOPPED;
   VMInstance.Program[PrgId].Result          =  FAIL;
 
   if (pI != NULL)
   {
 
+#ifndef DISABLE_PROGRAM_PRELOAD
+    // Take over validated image and cleared memory from standby if possible
+
+    Preloaded     =  ProgramStandbyTake(PrgId,pI,&pData,&RamSize);
+#endif
+
     // Allocate memory for globals and objects
 
-    RamSize       =  GetAmountOfRamForImage(pI);
+    if (!Preloaded)
+    {
+      RamSize     =  GetAmountOfRamForImage(pI);
+    }
 
-    if (cMemoryOpen(PrgId,RamSize,(void**)&pData) == OK)
+    if ((Preloaded) || (cMemoryOpen(PrgId,RamSize,(void**)&pData) == OK))
     { // Memory reserved
 
       // Save start of image
@@ -1469,7 +2237,22 @@ RESULT    ProgramReset(PRGID PrgId,IP pI,GP pG,UBYTE Deb)
       }
 #endif
 
-      if (cValidateProgram(PrgId,pI,VMInstance.Program[PrgId].Label,Disassemble) != OK)
+      if (!Preloaded)
+      {
+#ifndef DISABLE_LAZY_VALIDATION
+        if ((PrgId == USER_SLOT) && (Deb == 0) && (!Disassemble) && (cValidateImage(pI) == OK) && (cValidateObject(pI,1,VMInstance.Program[PrgId].Label) == OK))
+        { // Headers and first object valid - remaining objects are validated when first scheduled
+
+          Lazy  =  1;
+        }
+        else
+#endif
+        {
+          Valid  =  cValidateProgram(PrgId,pI,VMInstance.Program[PrgId].Label,Disassemble);
+        }
+      }
+
+      if (Valid != OK)
       {
         if (PrgId != CMD_SLOT)
         {
@@ -1479,18 +2262,18 @@ RESULT    ProgramReset(PRGID PrgId,IP pI,GP pG,UBYTE Deb)
       else
       {
 
-        // Clear memory
+        // Clear memory (already done if preloaded)
 
-        for (Index = 0;Index < RamSize;Index++)
+        if (!Preloaded)
         {
-          pData[Index]  =  0;
+          for (Index = 0;Index < RamSize;Index++)
+          {
+            pData[Index]  =  0;
+          }
         }
 
-        for (No = 0;No < MAX_BREAKPOINTS;No++)
-        {
-          VMInstance.Program[PrgId].Brkp[No].Addr    =  0;
-          VMInstance.Program[PrgId].Brkp[No].OpCode  =  0;
-        }
+        memset(VMInstance.Program[PrgId].Brkp,0,sizeof(VMInstance.Program[PrgId].Brkp));
+        VMInstance.Program[PrgId].Brkps        =  0;
 
         // Get VMInstance.Objects
 
@@ -1569,6 +2352,18 @@ RESULT    ProgramReset(PRGID PrgId,IP pI,GP pG,UBYTE Deb)
           pData                =  &pData[sizeof(OBJ) + VMInstance.Program[PrgId].pObjHead[ObjIndex].LocalBytes];
         }
 
+#ifndef DISABLE_LAZY_VALIDATION
+        // Object validated flags (memory is cleared)
+
+        VMInstance.Program[PrgId].pObjValid       =  (UBYTE*)pData;
+        VMInstance.Program[PrgId].Validated       =  1;
+        if (Lazy)
+        {
+          VMInstance.Program[PrgId].Validated     =  0;
+          VMInstance.Program[PrgId].pObjValid[1]  =  1;
+        }
+#endif
+
         VMInstance.Program[PrgId].ObjectId        =  1;
         VMInstance.Program[PrgId].Status          =  RUNNING;
         VMInstance.Program[PrgId].StatusChange    =  RUNNING;
@@ -1594,6 +2389,10 @@ RESULT    ProgramReset(PRGID PrgId,IP pI,GP pG,UBYTE Deb)
         VMInstance.Program[PrgId].InstrCnt        =  0;
         VMInstance.Program[PrgId].StartTime       =  GetTimeMS();
         VMInstance.Program[PrgId].RunTime         =  cTimerGetuS();
+        VMInstance.Program[PrgId].ResetTime       =  VMInstance.Program[PrgId].RunTime - StartTime;
+#ifdef DEBUG_TRACE_PRELOAD
+        printf("Program %d load %lu uS reset %lu uS (%s)\r\n",PrgId,(unsigned long)VMInstance.Program[PrgId].LoadTime,(unsigned long)VMInstance.Program[PrgId].ResetTime,(Preloaded) ? "standby" : "cold");
+#endif
       }
     }
   }
@@ -1614,6 +2413,9 @@ void      ProgramEnd(PRGID PrgId)
   {
 
     VMInstance.Program[PrgId].InstrTime       =  cTimerGetuS() - VMInstance.Program[PrgId].RunTime;
+#ifdef DEBUG_TRACE_IDLE
+    printf("PROGRAM %d END: parked %lu times, VM slept %lu times %lu uS\r\n",PrgId,(unsigned long)VMInstance.Program[PrgId].IdleParks,(unsigned long)VMInstance.IdleYields,(unsigned long)VMInstance.IdleTime);
+#endif
 
     VMInstance.Program[PrgId].Objects         =  0;
     VMInstance.Program[PrgId].Status          = STOPPED;
@@ -1884,7 +2686,11 @@ RESULT    ObjectExec(void)
  */
 void      ObjectEnQueue(OBJID Id)
 {
+#ifndef DISABLE_LAZY_VALIDATION
+  if ((Id > 0) && (Id <= VMInstance.Objects) && (ObjectValidate(Id) == OK))
+#else
   if ((Id > 0) && (Id <= VMInstance.Objects))
+#endif
   {
     (*VMInstance.pObjList[Id]).ObjStatus        =  RUNNING;
     (*VMInstance.pObjList[Id]).Ip               = &VMInstance.pImage[(ULONG)VMInstance.pObjHead[Id].OffsetToInstructions];
@@ -2336,27 +3142,76 @@ RESULT    mSchedInit(int argc,char *argv[])
   pImgHead                =  (IMGHEAD*)UiImage;
   (*pImgHead).ImageSize   =  sizeof(UiImage);
 
-#if (HARDWARE != SIMULATION)
-  openlog(PROJECT,LOG_NDELAY,LOG_USER);
-  syslog(LOG_INFO,"VM Started");
+#if (HARDWARE != SIMULATION)
+  openlog(PROJECT,LOG_NDELAY,LOG_USER);
+  syslog(LOG_INFO,"VM Started");
+
+  if (argc >= 2)
+  {
+    snprintf((char*)VMInstance.FirstProgram,MAX_FILENAME_SIZE,"%s",argv[1]);
+  }
+  else
+  {
+    snprintf((char*)VMInstance.FirstProgram,MAX_FILENAME_SIZE,DEFAULT_UI);
+  }
+
+#else
+  //TBD
+#endif
+
+  ProgramReset(VMInstance.ProgramId,UiImage,(GP)VMInstance.FirstProgram,0);
+
+  return (RESULT)(Result);
+}
+
+
+#ifndef DISABLE_IDLE_LOOP_PARKING
+/*! \brief    Give time back to the system when all objects are parked (see \ref idleloop)
+ *
+ *            Called after every time slice - sleeps until next UPDATE_TIME1 housekeeping if
+ *            every object in every running program has been parked or waiting for a full round
+ *
+ */
+void      IdleLoopYield(void)
+{
+  ULONG   Objects = 0;
+  ULONG   Time;
+  ULONG   Start;
+  PRGID   PrgId;
+
+  if ((VMInstance.IdleParked) || ((VMInstance.IdleSlices) && (VMInstance.DispatchStatus == BUSYBREAK)))
+  { // Slice ended parked or waiting (a round must start with a parked object)
+
+    VMInstance.IdleSlices++;
 
-  if (argc >= 2)
-  {
-    snprintf((char*)VMInstance.FirstProgram,MAX_FILENAME_SIZE,"%s",argv[1]);
+    for (PrgId = 0;PrgId < MAX_PROGRAMS;PrgId++)
+    {
+      if (VMInstance.Program[PrgId].Status != STOPPED)
+      {
+        Objects +=  (ULONG)VMInstance.Program[PrgId].Objects;
+      }
+    }
+    if (VMInstance.IdleSlices > Objects)
+    { // Full round without work
+
+      Time  =  GetTimeMS() - VMInstance.OldTime1;
+      if (Time < UPDATE_TIME1)
+      {
+        Start  =  cTimerGetuS();
+        usleep((UPDATE_TIME1 - Time) * 1000);
+        VMInstance.IdleTime +=  cTimerGetuS() - Start;
+        VMInstance.IdleYields++;
+      }
+      VMInstance.IdleSlices  =  0;
+    }
   }
   else
   {
-    snprintf((char*)VMInstance.FirstProgram,MAX_FILENAME_SIZE,DEFAULT_UI);
+    VMInstance.IdleSlices  =  0;
   }
-
-#else
-  //TBD
-#endif
-
-  ProgramReset(VMInstance.ProgramId,UiImage,(GP)VMInstance.FirstProgram,0);
-
-  return (RESULT)(Result);
+  VMInstance.IdleParked  =  0;
 }
+#endif
 
 
 RESULT    mSchedCtrl(UBYTE *pRestart)
@@ -2492,6 +3347,9 @@ RESULT    mSchedCtrl(UBYTE *pRestart)
     usleep(10);
     cInputUpdate((UWORD)Time);
     cUiUpdate((UWORD)Time);
+#ifndef DISABLE_PROGRAM_PRELOAD
+    ProgramStandbyUpdate();
+#endif
 
     if (VMInstance.Test)
     {
@@ -2506,6 +3364,10 @@ RESULT    mSchedCtrl(UBYTE *pRestart)
     }
   }
 
+#ifndef DISABLE_IDLE_LOOP_PARKING
+  IdleLoopYield();
+#endif
+
   if (VMInstance.DispatchStatus == FAILBREAK)
   {
     if (VMInstance.ProgramId != GUI_SLOT)
@@ -2612,6 +3474,10 @@ RESULT    mSchedExit(void)
   // Do any kind of cleanup that needs to be done.
   dynloadVMExit();
 
+#ifndef DISABLE_PROGRAM_PRELOAD
+  ProgramStandbyFree();
+#endif
+
   Result    |=  cValidateExit();
   Result    |=  cSoundExit();
   Result    |=  cComExit();
@@ -2854,6 +3720,7 @@ PRIM      PrimDispatchTabel[PRIMDISPATHTABLE_SIZE] =
   [opOUTPUT_READ]         =   &cOutputRead,
   [opOUTPUT_TEST]         =   &cOutputTest,
   [opOUTPUT_READY]        =   &cOutputReady,
+  [opOUTPUT_POSITION]     =   &cOutputPosition,
   [opOUTPUT_STEP_POWER]   =   &cOutputStepPower,
   [opOUTPUT_TIME_POWER]   =   &cOutputTimePower,
   [opOUTPUT_STEP_SPEED]   =   &cOutputStepSpeed,
@@ -2863,6 +3730,9 @@ PRIM      PrimDispatchTabel[PRIMDISPATHTABLE_SIZE] =
   [opOUTPUT_CLR_COUNT]    =   &cOutputClrCount,
   [opOUTPUT_GET_COUNT]    =   &cOutputGetCount,
   [opOUTPUT_PRG_STOP]     =   &cOutputPrgStop,
+  [opOUTPUT_HOLD]         =   &cOutputHold,
+  [opOUTPUT_STALL]        =   &cOutputStall,
+  [opOUTPUT_STALL_READY]  =   &cOutputStallReady,
   [opFILE]                =   &cMemoryFile,
   [opARRAY]               =   &cMemoryArray,
   [opARRAY_WRITE]         =   &cMemoryArrayWrite,
@@ -3287,6 +4157,12 @@ void      ObjectCall(void)
 
   // Get object to call from byte stream
   ObjectIdToCall  =  *(OBJID*)PrimParPointer();
+#ifndef DISABLE_LAZY_VALIDATION
+  if (ObjectValidate(ObjectIdToCall) != OK)
+  { // Called object not valid - program is stopped (FAILBREAK)
+  }
+  else
+#endif
   if ((*VMInstance.pObjList[ObjectIdToCall]).ObjStatus == STOPPED)
   { // Object free
 
@@ -3420,6 +4296,25 @@ void      Sleep(void)
  *    - \return (DATA8)     DATA   - Program name\n
  *
  *\n
+ *  - CMD = SET_BP_COND
+ *    - \param  (DATA16)    PRGID  - Program slot number  (see \ref prgid)
+ *    - \param  (DATA32)    ADDR   - Address of breakpoint set by opBP_SET
+ *    - \param  (DATA8)     COND   - Condition (see \ref bpcondition)
+ *    - \param  (DATA32)    OFFSET - Offset to DATA32 global variable compared
+ *    - \param  (DATA32)    VALUE  - Value compared (hit count if COND = BP_HIT_COUNT)\n
+ *
+ *\n
+ *  - CMD = GET_BP_HITS
+ *    - \param  (DATA16)    PRGID  - Program slot number  (see \ref prgid)
+ *    - \param  (DATA32)    ADDR   - Address of breakpoint set by opBP_SET
+ *    - \return (DATA32)    HITS   - Number of times the breakpoint has been passed (0 if none)\n
+ *
+ *\n
+ *  - CMD = CLR_BP
+ *    - \param  (DATA16)    PRGID  - Program slot number  (see \ref prgid)
+ *    - \param  (DATA32)    ADDR   - Address of breakpoint to remove\n
+ *
+ *\n
  */
 /*! \brief    opPROGRAM_INFO byte code
  *
@@ -3435,6 +4330,11 @@ void      ProgramInfo(void)
   DATA16  Instr;
   PRGID   PrgId;
   OBJID   ObjIndex;
+  IMINDEX Addr;
+  DATA8   Cond;
+  DATA32  Offset;
+  DATA32  Value;
+  BRKP    *pBrkp;
 
   Cmd             =  *(DATA8*)PrimParPointer();
   PrgId           =  *(PRGID*)PrimParPointer();
@@ -3504,6 +4404,61 @@ void      ProgramInfo(void)
     }
     break;
 
+    case SET_BP_COND :
+    {
+      Addr    =  *(IMINDEX*)PrimParPointer();
+      Cond    =  *(DATA8*)PrimParPointer();
+      Offset  =  *(DATA32*)PrimParPointer();
+      Value   =  *(DATA32*)PrimParPointer();
+
+      if ((VMInstance.Program[PrgId].Status != STOPPED) && (Cond >= 0) && (Cond < BP_CONDITIONS))
+      {
+        pBrkp  =  BreakFind(PrgId,Addr);
+        if (pBrkp != NULL)
+        {
+          if ((Cond == BP_ALWAYS) || (Cond == BP_HIT_COUNT) || ((Offset >= 0) && ((Offset + (DATA32)sizeof(DATA32)) <= (DATA32)(*(IMGHEAD*)VMInstance.Program[PrgId].pImage).GlobalBytes)))
+          {
+            (*pBrkp).Cond    =  Cond;
+            (*pBrkp).Offset  =  (GBINDEX)Offset;
+            (*pBrkp).Value   =  Value;
+          }
+        }
+      }
+    }
+    break;
+
+    case GET_BP_HITS :
+    {
+      Addr    =  *(IMINDEX*)PrimParPointer();
+      Value   =  0;
+
+      if (VMInstance.Program[PrgId].Status != STOPPED)
+      {
+        pBrkp  =  BreakFind(PrgId,Addr);
+        if (pBrkp != NULL)
+        {
+          Value  =  (DATA32)(*pBrkp).Hits;
+        }
+      }
+      *(DATA32*)PrimParPointer()              =  Value;
+    }
+    break;
+
+    case CLR_BP :
+    {
+      Addr    =  *(IMINDEX*)PrimParPointer();
+
+      if (VMInstance.Program[PrgId].Status != STOPPED)
+      {
+        pBrkp  =  BreakFind(PrgId,Addr);
+        if (pBrkp != NULL)
+        {
+          BreakRemove(PrgId,pBrkp);
+        }
+      }
+    }
+    break;
+
     default :
     {
       SetDispatchStatus(FAILBREAK);
@@ -3658,18 +4613,223 @@ void      Do(void)
 }
 
 
+#define   BRKP_HASH(Addr)     (((ULONG)(Addr) ^ ((ULONG)(Addr) >> 7)) & (BRKP_TABLE_SIZE - 1))
+
+
+/*! \brief    Find breakpoint in program
+ *
+ *            Breakpoints are kept in a hash table indexed by image offset
+ *            (linear probing, empty entries have Addr = 0)
+ *
+ *  \param    PrgId   Program slot number
+ *  \param    Addr    Offset from start of image
+ *  \return   BRKP*   Breakpoint or NULL if not found (always NULL inside image header)
+ */
+BRKP      *BreakFind(PRGID PrgId,IMINDEX Addr)
+{
+  BRKP    *pBrkp = NULL;
+  UWORD   Index;
+  UWORD   Tmp;
+
+  if (Addr < sizeof(IMGHEAD))
+  { // Image header never holds byte codes (and 0 marks empty entries)
+
+    return (NULL);
+  }
+
+  Index  =  BRKP_HASH(Addr);
+
+  for (Tmp = 0;(Tmp < BRKP_TABLE_SIZE) && (pBrkp == NULL);Tmp++)
+  {
+    if (VMInstance.Program[PrgId].Brkp[Index].Addr == Addr)
+    {
+      pBrkp  =  &VMInstance.Program[PrgId].Brkp[Index];
+    }
+    else
+    {
+      if (VMInstance.Program[PrgId].Brkp[Index].Addr == 0)
+      {
+        break;
+      }
+      Index  =  (Index + 1) & (BRKP_TABLE_SIZE - 1);
+    }
+  }
+
+  return (pBrkp);
+}
+
+
+/*! \brief    Remove breakpoint and restore the substituted opcode
+ *
+ *            Following entries in the probe sequence are moved back
+ *            so the table needs no deleted markers
+ *
+ *  \param    PrgId   Program slot number
+ *  \param    pBrkp   Breakpoint in table
+ */
+void      BreakRemove(PRGID PrgId,BRKP *pBrkp)
+{
+  BRKP    *pTable;
+  UWORD   Empty;
+  UWORD   Index;
+  UWORD   Home;
+
+  pTable  =  VMInstance.Program[PrgId].Brkp;
+
+  VMInstance.Program[PrgId].pImage[(*pBrkp).Addr]  =  (*pBrkp).OpCode;
+
+  Empty   =  (UWORD)(pBrkp - pTable);
+  Index   =  Empty;
+
+  while (1)
+  {
+    Index  =  (Index + 1) & (BRKP_TABLE_SIZE - 1);
+    if (pTable[Index].Addr == 0)
+    {
+      break;
+    }
+    Home  =  BRKP_HASH(pTable[Index].Addr);
+    if (((Index - Home) & (BRKP_TABLE_SIZE - 1)) >= ((Index - Empty) & (BRKP_TABLE_SIZE - 1)))
+    {
+      pTable[Empty]  =  pTable[Index];
+      Empty          =  Index;
+    }
+  }
+  memset(&pTable[Empty],0,sizeof(BRKP));
+  VMInstance.Program[PrgId].Brkps--;
+}
+
+
+/*! \brief    Insert breakpoint and patch the image
+ *
+ *  \param    PrgId   Program slot number
+ *  \param    No      Breakpoint type [0..3]
+ *  \param    Addr    Offset from start of image
+ */
+void      BreakInsert(PRGID PrgId,DATA8 No,IMINDEX Addr)
+{
+  BRKP    *pBrkp;
+  UWORD   Index;
+
+  pBrkp  =  BreakFind(PrgId,Addr);
+
+  if (pBrkp == NULL)
+  {
+#ifndef DISABLE_LAZY_VALIDATION
+    // Objects must be validated before their byte codes are patched
+
+    if (!VMInstance.Program[PrgId].Validated)
+    {
+      for (Index = 1;Index <= VMInstance.Program[PrgId].Objects;Index++)
+      {
+        if (!VMInstance.Program[PrgId].pObjValid[Index])
+        {
+          if (cValidateObject(VMInstance.Program[PrgId].pImage,(OBJID)Index,VMInstance.Program[PrgId].Label) != OK)
+          {
+            return;
+          }
+          VMInstance.Program[PrgId].pObjValid[Index]  =  1;
+        }
+      }
+      VMInstance.Program[PrgId].Validated  =  1;
+    }
+#endif
+    if (VMInstance.Program[PrgId].Brkps < (BRKP_TABLE_SIZE - 1))
+    {
+      Index  =  BRKP_HASH(Addr);
+      while (VMInstance.Program[PrgId].Brkp[Index].Addr != 0)
+      {
+        Index  =  (Index + 1) & (BRKP_TABLE_SIZE - 1);
+      }
+      pBrkp             =  &VMInstance.Program[PrgId].Brkp[Index];
+      (*pBrkp).Addr     =  Addr;
+      (*pBrkp).OpCode   =  (OP)VMInstance.Program[PrgId].pImage[Addr];
+      (*pBrkp).Cond     =  BP_ALWAYS;
+      (*pBrkp).Hits     =  0;
+      (*pBrkp).BusyObj  =  0;
+      VMInstance.Program[PrgId].Brkps++;
+    }
+  }
+  if (pBrkp != NULL)
+  {
+    (*pBrkp).No                             =  No;
+    VMInstance.Program[PrgId].pImage[Addr]  =  opBP0 + No;
+  }
+}
+
+
+/*! \brief    Evaluate breakpoint condition
+ *
+ *  \param    pBrkp   Breakpoint passed (Hits already counted)
+ *  \return   DATA8   Stop (0 = no, 1 = yes)
+ */
+DATA8     BreakCondition(BRKP *pBrkp)
+{
+  DATA8   Stop = 1;
+  DATA32  Global;
+
+  if ((*pBrkp).Cond == BP_HIT_COUNT)
+  {
+    if ((*pBrkp).Value > 1)
+    {
+      Stop  =  (((*pBrkp).Hits % (ULONG)(*pBrkp).Value) == 0) ? 1 : 0;
+    }
+  }
+  else
+  {
+    if ((*pBrkp).Cond != BP_ALWAYS)
+    {
+      memcpy(&Global,&VMInstance.pGlobal[(*pBrkp).Offset],sizeof(DATA32));
+
+      switch ((*pBrkp).Cond)
+      {
+        case BP_EQUAL :
+        {
+          Stop  =  (Global == (*pBrkp).Value) ? 1 : 0;
+        }
+        break;
+
+        case BP_NOT_EQUAL :
+        {
+          Stop  =  (Global != (*pBrkp).Value) ? 1 : 0;
+        }
+        break;
+
+        case BP_LESS :
+        {
+          Stop  =  (Global < (*pBrkp).Value) ? 1 : 0;
+        }
+        break;
+
+        case BP_GREATER :
+        {
+          Stop  =  (Global > (*pBrkp).Value) ? 1 : 0;
+        }
+        break;
+
+      }
+    }
+  }
+
+  return (Stop);
+}
+
+
 /*! \page VM
  *  <hr size="1"/>
  *  <b>     opBP0 - opBP3 </b>
  *
- *- Display globals or object locals on terminal\n
- *- Removes it self when done
+ *- Count hit and evaluate condition of breakpoint at this address\n
+ *- A substituted opcode that waits (BUSYBREAK) is one hit, not one per retry
+ *- If condition is met display globals or object locals on terminal (opBP3 pulses TP4)
+ *- Executes the substituted opcode and stays in place
  *- Dispatch status unchanged
  *
  */
 /*! \brief    opBP0 - opBP3 byte code
  *
- *            Display globals or object locals on terminal
+ *            Only reached at patched addresses so the program runs at full
+ *            speed until a breakpoint is passed
  *
  *            Uses following from current program context:
  *            pObjHead, ObjectIp, ProgramId
@@ -3678,37 +4838,67 @@ void      Do(void)
 void      BreakPoint(void)
 {
   IP      TmpIp;
+  IMINDEX Addr;
   DATA8   No;
+  DATA8   Stop = 1;
+  BRKP    *pBrkp;
   float   Instr;
 
   TmpIp   =  (--VMInstance.ObjectIp);
   No      =  *(DATA8*)TmpIp;
+  Addr    =  (IMINDEX)TmpIp - (IMINDEX)VMInstance.pImage;
+  pBrkp   =  BreakFind(VMInstance.ProgramId,Addr);
 
-  if (VMInstance.Program[VMInstance.ProgramId].Brkp[No & 0x03].OpCode)
+  if (pBrkp != NULL)
   {
-    *(DATA8*)TmpIp  =  VMInstance.Program[VMInstance.ProgramId].Brkp[No & 0x03].OpCode;
+    *(DATA8*)TmpIp  =  (*pBrkp).OpCode;
+    if ((*pBrkp).BusyObj == VMInstance.ObjectId)
+    { // Substituted opcode is retried after BUSYBREAK - same pass
+
+      (*pBrkp).BusyObj  =  0;
+      Stop              =  0;
+    }
+    else
+    {
+      (*pBrkp).Hits++;
+      Stop            =  BreakCondition(pBrkp);
+    }
   }
   else
   {
     VMInstance.ObjectIp++;
   }
 
-  if ((No & 0x03) == 3)
-  {
-    cUiTestpin(1);
-    cUiTestpin(0);
-  }
-  else
+  if (Stop)
   {
-    Instr  =  VMInstance.Program[VMInstance.ProgramId].InstrCnt +  VMInstance.InstrCnt;
+    if ((No & 0x03) == 3)
+    {
+      cUiTestpin(1);
+      cUiTestpin(0);
+    }
+    else
+    {
+      Instr  =  VMInstance.Program[VMInstance.ProgramId].InstrCnt +  VMInstance.InstrCnt;
 
-    snprintf(VMInstance.PrintBuffer,PRINTBUFFERSIZE,"\r\nBREAKPOINT #%d (%.0f)",No & 0x03,Instr);
-    VmPrint(VMInstance.PrintBuffer);
+      snprintf(VMInstance.PrintBuffer,PRINTBUFFERSIZE,"\r\nBREAKPOINT #%d @%lu [%lu] (%.0f)",No & 0x03,(unsigned long)Addr,(pBrkp != NULL) ? (unsigned long)(*pBrkp).Hits : 0UL,Instr);
+      VmPrint(VMInstance.PrintBuffer);
 
-    VMInstance.Debug  =  1;
+      VMInstance.Debug  =  1;
+    }
   }
   PrimDispatchTabel[*(VMInstance.ObjectIp++)]();
-  *(DATA8*)TmpIp  =  No;
+
+  // Patch again unless removed meanwhile
+  pBrkp   =  BreakFind(VMInstance.ProgramId,Addr);
+  if (pBrkp != NULL)
+  {
+    *(DATA8*)TmpIp  =  opBP0 + (*pBrkp).No;
+    if (VMInstance.ObjectIp == TmpIp)
+    { // Rewound (BUSYBREAK) - next entry by this object is not counted
+
+      (*pBrkp).BusyObj  =  VMInstance.ObjectId;
+    }
+  }
 }
 
 
@@ -3717,11 +4907,12 @@ void      BreakPoint(void)
  *  <b>     opBP_SET (PRGID, NO, ADDRESS)</b>
  *
  *- Set break point in byte code program\n
+ *- Up to BRKP_TABLE_SIZE - 1 break points per program - see also opPROGRAM_INFO SET_BP_COND, GET_BP_HITS and CLR_BP
  *- Dispatch status unchanged
  *
  *  \param  (DATA16)  PRGID   - Program slot number (see \ref prgid)
- *  \param  (DATA8)   NO      - Breakpoint number [0..2] (3 = trigger out on TP4)
- *  \param  (DATA32)  ADDRESS - Address (Offset from start of image) (0 = remove breakpoint)
+ *  \param  (DATA8)   NO      - Breakpoint type [0..2] (3 = trigger out on TP4)
+ *  \param  (DATA32)  ADDRESS - Address (Offset from start of image) (0 = remove all breakpoints of type NO)
  */
 /*! \brief    opBP_SET byte code
  *
@@ -3736,30 +4927,38 @@ void      BreakSet(void)
   PRGID   PrgId;
   DATA8   No;
   DATA32  Addr;
+  UWORD   Index;
 
   PrgId   =  *(PRGID*)PrimParPointer();
   No      =  *(DATA8*)PrimParPointer();
   Addr    =  *(IMINDEX*)PrimParPointer();
 
-  if (No < MAX_BREAKPOINTS)
+  if ((No >= 0) && (No < MAX_BREAKPOINTS))
   {
     if (VMInstance.Program[PrgId].Status != STOPPED)
     {
       if (Addr)
       {
-        VMInstance.Program[PrgId].Brkp[No].Addr     =  Addr;
-        VMInstance.Program[PrgId].Brkp[No].OpCode   =  (OP)VMInstance.Program[PrgId].pImage[Addr];
-        VMInstance.Program[PrgId].pImage[Addr]      =  opBP0 + No;
+        if ((Addr >= (DATA32)sizeof(IMGHEAD)) && (Addr < (DATA32)(*(IMGHEAD*)VMInstance.Program[PrgId].pImage).ImageSize))
+        {
+          BreakInsert(PrgId,No,(IMINDEX)Addr);
+        }
       }
       else
       {
-        if ((VMInstance.Program[PrgId].Brkp[No].Addr != 0) && (VMInstance.Program[PrgId].Brkp[No].OpCode != 0))
+        Index  =  0;
+        while (Index < BRKP_TABLE_SIZE)
         {
-          Addr  =  VMInstance.Program[PrgId].Brkp[No].Addr;
-          VMInstance.Program[PrgId].pImage[Addr]  =  VMInstance.Program[PrgId].Brkp[No].OpCode;
+          if ((VMInstance.Program[PrgId].Brkp[Index].Addr != 0) && (VMInstance.Program[PrgId].Brkp[Index].No == No))
+          {
+            // Next entry may be moved here
+            BreakRemove(PrgId,&VMInstance.Program[PrgId].Brkp[Index]);
+          }
+          else
+          {
+            Index++;
+          }
         }
-        VMInstance.Program[PrgId].Brkp[No].Addr     =  0;
-        VMInstance.Program[PrgId].Brkp[No].OpCode   =  0;
       }
     }
   }
@@ -3947,6 +5146,36 @@ void      Info(void)
 }
 
 
+/*! \brief    Get length of string parameter just fetched by "PrimParPointer"
+ *
+ *            If the parameter was a handle with a tracked length (see \ref cMemoryGetStringLength)
+ *            no scanning is done - the handle is read only here so tracking is re-armed
+ *
+ *  \param    pString   Pointer returned by "PrimParPointer"
+ *
+ *  \return   Length of string (not including zero termination)
+ */
+DATA32    StringParLength(DATA8 *pString)
+{
+  DATA32  Length;
+
+  if ((VMInstance.Handle >= 0) && (VMInstance.HandleLength >= 0))
+  {
+    Length  =  VMInstance.HandleLength;
+  }
+  else
+  {
+    Length  =  (DATA32)strlen((char*)pString);
+  }
+  if (VMInstance.Handle >= 0)
+  {
+    cMemorySetStringLength(VMInstance.ProgramId,VMInstance.Handle,Length);
+  }
+
+  return (Length);
+}
+
+
 /*! \page VM
  *  <hr size="1"/>
  *  <b>     opSTRINGS (CMD, ....)  </b>
@@ -4037,6 +5266,10 @@ void      Info(void)
  *\ref stringexample1 "Program Example"
  */
 /*! \brief  opSTRINGS byte code
+ *
+ *  String handles keep their length in the array descriptor so GET_SIZE, COMPARE
+ *  and ADD do not need to scan. ADD with DESTINATION equal to SOURCE1 appends in
+ *  place and grows the handle geometrically.
  *
  */
 void      Strings(void)
@@ -4049,6 +5282,10 @@ void      Strings(void)
   DATA16  Data16;
   DATA32  Data32;
   DATA32  Start;
+  DATA32  Length1;
+  DATA32  Length2;
+  HANDLER Handle1;
+  DATA8   *pTmp;
   DATA8   Tmp;
   DATA8   Figures;
   DATA8   Decimals;
@@ -4061,28 +5298,60 @@ void      Strings(void)
     case GET_SIZE :
     {
       pSource1                    =  (DATA8*)PrimParPointer();
-      *(DATA16*)PrimParPointer()  =  (DATA16)strlen((char*)pSource1);
+      Length1                     =  StringParLength(pSource1);
+      *(DATA16*)PrimParPointer()  =  (DATA16)Length1;
     }
     break;
 
     case ADD :
     {
       pSource1                    =  (DATA8*)PrimParPointer();
+      Length1                     =  StringParLength(pSource1);
+      Handle1                     =  VMInstance.Handle;
       pSource2                    =  (DATA8*)PrimParPointer();
+      Length2                     =  StringParLength(pSource2);
       pDestination                =  (DATA8*)PrimParPointer();
       if (VMInstance.Handle >= 0)
       {
-        Data32        =  (DATA32)strlen((char*)pSource1);
-        Data32       +=  (DATA32)strlen((char*)pSource2);
-        Data32       +=  1;
-        if (Data32 > MIN_ARRAY_ELEMENTS)
+        Data32        =  Length1 + Length2 + 1;
+
+        if (VMInstance.Handle == Handle1)
+        { // Append in place (only SOURCE2 is copied)
+
+          pSource1      =  pDestination;
+          pDestination  =  (DATA8*)cMemoryGrow(VMInstance.ProgramId,VMInstance.Handle,Data32);
+          if (pSource2 == pSource1)
+          {
+            pSource2    =  pDestination;
+          }
+          pSource1      =  pDestination;
+        }
+        else
         {
-          pDestination  =  (DATA8*)VmMemoryResize(VMInstance.Handle,Data32);
+          if (Data32 > MIN_ARRAY_ELEMENTS)
+          {
+            pTmp          =  pDestination;
+            pDestination  =  (DATA8*)VmMemoryResize(VMInstance.Handle,Data32);
+            if (pSource2 == pTmp)
+            { // Handle moved by resize
+
+              pSource2    =  pDestination;
+            }
+          }
         }
       }
       if (pDestination != NULL)
       {
-        sprintf((char*)pDestination,"%s%s",(char*)pSource1,(char*)pSource2);
+        memmove((void*)&pDestination[Length1],(void*)pSource2,(size_t)Length2);
+        pDestination[Length1 + Length2]  =  0;
+        if (pSource1 != pDestination)
+        {
+          memmove((void*)pDestination,(void*)pSource1,(size_t)Length1);
+        }
+        if (VMInstance.Handle >= 0)
+        {
+          cMemorySetStringLength(VMInstance.ProgramId,VMInstance.Handle,Length1 + Length2);
+        }
       }
     }
     break;
@@ -4090,9 +5359,11 @@ void      Strings(void)
     case COMPARE :
     {
       pSource1                    =  (DATA8*)PrimParPointer();
+      Length1                     =  StringParLength(pSource1);
       pSource2                    =  (DATA8*)PrimParPointer();
+      Length2                     =  StringParLength(pSource2);
 
-      if (strcmp((char*)pSource1,(char*)pSource2) == 0)
+      if ((Length1 == Length2) && (memcmp((void*)pSource1,(void*)pSource2,(size_t)Length1) == 0))
       {
         *(DATA8*)PrimParPointer()  =  1;
       }
@@ -4106,19 +5377,33 @@ void      Strings(void)
     case DUPLICATE :
     {
       pSource1                    =  (DATA8*)PrimParPointer();
+      Length1                     =  StringParLength(pSource1);
       pDestination                =  (DATA8*)PrimParPointer();
       if (VMInstance.Handle >= 0)
       {
-        Data32        =  (DATA32)strlen((char*)pSource1);
-        Data32       +=  1;
+        Data32        =  Length1 + 1;
         if (Data32 > MIN_ARRAY_ELEMENTS)
         {
-          pDestination  =  (DATA8*)VmMemoryResize(VMInstance.Handle,Data32);
+          if (pSource1 == pDestination)
+          { // Duplicate onto itself
+
+            pDestination  =  (DATA8*)VmMemoryResize(VMInstance.Handle,Data32);
+            pSource1      =  pDestination;
+          }
+          else
+          {
+            pDestination  =  (DATA8*)VmMemoryResize(VMInstance.Handle,Data32);
+          }
         }
       }
       if (pDestination != NULL)
       {
-        strcpy((char*)pDestination,(char*)pSource1);
+        memmove((void*)pDestination,(void*)pSource1,(size_t)Length1);
+        pDestination[Length1]  =  0;
+        if (VMInstance.Handle >= 0)
+        {
+          cMemorySetStringLength(VMInstance.ProgramId,VMInstance.Handle,Length1);
+        }
       }
     }
     break;
@@ -4257,11 +5542,11 @@ void      Strings(void)
     case STRIP :
     {
       pSource1      =  (DATA8*)PrimParPointer();
+      Length1       =  StringParLength(pSource1);
       pDestination  =  (DATA8*)PrimParPointer();
       if (VMInstance.Handle >= 0)
       {
-        Data32        =  (DATA32)strlen((char*)pSource1);
-        Data32       +=  1;
+        Data32        =  Length1 + 1;
         if (Data32 > MIN_ARRAY_ELEMENTS)
         {
           pDestination  =  (DATA8*)VmMemoryResize(VMInstance.Handle,Data32);
@@ -4269,16 +5554,21 @@ void      Strings(void)
       }
       if (pDestination != NULL)
       {
+        Length2       =  0;
         while (*pSource1)
         {
           if ((*pSource1 != ' '))
           {
-            *pDestination  =  *pSource1;
-            pDestination++;
+            pDestination[Length2]  =  *pSource1;
+            Length2++;
           }
           pSource1++;
         }
-        *pDestination  =  *pSource1;
+        pDestination[Length2]  =  *pSource1;
+        if (VMInstance.Handle >= 0)
+        {
+          cMemorySetStringLength(VMInstance.ProgramId,VMInstance.Handle,Length2);
+        }
       }
     }
     break;
@@ -4286,13 +5576,14 @@ void      Strings(void)
     case SUB :
     {
       pSource1                    =  (DATA8*)PrimParPointer();
+      Length1                     =  StringParLength(pSource1);
       pSource2                    =  (DATA8*)PrimParPointer();
+      Start                       =  StringParLength(pSource2);
       pDestination                =  (DATA8*)PrimParPointer();
 
-      Start                       =  (DATA32)strlen((char*)pSource2);
       if (VMInstance.Handle >= 0)
       {
-        Data32        =  (DATA32)strlen((char*)pSource1);
+        Data32        =  Length1;
         Data32       +=  1;
         if (Data32 > MIN_ARRAY_ELEMENTS)
         {
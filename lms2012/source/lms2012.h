@@ -72,6 +72,7 @@ Development with debug messages:    DEBUG defined, TERMINAL_ENABLED = 1, DEBUG_U
 //#define   DEBUG_D_UI
 //#define   DEBUG_D_SOUND
 //#define   DEBUG_D_IIC
+//#define   DEBUG_D_IIC_TARGET
 //#define   DEBUG_D_USBDEV
 
 //#define   ENABLE_TEST_ON_PORT4
@@ -91,12 +92,24 @@ Development with debug messages:    DEBUG defined, TERMINAL_ENABLED = 1, DEBUG_U
 //#define   DEBUG_TRACE_FREEZE
 //#define   DEBUG_TRACE_FILENAME
 //#define   DEBUG_TRACE_IIC
+//#define   DEBUG_TRACE_MODE2
+//#define   DEBUG_TRACE_BT_LINK
+//#define   DEBUG_TRACE_BT_BROADCAST
+//#define   DEBUG_TRACE_TOPLINE
+//#define   DEBUG_TRACE_WIFI_LATENCY
+//#define   DEBUG_TRACE_WIFI_RECONNECT
+//#define   DEBUG_TRACE_UDP_MSG
 //#define   DEBUG_SDCARD
 //#define   DEBUG_USBSTICK
 //#define   DEBUG_VIRTUAL_BATT_TEMP
 //#define   DEBUG_TEMP_SHUTDOWN
 //#define   DEBUG_BACK_BLOCKED
 //#define   DEBUG_MEMORY_USAGE
+//#define   DEBUG_TRACE_PRELOAD
+//#define   DEBUG_TRACE_IDLE
+//#define   DEBUG_TRACE_ADC
+//#define   DEBUG_TRACE_HOLD
+//#define   DEBUG_TRACE_HOTPLUG
 #define   DEBUG_RECHARGEABLE
 #define   ALLOW_DEBUG_PULSE
 
@@ -181,10 +194,16 @@ char      *HwId = "03";
 //#define   DISABLE_PAR_ALIGNMENT         //!< Disable possibility to align sub call parameter types
 //#define   DISABLE_NEW_CALL_MUTEX        //!< Disable smart object switching after return from non reentrant sub call (enables blocked thread call)
 //#define   DISABLE_SYSTEM_BYTECODE       //!< Disable the use of opSYSTEM command
+//#define   DISABLE_BT_BROADCAST          //!< Send mailbox writes to all slaves one by one
 //#define   DISABLE_FILENAME_CHECK        //!< Disable "c_memory" filename check
 //#define   DISABLE_AD_WORD_PROTECT       //!< Disable A/D word result protection
 //#define   DISABLE_UPDATE_DISASSEMBLY    //!< Disable disassemble of running update commands
 //#define   DISABLE_BLOCK_ALIAS_LOCALS    //!< Disable change of block locals if sub call alias (parallelism)
+//#define   DISABLE_PROGRAM_PRELOAD       //!< Don't preload last run program into standby
+//#define   DISABLE_IDLE_LOOP_PARKING     //!< Don't park objects spinning in side effect free back-edge loops
+//#define   DISABLE_LAZY_VALIDATION       //!< Validate all byte codes in user programs before start (not per object when first scheduled)
+//#define   DISABLE_FAST_DCM              //!< Don't identify input devices before the full connect steady time
+//#define   DISABLE_BATT_COMPENSATION     //!< Don't scale unregulated motor power to nominal battery voltage
 
 #define   TESTDEVICE    3
 
@@ -258,7 +277,8 @@ char      *HwId = "03";
 
 
 #define   MAX_PROGRAMS          SLOTS                 //!< Max number of programs (including UI and direct commands) running at a time
-#define   MAX_BREAKPOINTS       4                     //!< Max number of breakpoints (opCODES depends on this value)
+#define   MAX_BREAKPOINTS       4                     //!< Max number of breakpoint types (opCODES depends on this value)
+#define   BRKP_TABLE_SIZE       128                   //!< Max number of breakpoints per program (power of 2)
 #define   MAX_LABELS            32                    //!< Max number of labels per program
 #define   MAX_DEVICE_TYPE       127                   //!< Highest type number (positive)
 #define   MAX_VALID_TYPE        vmMAX_VALID_TYPE      //!< Highest valid type
@@ -283,6 +303,7 @@ char      *HwId = "03";
 
 #define   LOGBUFFER_SIZE        1000                  //!< Min log buffer size
 #define   DEVICE_LOGBUF_SIZE    300                   //!< Device log buffer size (black layer buffer)
+#define   DCM_EVENTS            16                    //!< Device connection event queue size (must be power of 2)
 #define   MIN_LIVE_UPDATE_TIME  10                    //!< [mS] Min sample time when live update
 
 #define   MIN_IIC_REPEAT_TIME   10                    //!< [mS] Min IIC device repeat time
@@ -352,6 +373,9 @@ char      *HwId = "03";
 #define   USBDEV_DEVICE         "lms_usbdev"          //!< USB device
 #define   USBDEV_DEVICE_NAME    "/dev/lms_usbdev"     //!< USB device
 
+#define   USBBULK_DEVICE        "lms_usbbulk"         //!< USB vendor bulk interface
+#define   USBBULK_DEVICE_NAME   "/dev/lms_usbbulk"    //!< USB vendor bulk interface
+
 #define   USBHOST_DEVICE        "lms_usbhost"         //!< USB host
 #define   USBHOST_DEVICE_NAME   "/dev/lms_usbhost"    //!< USB host
 
@@ -443,6 +467,7 @@ char      *HwId = "03";
 #define   DEFAULT_SLEEPMINUTES  vmDEFAULT_SLEEPMINUTES
 
 #define   COM_CMD_DEVICE_NAME   USBDEV_DEVICE_NAME    //!< USB HID command pipe device file name
+#define   COM_BULK_DEVICE_NAME  USBBULK_DEVICE_NAME   //!< USB bulk command pipe device file name
 
 /*! \endverbatim
  *
@@ -541,6 +566,10 @@ char      *HwId = "03";
 #define   UPDATE_SDCARD         500                   //!< Update sdcard size   [mS]
 #define   UPDATE_USBSTICK       500                   //!< Update usbstick size [mS]
 
+#define   IDLE_LOOP_CACHE       32                    //!< Number of analysed back-edges remembered (power of 2)
+#define   IDLE_LOOP_BODY        64                    //!< Max loop body size analysed for idle loop parking [bytes]
+#define   IDLE_LOOP_VARS        16                    //!< Max variables read or written in idle loop body
+
 
 // Per start of (polution) defines
 #define   MAX_SOUND_DATA_SIZE   250
@@ -711,8 +740,14 @@ OBJ;
  */
 typedef   struct
 {
-  IMINDEX Addr;                         //!< Offset to breakpoint address from image start
+  IMINDEX Addr;                         //!< Offset to breakpoint address from image start (0 = empty)
   OP      OpCode;                       //!< Saved substituted opcode
+  DATA8   No;                           //!< Breakpoint type [0..3] (patched opcode is opBP0 + No)
+  DATA8   Cond;                         //!< Condition for stopping (see \ref bpcondition)
+  GBINDEX Offset;                       //!< Offset to DATA32 global compared in condition
+  DATA32  Value;                        //!< Value compared in condition
+  ULONG   Hits;                         //!< Number of times the breakpoint has been passed
+  OBJID   BusyObj;                      //!< Object waiting on the substituted opcode (BUSYBREAK) - not a new pass (0 = none)
 }
 BRKP;
 
@@ -742,17 +777,77 @@ typedef   struct
   OBJSTAT   StatusChange;               //!< Program status change
   RESULT    Result;                     //!< Program result (OK, BUSY, FAIL)
 
-  BRKP      Brkp[MAX_BREAKPOINTS];      //!< Storage for breakpoint logic
+  BRKP      Brkp[BRKP_TABLE_SIZE];      //!< Storage for breakpoint logic (hashed by address)
+  UWORD     Brkps;                      //!< Number of breakpoints set
 
   LABEL     Label[MAX_LABELS];          //!< Storage for labels
   UWORD     Debug;                      //!< Debug flag
 
   DATA8     Name[FILENAME_SIZE];
 
+  ULONG     LoadTime;                   //!< Time used by last image load (opFILE LOAD_IMAGE) [uS]
+  ULONG     ResetTime;                  //!< Time used by validation and reset at program start [uS]
+#ifndef DISABLE_IDLE_LOOP_PARKING
+  ULONG     IdleParks;                  //!< Number of times an object was parked on an idle back-edge
+#endif
+#ifndef DISABLE_LAZY_VALIDATION
+  UBYTE     *pObjValid;                 //!< Pointer to object validated flags (index = object id)
+  DATA8     Validated;                  //!< All objects validated at program start
+#endif
+
 }
 PRG;
 
 
+#ifndef DISABLE_IDLE_LOOP_PARKING
+
+/*! \struct IDLELOOP
+ *          Result of back-edge analysis (cached by address of instruction following the branch)
+ */
+typedef   struct
+{
+  IP        pEnd;                       //!< Instruction pointer after back-edge branch (NULL = empty)
+  DATA8     Idle;                       //!< Loop body is side effect free and only waits for external inputs
+}
+IDLELOOP;
+
+#endif
+
+
+#ifndef DISABLE_PROGRAM_PRELOAD
+
+/*! \enum STANDBYSTATE
+ *          State of the program preloaded into standby
+ */
+typedef   enum
+{
+  STANDBY_EMPTY,                        //!< Nothing loaded (preloads "Filename" when user slot is idle)
+  STANDBY_LOADED,                       //!< Image read from file - validated and ram allocated in next idle update
+  STANDBY_READY,                        //!< Image loaded, validated and ram allocated and cleared
+  STANDBY_CLAIMED,                      //!< Image handed to user slot - ram follows at program start
+  STANDBY_FAILED                        //!< Preload failed (not retried until new file name)
+}
+STANDBYSTATE;
+
+/*! \struct STANDBY
+ *          Program kept ready in standby for fast program start
+ */
+typedef   struct
+{
+  char      Filename[vmFILENAMESIZE];   //!< Full path of image to preload
+  DATA8     State;                      //!< See \ref STANDBYSTATE
+  IP        pImage;                     //!< Image (not owned by any program until claimed)
+  DATA32    ImageSize;                  //!< Image size [bytes]
+  DATA32    ModTime;                    //!< Image file modification time when loaded
+  VARDATA   *pData;                     //!< Cleared ram for globals and objects
+  GBINDEX   RamSize;                    //!< Size of ram [bytes]
+  LABEL     Label[MAX_LABELS];          //!< Labels found while validating
+}
+STANDBY;
+
+#endif
+
+
 #define     TYPE_NAME_LENGTH    11
 #define     SYMBOL_LENGTH       4       //!< Symbol leng th (not including zero)
 
@@ -852,6 +947,12 @@ extern    OBJSTAT   ProgramStatusChange(PRGID PrgId);        // Get program stat
 
 extern    void      ProgramEnd(PRGID PrgId);
 
+#ifndef DISABLE_PROGRAM_PRELOAD
+extern    void      ProgramPreload(char *pFileName);         // Set program to keep ready in standby
+
+extern    RESULT    ProgramStandbyClaim(PRGID PrgId,char *pFileName,IP *ppImage,DATA32 *pSize); // Get image from standby
+#endif
+
 extern    OBJID     CallingObjectId(void);                   // Get calling objects id
 
 extern    void      AdjustObjectIp(IMOFFS Value);            // Adjust IP
@@ -948,6 +1049,51 @@ COLORSTRUCT;
 
 //        INTERFACE BETWEEN SHARED LIBRARIES AND MODULES
 
+/*! \page DcmEvents
+ *
+ *  <b>     Device Connection Events </b>
+ *
+ *  <hr size="1"/>
+ *
+ *  The device connection manager in the analog module appends an event to the queue in
+ *  shared memory every time the connection or type on a port changes. "DcmEventIn" counts
+ *  all events ever written - the reader keeps its own count and reads from
+ *  "DcmEvent[Count & (DCM_EVENTS - 1)]" until it has caught up.
+ *
+ *  An input device is identified as soon as its pin signature has been steady for a short
+ *  time (DCM_EVENT_CONNECT). When it has stayed for the full connect steady time the
+ *  identification is confirmed (DCM_EVENT_CONFIRM) - or retracted by a DCM_EVENT_DISCONNECT.
+ *
+ *  For connect and confirm events "Time" is the DCM time "DcmTime" at which the pin signature
+ *  first left the open port condition - so "DcmTime - Time" is the time since the device was
+ *  plugged in. For disconnect events it is the time of the event.
+ *
+ *  \verbatim
+ */
+
+enum      DCM_EVENT
+{
+  DCM_EVENT_DISCONNECT,
+  DCM_EVENT_CONNECT,
+  DCM_EVENT_CONFIRM
+};
+
+typedef   struct
+{
+  ULONG   Time;                   //!< DCM time when device was plugged in [mS]
+  DATA8   Port;                   //!< Input port [0..INPUTS - 1] or INPUTS + output port
+  DATA8   Event;                  //!< DCM_EVENT_xxx
+  DATA8   Type;                   //!< Device type after event
+  DATA8   Conn;                   //!< Connection type after event
+}
+DCMEVENT;
+
+/*\endverbatim
+ *
+ *  \n
+ */
+
+
 /*! \page AnalogModuleMemory
  *  <b>     Shared Memory </b>
  *
@@ -987,6 +1133,10 @@ typedef   struct
 
   DATA8   OutDcm[OUTPUTS];        //!< Output port device types
   DATA8   OutConn[OUTPUTS];
+
+  DCMEVENT  DcmEvent[DCM_EVENTS]; //!< Device connection event queue
+  UWORD   DcmEventIn;             //!< Events written to queue
+  ULONG   DcmTime;                //!< DCM time [mS]
 #ifndef DISABLE_PREEMPTED_VM
   UWORD   PreemptMilliSeconds;
 #endif
@@ -1097,6 +1247,10 @@ typedef   struct
   DATA8   Changed[INPUTS];
   DATA8   Output[INPUTS][IIC_DATA_LENGTH];    //!< Bytes to IIC device
   DATA8   OutputLength[INPUTS];
+  ULONG   Time[INPUTS];                       //!< [mS] Driver time stamp of latest Raw data
+  DATA8   Result[INPUTS];                     //!< Result of latest IIC write/read (OK, BUSY, FAIL)
+  DATA8   Input[INPUTS][IIC_DATA_LENGTH];     //!< Bytes read by latest IIC write/read
+  DATA8   InputLength[INPUTS];
 }
 IIC;
 
@@ -1337,6 +1491,9 @@ typedef struct
   SLONG TachoCounts;
   SBYTE Speed;
   SLONG TachoSensor;
+  UBYTE Stalled;                        //!< Stall detected - cleared by next run command
+  UWORD StallCount;                     //!< Stall events since motor type change
+  UWORD Vbatt;                          //!< Battery voltage [mV] written by VM (0 = not known)
 }MOTORDATA;
 
 typedef struct
@@ -1402,6 +1559,34 @@ typedef struct
   DATA32  Time;
   DATA8   Brake;
 } TIMESYNC;
+
+typedef struct
+{
+  DATA8   Cmd;
+  DATA8   Nos;
+  DATA32  Position;
+} OUTPUTPOSITION;
+
+typedef struct
+{
+  DATA8   Cmd;
+  DATA8   Nos;
+  DATA16  Kp;                           //!< Proportional gain  [0.01 %/degree]
+  DATA16  Ki;                           //!< Integral gain      [0.01 %/(degree*S)]
+  DATA16  Kd;                           //!< Differential gain  [0.01 %/speed %]
+  DATA8   Deadband;                     //!< Position deadband  [degree]
+  DATA8   Power;                        //!< Max power          [0..100%]
+} HOLDSETUP;
+
+typedef struct
+{
+  DATA8   Cmd;
+  DATA8   Nos;
+  DATA8   Power;                        //!< Min power          [0..100%] (0 = disabled)
+  DATA8   Speed;                        //!< Max speed          [0..100%]
+  DATA16  Delay;                        //!< Stall delay        [mS]
+  DATA8   Action;                       //!< Stall action       (STALL_ACTION)
+} STALLSETUP;
 /*
  *                 End of Motor/OUTPUT Typedef
  */
@@ -1420,6 +1605,16 @@ typedef struct
   PRGID     FavouritePrg;
   PRGID     ProgramId;                    //!< Program id running
   PRG       Program[MAX_PROGRAMS];        //!< Program[0] is the UI byte codes running
+#ifndef DISABLE_PROGRAM_PRELOAD
+  STANDBY   Standby;                      //!< Program preloaded for user slot
+#endif
+#ifndef DISABLE_IDLE_LOOP_PARKING
+  IDLELOOP  IdleLoop[IDLE_LOOP_CACHE];    //!< Analysed back-edges
+  DATA8     IdleParked;                   //!< Running object parked on idle back-edge in this slice
+  ULONG     IdleSlices;                   //!< Consecutive slices ended parked or waiting
+  ULONG     IdleYields;                   //!< Number of times the VM thread slept because all objects were idle
+  ULONG     IdleTime;                     //!< Time given back to the system by sleeping [uS]
+#endif
 
 
   ULONG     InstrCnt;                     //!< Instruction counter (performance test)
@@ -1463,6 +1658,7 @@ typedef struct
 
   ULONG     Value;
   HANDLER   Handle;
+  DATA32    HandleLength;                 //!< Tracked string length of "Handle" before parameter was fetched (-1 = unknown)
 
   ERR       Errors[ERROR_BUFFER_SIZE];
   UBYTE     ErrorIn;
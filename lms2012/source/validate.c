@@ -1646,6 +1646,124 @@ RESULT    cValidateBytecode(IP pI,IMINDEX *pIndex,LABEL *pLabel)
 }
 
 
+/*! \brief    Check image and object headers without scanning byte codes
+ *
+ *            Used for lazy validation: byte codes are validated per object by "cValidateObject"
+ *            before the object is scheduled for the first time. Images not suited for this
+ *            (object headers without instruction offsets) must be validated by "cValidateProgram"
+ *
+ *  \param    pI      Pointer to image
+ *  \return   RESULT  OK if headers are valid and every object has a valid instruction offset
+ */
+RESULT    cValidateImage(IP pI)
+{
+  RESULT  Result = OK;
+  IMINDEX TotalSize;        // Total image size
+  OBJID   Objects;          // Total number of objects
+  OBJHEAD *pOH;
+  OBJID   ObjIndex;
+  IMINDEX ImageIndex;       // Index to first instruction
+
+
+  cValidateSetErrorIndex(0);
+
+  TotalSize   =  (*(IMGHEAD*)pI).ImageSize;
+  Objects     =  (*(IMGHEAD*)pI).NumberOfObjects;
+
+  // Check size
+  ImageIndex  =  sizeof(IMGHEAD) + Objects * sizeof(OBJHEAD);
+
+  if ((TotalSize < ImageIndex) || (Objects == 0))
+  { // Size too small
+
+    cValidateSetErrorIndex(4);
+    Result  =  FAIL;
+  }
+  else
+  {
+    pOH       =  (OBJHEAD*)&pI[sizeof(IMGHEAD) - sizeof(OBJHEAD)];
+
+    for (ObjIndex = 1;(ObjIndex <= Objects) && (Result == OK);ObjIndex++)
+    {
+      if (((IMINDEX)pOH[ObjIndex].OffsetToInstructions < ImageIndex) || ((IMINDEX)pOH[ObjIndex].OffsetToInstructions >= TotalSize) || (pOH[ObjIndex].OwnerObjectId > Objects))
+      {
+        cValidateSetErrorIndex(sizeof(IMGHEAD) + (ObjIndex - 1) * sizeof(OBJHEAD));
+        Result  =  FAIL;
+      }
+    }
+  }
+
+  return (Result);
+}
+
+
+/*! \brief    Validate byte codes in one object
+ *
+ *            Same checks as "cValidateProgram" does for the object but starting at the object
+ *            instruction offset (headers must have been checked by "cValidateImage")
+ *
+ *  \param    pI      Pointer to image
+ *  \param    ObjId   Object to validate
+ *  \param    pLabel  Label table to update
+ *  \return   RESULT  OK or FAIL
+ */
+RESULT    cValidateObject(IP pI,OBJID ObjId,LABEL *pLabel)
+{
+  RESULT  Result = OK;
+  IMINDEX TotalSize;        // Total image size
+  OBJHEAD *pOH;
+  IMINDEX ImageIndex;       // Index into total image
+  IMINDEX TmpIndex = 0;     // Lached "ImageIndex"
+  UBYTE   ParIndex;
+  UBYTE   Type;
+
+
+  cValidateSetErrorIndex(0);
+
+  TotalSize   =  (*(IMGHEAD*)pI).ImageSize;
+  pOH         =  (OBJHEAD*)&pI[sizeof(IMGHEAD) - sizeof(OBJHEAD)];
+  ImageIndex  =  (IMINDEX)pOH[ObjId].OffsetToInstructions;
+  TmpIndex    =  ImageIndex;
+
+  // Check for SUBCALL parameter description
+  if ((pOH[ObjId].OwnerObjectId == 0) && (pOH[ObjId].TriggerCount == 1))
+  { // SUBCALL object
+
+    ParIndex  =  (IMINDEX)pI[ImageIndex++];
+    while ((ParIndex) && (ImageIndex < TotalSize))
+    {
+      Type  =  pI[ImageIndex++];
+      if ((Type & CALLPAR_TYPE) == CALLPAR_STRING)
+      {
+        ImageIndex++;
+      }
+      ParIndex--;
+    }
+  }
+
+  // Scan all byte codes in object
+  while ((Result == OK) && (ImageIndex < TotalSize))
+  {
+    TmpIndex  =  ImageIndex;
+    Result    =  cValidateBytecode(pI,&ImageIndex,pLabel);
+  }
+  if ((Result == FAIL) || (ImageIndex > TotalSize))
+  {
+    cValidateSetErrorIndex(TmpIndex);
+    Result  =  FAIL;
+  }
+  else
+  {
+    Result  =  OK;
+  }
+#ifdef    DEBUG
+  printf("Object %d validated %d..%d %s\r\n",ObjId,(IMINDEX)pOH[ObjId].OffsetToInstructions,ImageIndex,(Result == OK) ? "OK" : "FAIL");
+#endif
+
+  return (Result);
+}
+
+
 RESULT    cValidateProgram(PRGID PrgId,IP pI,LABEL *pLabel,DATA8 Disassemble)
 {
   RESULT  Result;
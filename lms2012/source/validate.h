@@ -30,6 +30,10 @@ RESULT    cValidateDisassemble(IP pI,IMINDEX *pIndex,LABEL *pLabel);
 
 RESULT    cValidateProgram(PRGID PrgId,IP pI,LABEL *pLabel,DATA8 Disassemble);
 
+RESULT    cValidateImage(IP pI);
+
+RESULT    cValidateObject(IP pI,OBJID ObjId,LABEL *pLabel);
+
 
 typedef struct
 {